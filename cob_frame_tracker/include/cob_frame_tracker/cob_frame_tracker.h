@@ -41,6 +41,7 @@
 
 #include <kdl_parser/kdl_parser.hpp>
 #include <kdl/chainiksolvervel_pinv.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
 #include <kdl/chainfksolvervel_recursive.hpp>
 #include <kdl/frames.hpp>
 #include <kdl/jntarray.hpp>
@@ -50,8 +51,12 @@
 #include <dynamic_reconfigure/server.h>
 #include <dynamic_reconfigure/Reconfigure.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
 
 
+/// [s] the estimated twist of the target is reset if its TF is not updated within this interval (e.g. a static target)
+#define TARGET_TWIST_MAX_SAMPLE_INTERVAL 0.5
+
 typedef actionlib::SimpleActionServer<cob_frame_tracker::FrameTrackingAction> SAS_FrameTrackingAction_t;
 
 struct HoldTf
@@ -64,13 +69,27 @@ struct HoldTf
 class CobFrameTracker
 {
 public:
-    CobFrameTracker()
+    /// Stand-alone tracker: parameters in the node namespace, own TF listener.
+    CobFrameTracker() :
+        tf_listener_(new tf::TransformListener())
+    {
+        ht_.hold = false;
+    }
+
+    /**
+     * @param nh The namespace of the chain; its callback queue is used for all callbacks of the tracker.
+     * @param tf_listener TF listener (possibly shared with other trackers of the process).
+     */
+    CobFrameTracker(const ros::NodeHandle& nh, const boost::shared_ptr<tf::TransformListener>& tf_listener) :
+        nh_(nh),
+        tf_listener_(tf_listener)
     {
         ht_.hold = false;
     }
 
     ~CobFrameTracker()
     {
+        jntToCartSolver_pos_.reset();
         jntToCartSolver_vel_.reset();
         as_.reset();
         reconfigure_server_.reset();
@@ -87,6 +106,19 @@ public:
 
     bool getTransform(const std::string& from, const std::string& to, tf::StampedTransform& stamped_tf);
 
+    /// Pose of the tracking frame w.r.t. chain_base_link (FK for the chain tip).
+    bool getTrackingFramePose(tf::StampedTransform& stamped_tf);
+
+    /**
+     * Pose of the target frame w.r.t. the tracking frame (FK for the chain tip, TF for the target).
+     * The target pose is extrapolated to the current time with its estimated twist.
+     * @param twist_ff The estimated twist of the target w.r.t. the tracking frame (feedforward).
+     */
+    bool getTrackingError(tf::StampedTransform& stamped_tf, KDL::Twist& twist_ff);
+
+    /// Estimates the twist of the target (w.r.t. chain_base_link) from the last two poses of its TF.
+    void updateTargetTwist(const tf::StampedTransform& cb_transform_target);
+
     void publishZeroTwist();
     void publishTwist(ros::Duration period, bool do_publish = true);
     void publishHoldTwist(const ros::Duration& period);
@@ -98,6 +130,7 @@ public:
     void action_abort();
 
 private:
+    ros::NodeHandle nh_;
     HoldTf ht_;
 
     double update_rate_;
@@ -133,9 +166,12 @@ private:
     KDL::Chain chain_;
     KDL::JntArray last_q_;
     KDL::JntArray last_q_dot_;
+    boost::shared_ptr<KDL::ChainFkSolverPos_recursive> jntToCartSolver_pos_;
     boost::shared_ptr<KDL::ChainFkSolverVel_recursive> jntToCartSolver_vel_;
+    bool joint_states_valid_;       ///< last_q_ has been received
+    ros::Time joint_states_stamp_;
 
-    tf::TransformListener tf_listener_;
+    boost::shared_ptr<tf::TransformListener> tf_listener_;
 
     ros::Subscriber jointstate_sub_;
     ros::Publisher twist_pub_;
@@ -180,6 +216,15 @@ private:
     KDL::Twist current_twist_;
     KDL::Twist target_twist_;
 
+    /// Moving target
+    tf::StampedTransform target_pose_;  ///< last TF sample of the target frame (w.r.t. chain_base_link)
+    bool target_pose_valid_;
+    tf::Vector3 target_vel_;            ///< estimated twist of the target frame (w.r.t. chain_base_link)
+    tf::Vector3 target_rot_;
+    double target_feedforward_;         ///< gain of the estimated twist of the target within the published twist
+    double target_twist_filter_time_;   ///< [s] time constant of the low-pass filter of the estimated twist
+    double target_max_extrapolation_;   ///< [s] maximum extrapolation of the target pose to the current time
+
     double cart_distance_;
     double rot_distance_;
 
@@ -34,9 +34,8 @@
 
 bool CobFrameTracker::initialize()
 {
-    ros::NodeHandle nh_;
-    ros::NodeHandle nh_tracker("frame_tracker");
-    ros::NodeHandle nh_twist("twist_controller");
+    ros::NodeHandle nh_tracker(nh_, "frame_tracker");
+    ros::NodeHandle nh_twist(nh_, "twist_controller");
 
     /// get params
     if (nh_tracker.hasParam("update_rate"))
@@ -88,6 +87,9 @@ bool CobFrameTracker::initialize()
     dof_ = chain_.getNrOfJoints();
     last_q_ = KDL::JntArray(dof_);
     last_q_dot_ = KDL::JntArray(dof_);
+    joint_states_valid_ = false;
+    jntToCartSolver_pos_.reset(new KDL::ChainFkSolverPos_recursive(chain_));
+    jntToCartSolver_vel_.reset(new KDL::ChainFkSolverVel_recursive(chain_));
 
     if (nh_tracker.hasParam("movable_trans"))
     {    nh_tracker.getParam("movable_trans", movable_trans_);    }
@@ -145,6 +147,13 @@ bool CobFrameTracker::initialize()
     current_twist_.Zero();
     target_twist_.Zero();
 
+    target_pose_valid_ = false;
+    target_vel_.setZero();
+    target_rot_.setZero();
+    target_feedforward_ = 1.0;
+    target_twist_filter_time_ = 0.05;
+    target_max_extrapolation_ = 0.1;
+
     abortion_counter_ = 0;
     max_abortions_ = update_rate_;    // if tracking fails for 1 second
 
@@ -218,8 +227,8 @@ bool CobFrameTracker::getTransform(const std::string& from, const std::string& t
 
     try
     {
-        tf_listener_.waitForTransform(from, to, ros::Time(0), ros::Duration(0.2));
-        tf_listener_.lookupTransform(from, to, ros::Time(0), stamped_tf);
+        tf_listener_->waitForTransform(from, to, ros::Time(0), ros::Duration(0.2));
+        tf_listener_->lookupTransform(from, to, ros::Time(0), stamped_tf);
         transform = true;
     }
     catch (tf::TransformException& ex)
@@ -230,25 +239,130 @@ bool CobFrameTracker::getTransform(const std::string& from, const std::string& t
     return transform;
 }
 
+/**
+ * The pose of the chain tip is computed from the latest joint states, i.e. it does not depend on the delay of the robot_state_publisher.
+ * Other tracking frames (i.e. lookat_focus) are looked up in TF.
+ */
+bool CobFrameTracker::getTrackingFramePose(tf::StampedTransform& stamped_tf)
+{
+    if (tracking_frame_ != chain_tip_link_ || !joint_states_valid_)
+    {
+        return this->getTransform(chain_base_link_, tracking_frame_, stamped_tf);
+    }
+
+    KDL::Frame frame;
+    if (jntToCartSolver_pos_->JntToCart(last_q_, frame) < 0)
+    {
+        ROS_ERROR("ChainFkSolverPos failed!");
+        return false;
+    }
+
+    double x, y, z, w;
+    frame.M.GetQuaternion(x, y, z, w);
+    stamped_tf = tf::StampedTransform(tf::Transform(tf::Quaternion(x, y, z, w), tf::Vector3(frame.p.x(), frame.p.y(), frame.p.z())),
+                                      joint_states_stamp_, chain_base_link_, tracking_frame_);
+    return true;
+}
+
+/**
+ * For the chain tip only the target frame is looked up in TF (w.r.t. chain_base_link), such that the error is
+ * as recent as the joint states and the target.
+ * The TF of the target lags behind the current time (e.g. for a perceived object). It is extrapolated with the
+ * estimated twist of the target, which is also returned as feedforward such that a moving target is tracked without lag.
+ */
+bool CobFrameTracker::getTrackingError(tf::StampedTransform& stamped_tf, KDL::Twist& twist_ff)
+{
+    tf::StampedTransform cb_transform_tracking, cb_transform_target;
+    if (!this->getTrackingFramePose(cb_transform_tracking) || !this->getTransform(chain_base_link_, target_frame_, cb_transform_target))
+    {
+        return false;
+    }
+
+    this->updateTargetTwist(cb_transform_target);
+
+    const double dt = std::min(std::max((ros::Time::now() - cb_transform_target.stamp_).toSec(), 0.0), target_max_extrapolation_);
+    cb_transform_target.setOrigin(cb_transform_target.getOrigin() + target_vel_ * dt);
+    const double angle = target_rot_.length() * dt;
+    if (angle > 0.0)
+    {
+        cb_transform_target.setRotation(tf::Quaternion(target_rot_.normalized(), angle) * cb_transform_target.getRotation());
+    }
+
+    stamped_tf = tf::StampedTransform(cb_transform_tracking.inverseTimes(cb_transform_target), cb_transform_target.stamp_, tracking_frame_, target_frame_);
+
+    const tf::Matrix3x3 tracking_basis_cb = cb_transform_tracking.getBasis().transpose();
+    const tf::Vector3 vel = tracking_basis_cb * target_vel_;
+    const tf::Vector3 rot = tracking_basis_cb * target_rot_;
+    twist_ff = KDL::Twist(KDL::Vector(vel.x(), vel.y(), vel.z()), KDL::Vector(rot.x(), rot.y(), rot.z()));
+    return true;
+}
+
+/**
+ * The twist is the difference quotient of successive TF samples of the target, smoothed by a first order low-pass filter.
+ * Samples with the same stamp (no new TF data) do not change the estimate.
+ */
+void CobFrameTracker::updateTargetTwist(const tf::StampedTransform& cb_transform_target)
+{
+    const double dt = (cb_transform_target.stamp_ - target_pose_.stamp_).toSec();
+    if (target_pose_valid_ && target_pose_.child_frame_id_ == cb_transform_target.child_frame_id_ && dt <= 0.0)
+    {
+        /// the transform of the target is not updated anymore: do not feed forward the last estimate forever
+        if ((ros::Time::now() - target_pose_.stamp_).toSec() > TARGET_TWIST_MAX_SAMPLE_INTERVAL)
+        {
+            target_vel_.setZero();
+            target_rot_.setZero();
+        }
+        return;
+    }
+
+    if (!target_pose_valid_ || target_pose_.child_frame_id_ != cb_transform_target.child_frame_id_ || dt > TARGET_TWIST_MAX_SAMPLE_INTERVAL)
+    {
+        target_vel_.setZero();
+        target_rot_.setZero();
+    }
+    else
+    {
+        const tf::Vector3 vel = (cb_transform_target.getOrigin() - target_pose_.getOrigin()) / dt;
+
+        /// rotation from the last to the current orientation (w.r.t. chain_base_link) along the shortest path
+        tf::Quaternion delta = cb_transform_target.getRotation() * target_pose_.getRotation().inverse();
+        if (delta.w() < 0.0)
+        {
+            delta = -delta;
+        }
+        const tf::Vector3 rot = delta.getAxis() * (delta.getAngle() / dt);
+
+        const double alpha = dt / (target_twist_filter_time_ + dt);
+        target_vel_ += (vel - target_vel_) * alpha;
+        target_rot_ += (rot - target_rot_) * alpha;
+    }
+
+    target_pose_ = cb_transform_target;
+    target_pose_valid_ = true;
+}
+
 void CobFrameTracker::publishZeroTwist()
 {
     // publish zero Twist for stopping
-    geometry_msgs::TwistStamped twist_msg;
+    geometry_msgs::TwistStampedPtr twist_msg(new geometry_msgs::TwistStamped());
     ros::Time now = ros::Time::now();
-    twist_msg.header.frame_id = tracking_frame_;
-    twist_msg.header.stamp = now;
+    twist_msg->header.frame_id = tracking_frame_;
+    twist_msg->header.stamp = now;
     twist_pub_.publish(twist_msg);
 }
 
 void CobFrameTracker::publishTwist(ros::Duration period, bool do_publish)
 {
     tf::StampedTransform transform_tf;
-    bool success = this->getTransform(tracking_frame_, target_frame_, transform_tf);
+    KDL::Twist twist_ff = KDL::Twist::Zero();
+    bool success = this->getTrackingError(transform_tf, twist_ff);
 
-    geometry_msgs::TwistStamped twist_msg, error_msg;
+    /// the command is passed by pointer (not serialized for a TwistController in the same process)
+    geometry_msgs::TwistStampedPtr twist_msg(new geometry_msgs::TwistStamped());
+    geometry_msgs::TwistStamped error_msg;
     ros::Time now = ros::Time::now();
-    twist_msg.header.frame_id = tracking_frame_;
-    twist_msg.header.stamp = now;
+    twist_msg->header.frame_id = tracking_frame_;
+    twist_msg->header.stamp = now;
     error_msg.header.frame_id = tracking_frame_;
     error_msg.header.stamp = now;
 
@@ -274,9 +388,9 @@ void CobFrameTracker::publishTwist(ros::Duration period, bool do_publish)
 
     if (movable_trans_)
     {
-        twist_msg.twist.linear.x = pid_controller_trans_x_.computeCommand(error_trans_x, period);
-        twist_msg.twist.linear.y = pid_controller_trans_y_.computeCommand(error_trans_y, period);
-        twist_msg.twist.linear.z = pid_controller_trans_z_.computeCommand(error_trans_z, period);
+        twist_msg->twist.linear.x = pid_controller_trans_x_.computeCommand(error_trans_x, period) + target_feedforward_ * twist_ff.vel.x();
+        twist_msg->twist.linear.y = pid_controller_trans_y_.computeCommand(error_trans_y, period) + target_feedforward_ * twist_ff.vel.y();
+        twist_msg->twist.linear.z = pid_controller_trans_z_.computeCommand(error_trans_z, period) + target_feedforward_ * twist_ff.vel.z();
     }
 
     if (movable_rot_)
@@ -284,9 +398,9 @@ void CobFrameTracker::publishTwist(ros::Duration period, bool do_publish)
         /// ToDo: Consider angular error as RPY or Quaternion?
         /// ToDo: What to do about sign conversion (pi->-pi) in angular rotation?
 
-        twist_msg.twist.angular.x = pid_controller_rot_x_.computeCommand(error_rot_x, period);
-        twist_msg.twist.angular.y = pid_controller_rot_y_.computeCommand(error_rot_y, period);
-        twist_msg.twist.angular.z = pid_controller_rot_z_.computeCommand(error_rot_z, period);
+        twist_msg->twist.angular.x = pid_controller_rot_x_.computeCommand(error_rot_x, period) + target_feedforward_ * twist_ff.rot.x();
+        twist_msg->twist.angular.y = pid_controller_rot_y_.computeCommand(error_rot_y, period) + target_feedforward_ * twist_ff.rot.y();
+        twist_msg->twist.angular.z = pid_controller_rot_z_.computeCommand(error_rot_z, period) + target_feedforward_ * twist_ff.rot.z();
     }
 
     /// debug only
@@ -304,12 +418,12 @@ void CobFrameTracker::publishTwist(ros::Duration period, bool do_publish)
     if (std::fabs(transform_tf.getOrigin().z()) >= max_vel_rot_)
         ROS_WARN("Twist.angular.z: %f exceeds limit %f", transform_tf.getOrigin().z(), max_vel_rot_);
 
-    twist_msg.twist.linear.x = copysign(std::min(max_vel_lin_, std::fabs(transform_tf.getOrigin().x())),transform_tf.getOrigin().x());
-    twist_msg.twist.linear.y = copysign(std::min(max_vel_lin_, std::fabs(transform_tf.getOrigin().y())),transform_tf.getOrigin().y());
-    twist_msg.twist.linear.z = copysign(std::min(max_vel_lin_, std::fabs(transform_tf.getOrigin().z())),transform_tf.getOrigin().z());
-    twist_msg.twist.angular.x = copysign(std::min(max_vel_rot_, std::fabs(transform_tf.getRotation().x())),transform_tf.getRotation().x());
-    twist_msg.twist.angular.y = copysign(std::min(max_vel_rot_, std::fabs(transform_tf.getRotation().y())),transform_tf.getRotation().y());
-    twist_msg.twist.angular.z = copysign(std::min(max_vel_rot_, std::fabs(transform_tf.getRotation().z())),transform_tf.getRotation().z());
+    twist_msg->twist.linear.x = copysign(std::min(max_vel_lin_, std::fabs(transform_tf.getOrigin().x())),transform_tf.getOrigin().x());
+    twist_msg->twist.linear.y = copysign(std::min(max_vel_lin_, std::fabs(transform_tf.getOrigin().y())),transform_tf.getOrigin().y());
+    twist_msg->twist.linear.z = copysign(std::min(max_vel_lin_, std::fabs(transform_tf.getOrigin().z())),transform_tf.getOrigin().z());
+    twist_msg->twist.angular.x = copysign(std::min(max_vel_rot_, std::fabs(transform_tf.getRotation().x())),transform_tf.getRotation().x());
+    twist_msg->twist.angular.y = copysign(std::min(max_vel_rot_, std::fabs(transform_tf.getRotation().y())),transform_tf.getRotation().y());
+    twist_msg->twist.angular.z = copysign(std::min(max_vel_rot_, std::fabs(transform_tf.getRotation().z())),transform_tf.getRotation().z());
     **/
 
     // eukl distance
@@ -321,12 +435,12 @@ void CobFrameTracker::publishTwist(ros::Duration period, bool do_publish)
     // rot_distance_ = 2* acos(transform_msg.transform.rotation.w);
 
     // get target_twist
-    target_twist_.vel.x(twist_msg.twist.linear.x);
-    target_twist_.vel.y(twist_msg.twist.linear.y);
-    target_twist_.vel.z(twist_msg.twist.linear.z);
-    target_twist_.rot.x(twist_msg.twist.angular.x);
-    target_twist_.rot.y(twist_msg.twist.angular.y);
-    target_twist_.rot.z(twist_msg.twist.angular.z);
+    target_twist_.vel.x(twist_msg->twist.linear.x);
+    target_twist_.vel.y(twist_msg->twist.linear.y);
+    target_twist_.vel.z(twist_msg->twist.linear.z);
+    target_twist_.rot.x(twist_msg->twist.angular.x);
+    target_twist_.rot.y(twist_msg->twist.angular.y);
+    target_twist_.rot.z(twist_msg->twist.angular.z);
 
     if (do_publish)
     {
@@ -338,12 +452,13 @@ void CobFrameTracker::publishTwist(ros::Duration period, bool do_publish)
 void CobFrameTracker::publishHoldTwist(const ros::Duration& period)
 {
     tf::StampedTransform transform_tf;
-    bool success = this->getTransform(chain_base_link_, tracking_frame_, transform_tf);
+    bool success = this->getTrackingFramePose(transform_tf);
 
-    geometry_msgs::TwistStamped twist_msg, error_msg;
+    geometry_msgs::TwistStampedPtr twist_msg(new geometry_msgs::TwistStamped());
+    geometry_msgs::TwistStamped error_msg;
     ros::Time now = ros::Time::now();
-    twist_msg.header.frame_id = tracking_frame_;
-    twist_msg.header.stamp = now;
+    twist_msg->header.frame_id = tracking_frame_;
+    twist_msg->header.stamp = now;
     error_msg.header.frame_id = tracking_frame_;
     error_msg.header.stamp = now;
 
@@ -373,13 +488,13 @@ void CobFrameTracker::publishHoldTwist(const ros::Duration& period)
             error_msg.twist.angular.y = error_rot_y;
             error_msg.twist.angular.z = error_rot_z;
 
-            twist_msg.twist.linear.x = pid_controller_trans_x_.computeCommand(error_trans_x, period);
-            twist_msg.twist.linear.y = pid_controller_trans_y_.computeCommand(error_trans_y, period);
-            twist_msg.twist.linear.z = pid_controller_trans_z_.computeCommand(error_trans_z, period);
+            twist_msg->twist.linear.x = pid_controller_trans_x_.computeCommand(error_trans_x, period);
+            twist_msg->twist.linear.y = pid_controller_trans_y_.computeCommand(error_trans_y, period);
+            twist_msg->twist.linear.z = pid_controller_trans_z_.computeCommand(error_trans_z, period);
 
-            twist_msg.twist.angular.x = pid_controller_rot_x_.computeCommand(error_rot_x, period);
-            twist_msg.twist.angular.y = pid_controller_rot_y_.computeCommand(error_rot_y, period);
-            twist_msg.twist.angular.z = pid_controller_rot_z_.computeCommand(error_rot_z, period);
+            twist_msg->twist.angular.x = pid_controller_rot_x_.computeCommand(error_rot_x, period);
+            twist_msg->twist.angular.y = pid_controller_rot_y_.computeCommand(error_rot_y, period);
+            twist_msg->twist.angular.z = pid_controller_rot_z_.computeCommand(error_rot_z, period);
         }
     }
 
@@ -413,7 +528,7 @@ bool CobFrameTracker::startTrackingCallback(cob_srvs::SetString::Request& reques
     else
     {
         // check whether given target frame exists
-        if (!tf_listener_.frameExists(request.data))
+        if (!tf_listener_->frameExists(request.data))
         {
             std::string msg = "CobFrameTracker: StartTracking denied because target frame '" + request.data + "' does not exist";
             ROS_ERROR_STREAM(msg);
@@ -463,7 +578,7 @@ bool CobFrameTracker::startLookatCallback(cob_srvs::SetString::Request& request,
     else
     {
         // check whether given target frame exists
-        if (!tf_listener_.frameExists(request.data))
+        if (!tf_listener_->frameExists(request.data))
         {
             std::string msg = "CobFrameTracker: StartLookat denied because target frame '" + request.data + "' does not exist";
             ROS_ERROR_STREAM(msg);
@@ -588,7 +703,7 @@ void CobFrameTracker::goalCB()
             // Goal should not be accepted
             ROS_ERROR_STREAM("CobFrameTracker: Received ActionGoal while tracking/lookat Service is active!");
         }
-        else if (!tf_listener_.frameExists(goal_->tracking_frame))
+        else if (!tf_listener_->frameExists(goal_->tracking_frame))
         {
             // Goal should not be accepted
             ROS_ERROR_STREAM("CobFrameTracker: Received ActionGoal but target frame '" << goal_->tracking_frame << "' does not exist");
@@ -752,10 +867,11 @@ void CobFrameTracker::jointstateCallback(const sensor_msgs::JointState::ConstPtr
     {
         last_q_ = q_temp;
         last_q_dot_ = q_dot_temp;
+        joint_states_valid_ = true;
+        joint_states_stamp_ = msg->header.stamp;
         ///---------------------------------------------------------------------
         KDL::FrameVel FrameVel;
         KDL::JntArrayVel jntArrayVel = KDL::JntArrayVel(last_q_, last_q_dot_);
-        jntToCartSolver_vel_.reset(new KDL::ChainFkSolverVel_recursive(chain_));
         int ret = jntToCartSolver_vel_->JntToCart(jntArrayVel, FrameVel, -1);
         if (ret >= 0)
         {
@@ -779,6 +895,9 @@ void CobFrameTracker::reconfigureCallback(cob_frame_tracker::FrameTrackerConfig&
     twist_dead_threshold_rot_ = config.twist_dead_threshold_rot;
     twist_deviation_threshold_lin_ = config.twist_deviation_threshold_lin;
     twist_deviation_threshold_rot_ = config.twist_deviation_threshold_rot;
+    target_feedforward_ = config.target_feedforward;
+    target_twist_filter_time_ = config.target_twist_filter_time;
+    target_max_extrapolation_ = config.target_max_extrapolation;
 }
 
 /** checks whether the twist is infinitesimally small **/
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <tf/transform_listener.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <cob_frame_tracker/cob_frame_tracker.h>
+
+namespace cob_frame_tracker
+{
+
+/**
+ * The FrameTracker of one chain within a nodelet manager.
+ * The twist commands are passed to a TwistController in the same manager without serialization.
+ * If ~share_tf_listener is set (default), all FrameTrackers of the manager use the same TF buffer. This buffer is shared
+ * within this package only: TwistControllerNodelets and ObstacleDistanceNodelets in the same manager keep their own ones
+ * (the packages have no common library to hold a process-wide listener), i.e. a manager runs up to three TF buffers.
+ */
+class FrameTrackerNodelet : public nodelet::Nodelet
+{
+    public:
+        virtual ~FrameTrackerNodelet()
+        {
+            this->tracker_.reset();
+        }
+
+    private:
+        virtual void onInit()
+        {
+            bool share_tf_listener;
+            this->getPrivateNodeHandle().param<bool>("share_tf_listener", share_tf_listener, true);
+            boost::shared_ptr<tf::TransformListener> tf_listener = share_tf_listener ? getSharedTfListener() : boost::shared_ptr<tf::TransformListener>(new tf::TransformListener());
+
+            this->tracker_.reset(new CobFrameTracker(this->getNodeHandle(), tf_listener));
+            if (!this->tracker_->initialize())
+            {
+                ROS_ERROR("Failed to initialize FrameTracker");
+                this->tracker_.reset();
+            }
+        }
+
+        /// @return The TF listener of all FrameTrackers of the process (created on first use, not shared with other packages).
+        static boost::shared_ptr<tf::TransformListener> getSharedTfListener()
+        {
+            static boost::weak_ptr<tf::TransformListener> shared_tf_listener;
+            static boost::mutex shared_tf_listener_lock;
+
+            boost::mutex::scoped_lock lock(shared_tf_listener_lock);
+            boost::shared_ptr<tf::TransformListener> tf_listener = shared_tf_listener.lock();
+            if (!tf_listener)
+            {
+                tf_listener.reset(new tf::TransformListener());
+                shared_tf_listener = tf_listener;
+            }
+
+            return tf_listener;
+        }
+
+        boost::shared_ptr<CobFrameTracker> tracker_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cob_frame_tracker::FrameTrackerNodelet, nodelet::Nodelet)
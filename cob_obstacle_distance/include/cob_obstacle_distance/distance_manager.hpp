@@ -22,6 +22,7 @@
 #include <thread>
 #include <mutex>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <cob_obstacle_distance/link_to_collision.hpp>
 
 #include <ros/ros.h>
@@ -68,7 +69,7 @@ class DistanceManager
         ros::NodeHandle& nh_;
         ros::Publisher marker_pub_;
         ros::Publisher obstacle_distances_pub_;
-        tf::TransformListener tf_listener_;
+        boost::shared_ptr<tf::TransformListener> tf_listener_;
         Eigen::Affine3d tf_cb_frame_bl_;
 
         std::vector<std::string> joints_;
@@ -100,6 +101,12 @@ class DistanceManager
          */
         DistanceManager(ros::NodeHandle& nh);
 
+        /**
+         * @param nh Reference to the ROS node handle.
+         * @param tf_listener TF listener (possibly shared with other DistanceManagers of the process).
+         */
+        DistanceManager(ros::NodeHandle& nh, const boost::shared_ptr<tf::TransformListener>& tf_listener);
+
         ~DistanceManager();
 
         inline const std::string getRootFrame() const
@@ -108,7 +115,7 @@ class DistanceManager
         }
 
         /**
-         * Clears all managed obstacles and objects of interest.
+         * Stops the self collision transform threads and clears all managed obstacles and objects of interest.
          */
         void clear();
 
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <thread>
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <tf/transform_listener.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "cob_obstacle_distance/distance_manager.hpp"
+
+/// rate of the distance calculation (as in the node)
+#define OBSTACLE_DISTANCE_RATE 20.0
+
+namespace cob_obstacle_distance
+{
+
+/**
+ * The DistanceManager of one chain within a nodelet manager.
+ * The obstacle distances are passed to a TwistController in the same manager without serialization.
+ * If ~share_tf_listener is set (default), all DistanceManagers of the manager use the same TF buffer. This buffer is
+ * shared within this package only: FrameTrackerNodelets and TwistControllerNodelets in the same manager keep their own
+ * ones (the packages have no common library to hold a process-wide listener).
+ */
+class ObstacleDistanceNodelet : public nodelet::Nodelet
+{
+    public:
+        virtual ~ObstacleDistanceNodelet()
+        {
+            this->calculation_timer_.stop();
+            if (this->distance_manager_)
+            {
+                this->distance_manager_->clear();
+            }
+
+            if (this->transform_thread_.joinable())
+            {
+                this->transform_thread_.join();
+            }
+
+            this->distance_manager_.reset();
+        }
+
+    private:
+        virtual void onInit()
+        {
+            this->nh_ = this->getNodeHandle();
+
+            bool share_tf_listener;
+            this->getPrivateNodeHandle().param<bool>("share_tf_listener", share_tf_listener, true);
+            boost::shared_ptr<tf::TransformListener> tf_listener = share_tf_listener ? getSharedTfListener() : boost::shared_ptr<tf::TransformListener>(new tf::TransformListener());
+
+            this->distance_manager_.reset(new DistanceManager(this->nh_, tf_listener));
+            if (0 != this->distance_manager_->init())
+            {
+                ROS_ERROR("Failed to initialize DistanceManager.");
+                this->distance_manager_.reset();
+                return;
+            }
+
+            this->transform_thread_ = std::thread(&DistanceManager::transform, this->distance_manager_.get());
+            ROS_INFO_STREAM("Started transform thread.");
+
+            /// all callbacks are processed by the callback queue of the nodelet (i.e. sequentially as in the node)
+            this->jointstate_sub_ = this->nh_.subscribe("joint_states", 1, &DistanceManager::jointstateCb, this->distance_manager_.get());
+            this->obstacle_sub_ = this->nh_.subscribe("obstacle_distance/registerObstacle", 1, &DistanceManager::registerObstacle, this->distance_manager_.get());
+            this->registration_srv_ = this->nh_.advertiseService("obstacle_distance/registerLinkOfInterest", &DistanceManager::registerLinkOfInterest, this->distance_manager_.get());
+            this->calculation_timer_ = this->nh_.createTimer(ros::Duration(1.0 / OBSTACLE_DISTANCE_RATE), &ObstacleDistanceNodelet::calculationTimerCallback, this);
+        }
+
+        void calculationTimerCallback(const ros::TimerEvent& event)
+        {
+            this->distance_manager_->calculate();
+        }
+
+        /// @return The TF listener of all DistanceManagers of the process (created on first use, not shared with other packages).
+        static boost::shared_ptr<tf::TransformListener> getSharedTfListener()
+        {
+            static boost::weak_ptr<tf::TransformListener> shared_tf_listener;
+            static boost::mutex shared_tf_listener_lock;
+
+            boost::mutex::scoped_lock lock(shared_tf_listener_lock);
+            boost::shared_ptr<tf::TransformListener> tf_listener = shared_tf_listener.lock();
+            if (!tf_listener)
+            {
+                tf_listener.reset(new tf::TransformListener());
+                shared_tf_listener = tf_listener;
+            }
+
+            return tf_listener;
+        }
+
+        ros::NodeHandle nh_;    ///< referenced by the DistanceManager
+        boost::scoped_ptr<DistanceManager> distance_manager_;
+        std::thread transform_thread_;
+
+        ros::Subscriber jointstate_sub_;
+        ros::Subscriber obstacle_sub_;
+        ros::ServiceServer registration_srv_;
+        ros::Timer calculation_timer_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cob_obstacle_distance::ObstacleDistanceNodelet, nodelet::Nodelet)
@@ -59,7 +59,11 @@
 
 uint32_t DistanceManager::seq_nr_ = 0;
 
-DistanceManager::DistanceManager(ros::NodeHandle& nh) : nh_(nh), stop_sca_threads_(false)
+DistanceManager::DistanceManager(ros::NodeHandle& nh) : nh_(nh), stop_sca_threads_(false), tf_listener_(new tf::TransformListener())
+{}
+
+DistanceManager::DistanceManager(ros::NodeHandle& nh, const boost::shared_ptr<tf::TransformListener>& tf_listener)
+    : nh_(nh), stop_sca_threads_(false), tf_listener_(tf_listener)
 {}
 
 DistanceManager::~DistanceManager()
@@ -162,9 +166,17 @@ void DistanceManager::clear()
     {
         it->join();
     }
+    this->self_collision_transform_threads_.clear();
 
-    this->obstacle_mgr_->clear();
-    this->object_of_interest_mgr_->clear();
+    if (this->obstacle_mgr_)
+    {
+        this->obstacle_mgr_->clear();
+    }
+
+    if (this->object_of_interest_mgr_)
+    {
+        this->object_of_interest_mgr_->clear();
+    }
 }
 
 
@@ -194,7 +206,8 @@ void DistanceManager::drawObjectsOfInterest()
 
 void DistanceManager::calculate()
 {
-    cob_control_msgs::ObstacleDistances obstacle_distances;
+    /// the distances are passed by pointer (not serialized for a TwistController in the same process)
+    cob_control_msgs::ObstacleDistancesPtr obstacle_distances(new cob_control_msgs::ObstacleDistances());
 
     // Transform needs to be calculated only once for robot structure
     // and is same for all obstacles.
@@ -294,13 +307,13 @@ void DistanceManager::calculate()
                     tf::vectorEigenToMsg(obst_vector, od_msg.nearest_point_obstacle_vector);
                     tf::vectorEigenToMsg(rel_base_link_frame_pos, od_msg.nearest_point_frame_vector);
                     tf::vectorEigenToMsg(chainbase2frame_pos, od_msg.frame_vector);
-                    obstacle_distances.distances.push_back(od_msg);
+                    obstacle_distances->distances.push_back(od_msg);
                 }
             }
         }
     }
 
-    if (obstacle_distances.distances.size() > 0)
+    if (obstacle_distances->distances.size() > 0)
     {
         this->obstacle_distances_pub_.publish(obstacle_distances);
     }
@@ -315,10 +328,10 @@ void DistanceManager::transform()
         {
             tf::StampedTransform cb_transform_bl;
             ros::Time time = ros::Time(0);
-            if (tf_listener_.waitForTransform(chain_base_link_, root_frame_id_, time, ros::Duration(5.0)))
+            if (tf_listener_->waitForTransform(chain_base_link_, root_frame_id_, time, ros::Duration(5.0)))
             {
                 std::lock_guard<std::mutex> lock(mtx_);
-                tf_listener_.lookupTransform(chain_base_link_, root_frame_id_, time, cb_transform_bl);
+                tf_listener_->lookupTransform(chain_base_link_, root_frame_id_, time, cb_transform_bl);
                 tf::transformTFToEigen(cb_transform_bl, tf_cb_frame_bl_);
             }
         }
@@ -341,12 +354,12 @@ void DistanceManager::transformSelfCollisionLinks(const std::string link_name)
         {
             ros::Time time = ros::Time(0);
             // https://github.com/ros-visualization/rviz/issues/702: TF listener is thread safe
-            if (tf_listener_.waitForTransform(root_frame_id_, link_name, time, ros::Duration(5.0)))
+            if (tf_listener_->waitForTransform(root_frame_id_, link_name, time, ros::Duration(5.0)))
             {
                 std::lock_guard<std::mutex> lock(obstacle_mgr_mtx_);
                 tf::StampedTransform stamped_transform;
                 geometry_msgs::Transform msg_transform;
-                tf_listener_.lookupTransform(root_frame_id_, link_name, time, stamped_transform);
+                tf_listener_->lookupTransform(root_frame_id_, link_name, time, stamped_transform);
                 PtrIMarkerShape_t shape_ptr;
                 if (this->obstacle_mgr_->getShape(link_name, shape_ptr))
                 {
@@ -424,8 +437,8 @@ void DistanceManager::registerObstacle(const moveit_msgs::CollisionObject::Const
     try
     {
         ros::Time time = ros::Time(0);
-        tf_listener_.waitForTransform(root_frame_id_, msg->header.frame_id, time, ros::Duration(0.5));
-        tf_listener_.lookupTransform(root_frame_id_, msg->header.frame_id, time, frame_transform_root);
+        tf_listener_->waitForTransform(root_frame_id_, msg->header.frame_id, time, ros::Duration(0.5));
+        tf_listener_->lookupTransform(root_frame_id_, msg->header.frame_id, time, frame_transform_root);
         tf::transformTFToEigen(frame_transform_root, tf_frame_root);
     }
     catch (tf::TransformException& ex)
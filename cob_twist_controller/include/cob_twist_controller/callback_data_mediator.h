@@ -18,27 +18,49 @@
 #ifndef COB_TWIST_CONTROLLER_CALLBACK_DATA_MEDIATOR_H
 #define COB_TWIST_CONTROLLER_CALLBACK_DATA_MEDIATOR_H
 
+#include <map>
+#include <string>
 #include <vector>
 #include <stdint.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
 #include "cob_twist_controller/constraints/constraint_params.h"
 #include "cob_control_msgs/ObstacleDistances.h"
 
-/// Represents a data pool for distribution of collected data from ROS callback.
+/**
+ * Represents a data pool for distribution of collected data from ROS callback.
+ * Obstacle distances are double-buffered: the producer (ROS callback) fills the back buffer and publishes it atomically,
+ * consumers (constraints) take a reference to the published snapshot without blocking and without copying.
+ * Links of interest are resolved to indices once (at constraint creation).
+ */
 class CallbackDataMediator
 {
     private:
-        typedef ObstacleDistancesInfo_t::const_iterator ObstacleDistancesIter_t;
-        ObstacleDistancesInfo_t obstacle_distances_;
-        boost::mutex distances_to_obstacles_lock_;
+        typedef boost::shared_ptr<ObstacleDistancesInfo_t> ObstacleDistancesInfoPtr_t;
+        typedef boost::shared_ptr<const ObstacleDistancesInfo_t> ObstacleDistancesInfoConstPtr_t;
+
+        ObstacleDistancesInfoConstPtr_t front_;  ///< the published snapshot (accessed atomically only)
+        ObstacleDistancesInfoPtr_t buffers_[2];
+        uint8_t back_idx_;
+        uint32_t obstacle_distances_cnt_;
+
+        std::map<std::string, uint32_t> link_indices_;
+        boost::mutex links_lock_;  ///< serializes producer and link registration (never taken by consumers)
 
     public:
-        CallbackDataMediator() {}
+        CallbackDataMediator();
+
+        /**
+         * Registers a link of interest.
+         * @param link Name of the link (link_of_interest within the obstacle distance messages).
+         * @return The index of the link (the same index for repeated registrations).
+         */
+        uint32_t registerLink(const std::string& link);
 
         /**
-         * @return Number of active distances to obstacles.
+         * @return Number of links with active distances to obstacles.
          */
         uint32_t obstacleDistancesCnt();
 
@@ -24,6 +24,9 @@
 #include <sensor_msgs/JointState.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <visualization_msgs/MarkerArray.h>
+#include <realtime_tools/realtime_publisher.h>
 
 #include <urdf/model.h>
 
@@ -38,8 +41,10 @@
 
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <dynamic_reconfigure/server.h>
+#include <cob_srvs/SetString.h>
 #include <pluginlib/class_loader.h>
 
 #include <cob_twist_controller/TwistControllerConfig.h>
@@ -47,27 +52,42 @@
 #include <cob_twist_controller/inverse_differential_kinematics_solver.h>
 #include "cob_twist_controller/controller_interfaces/controller_interface_base.h"
 #include "cob_twist_controller/callback_data_mediator.h"
+#include "cob_twist_controller/replay/twist_controller_log.h"
+#include "cob_twist_controller/flight_recorder.h"
+#include "cob_twist_controller/twist_controller_shared.h"
+#include "cob_twist_controller/utils/twist_history.h"
 
 class CobTwistController
 {
 private:
     ros::NodeHandle nh_;
 
-    ros::Subscriber jointstate_sub_;
-
     ros::Subscriber twist_sub_;
     ros::Subscriber twist_stamped_sub_;
 
     ros::Subscriber odometry_sub_;
 
-    ros::Publisher twist_direction_pub_;
+    boost::scoped_ptr<realtime_tools::RealtimePublisher<visualization_msgs::MarkerArray> > twist_direction_pub_;
+    uint32_t visualization_cnt_;    ///< cycles since the last visualization
+
+    ros::Publisher diagnostics_pub_;
+    ros::Timer pipeline_stats_timer_;
+
+    ros::ServiceServer dump_flight_recorder_srv_;
 
     ros::ServiceClient register_link_client_;
     ros::Subscriber obstacle_distance_sub_;
 
     KDL::Chain chain_;
     JointStates joint_states_;
-    KDL::Twist twist_odometry_cb_;
+    TwistHistory odometry_history_;     ///< twists of the base w.r.t. base_link
+    KDL::Frame cb_frame_bl_;            ///< chain_base_link -> base_link (converted when the transform changes)
+    KDL::Vector bl_vector_ct_;          ///< base_link -> chain_tip_link
+    ros::Time cb_bl_stamp_;
+    ros::Time bl_ct_stamp_;
+    bool base_frames_valid_;
+    double base_compensation_age_;      ///< [s] age of the newest odometry at the time of the last compensated twist
+    double base_compensation_max_age_;  ///< [s] maximum age since the last diagnostics
 
     TwistControllerParams twist_controller_params_;
 
@@ -77,16 +97,58 @@ private:
     boost::shared_ptr<pluginlib::ClassLoader<cob_twist_controller::ControllerInterfaceBase> > interface_loader_;
 
     CallbackDataMediator callback_data_mediator_;
-
-    tf::TransformListener tf_listener_;
+    TwistControllerLogWriter log_writer_;   ///< records the controller inputs for offline replay (if 'record_file' is set)
+    FlightRecorder flight_recorder_;        ///< keeps the last cycles for the analysis of anomalies
+    FlightRecord flight_record_;
+
+    boost::shared_ptr<TwistControllerShared> shared_;   ///< robot description, TF and joint states (shared with the other chains of the process)
+    std::string twist_frame_;       ///< frame of the last stamped twist
+    int32_t twist_frame_idx_;
+    std::string tracking_frame_;    ///< frame of the last visualized twist
+    int32_t tracking_frame_idx_;
+    int32_t cb_bl_idx_;             ///< chain_base_link -> base_link
+    int32_t bl_ct_idx_;             ///< base_link -> chain_tip_link
 
 public:
-    CobTwistController()
+    /// Stand-alone controller: parameters in the node namespace, own shared resources, global callback queue.
+    CobTwistController() :
+        visualization_cnt_(0),
+        base_frames_valid_(false),
+        base_compensation_age_(0.0),
+        base_compensation_max_age_(0.0),
+        twist_frame_idx_(-1),
+        tracking_frame_idx_(-1),
+        cb_bl_idx_(-1),
+        bl_ct_idx_(-1)
+    {
+    }
+
+    /**
+     * Controller of one of several chains within a process.
+     * @param nh The namespace of the chain; its callback queue is used for all callbacks of the chain.
+     * @param shared Initialized resources shared by all chains.
+     */
+    CobTwistController(const ros::NodeHandle& nh, const boost::shared_ptr<TwistControllerShared>& shared) :
+        nh_(nh),
+        visualization_cnt_(0),
+        base_frames_valid_(false),
+        base_compensation_age_(0.0),
+        base_compensation_max_age_(0.0),
+        shared_(shared),
+        twist_frame_idx_(-1),
+        tracking_frame_idx_(-1),
+        cb_bl_idx_(-1),
+        bl_ct_idx_(-1)
     {
     }
 
     ~CobTwistController()
     {
+        if (this->shared_)
+        {
+            this->shared_->unregisterJointStates(this);
+        }
+
         this->jntToCartSolver_vel_.reset();
         this->p_inv_diff_kin_solver_.reset();
         this->controller_interface_.reset();
@@ -99,15 +161,30 @@ public:
 
     void reconfigureCallback(cob_twist_controller::TwistControllerConfig& config, uint32_t level);
     void checkSolverAndConstraints(cob_twist_controller::TwistControllerConfig& config);
-    void jointstateCallback(const sensor_msgs::JointState::ConstPtr& msg);
+    void jointStatesCallback(const KDL::JntArray& q, const KDL::JntArray& q_dot);
     void odometryCallback(const nav_msgs::Odometry::ConstPtr& msg);
+    void obstacleDistancesCallback(const cob_control_msgs::ObstacleDistances::ConstPtr& msg);
 
     void twistCallback(const geometry_msgs::Twist::ConstPtr& msg);
     void twistStampedCallback(const geometry_msgs::TwistStamped::ConstPtr& msg);
 
-    void solveTwist(KDL::Twist twist);
+    /// @param stamp Time of the twist (zero: now).
+    void solveTwist(KDL::Twist twist, const ros::Time& stamp);
+
+    /// Twist of the base w.r.t. chain_base_link at the given time (BASE_COMPENSATION).
+    bool getBaseTwist(const ros::Time& stamp, KDL::Twist& twist_cb);
+
+    /// Converts the transforms between chain_base_link, base_link and chain_tip_link if they have changed.
+    bool updateBaseFrames();
+
     void visualizeTwist(KDL::Twist twist);
 
+    /// Hands the state of the cycle over to the flight recorder (to be called at the end of the cycle).
+    void recordCycle(const ros::Time& stamp, const KDL::Twist& twist, int result, const KDL::JntArray& q_dot);
+    bool dumpFlightRecorderCallback(cob_srvs::SetString::Request& request, cob_srvs::SetString::Response& response);
+
+    void pipelineStatsTimerCallback(const ros::TimerEvent& event);
+
     boost::recursive_mutex reconfig_mutex_;
     boost::shared_ptr< dynamic_reconfigure::Server<cob_twist_controller::TwistControllerConfig> > reconfigure_server_;
 };
@@ -60,6 +60,8 @@ enum SolverTypes
     STACK_OF_TASKS = cob_twist_controller::TwistController_STACK_OF_TASKS,
     TASK_2ND_PRIO = cob_twist_controller::TwistController_TASK_2ND_PRIO,
     UNIFIED_JLA_SA = cob_twist_controller::TwistController_UNIFIED_JLA_SA,
+    HIERARCHICAL_QP = cob_twist_controller::TwistController_HIERARCHICAL_QP,
+    MPC = cob_twist_controller::TwistController_MPC,
 };
 
 enum ConstraintTypesCA
@@ -74,6 +76,7 @@ enum ConstraintTypesJLA
     JLA_ON = cob_twist_controller::TwistController_JLA,
     JLA_MID_ON = cob_twist_controller::TwistController_JLA_MID,
     JLA_INEQ_ON = cob_twist_controller::TwistController_JLA_INEQ,
+    JLA_VEC_ON = cob_twist_controller::TwistController_JLA_VEC,
 };
 
 enum LookatAxisTypes
@@ -151,6 +154,7 @@ struct ConstraintParams
     double k_H;
     double damping;
     ConstraintThresholds thresholds;
+    bool lazy_evaluation;   ///< skip the calculation while the constraint is far from activation
 };
 
 enum ConstraintTypes
@@ -206,12 +210,45 @@ struct UJSSolverParams
     double delta_speed;
 };
 
+struct HQPSolverParams
+{
+    HQPSolverParams() :
+        max_iterations(50),
+        tolerance(1.0e-6),
+        regularization(1.0e-4)
+    {}
+
+    uint32_t max_iterations;
+    double tolerance;
+    double regularization;
+};
+
+struct MPCSolverParams
+{
+    MPCSolverParams() :
+        horizon(10),
+        step(0.05),
+        weight_acc(0.01),
+        max_iterations(300),
+        tolerance(1.0e-4)
+    {}
+
+    uint32_t horizon;
+    double step;        ///< [s] duration of all steps but the first one (which lasts one cycle)
+    double weight_acc;
+    uint32_t max_iterations;
+    double tolerance;
+};
+
 struct TwistControllerParams
 {
     TwistControllerParams() :
         dof(0),
         controller_interface(""),
         integrator_smoothing(0.2),
+        trajectory_lookahead_points(1),
+        trajectory_lookahead_step(0.0),
+        trajectory_decimation(1),
 
         numerical_filtering(false),
         damping_method(SIGMOID),
@@ -229,9 +266,21 @@ struct TwistControllerParams
 
         constraint_jla(JLA_ON),
         constraint_ca(CA_ON),
+        constraint_lazy_evaluation(true),
+        constraint_parallel_evaluation(false),
+        constraint_parallel_min_cost(20.0),
+        constraint_parallel_threads(2),
 
         kinematic_extension(NO_EXTENSION),
-        extension_ratio(0.0)
+        extension_ratio(0.0),
+        base_compensation_max_extrapolation(0.1),
+
+        enable_pipeline_stats(false),
+        pipeline_stats_period(1.0),
+        visualization_decimation(1),
+        enable_flight_recorder(true),
+        flight_recorder_auto_dump(false),
+        flight_recorder_dump_on_saturation(false)
     {
         ConstraintParams cp_ca;
         cp_ca.priority = 100;
@@ -240,6 +289,7 @@ struct TwistControllerParams
         cp_ca.thresholds.activation = 0.1;
         cp_ca.thresholds.critical = 0.025;
         cp_ca.thresholds.activation_with_buffer = cp_ca.thresholds.activation * 1.5;  // best experienced value
+        cp_ca.lazy_evaluation = constraint_lazy_evaluation;
         constraint_params.insert(std::pair<ConstraintTypes, ConstraintParams>(CA, cp_ca));
 
         ConstraintParams cp_jla;
@@ -249,6 +299,7 @@ struct TwistControllerParams
         cp_jla.thresholds.activation = 0.1;
         cp_jla.thresholds.critical = 0.05;
         cp_jla.thresholds.activation_with_buffer = cp_jla.thresholds.activation * 4.0;  // best experienced value
+        cp_jla.lazy_evaluation = constraint_lazy_evaluation;
         constraint_params.insert(std::pair<ConstraintTypes, ConstraintParams>(JLA, cp_jla));
     }
 
@@ -258,6 +309,9 @@ struct TwistControllerParams
 
     std::string controller_interface;
     double integrator_smoothing;
+    uint32_t trajectory_lookahead_points;   ///< number of points of the JointTrajectory (1: a single point for the next cycle)
+    double trajectory_lookahead_step;       ///< [s] time between the lookahead points (0.0: the cycle period)
+    uint32_t trajectory_decimation;         ///< the JointTrajectory is published every n-th cycle
 
     bool numerical_filtering;
     DampingMethodTypes damping_method;
@@ -275,15 +329,29 @@ struct TwistControllerParams
 
     ConstraintTypesCA constraint_ca;
     ConstraintTypesJLA constraint_jla;
+    bool constraint_lazy_evaluation;
+    bool constraint_parallel_evaluation;
+    double constraint_parallel_min_cost;    ///< [us] constraints with a shorter update duration are updated inline
+    uint32_t constraint_parallel_threads;   ///< size of the thread pool (not reconfigurable)
     std::map<ConstraintTypes, ConstraintParams> constraint_params;
 
     UJSSolverParams ujs_solver_params;
+    HQPSolverParams hqp_solver_params;
+    MPCSolverParams mpc_solver_params;
     LimiterParams limiter_params;
 
     KinematicExtensionTypes kinematic_extension;
     std::string lookat_pointing_frame;
     LookatOffset lookat_offset;
     double extension_ratio;
+    double base_compensation_max_extrapolation;     ///< [s] horizon for the extrapolation of the odometry (BASE_COMPENSATION)
+
+    bool enable_pipeline_stats;
+    double pipeline_stats_period;
+    uint32_t visualization_decimation;  ///< the debug topics are published every n-th cycle
+    bool enable_flight_recorder;
+    bool flight_recorder_auto_dump;
+    bool flight_recorder_dump_on_saturation;
 
     std::vector<std::string> frame_names;
     std::vector<std::string> joints;
@@ -309,6 +377,9 @@ struct TwistControllerParams
 
         constraint_jla = static_cast<ConstraintTypesJLA>(config.constraint_jla);
         constraint_ca = static_cast<ConstraintTypesCA>(config.constraint_ca);
+        constraint_lazy_evaluation = config.constraint_lazy_evaluation;
+        constraint_parallel_evaluation = config.constraint_parallel_evaluation;
+        constraint_parallel_min_cost = config.constraint_parallel_min_cost;
 
         ConstraintParams cp_jla;
         cp_jla.priority = config.priority_jla;
@@ -320,6 +391,7 @@ struct TwistControllerParams
         cp_jla.thresholds.activation = activation_jla_in_percent / 100.0;
         cp_jla.thresholds.critical = critical_jla_in_percent / 100.0;
         cp_jla.thresholds.activation_with_buffer = cp_jla.thresholds.activation * (1.0 + activation_buffer_jla_in_percent / 100.0);
+        cp_jla.lazy_evaluation = constraint_lazy_evaluation;
         constraint_params[JLA] = cp_jla;
 
         ConstraintParams cp_ca;
@@ -330,6 +402,7 @@ struct TwistControllerParams
         cp_ca.thresholds.activation = config.activation_threshold_ca;  // in [m]
         cp_ca.thresholds.critical = config.critical_threshold_ca;  // in [m]
         cp_ca.thresholds.activation_with_buffer = cp_ca.thresholds.activation * (1.0 + activaton_buffer_ca_in_percent / 100.0);
+        cp_ca.lazy_evaluation = constraint_lazy_evaluation;
         constraint_params[CA] = cp_ca;
 
         ujs_solver_params.sigma = config.sigma;
@@ -337,6 +410,16 @@ struct TwistControllerParams
         ujs_solver_params.delta_pos = config.delta_pos;
         ujs_solver_params.delta_speed = config.delta_speed;
 
+        hqp_solver_params.max_iterations = config.qp_max_iterations;
+        hqp_solver_params.tolerance = config.qp_tolerance;
+        hqp_solver_params.regularization = config.qp_regularization;
+
+        mpc_solver_params.horizon = config.mpc_horizon;
+        mpc_solver_params.step = config.mpc_step;
+        mpc_solver_params.weight_acc = config.mpc_weight_acc;
+        mpc_solver_params.max_iterations = config.mpc_max_iterations;
+        mpc_solver_params.tolerance = config.mpc_tolerance;
+
         limiter_params.keep_direction = config.keep_direction;
         limiter_params.enforce_input_limits = config.enforce_input_limits;
         limiter_params.enforce_pos_limits = config.enforce_pos_limits;
@@ -350,6 +433,14 @@ struct TwistControllerParams
 
         kinematic_extension = static_cast<KinematicExtensionTypes>(config.kinematic_extension);
         extension_ratio = config.extension_ratio;
+        base_compensation_max_extrapolation = config.base_compensation_max_extrapolation;
+
+        enable_pipeline_stats = config.enable_pipeline_stats;
+        pipeline_stats_period = config.pipeline_stats_period;
+        visualization_decimation = config.visualization_decimation;
+        enable_flight_recorder = config.enable_flight_recorder;
+        flight_recorder_auto_dump = config.flight_recorder_auto_dump;
+        flight_recorder_dump_on_saturation = config.flight_recorder_dump_on_saturation;
     }
 
     void to_config(cob_twist_controller::TwistControllerConfig& config)
@@ -370,6 +461,9 @@ struct TwistControllerParams
 
         config.constraint_jla = config.constraint_jla;
         config.constraint_ca = constraint_ca;
+        config.constraint_lazy_evaluation = constraint_lazy_evaluation;
+        config.constraint_parallel_evaluation = constraint_parallel_evaluation;
+        config.constraint_parallel_min_cost = constraint_parallel_min_cost;
 
         config.priority_jla = constraint_params[JLA].priority;
         config.k_H_jla = constraint_params[JLA].k_H;
@@ -390,6 +484,16 @@ struct TwistControllerParams
         config.delta_pos = ujs_solver_params.delta_pos;
         config.delta_speed = ujs_solver_params.delta_speed;
 
+        config.qp_max_iterations = hqp_solver_params.max_iterations;
+        config.qp_tolerance = hqp_solver_params.tolerance;
+        config.qp_regularization = hqp_solver_params.regularization;
+
+        config.mpc_horizon = mpc_solver_params.horizon;
+        config.mpc_step = mpc_solver_params.step;
+        config.mpc_weight_acc = mpc_solver_params.weight_acc;
+        config.mpc_max_iterations = mpc_solver_params.max_iterations;
+        config.mpc_tolerance = mpc_solver_params.tolerance;
+
         config.keep_direction = limiter_params.keep_direction;
         config.enforce_input_limits = limiter_params.enforce_input_limits;
         config.enforce_pos_limits = limiter_params.enforce_pos_limits;
@@ -403,6 +507,14 @@ struct TwistControllerParams
 
         config.kinematic_extension = kinematic_extension;
         config.extension_ratio = extension_ratio;
+        config.base_compensation_max_extrapolation = base_compensation_max_extrapolation;
+
+        config.enable_pipeline_stats = enable_pipeline_stats;
+        config.pipeline_stats_period = pipeline_stats_period;
+        config.visualization_decimation = visualization_decimation;
+        config.enable_flight_recorder = enable_flight_recorder;
+        config.flight_recorder_auto_dump = flight_recorder_auto_dump;
+        config.flight_recorder_dump_on_saturation = flight_recorder_dump_on_saturation;
     }
 };
 
@@ -450,6 +562,7 @@ class ConstraintState
 
 typedef Eigen::Matrix<double, 6, Eigen::Dynamic> Matrix6Xd_t;
 typedef Eigen::Matrix<double, 6, 1> Vector6d_t;
-typedef std::map<std::string, std::vector<ObstacleDistanceData> > ObstacleDistancesInfo_t;
+/// Distances to obstacles per link of interest (indexed by the link index registered at the CallbackDataMediator).
+typedef std::vector<std::vector<ObstacleDistanceData> > ObstacleDistancesInfo_t;
 
 #endif  // COB_TWIST_CONTROLLER_COB_TWIST_CONTROLLER_DATA_TYPES_H
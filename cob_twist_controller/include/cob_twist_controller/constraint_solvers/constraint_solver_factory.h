@@ -22,13 +22,14 @@
 #include <Eigen/Core>
 #include <Eigen/SVD>
 #include <kdl/jntarray.hpp>
-#include <kdl/chainjnttojacsolver.hpp>
-#include <kdl/chainfksolvervel_recursive.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
 #include "cob_twist_controller/constraint_solvers/factories/solver_factory.h"
 #include "cob_twist_controller/callback_data_mediator.h"
+#include "cob_twist_controller/kinematics_cache.h"
+#include "cob_twist_controller/pipeline_stats.h"
+#include "cob_twist_controller/constraint_solvers/constraint_updater.h"
 
 /// Static class providing a single method for creation of damping method, solver and starting the solving of the IK problem.
 class ConstraintSolverFactory
@@ -37,16 +38,23 @@ class ConstraintSolverFactory
         /**
          * Ctor of ConstraintSolverFactoryBuilder.
          * @param data_mediator: Reference to an callback data mediator.
-         * @param jnt_to_jac: Reference to an joint to Jacobian solver.
+         * @param kinematics_cache: Reference to the kinematics of the current joint states.
+         * @param prediction_cache: Reference to the kinematics used for the predicted joint states.
+         * @param pipeline_stats: Reference to the latency instrumentation the solvers report to.
+         * @param constraint_updater: Reference to the pool the solvers update the constraints with.
          */
         ConstraintSolverFactory(CallbackDataMediator& data_mediator,
-                                KDL::ChainJntToJacSolver& jnt_to_jac,
-                                KDL::ChainFkSolverVel_recursive& fk_solver_vel,
-                                TaskStackController_t& task_stack_controller) :
+                                KinematicsCache& kinematics_cache,
+                                KinematicsCache& prediction_cache,
+                                TaskStackController_t& task_stack_controller,
+                                PipelineStats& pipeline_stats,
+                                ConstraintUpdater& constraint_updater) :
             data_mediator_(data_mediator),
-            jnt_to_jac_(jnt_to_jac),
+            kinematics_cache_(kinematics_cache),
+            prediction_cache_(prediction_cache),
             task_stack_controller_(task_stack_controller),
-            fk_solver_vel_(fk_solver_vel)
+            pipeline_stats_(pipeline_stats),
+            constraint_updater_(constraint_updater)
         {
             this->solver_factory_.reset();
             this->damping_method_.reset();
@@ -81,19 +89,45 @@ class ConstraintSolverFactory
         static bool getSolverFactory(const TwistControllerParams& params,
                                      const LimiterParams& limiter_params,
                                      boost::shared_ptr<ISolverFactory>& solver_factory,
-                                     TaskStackController_t& task_stack_controller);
+                                     TaskStackController_t& task_stack_controller,
+                                     PipelineStats& pipeline_stats,
+                                     ConstraintUpdater& constraint_updater);
 
         int8_t resetAll(const TwistControllerParams& params, const LimiterParams& limiter_params);
 
+        /**
+         * Recreates the damping method only (solver, constraints and task stack are kept).
+         */
+        int8_t resetDamping(const TwistControllerParams& params);
+
+        /**
+         * Applies changed gains and thresholds to the existing constraints (structure and priorities are kept).
+         */
+        void updateConstraintParams(const TwistControllerParams& params);
+
+        /// The constraints of the current solver (in the order of priority).
+        inline const std::set<ConstraintBase_t>& getConstraints() const
+        {
+            return this->constraints_;
+        }
+
+        /// The pseudoinverse calculator of the current solver (NULL if there is none).
+        inline const IPseudoinverseCalculator* getPInvCalculator() const
+        {
+            return this->solver_factory_ ? &this->solver_factory_->getPInvCalculator() : NULL;
+        }
+
     private:
         CallbackDataMediator& data_mediator_;
-        KDL::ChainJntToJacSolver& jnt_to_jac_;
-        KDL::ChainFkSolverVel_recursive& fk_solver_vel_;
+        KinematicsCache& kinematics_cache_;
+        KinematicsCache& prediction_cache_;
 
         boost::shared_ptr<ISolverFactory> solver_factory_;
         boost::shared_ptr<DampingBase> damping_method_;
         std::set<ConstraintBase_t> constraints_;
         TaskStackController_t& task_stack_controller_;
+        PipelineStats& pipeline_stats_;
+        ConstraintUpdater& constraint_updater_;
 };
 
 #endif  // COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_CONSTRAINT_SOLVER_FACTORY_H
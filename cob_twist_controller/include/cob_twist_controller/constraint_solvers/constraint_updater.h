@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_CONSTRAINT_UPDATER_H
+#define COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_CONSTRAINT_UPDATER_H
+
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+#include <kdl/jntarrayvel.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+#include "cob_twist_controller/constraints/constraint_base.h"
+
+#define CONSTRAINT_UPDATER_DEFAULT_THREADS 2
+#define CONSTRAINT_UPDATER_COST_SMOOTHING 0.2   /// weight of the latest measurement within the smoothed update cost
+
+/**
+ * Fork-join update of the constraints of a cycle on a persistent pool of worker threads.
+ * The update of a constraint only reads the joint states, the prediction and the Jacobian of the cycle and writes the
+ * state of the constraint itself. So the constraints whose (smoothed) update duration exceeds a threshold are distributed
+ * among the workers, while the calling thread updates the cheap ones inline and then helps with the expensive ones.
+ * The solvers process the results afterwards in the order of priority, i.e. the outputs are identical to a serial update.
+ */
+class ConstraintUpdater
+{
+    public:
+        /**
+         * @param nr_of_threads Number of worker threads (started with the first parallel update; 0: always serial).
+         */
+        explicit ConstraintUpdater(uint32_t nr_of_threads = CONSTRAINT_UPDATER_DEFAULT_THREADS);
+
+        ~ConstraintUpdater();
+
+        /**
+         * Updates all constraints and returns as soon as all of them are up-to-date.
+         * @param min_cost Constraints with a smaller update duration [us] are updated inline by the calling thread.
+         */
+        void update(const std::set<ConstraintBase_t>& constraints,
+                    double min_cost,
+                    const JointStates& joint_states,
+                    const KDL::JntArrayVel& joints_prediction,
+                    const Matrix6Xd_t& jacobian_data);
+
+    private:
+        void start();
+        void stop();
+        void run();
+
+        /// Updates the expensive constraints until none is left (executed by the workers and the calling thread).
+        void processJobs();
+        void updateConstraint(PriorityBase<uint32_t>& constraint);
+
+        const uint32_t nr_of_threads_;
+        boost::thread_group threads_;
+
+        boost::mutex lock_;
+        boost::condition_variable start_cond_;
+        boost::condition_variable done_cond_;
+        bool running_;
+        uint64_t generation_;       ///< incremented for each parallel update (guarded by lock_)
+        uint32_t busy_workers_;     ///< workers which have not finished the current generation (guarded by lock_)
+
+        std::vector<ConstraintBase_t> jobs_;    ///< the expensive constraints of the current generation
+        boost::atomic<uint32_t> next_job_;
+
+        const JointStates* joint_states_;
+        const KDL::JntArrayVel* joints_prediction_;
+        const Matrix6Xd_t* jacobian_data_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_CONSTRAINT_UPDATER_H
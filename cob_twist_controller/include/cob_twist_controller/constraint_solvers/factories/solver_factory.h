@@ -24,8 +24,11 @@
 #include <kdl/jntarray.hpp>
 
 #include "cob_twist_controller/damping_methods/damping_base.h"
+#include "cob_twist_controller/inverse_jacobian_calculations/inverse_jacobian_calculation_base.h"
 #include "cob_twist_controller/constraints/constraint_base.h"
 #include "cob_twist_controller/task_stack/task_stack_controller.h"
+#include "cob_twist_controller/pipeline_stats.h"
+#include "cob_twist_controller/constraint_solvers/constraint_updater.h"
 
 /// Interface definition to support generic usage of the solver factory without specifying a typename in prior.
 class ISolverFactory
@@ -37,6 +40,8 @@ class ISolverFactory
                                                          boost::shared_ptr<DampingBase>& damping_method,
                                                          std::set<ConstraintBase_t>& constraints) const = 0;
 
+        virtual const IPseudoinverseCalculator& getPInvCalculator() const = 0;
+
         virtual ~ISolverFactory() {}
 };
 
@@ -47,9 +52,13 @@ class SolverFactory : public ISolverFactory
     public:
         SolverFactory(const TwistControllerParams& params,
                       const LimiterParams& limiter_params,
-                      TaskStackController_t& task_stack_controller)
+                      TaskStackController_t& task_stack_controller,
+                      PipelineStats& pipeline_stats,
+                      ConstraintUpdater& constraint_updater)
         {
             constraint_solver_.reset(new T(params, limiter_params, task_stack_controller));
+            constraint_solver_->setPipelineStats(&pipeline_stats);
+            constraint_solver_->setConstraintUpdater(&constraint_updater);
         }
 
         ~SolverFactory()
@@ -81,6 +90,11 @@ class SolverFactory : public ISolverFactory
             return new_q_dot;
         }
 
+        const IPseudoinverseCalculator& getPInvCalculator() const
+        {
+            return constraint_solver_->getPInvCalculator();
+        }
+
     private:
         boost::shared_ptr<T> constraint_solver_;
 };
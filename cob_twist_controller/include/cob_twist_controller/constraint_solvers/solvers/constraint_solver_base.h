@@ -27,6 +27,8 @@
 #include "cob_twist_controller/constraints/constraint_base.h"
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
 #include "cob_twist_controller/task_stack/task_stack_controller.h"
+#include "cob_twist_controller/pipeline_stats.h"
+#include "cob_twist_controller/constraint_solvers/constraint_updater.h"
 
 /// Base class for solvers, defining interface methods.
 template <typename PINV = PInvBySVD>
@@ -77,6 +79,30 @@ class ConstraintSolver
             this->jacobian_data_ = jacobian_data;
         }
 
+        /**
+         * Sets the latency instrumentation the solver reports its stages to.
+         */
+        inline void setPipelineStats(PipelineStats* pipeline_stats)
+        {
+            this->pipeline_stats_ = pipeline_stats;
+        }
+
+        /**
+         * Sets the pool the constraints are updated with if the parallel evaluation is enabled.
+         */
+        inline void setConstraintUpdater(ConstraintUpdater* constraint_updater)
+        {
+            this->constraint_updater_ = constraint_updater;
+        }
+
+        /**
+         * The pseudoinverse calculator of the solver (provides the singular values and damping of the last cycle).
+         */
+        inline const IPseudoinverseCalculator& getPInvCalculator() const
+        {
+            return this->pinv_calc_;
+        }
+
         virtual ~ConstraintSolver()
         {
             this->clearConstraints();
@@ -87,10 +113,42 @@ class ConstraintSolver
                          TaskStackController_t& task_stack_controller) :
                 params_(params),
                 limiter_params_(limiter_params),
-                task_stack_controller_(task_stack_controller)
+                task_stack_controller_(task_stack_controller),
+                pipeline_stats_(NULL),
+                constraint_updater_(NULL)
         {}
 
     protected:
+        /// Marks the end of a pipeline stage (if an instrumentation is set).
+        inline void markStage(PipelineStages stage)
+        {
+            if (NULL != this->pipeline_stats_)
+            {
+                this->pipeline_stats_->mark(stage);
+            }
+        }
+
+        /**
+         * Updates all constraints (in parallel if enabled). The results have to be processed in the order of the set afterwards.
+         */
+        inline void updateConstraints(const JointStates& joint_states, const KDL::JntArrayVel& joints_prediction)
+        {
+            if (NULL != this->constraint_updater_ && this->params_.constraint_parallel_evaluation)
+            {
+                this->constraint_updater_->update(this->constraints_,
+                                                  this->params_.constraint_parallel_min_cost,
+                                                  joint_states,
+                                                  joints_prediction,
+                                                  this->jacobian_data_);
+                return;
+            }
+
+            for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
+            {
+                (*it)->update(joint_states, joints_prediction, this->jacobian_data_);
+            }
+        }
+
         /// set inserts sorted (default less operator); if element has already been added it returns an iterator on it.
         std::set<ConstraintBase_t> constraints_;  /// Set of constraints.
         const TwistControllerParams& params_;  /// References the inv. diff. kin. solver parameters.
@@ -99,6 +157,8 @@ class ConstraintSolver
         boost::shared_ptr<DampingBase> damping_;  /// The currently set damping method.
         PINV pinv_calc_;  /// An instance that helps solving the inverse of the Jacobian.
         TaskStackController_t& task_stack_controller_;  /// Reference to the task stack controller.
+        PipelineStats* pipeline_stats_;  /// The latency instrumentation (owned by the inv. diff. kin. solver).
+        ConstraintUpdater* constraint_updater_;  /// The pool for the parallel update of the constraints (owned by the inv. diff. kin. solver).
 };
 
 #endif  // COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_CONSTRAINT_SOLVER_BASE_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_HIERARCHICAL_QP_SOLVER_H
+#define COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_HIERARCHICAL_QP_SOLVER_H
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+#include "cob_twist_controller/constraint_solvers/solvers/stack_of_tasks_solver.h"
+
+/**
+ * Solves the task stack as a strict hierarchy of quadratic programs.
+ * Each priority level minimizes the (regularized) task error subject to hard box bounds on the joint velocities
+ * (derived from the joint velocity and position limits) and to the task velocities achieved by all higher levels.
+ * The lowest level pulls the remaining redundancy towards the GPM gradient of the constraints in DANGER state.
+ * Every level is solved by a primal active set method whose working set is warm started from the previous cycle.
+ * Constraint states and tasks are processed the same way as in the StackOfTasksSolver.
+ */
+class HierarchicalQPSolver : public StackOfTasksSolver
+{
+    public:
+        HierarchicalQPSolver(const TwistControllerParams& params,
+                             const LimiterParams& limiter_params,
+                             TaskStackController_t& task_stack_controller) :
+                StackOfTasksSolver(params, limiter_params, task_stack_controller)
+        {}
+
+        virtual ~HierarchicalQPSolver()
+        {}
+
+        /**
+         * Specific implementation of solve-method to solve IK problem with constraints by using a hierarchy of QPs.
+         * See base class ConstraintSolver for more details on params and returns.
+         */
+        virtual Eigen::MatrixXd solve(const Vector6d_t& in_cart_velocities,
+                                      const JointStates& joint_states);
+
+    private:
+        /**
+         * Calculates the box bounds of the joint velocities for the next cycle.
+         * Position limits are converted into velocity bounds by means of the cycle time.
+         */
+        void calcBounds(const JointStates& joint_states,
+                        double cycle,
+                        Eigen::VectorXd& lower,
+                        Eigen::VectorXd& upper) const;
+
+        /**
+         * Solves one priority level: min ||A x - b||^2 + regularization * ||x||^2
+         * s.t. A_eq x = b_eq and lower <= x <= upper.
+         * @param level The index of the priority level (used for the warm start).
+         * @param x Feasible start point on input (satisfying A_eq and the bounds), solution of the level on output.
+         * @return Number of active set iterations, -1 if the level could not be solved to optimality.
+         */
+        int solveLevel(uint32_t level,
+                       const Eigen::MatrixXd& A,
+                       const Eigen::VectorXd& b,
+                       double regularization,
+                       const Eigen::MatrixXd& A_eq,
+                       const Eigen::VectorXd& b_eq,
+                       const Eigen::VectorXd& lower,
+                       const Eigen::VectorXd& upper,
+                       Eigen::VectorXd& x);
+
+        /**
+         * Solves the equality constrained subproblem of a working set:
+         * min 0.5 x^T H x + g^T x s.t. A_eq x = b_eq and x_j at its bound for all j in the working set.
+         * @param lambda The Lagrange multipliers of the bounds in the working set (0 for free joints).
+         * @return false if the equality constraints are inconsistent with the working set.
+         */
+        bool solveEqualityProblem(const Eigen::MatrixXd& H,
+                                  const Eigen::VectorXd& g,
+                                  const Eigen::MatrixXd& A_eq,
+                                  const Eigen::VectorXd& b_eq,
+                                  const Eigen::VectorXd& lower,
+                                  const Eigen::VectorXd& upper,
+                                  const Eigen::VectorXi& working_set,
+                                  Eigen::VectorXd& x,
+                                  Eigen::VectorXd& lambda) const;
+
+        /// Working sets of the last cycle per priority level (-1: at lower bound, 1: at upper bound, 0: free).
+        std::vector<Eigen::VectorXi> working_sets_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_HIERARCHICAL_QP_SOLVER_H
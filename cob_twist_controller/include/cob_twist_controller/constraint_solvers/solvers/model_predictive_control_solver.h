@@ -0,0 +1,123 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_MODEL_PREDICTIVE_CONTROL_SOLVER_H
+#define COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_MODEL_PREDICTIVE_CONTROL_SOLVER_H
+
+#include <set>
+#include <ros/ros.h>
+#include <Eigen/Dense>
+
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+#include "cob_twist_controller/constraint_solvers/solvers/constraint_solver_base.h"
+
+#include "cob_twist_controller/constraints/constraint_base.h"
+#include "cob_twist_controller/constraints/constraint.h"
+
+#define MPC_ADMM_RHO 0.1                /// step size of the ADMM iterations (for rows with finite bounds)
+#define MPC_ADMM_RHO_EQ_SCALE 1.0e3     /// rows with equal lower and upper bounds get a larger step size
+#define MPC_ADMM_RHO_MIN 1.0e-6         /// step size for rows without bounds
+#define MPC_ADMM_SIGMA 1.0e-6           /// proximal regularization of the primal variables
+#define MPC_ADMM_ALPHA 1.6              /// over-relaxation
+#define MPC_ADMM_ADAPT_INTERVAL 25      /// iterations between the adaptations of the step sizes
+#define MPC_ADMM_ADAPT_RATIO 5.0        /// step sizes are only adapted (and refactorized) if they change by this factor
+#define MPC_ADMM_RHO_SCALE_MIN 1.0e-4
+#define MPC_ADMM_RHO_SCALE_MAX 1.0e4
+#define MPC_REGULARIZATION 1.0e-4       /// pulls otherwise undetermined directions (singularities) towards the GPM solution
+
+/**
+ * Receding horizon (linear MPC) variant of the GPM.
+ * With the Jacobian linearized at the current state, the joint velocities u_0, ..., u_{N-1} of N steps are optimized:
+ *   min sum_k h_k (||J (u_k - u_p)||^2 + ||P (u_k - u_h)||^2) + weight_acc * sum_k ||u_k - u_{k-1}||^2 / h_k
+ * with the (damped) particular solution u_p, the nullspace projector P and the homogeneous solution u_h of the GPM.
+ * So without active limits and without weight_acc the plan equals the GPM solution. The QP is subject to the joint
+ * velocity limits, the joint acceleration limits (u_{-1} is the current joint velocity) and the joint position limits
+ * along the predicted trajectory. The first step lasts one cycle (h_0), the further ones mpc_step.
+ * The QP is solved by the ADMM (as in OSQP) on a structured constraint matrix, warm started with the plan and the dual
+ * variables of the last cycle (shifted by one step) and its step sizes. Only u_0 is commanded.
+ */
+class ModelPredictiveControlSolver : public ConstraintSolver<>
+{
+    public:
+        ModelPredictiveControlSolver(const TwistControllerParams& params,
+                                     const LimiterParams& limiter_params,
+                                     TaskStackController_t& task_stack_controller) :
+                ConstraintSolver(params, limiter_params, task_stack_controller),
+                n_(0),
+                horizon_(0),
+                rho_scale_(1.0),
+                iterations_(0)
+        {
+            this->last_time_ = ros::Time::now();
+        }
+
+        virtual ~ModelPredictiveControlSolver()
+        {}
+
+        /**
+         * Specific implementation of solve-method to solve IK problem with constraints by a receding horizon QP.
+         * See base class ConstraintSolver for more details on params and returns.
+         */
+        virtual Eigen::MatrixXd solve(const Vector6d_t& in_cart_velocities,
+                                      const JointStates& joint_states);
+
+        /// ADMM iterations of the last cycle, -1 if the tolerance has not been reached.
+        inline int getIterations() const
+        {
+            return this->iterations_;
+        }
+
+    private:
+        /// Moves the plan and the dual variables of the last cycle forward by one step (warm start).
+        void shiftWarmStart();
+
+        /**
+         * Sets up the bounds and step sizes of the rows of the constraint matrix A = [I; D; L]:
+         * velocities u_k, velocity differences u_k - u_{k-1} and position increments sum_{i<=k} h_i u_i.
+         */
+        void calcBounds(const JointStates& joint_states, const Eigen::VectorXd& u_prev);
+
+        /// z = A x
+        void multiplyA(const Eigen::VectorXd& x, Eigen::VectorXd& z) const;
+
+        /// x = A^T z
+        void multiplyAt(const Eigen::VectorXd& z, Eigen::VectorXd& x) const;
+
+        /// K += A^T diag(rho) A
+        void addAtRhoA(Eigen::MatrixXd& K) const;
+
+        /**
+         * Solves min 0.5 x^T H x + g^T x s.t. lower <= A x <= upper, starting at x_ and y_.
+         * @return Number of iterations, -1 if the tolerance has not been reached.
+         */
+        int solveQP(const Eigen::MatrixXd& H, const Eigen::VectorXd& g);
+
+        ros::Time last_time_;
+        uint32_t n_;                ///< joints
+        uint32_t horizon_;          ///< steps
+        Eigen::VectorXd h_;         ///< durations of the steps
+        Eigen::VectorXd lower_;
+        Eigen::VectorXd upper_;
+        Eigen::VectorXd rho_;
+        double rho_scale_;          ///< adapted scale of the step sizes (kept for the next cycle)
+        int iterations_;            ///< ADMM iterations of the last cycle
+        Eigen::VectorXd x_;         ///< planned joint velocities (warm start)
+        Eigen::VectorXd y_;         ///< dual variables of the rows of A (warm start)
+        Eigen::LLT<Eigen::MatrixXd> llt_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_MODEL_PREDICTIVE_CONTROL_SOLVER_H
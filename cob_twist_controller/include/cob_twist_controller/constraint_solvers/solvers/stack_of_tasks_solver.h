@@ -19,10 +19,12 @@
 #define COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_STACK_OF_TASKS_SOLVER_H
 
 #include <set>
+#include <vector>
 #include <ros/ros.h>
 
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
 #include "cob_twist_controller/constraint_solvers/solvers/constraint_solver_base.h"
+#include "cob_twist_controller/inverse_jacobian_calculations/null_space_projector.h"
 
 #include "cob_twist_controller/constraints/constraint_base.h"
 #include "cob_twist_controller/constraints/constraint.h"
@@ -40,6 +42,7 @@ class StackOfTasksSolver : public ConstraintSolver<>
             this->last_time_ = ros::Time::now();
             this->global_constraint_state_ = NORMAL;
             this->in_cart_vel_damping_ = 1.0;
+            this->main_task_slot_ = -1;
         }
 
         virtual ~StackOfTasksSolver()
@@ -54,17 +57,35 @@ class StackOfTasksSolver : public ConstraintSolver<>
 
         /**
          * Process the state of the constraint and update the sum_of_gradient.
+         * @param task_slot The task slot of the constraint (registered on its first CRITICAL state, -1 before).
          */
         void processState(std::set<ConstraintBase_t>::iterator& it,
                           const Eigen::MatrixXd& projector,
                           const Eigen::MatrixXd& particular_solution,
                           double inv_sum_of_prios,
-                          Eigen::VectorXd& sum_of_gradient);
+                          Eigen::VectorXd& sum_of_gradient,
+                          int32_t& task_slot);
 
     protected:
+        /**
+         * Updates the main task in its slot of the task stack (registered on first use) and activates it.
+         */
+        void updateMainTask(const Vector6d_t& in_cart_velocities);
+
+        /**
+         * Prepares the task slots of the main task and the constraints.
+         * Slots stay valid as long as the task stack is not cleared and the set holds the same constraints.
+         */
+        void prepareTaskSlots();
+
         ros::Time last_time_;
         EN_ConstraintStates global_constraint_state_;
         double in_cart_vel_damping_;
+        int32_t main_task_slot_;
+        std::vector<ConstraintBase_t> slot_constraints_;  /// constraints the task slots have been registered for
+        std::vector<int32_t> constraint_task_slots_;      /// task slots in the order of the constraints set
+        Eigen::MatrixXd projection_;                      /// buffer of the projected partial values of a constraint
+        NullSpaceProjector null_space_projector_;
 };
 
 #endif  // COB_TWIST_CONTROLLER_CONSTRAINT_SOLVERS_SOLVERS_STACK_OF_TASKS_SOLVER_H
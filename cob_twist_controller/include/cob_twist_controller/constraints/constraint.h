@@ -20,13 +20,13 @@
 
 #include <set>
 #include <string>
+#include <vector>
 #include <limits>
-#include <kdl/chainjnttojacsolver.hpp>
-#include <kdl/chainfksolvervel_recursive.hpp>
 
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
 #include "cob_twist_controller/constraints/constraint_base.h"
 #include "cob_twist_controller/callback_data_mediator.h"
+#include "cob_twist_controller/kinematics_cache.h"
 
 /* BEGIN ConstraintsBuilder *************************************************************************************/
 /// Class providing a static method to create constraints.
@@ -36,8 +36,8 @@ class ConstraintsBuilder
     public:
         static std::set<ConstraintBase_t> createConstraints(const TwistControllerParams& params,
                                                             const LimiterParams& limiter_params,
-                                                            KDL::ChainJntToJacSolver& jnt_to_jac_,
-                                                            KDL::ChainFkSolverVel_recursive& fk_solver_vel,
+                                                            KinematicsCache& kinematics_cache,
+                                                            KinematicsCache& prediction_cache,
                                                             CallbackDataMediator& data_mediator);
 
     private:
@@ -55,19 +55,17 @@ class CollisionAvoidance : public ConstraintBase<T_PARAMS, PRIO>
         CollisionAvoidance(PRIO prio,
                            T_PARAMS constraint_params,
                            CallbackDataMediator& cbdm,
-                           KDL::ChainJntToJacSolver& jnt_to_jac,
-                           KDL::ChainFkSolverVel_recursive& fk_solver_vel) :
+                           KinematicsCache& kinematics_cache,
+                           KinematicsCache& prediction_cache) :
             ConstraintBase<T_PARAMS, PRIO>(prio, constraint_params, cbdm),
-            jnt_to_jac_(jnt_to_jac),
-            fk_solver_vel_(fk_solver_vel)
+            kinematics_cache_(kinematics_cache),
+            prediction_cache_(prediction_cache)
         {}
 
         virtual ~CollisionAvoidance()
         {}
 
         virtual std::string getTaskId() const;
-        virtual Eigen::MatrixXd getTaskJacobian() const;
-        virtual Eigen::VectorXd getTaskDerivatives() const;
 
         virtual void calculate();
 
@@ -80,6 +78,8 @@ class CollisionAvoidance : public ConstraintBase<T_PARAMS, PRIO>
 
     private:
         virtual double getCriticalValue() const;
+        virtual bool isNearActivation();
+        virtual void calculateInactive();
 
         void calcValue();
         void calcDerivativeValue();
@@ -87,12 +87,10 @@ class CollisionAvoidance : public ConstraintBase<T_PARAMS, PRIO>
         void calcPredictionValue();
         double getActivationThresholdWithBuffer() const;
 
-        KDL::ChainJntToJacSolver& jnt_to_jac_;
-        KDL::ChainFkSolverVel_recursive& fk_solver_vel_;
+        KinematicsCache& kinematics_cache_;     ///< kinematics of the current cycle, updated by the InverseDifferentialKinematicsSolver
+        KinematicsCache& prediction_cache_;     ///< kinematics of the predicted joint states, shared by all CA constraints
 
         Eigen::VectorXd values_;
-        Eigen::VectorXd derivative_values_;
-        Eigen::MatrixXd task_jacobian_;
 };
 /* END CollisionAvoidance ***************************************************************************************/
 
@@ -118,16 +116,18 @@ class JointLimitAvoidance : public ConstraintBase<T_PARAMS, PRIO>
         virtual std::string getTaskId() const;
 
         virtual void calculate();
-        virtual Eigen::MatrixXd getTaskJacobian() const;
-        virtual Eigen::VectorXd getTaskDerivatives() const;
 
         virtual double getActivationGain() const;
         virtual double getSelfMotionMagnitude(const Eigen::MatrixXd& particular_solution, const Eigen::MatrixXd& homogeneous_solution) const;
 
     private:
+        virtual bool isNearActivation();
+        virtual void calculateInactive();
+
         void calcValue();
         void calcDerivativeValue();
         void calcPartialValues();
+        void calcRelativeDistances();
 
         double abs_delta_max_;
         double abs_delta_min_;
@@ -185,8 +185,6 @@ class JointLimitAvoidanceIneq : public ConstraintBase<T_PARAMS, PRIO>
         {}
 
         virtual std::string getTaskId() const;
-        virtual Eigen::MatrixXd getTaskJacobian() const;
-        virtual Eigen::VectorXd getTaskDerivatives() const;
 
         virtual void calculate();
 
@@ -194,9 +192,13 @@ class JointLimitAvoidanceIneq : public ConstraintBase<T_PARAMS, PRIO>
         virtual double getSelfMotionMagnitude(const Eigen::MatrixXd& particular_solution, const Eigen::MatrixXd& homogeneous_solution) const;
 
     private:
+        virtual bool isNearActivation();
+        virtual void calculateInactive();
+
         void calcValue();
         void calcDerivativeValue();
         void calcPartialValues();
+        void calcRelativeDistances();
 
         double abs_delta_max_;
         double abs_delta_min_;
@@ -205,6 +207,59 @@ class JointLimitAvoidanceIneq : public ConstraintBase<T_PARAMS, PRIO>
 };
 /* END JointLimitAvoidanceIneq **************************************************************************************/
 
+/* BEGIN JointLimitAvoidanceVec ************************************************************************************/
+/// Class providing methods that realize a JointLimitAvoidance constraint for all joints of the chain within one object.
+/// Evaluates the same cost function as JointLimitAvoidance in a single vectorized pass over contiguous limit arrays.
+template <typename T_PARAMS, typename PRIO = uint32_t>
+class JointLimitAvoidanceVec : public ConstraintBase<T_PARAMS, PRIO>
+{
+    public:
+        JointLimitAvoidanceVec(PRIO prio,
+                               T_PARAMS constraint_params,
+                               CallbackDataMediator& cbdm,
+                               uint32_t dof);
+
+        virtual ~JointLimitAvoidanceVec()
+        {}
+
+        virtual std::string getTaskId() const;
+
+        virtual void calculate();
+
+        virtual double getActivationGain() const;
+        virtual double getSelfMotionMagnitude(const Eigen::MatrixXd& particular_solution, const Eigen::MatrixXd& homogeneous_solution) const;
+
+        virtual double getInvDangerPriority() const;
+        virtual Eigen::VectorXd getDangerPartialValues() const;
+
+    private:
+        virtual bool isNearActivation();
+        virtual void calculateInactive();
+
+        void calcRelativeDistances();
+        void calcActivationGains();
+        void calcTask();
+        void calcDangerTerms();
+
+        const uint32_t dof_;
+        Eigen::ArrayXd limits_min_;
+        Eigen::ArrayXd limits_max_;
+        Eigen::ArrayXd limits_range_sqr_;
+
+        Eigen::ArrayXd rel_;                ///< relative distance to the nearer limit
+        Eigen::ArrayXd pred_rel_;           ///< predicted relative distance to the nearer limit
+        Eigen::ArrayXd values_;             ///< cost function value per joint
+        Eigen::ArrayXd gradient_;           ///< partial value per joint
+        Eigen::ArrayXd activation_gains_;   ///< activation gain per joint
+        std::vector<bool> critical_;        ///< critical state per joint
+
+        uint32_t critical_cnt_;
+
+        double inv_danger_priority_;                ///< sum of the inverse priorities of the joints not critical
+        Eigen::VectorXd danger_partial_values_;     ///< partial values of the joints not critical, weighted by inverse priority
+};
+/* END JointLimitAvoidanceVec **************************************************************************************/
+
 typedef ConstraintsBuilder<uint32_t> ConstraintsBuilder_t;
 
 #include "cob_twist_controller/constraints/constraint_impl.h"   // implementation of templated class
@@ -40,7 +40,7 @@ template
 class PriorityBase
 {
     public:
-        explicit PriorityBase(PRIO prio): priority_(prio)
+        explicit PriorityBase(PRIO prio): priority_(prio), update_cost_(0.0)
         {}
 
         virtual ~PriorityBase()
@@ -77,25 +77,43 @@ class PriorityBase
             return static_cast<double>(priority_);
         }
 
+        /// Smoothed duration of update() [us] as measured by the ConstraintUpdater (0.0 if not measured yet).
+        inline double getUpdateCost() const
+        {
+            return this->update_cost_;
+        }
+
+        inline void setUpdateCost(double update_cost)
+        {
+            this->update_cost_ = update_cost;
+        }
+
         virtual Task_t createTask() = 0;
         virtual std::string getTaskId() const = 0;
         virtual ConstraintState getState() const = 0;
-        virtual Eigen::MatrixXd getTaskJacobian() const = 0;
-        virtual Eigen::VectorXd getTaskDerivatives() const = 0;
+        virtual const Eigen::MatrixXd& getTaskJacobian() const = 0;
+        virtual const Eigen::VectorXd& getTaskDerivatives() const = 0;
 
         virtual void update(const JointStates& joint_states, const KDL::JntArrayVel& joints_prediction, const Matrix6Xd_t& jacobian_data) = 0;
+        virtual void updateParams(const TwistControllerParams& tc_params) = 0;
         virtual void calculate() = 0;
         virtual double getValue() const = 0;
         virtual double getDerivativeValue() const = 0;
-        virtual Eigen::VectorXd getPartialValues() const = 0;
+        virtual const Eigen::VectorXd& getPartialValues() const = 0;
         virtual double getPredictionValue() const = 0;
 
         virtual double getActivationGain() const = 0;
         virtual double getSelfMotionMagnitude(const Eigen::MatrixXd& particular_solution,
                                               const Eigen::MatrixXd& homogeneous_solution) const = 0;
 
+        /// Sum of the inverse priorities of the parts of the constraint in DANGER state (weighting of the GPM terms).
+        virtual double getInvDangerPriority() const = 0;
+        /// Partial values of the parts of the constraint in DANGER state, each weighted with its inverse priority.
+        virtual Eigen::VectorXd getDangerPartialValues() const = 0;
+
     protected:
         PRIO priority_;
+        double update_cost_;
 
         virtual double getCriticalValue() const = 0;
 };
@@ -127,7 +145,9 @@ class ConstraintBase : public PriorityBase<PRIO>
           prediction_value_(std::numeric_limits<double>::max()),
           last_value_(0.0),
           last_time_(ros::Time::now()),
-          last_pred_time_(ros::Time::now())
+          last_pred_time_(ros::Time::now()),
+          task_jacobian_(Eigen::MatrixXd::Zero(1, 1)),
+          task_derivatives_(Eigen::VectorXd::Zero(1))
         {
             this->member_inst_cnt_ = instance_ctr_++;
         }
@@ -151,14 +171,15 @@ class ConstraintBase : public PriorityBase<PRIO>
             return this->state_;
         }
 
-        virtual Eigen::MatrixXd getTaskJacobian() const
+        /// The task buffers are updated by the calculation of the constraint (empty task unless the constraint defines one).
+        virtual const Eigen::MatrixXd& getTaskJacobian() const
         {
-            return Eigen::MatrixXd::Zero(1, 1);
+            return this->task_jacobian_;
         }
 
-        virtual Eigen::VectorXd getTaskDerivatives() const
+        virtual const Eigen::VectorXd& getTaskDerivatives() const
         {
-            return Eigen::VectorXd::Zero(1, 1);
+            return this->task_derivatives_;
         }
 
         virtual void update(const JointStates& joint_states, const KDL::JntArrayVel& joints_prediction, const Matrix6Xd_t& jacobian_data)
@@ -171,7 +192,23 @@ class ConstraintBase : public PriorityBase<PRIO>
             this->jacobian_data_ = jacobian_data;
             this->jnts_prediction_ = joints_prediction;
             this->callback_data_mediator_.fill(this->constraint_params_);
-            this->calculate();
+
+            if (this->constraint_params_.params_.lazy_evaluation && !this->isNearActivation())
+            {
+                this->calculateInactive();
+            }
+            else
+            {
+                this->calculate();
+            }
+        }
+
+        /**
+         * Takes over gains and thresholds of the constraint type (the priority is not changed).
+         */
+        virtual void updateParams(const TwistControllerParams& tc_params)
+        {
+            this->constraint_params_.params_ = tc_params.constraint_params.at(T_PARAMS::getType());
         }
 
         virtual void calculate() = 0;
@@ -186,7 +223,7 @@ class ConstraintBase : public PriorityBase<PRIO>
             return this->derivative_value_;
         }
 
-        virtual Eigen::VectorXd getPartialValues() const
+        virtual const Eigen::VectorXd& getPartialValues() const
         {
             return this->partial_values_;
         }
@@ -200,6 +237,23 @@ class ConstraintBase : public PriorityBase<PRIO>
         virtual double getSelfMotionMagnitude(const Eigen::MatrixXd& particular_solution,
                                               const Eigen::MatrixXd& homogeneous_solution) const = 0;
 
+        /// The constraint as a whole: its inverse priority if it is in DANGER state.
+        virtual double getInvDangerPriority() const
+        {
+            if (DANGER != this->state_.getCurrent())
+            {
+                return 0.0;
+            }
+
+            const double prio = this->getPriorityAsNum();
+            return prio > ZERO_THRESHOLD ? 1.0 / prio : 1.0 / DIV0_SAFE;
+        }
+
+        virtual Eigen::VectorXd getDangerPartialValues() const
+        {
+            return this->getInvDangerPriority() * this->partial_values_;
+        }
+
     protected:
         ConstraintState state_;
         T_PARAMS constraint_params_;
@@ -217,6 +271,9 @@ class ConstraintBase : public PriorityBase<PRIO>
         ros::Time last_time_;
         ros::Time last_pred_time_;
 
+        Eigen::MatrixXd task_jacobian_;
+        Eigen::VectorXd task_derivatives_;
+
         uint32_t member_inst_cnt_;
         static uint32_t instance_ctr_;
 
@@ -224,6 +281,34 @@ class ConstraintBase : public PriorityBase<PRIO>
         {
             return 0.0;
         }
+
+        /**
+         * Cheap pre-check of the lazy evaluation, based on the data copied by update().
+         * @return false only if the constraint is that far from its activation threshold that calculate() would not contribute to the solution.
+         */
+        virtual bool isNearActivation()
+        {
+            return true;
+        }
+
+        /**
+         * Replaces calculate() while the constraint is far from activation: The partial values are zero.
+         * Derived constraints set the state which calculate() would result in.
+         */
+        virtual void calculateInactive()
+        {
+            this->partial_values_.setZero(this->jacobian_data_.cols());
+        }
+
+        /**
+         * One row task of a constraint with a scalar cost function: The partial values are the task Jacobian and the
+         * derivative value is the task. Assigned to the task buffers, i.e. without reallocation once they are sized.
+         */
+        void setScalarTask()
+        {
+            this->task_jacobian_ = this->partial_values_.transpose();
+            this->task_derivatives_.setConstant(1, this->derivative_value_);
+        }
 };
 
 template <typename T_PARAMS, typename PRIO>
@@ -27,7 +27,6 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/pointer_cast.hpp>
 
-#include <kdl/chainjnttojacsolver.hpp>
 #include <kdl/jntarray.hpp>
 
 #include <eigen_conversions/eigen_kdl.h>
@@ -53,28 +52,6 @@ std::string CollisionAvoidance<T_PARAMS, PRIO>::getTaskId() const
     return taskid;
 }
 
-/**
- * Critical Point Jacobian: Each critical point is represented by one CA constraint.
- * So the partial values represent a one row task Jacobian.
- * @return Partial values as task Jacobian.
- */
-template <typename T_PARAMS, typename PRIO>
-Eigen::MatrixXd CollisionAvoidance<T_PARAMS, PRIO>::getTaskJacobian() const
-{
-    return this->task_jacobian_;
-}
-
-/**
- * 1x1 Vector returning the task derivative of a CA constraint.
- * One row task Jacobian <-> One dim derivative.
- * @return The derivative value.
- */
-template <typename T_PARAMS, typename PRIO>
-Eigen::VectorXd CollisionAvoidance<T_PARAMS, PRIO>::getTaskDerivatives() const
-{
-    return this->derivative_values_;
-}
-
 template <typename T_PARAMS, typename PRIO>
 void CollisionAvoidance<T_PARAMS, PRIO>::calculate()
 {
@@ -174,8 +151,8 @@ template <typename T_PARAMS, typename PRIO>
 double CollisionAvoidance<T_PARAMS, PRIO>::getCriticalValue() const
 {
     double min_distance = std::numeric_limits<double>::max();
-    for (std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.current_distances_.begin();
-         it != this->constraint_params_.current_distances_.end();
+    for (std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.getCurrentDistances().begin();
+         it != this->constraint_params_.getCurrentDistances().end();
          ++it)
     {
         if (it->min_distance < min_distance)
@@ -187,13 +164,36 @@ double CollisionAvoidance<T_PARAMS, PRIO>::getCriticalValue() const
     return min_distance;
 }
 
+/**
+ * Neither the values nor the partial values consider obstacles beyond the activation buffer.
+ * So the constraint only has to be calculated if an obstacle is within the buffer (or it has to stay CRITICAL).
+ */
+template <typename T_PARAMS, typename PRIO>
+bool CollisionAvoidance<T_PARAMS, PRIO>::isNearActivation()
+{
+    return (this->state_.getCurrent() == CRITICAL ||
+            this->getCriticalValue() < this->constraint_params_.params_.thresholds.activation_with_buffer);
+}
+
+/**
+ * The prediction is skipped as well: Within one cycle the critical point cannot move from beyond the activation buffer into the critical region.
+ */
+template <typename T_PARAMS, typename PRIO>
+void CollisionAvoidance<T_PARAMS, PRIO>::calculateInactive()
+{
+    ConstraintBase<T_PARAMS, PRIO>::calculateInactive();
+    this->prediction_value_ = std::numeric_limits<double>::max();
+    this->last_pred_time_ = ros::Time::now();
+    this->state_.setState(NORMAL);
+}
+
 template <typename T_PARAMS, typename PRIO>
 void CollisionAvoidance<T_PARAMS, PRIO>::calcValue()
 {
     const ConstraintParams& params = this->constraint_params_.params_;
     std::vector<double> relevant_values;
-    for (std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.current_distances_.begin();
-         it != this->constraint_params_.current_distances_.end();
+    for (std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.getCurrentDistances().begin();
+         it != this->constraint_params_.getCurrentDistances().end();
          ++it)
     {
         if (params.thresholds.activation_with_buffer > it->min_distance)
@@ -220,94 +220,83 @@ template <typename T_PARAMS, typename PRIO>
 void CollisionAvoidance<T_PARAMS, PRIO>::calcDerivativeValue()
 {
     this->derivative_value_ = -0.1 * this->value_;  // exponential decay experimentally chosen -0.1
-    this->derivative_values_ = -0.1 * this->values_;
+    this->task_derivatives_ = -0.1 * this->values_;  // one task derivative per critical point
 }
 
 /**
  * Calculate the partial values for each obstacle with the current link.
  * For GPM the partial values are summed.
  * For task constraint the task Jacobian is created: Each row is the partial value vector of one collision pair.
+ * The Jacobian of the link segment is taken from the KinematicsCache, i.e. it is computed once per cycle
+ * and only mapped to the critical point of each collision pair.
  * ATTENTION: The magnitude and activation gain are considered only for GPM here.
  */
 template <typename T_PARAMS, typename PRIO>
 void CollisionAvoidance<T_PARAMS, PRIO>::calcPartialValues()
 {
-    // ROS_INFO_STREAM("CollisionAvoidance::calcPartialValues:");
-    Eigen::VectorXd partial_values = Eigen::VectorXd::Zero(this->jacobian_data_.cols());
-    Eigen::VectorXd sum_partial_values = Eigen::VectorXd::Zero(this->jacobian_data_.cols());
-    this->partial_values_ = Eigen::VectorXd::Zero(this->jacobian_data_.cols());
+    const uint32_t cols = this->jacobian_data_.cols();
+    Eigen::VectorXd sum_partial_values = Eigen::VectorXd::Zero(cols);
+    this->partial_values_ = Eigen::VectorXd::Zero(cols);
 
     const ConstraintParams& params = this->constraint_params_.params_;
     std::vector<Eigen::VectorXd> vec_partial_values;
 
-    // ROS_INFO_STREAM("this->jacobian_data_.cols: " << this->jacobian_data_.cols());
-    // ROS_INFO_STREAM("this->joint_states_.current_q_.rows: " << this->joint_states_.current_q_.rows());
-
     std::vector<std::string>::const_iterator str_it = std::find(this->constraint_params_.frame_names_.begin(),
                                                                 this->constraint_params_.frame_names_.end(),
                                                                 this->constraint_params_.id_);
 
-    for (std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.current_distances_.begin();
-         it != this->constraint_params_.current_distances_.end();
+    // Translational and rotational part of the segment Jacobian (extended by the columns of a KinematicExtension).
+    // Both are only set up once the first collision pair within the activation buffer is found.
+    Eigen::Matrix3Xd jac_transl;
+    Eigen::Matrix3Xd jac_rot;
+    bool segment_jac_valid = false;
+
+    for (std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.getCurrentDistances().begin();
+         it != this->constraint_params_.getCurrentDistances().end();
          ++it)
     {
         if (params.thresholds.activation_with_buffer > it->min_distance)
         {
             if (this->constraint_params_.frame_names_.end() != str_it)
             {
-                Eigen::Vector3d collision_pnt_vector = it->nearest_point_frame_vector - it->frame_vector;
-                Eigen::Vector3d distance_vec = it->nearest_point_frame_vector - it->nearest_point_obstacle_vector;
-
-                // Create a skew-symm matrix as transformation between the segment root and the critical point.
-                Eigen::Matrix3d skew_symm;
-                skew_symm <<     0.0,                       collision_pnt_vector.z(), -collision_pnt_vector.y(),
-                                -collision_pnt_vector.z(),  0.0,                       collision_pnt_vector.x(),
-                                 collision_pnt_vector.y(), -collision_pnt_vector.x(),  0.0;
-
-                Eigen::Matrix3d ident = Eigen::Matrix3d::Identity();
-                Eigen::Matrix<double, 6, 6> T;
-                T.block(0, 0, 3, 3) << ident;
-                T.block(0, 3, 3, 3) << skew_symm;
-                T.block(3, 0, 3, 3) << Eigen::Matrix3d::Zero();
-                T.block(3, 3, 3, 3) << ident;
-                // ****************************************************************************************************
-
-                uint32_t idx = str_it - this->constraint_params_.frame_names_.begin();
-                uint32_t frame_number = idx + 1;  // segment nr not index represents frame number
-
-                KDL::JntArray ja = this->joint_states_.current_q_;
-                KDL::Jacobian new_jac_chain(this->joint_states_.current_q_.rows());
-
-                // ROS_INFO_STREAM("frame_number: " << frame_number);
-                // ROS_INFO_STREAM("ja.rows: " << ja.rows());
-                // ROS_INFO_STREAM("new_jac_chain: " << new_jac_chain.rows() << " x " << new_jac_chain.columns());
-
-                if (0 != this->jnt_to_jac_.JntToJac(ja, new_jac_chain, frame_number))
+                if (!segment_jac_valid)
                 {
-                    ROS_ERROR_STREAM("Failed to calculate JntToJac. Error Code: " << this->jnt_to_jac_.getError() << " (" << this->jnt_to_jac_.strError(this->jnt_to_jac_.getError()) << ")");
-                    ROS_ERROR_STREAM("This is likely due to using a KinematicExtension! The ChainJntToJac-Solver is configured for the main chain only!");
-                    return;
+                    uint32_t idx = str_it - this->constraint_params_.frame_names_.begin();
+                    uint32_t frame_number = idx + 1;  // segment nr not index represents frame number
+
+                    if (frame_number > this->kinematics_cache_.getNrOfSegments())
+                    {
+                        ROS_ERROR_STREAM("Frame number " << frame_number << " exceeds the " << this->kinematics_cache_.getNrOfSegments() << " segments of the chain!");
+                        return;
+                    }
+                    const KDL::Jacobian& segment_jac = this->kinematics_cache_.getJacobian(frame_number);
+
+                    jac_transl = this->jacobian_data_.topRows(3);
+                    jac_rot = this->jacobian_data_.bottomRows(3);
+                    jac_transl.leftCols(segment_jac.data.cols()) = segment_jac.data.topRows(3);
+                    jac_rot.leftCols(segment_jac.data.cols()) = segment_jac.data.bottomRows(3);
+                    segment_jac_valid = true;
                 }
-                // ROS_INFO_STREAM("new_jac_chain.columns: " << new_jac_chain.columns());
 
-                Matrix6Xd_t jac_extension = this->jacobian_data_;
-                jac_extension.block(0, 0, new_jac_chain.data.rows(), new_jac_chain.data.cols()) = new_jac_chain.data;
-                Matrix6Xd_t crit_pnt_jac = T * jac_extension;
-                Eigen::Matrix3Xd m_transl = Eigen::Matrix3Xd::Zero(3, crit_pnt_jac.cols());
-                m_transl << crit_pnt_jac.row(0),
-                            crit_pnt_jac.row(1),
-                            crit_pnt_jac.row(2);
+                Eigen::Vector3d collision_pnt_vector = it->nearest_point_frame_vector - it->frame_vector;
+                Eigen::Vector3d distance_vec = it->nearest_point_frame_vector - it->nearest_point_obstacle_vector;
 
                 double vec_norm = distance_vec.norm();
                 vec_norm = (vec_norm > 0.0) ? vec_norm : DIV0_SAFE;
-                Eigen::VectorXd term_2nd = (m_transl.transpose()) * (distance_vec / vec_norm);  // use the unit vector only for direction!
+                const Eigen::Vector3d unit_distance_vec = distance_vec / vec_norm;  // use the unit vector only for direction!
+
+                // The translational Jacobian of the critical point is J_v + S(p) * J_w with S(p) * w = w x p,
+                // p being the vector between the segment root and the critical point.
+                // Its transpose applied to the unit distance vector n thus is J_v^T * n + J_w^T * (p x n).
+                Eigen::VectorXd term_2nd = jac_transl.transpose() * unit_distance_vec
+                                         + jac_rot.transpose() * collision_pnt_vector.cross(unit_distance_vec);
 
                 // Gradient of the cost function from: Strasse O., Escande A., Mansard N. et al.
                 // "Real-Time (Self)-Collision Avoidance Task on a HRP-2 Humanoid Robot", 2008 IEEE International Conference
                 const double denom = it->min_distance > 0.0 ? it->min_distance : DIV0_SAFE;
                 const double activation_gain = this->getActivationGain(it->min_distance);
                 const double magnitude = this->getSelfMotionMagnitude(it->min_distance);
-                partial_values = (2.0 * ((it->min_distance - params.thresholds.activation_with_buffer) / denom) * term_2nd);
+                Eigen::VectorXd partial_values = (2.0 * ((it->min_distance - params.thresholds.activation_with_buffer) / denom) * term_2nd);
                 // only consider the gain for the partial values, because of GPM, not for the task jacobian!
                 sum_partial_values += (activation_gain * magnitude * partial_values);
                 vec_partial_values.push_back(partial_values);
@@ -322,20 +311,17 @@ void CollisionAvoidance<T_PARAMS, PRIO>::calcPartialValues()
             // ROS_INFO_STREAM("min_dist not within activation_buffer: " << params.thresholds.activation_with_buffer << " <= " << it->min_distance);
         }
     }
-    // ROS_INFO_STREAM("Done all distances");
-    // ROS_INFO_STREAM("vec_partial_values.size:" << vec_partial_values.size());
 
+    // Critical Point Jacobian: one row (the partial values) per critical point
     if (vec_partial_values.size() > 0)
     {
-        this->task_jacobian_.resize(vec_partial_values.size(), this->jacobian_data_.cols());
+        this->task_jacobian_.resize(vec_partial_values.size(), cols);
     }
 
     for (uint32_t idx = 0; idx < vec_partial_values.size(); ++idx)
     {
-        this->task_jacobian_.block(idx, 0, 1, this->jacobian_data_.cols()) = vec_partial_values.at(idx).transpose();
+        this->task_jacobian_.block(idx, 0, 1, cols) = vec_partial_values.at(idx).transpose();
     }
-    // ROS_INFO_STREAM("this->task_jacobian_.rows:" << this->task_jacobian_.rows());
-    // ROS_INFO_STREAM("this->task_jacobian_.cols:" << this->task_jacobian_.cols());
 
     this->partial_values_ = sum_partial_values;
 }
@@ -357,22 +343,18 @@ void CollisionAvoidance<T_PARAMS, PRIO>::calcPredictionValue()
 
     if (this->constraint_params_.frame_names_.end() != str_it)
     {
-        if (this->constraint_params_.current_distances_.size() > 0)
+        if (this->constraint_params_.getCurrentDistances().size() > 0)
         {
             uint32_t frame_number = (str_it - this->constraint_params_.frame_names_.begin()) + 1;  // segment nr not index represents frame number
-            KDL::FrameVel frame_vel;
 
-            // Calculate prediction for pos and vel
-            int error = this->fk_solver_vel_.JntToCart(this->jnts_prediction_, frame_vel, frame_number);
-            if (error != 0)
+            // Calculate prediction for pos and vel (the pass is shared by all CA constraints of the cycle)
+            if (0 != this->prediction_cache_.update(this->jnts_prediction_.q, this->jnts_prediction_.qdot))
             {
-                ROS_ERROR_STREAM("Could not calculate twist for frame: " << frame_number << ". Error Code: " << error << " (" << this->fk_solver_vel_.strError(error) << ")");
-                ROS_ERROR_STREAM("This is likely due to using a KinematicExtension! The ChainFkSolverVel is configured for the main chain only!");
+                ROS_ERROR_STREAM("Could not calculate twist for frame: " << frame_number);
                 return;
             }
-            // ROS_INFO_STREAM("Calculated twist for frame: " << frame_number);
 
-            KDL::Twist twist = frame_vel.GetTwist();  // predicted frame twist
+            const KDL::Twist& twist = this->prediction_cache_.getTwist(frame_number);  // predicted frame twist
 
             Eigen::Vector3d pred_twist_vel;
             tf::vectorKDLToEigen(twist.vel, pred_twist_vel);
@@ -380,9 +362,9 @@ void CollisionAvoidance<T_PARAMS, PRIO>::calcPredictionValue()
             Eigen::Vector3d pred_twist_rot;
             tf::vectorKDLToEigen(twist.rot, pred_twist_rot);
 
-            std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.current_distances_.begin();
+            std::vector<ObstacleDistanceData>::const_iterator it = this->constraint_params_.getCurrentDistances().begin();
             ObstacleDistanceData critical_data = *it;
-            for ( ; it != this->constraint_params_.current_distances_.end(); ++it)
+            for ( ; it != this->constraint_params_.getCurrentDistances().end(); ++it)
             {
                 if (it->min_distance < critical_data.min_distance)
                 {
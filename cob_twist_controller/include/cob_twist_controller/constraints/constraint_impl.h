@@ -27,7 +27,6 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/pointer_cast.hpp>
 
-#include <kdl/chainjnttojacsolver.hpp>
 
 #include "cob_twist_controller/constraints/constraint.h"
 #include "cob_twist_controller/constraints/constraint_params.h"
@@ -39,8 +38,8 @@
 template <typename PRIO>
 std::set<ConstraintBase_t> ConstraintsBuilder<PRIO>::createConstraints(const TwistControllerParams& tc_params,
                                                                        const LimiterParams& limiter_params,
-                                                                       KDL::ChainJntToJacSolver& jnt_to_jac,
-                                                                       KDL::ChainFkSolverVel_recursive& fk_solver_vel,
+                                                                       KinematicsCache& kinematics_cache,
+                                                                       KinematicsCache& prediction_cache,
                                                                        CallbackDataMediator& data_mediator)
 {
     std::set<ConstraintBase_t> constraints;
@@ -84,6 +83,15 @@ std::set<ConstraintBase_t> ConstraintsBuilder<PRIO>::createConstraints(const Twi
             constraints.insert(boost::static_pointer_cast<PriorityBase<PRIO> >(jla));
         }
     }
+    else if (JLA_VEC_ON == tc_params.constraint_jla)
+    {
+        typedef JointLimitAvoidanceVec<ConstraintParamsJLA, PRIO> JlaVec_t;
+
+        ConstraintParamsJLA params = ConstraintParamsJLA(tc_params.constraint_params.at(JLA), limiter_params);
+        // TODO: take care PRIO could be of different type than UINT32
+        boost::shared_ptr<JlaVec_t > jla(new JlaVec_t(params.params_.priority, params, data_mediator, tc_params.joints.size()));
+        constraints.insert(boost::static_pointer_cast<PriorityBase<PRIO> >(jla));
+    }
     else
     {
         // JLA_OFF selected.
@@ -99,9 +107,10 @@ std::set<ConstraintBase_t> ConstraintsBuilder<PRIO>::createConstraints(const Twi
              it != tc_params.collision_check_links.end(); it++)
         {
             ConstraintParamsCA params = ConstraintParamsCA(tc_params.constraint_params.at(CA),tc_params.frame_names, *it);
+            params.link_idx_ = data_mediator.registerLink(*it);
             data_mediator.fill(params);
             // TODO: take care PRIO could be of different type than UINT32
-            boost::shared_ptr<CollisionAvoidance_t > ca(new CollisionAvoidance_t(startPrio--, params, data_mediator, jnt_to_jac, fk_solver_vel));
+            boost::shared_ptr<CollisionAvoidance_t > ca(new CollisionAvoidance_t(startPrio--, params, data_mediator, kinematics_cache, prediction_cache));
             constraints.insert(boost::static_pointer_cast<PriorityBase<PRIO> >(ca));
         }
     }
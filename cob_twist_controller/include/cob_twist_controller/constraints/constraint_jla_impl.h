@@ -52,18 +52,6 @@ std::string JointLimitAvoidance<T_PARAMS, PRIO>::getTaskId() const
     return taskid;
 }
 
-template <typename T_PARAMS, typename PRIO>
-Eigen::MatrixXd JointLimitAvoidance<T_PARAMS, PRIO>::getTaskJacobian() const
-{
-    return this->partial_values_.transpose();
-}
-
-template <typename T_PARAMS, typename PRIO>
-Eigen::VectorXd JointLimitAvoidance<T_PARAMS, PRIO>::getTaskDerivatives() const
-{
-    return Eigen::VectorXd::Identity(1, 1) * this->derivative_value_;
-}
-
 template <typename T_PARAMS, typename PRIO>
 void JointLimitAvoidance<T_PARAMS, PRIO>::calculate()
 {
@@ -72,19 +60,14 @@ void JointLimitAvoidance<T_PARAMS, PRIO>::calculate()
     const int32_t joint_idx = this->constraint_params_.joint_idx_;
     const double limit_min = limiter_params.limits_min[joint_idx];
     const double limit_max = limiter_params.limits_max[joint_idx];
-    const double joint_pos = this->joint_states_.current_q_(joint_idx);
-
-    this->abs_delta_max_ = std::abs(limit_max - joint_pos);
-    this->rel_max_ = std::abs(this->abs_delta_max_ / limit_max);
-
-    this->abs_delta_min_ = std::abs(joint_pos - limit_min);
-    this->rel_min_ = std::abs(this->abs_delta_min_ / limit_min);
 
+    this->calcRelativeDistances();
     const double rel_val = this->rel_max_ < this->rel_min_ ? this->rel_max_ : this->rel_min_;
 
     this->calcValue();
     this->calcPartialValues();
     this->calcDerivativeValue();
+    this->setScalarTask();
 
     // Compute prediction
     const double pred_delta_max = std::abs(limit_max - this->jnts_prediction_.q(joint_idx));
@@ -191,6 +174,45 @@ void JointLimitAvoidance<T_PARAMS, PRIO>::calcPartialValues()
     partial_values(this->constraint_params_.joint_idx_) = std::abs(denom) > ZERO_THRESHOLD ? nominator / denom : nominator / DIV0_SAFE;
     this->partial_values_ = partial_values;
 }
+
+/**
+ * The activation gain is zero beyond the activation buffer, i.e. the partial values do not contribute to the solution.
+ * The constraint only has to be calculated if the joint is within the buffer (or it has to stay CRITICAL).
+ */
+template <typename T_PARAMS, typename PRIO>
+bool JointLimitAvoidance<T_PARAMS, PRIO>::isNearActivation()
+{
+    this->calcRelativeDistances();
+    const double rel_val = this->rel_max_ < this->rel_min_ ? this->rel_max_ : this->rel_min_;
+    return (this->state_.getCurrent() == CRITICAL ||
+            rel_val < this->constraint_params_.params_.thresholds.activation_with_buffer);
+}
+
+/// Stays DANGER as calculate() would: Within one cycle the joint cannot move from beyond the activation buffer into the critical region.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidance<T_PARAMS, PRIO>::calculateInactive()
+{
+    ConstraintBase<T_PARAMS, PRIO>::calculateInactive();
+    this->setScalarTask();
+    this->state_.setState(DANGER);
+}
+
+/// Absolute and relative distance of the joint position to both limits.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidance<T_PARAMS, PRIO>::calcRelativeDistances()
+{
+    const LimiterParams& limiter_params = this->constraint_params_.limiter_params_;
+    const int32_t joint_idx = this->constraint_params_.joint_idx_;
+    const double limit_min = limiter_params.limits_min[joint_idx];
+    const double limit_max = limiter_params.limits_max[joint_idx];
+    const double joint_pos = this->joint_states_.current_q_(joint_idx);
+
+    this->abs_delta_max_ = std::abs(limit_max - joint_pos);
+    this->rel_max_ = std::abs(this->abs_delta_max_ / limit_max);
+
+    this->abs_delta_min_ = std::abs(joint_pos - limit_min);
+    this->rel_min_ = std::abs(this->abs_delta_min_ / limit_min);
+}
 /* END JointLimitAvoidance **************************************************************************************/
 
 /* BEGIN JointLimitAvoidanceMid ************************************************************************************/
@@ -309,18 +331,6 @@ std::string JointLimitAvoidanceIneq<T_PARAMS, PRIO>::getTaskId() const
     return taskid;
 }
 
-template <typename T_PARAMS, typename PRIO>
-Eigen::MatrixXd JointLimitAvoidanceIneq<T_PARAMS, PRIO>::getTaskJacobian() const
-{
-    return this->partial_values_.transpose();
-}
-
-template <typename T_PARAMS, typename PRIO>
-Eigen::VectorXd JointLimitAvoidanceIneq<T_PARAMS, PRIO>::getTaskDerivatives() const
-{
-    return Eigen::VectorXd::Identity(1, 1) * this->derivative_value_;
-}
-
 template <typename T_PARAMS, typename PRIO>
 void JointLimitAvoidanceIneq<T_PARAMS, PRIO>::calculate()
 {
@@ -329,19 +339,14 @@ void JointLimitAvoidanceIneq<T_PARAMS, PRIO>::calculate()
     const int32_t joint_idx = this->constraint_params_.joint_idx_;
     const double limit_min = limiter_params.limits_min[joint_idx];
     const double limit_max = limiter_params.limits_max[joint_idx];
-    const double joint_pos = this->joint_states_.current_q_(joint_idx);
-
-    this->abs_delta_max_ = std::abs(limit_max - joint_pos);
-    this->rel_max_ = std::abs(this->abs_delta_max_ / limit_max);
-
-    this->abs_delta_min_ = std::abs(joint_pos - limit_min);
-    this->rel_min_ = std::abs(this->abs_delta_min_ / limit_min);
 
+    this->calcRelativeDistances();
     const double rel_val = this->rel_max_ < this->rel_min_ ? this->rel_max_ : this->rel_min_;
 
     this->calcValue();
     this->calcPartialValues();
     this->calcDerivativeValue();
+    this->setScalarTask();
 
     // Compute prediction
     const double pred_delta_max = std::abs(limit_max - this->jnts_prediction_.q(joint_idx));
@@ -476,6 +481,261 @@ void JointLimitAvoidanceIneq<T_PARAMS, PRIO>::calcPartialValues()
     partial_values(this->constraint_params_.joint_idx_) = -2.0 * joint_pos + limit_max + limit_min;
     this->partial_values_ = partial_values;
 }
+
+/**
+ * The activation gain is zero beyond the activation buffer, i.e. the partial values do not contribute to the solution.
+ * The constraint only has to be calculated if the joint is within the buffer (or it has to stay CRITICAL).
+ */
+template <typename T_PARAMS, typename PRIO>
+bool JointLimitAvoidanceIneq<T_PARAMS, PRIO>::isNearActivation()
+{
+    this->calcRelativeDistances();
+    const double rel_val = this->rel_max_ < this->rel_min_ ? this->rel_max_ : this->rel_min_;
+    return (this->state_.getCurrent() == CRITICAL ||
+            rel_val < this->constraint_params_.params_.thresholds.activation_with_buffer);
+}
+
+/// Stays DANGER as calculate() would: Within one cycle the joint cannot move from beyond the activation buffer into the critical region.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceIneq<T_PARAMS, PRIO>::calculateInactive()
+{
+    ConstraintBase<T_PARAMS, PRIO>::calculateInactive();
+    this->setScalarTask();
+    this->state_.setState(DANGER);
+}
+
+/// Absolute and relative distance of the joint position to both limits.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceIneq<T_PARAMS, PRIO>::calcRelativeDistances()
+{
+    const LimiterParams& limiter_params = this->constraint_params_.limiter_params_;
+    const int32_t joint_idx = this->constraint_params_.joint_idx_;
+    const double limit_min = limiter_params.limits_min[joint_idx];
+    const double limit_max = limiter_params.limits_max[joint_idx];
+    const double joint_pos = this->joint_states_.current_q_(joint_idx);
+
+    this->abs_delta_max_ = std::abs(limit_max - joint_pos);
+    this->rel_max_ = std::abs(this->abs_delta_max_ / limit_max);
+
+    this->abs_delta_min_ = std::abs(joint_pos - limit_min);
+    this->rel_min_ = std::abs(this->abs_delta_min_ / limit_min);
+}
 /* END JointLimitAvoidanceIneq **************************************************************************************/
 
+/* BEGIN JointLimitAvoidanceVec ************************************************************************************/
+template <typename T_PARAMS, typename PRIO>
+JointLimitAvoidanceVec<T_PARAMS, PRIO>::JointLimitAvoidanceVec(PRIO prio,
+                                                               T_PARAMS constraint_params,
+                                                               CallbackDataMediator& cbdm,
+                                                               uint32_t dof)
+    : ConstraintBase<T_PARAMS, PRIO>(prio, constraint_params, cbdm),
+      dof_(dof),
+      limits_min_(Eigen::ArrayXd::Zero(dof)),
+      limits_max_(Eigen::ArrayXd::Zero(dof)),
+      rel_(Eigen::ArrayXd::Ones(dof)),
+      pred_rel_(Eigen::ArrayXd::Ones(dof)),
+      values_(Eigen::ArrayXd::Zero(dof)),
+      gradient_(Eigen::ArrayXd::Zero(dof)),
+      activation_gains_(Eigen::ArrayXd::Zero(dof)),
+      critical_(dof, false),
+      critical_cnt_(0),
+      inv_danger_priority_(0.0)
+{
+    const LimiterParams& limiter_params = this->constraint_params_.limiter_params_;
+    for (uint32_t i = 0; i < this->dof_; ++i)
+    {
+        this->limits_min_(i) = limiter_params.limits_min[i];
+        this->limits_max_(i) = limiter_params.limits_max[i];
+    }
+    this->limits_range_sqr_ = (this->limits_max_ - this->limits_min_).square();
+}
+
+template <typename T_PARAMS, typename PRIO>
+std::string JointLimitAvoidanceVec<T_PARAMS, PRIO>::getTaskId() const
+{
+    std::ostringstream oss;
+    oss << this->member_inst_cnt_;
+    oss << "_";
+    oss << this->priority_;
+    std::string taskid = "JointLimitAvoidanceVec_" + oss.str();
+    return taskid;
+}
+
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceVec<T_PARAMS, PRIO>::calculate()
+{
+    const ConstraintParams& params = this->constraint_params_.params_;
+    const Eigen::ArrayXd q = this->joint_states_.current_q_.data.head(this->dof_).array();
+    const Eigen::ArrayXd q_pred = this->jnts_prediction_.q.data.head(this->dof_).array();
+
+    const Eigen::ArrayXd max_delta = this->limits_max_ - q;
+    const Eigen::ArrayXd min_delta = q - this->limits_min_;
+    this->calcRelativeDistances();
+    this->pred_rel_ = ((this->limits_max_ - q_pred) / this->limits_max_).abs().min(((q_pred - this->limits_min_) / this->limits_min_).abs());
+
+    // cost function values and their gradient (see JointLimitAvoidance)
+    const Eigen::ArrayXd denom = max_delta * min_delta;
+    this->values_ = (denom.abs() > ZERO_THRESHOLD).select(this->limits_range_sqr_ / denom, this->limits_range_sqr_ / DIV0_SAFE);
+
+    const Eigen::ArrayXd nominator = (2.0 * q - this->limits_min_ - this->limits_max_) * this->limits_range_sqr_;
+    const Eigen::ArrayXd denom_grad = 4.0 * denom.square();
+    this->gradient_ = (denom_grad.abs() > ZERO_THRESHOLD).select(nominator / denom_grad, nominator / DIV0_SAFE);
+
+    this->calcActivationGains();
+
+    // the gains are applied to the partial values already, s.t. the constraint can be treated as a whole by the solvers
+    this->partial_values_ = Eigen::VectorXd::Zero(this->jacobian_data_.cols());
+    this->partial_values_.head(this->dof_) = (this->activation_gains_ * this->gradient_).matrix();
+
+    this->last_value_ = this->value_;
+    this->value_ = this->values_.sum();
+    this->derivative_value_ = -0.1 * this->value_;
+    this->prediction_value_ = this->pred_rel_.minCoeff();
+
+    // state machine of each joint as for JointLimitAvoidance
+    const double critical = params.thresholds.critical;
+    this->critical_cnt_ = 0;
+    for (uint32_t i = 0; i < this->dof_; ++i)
+    {
+        if (this->critical_[i] && this->pred_rel_(i) < this->rel_(i))
+        {
+            ROS_WARN_STREAM(this->getTaskId() << ": Joint " << i << " is CRITICAL but prediction is smaller than current rel_val -> Stay in CRIT.");
+        }
+        else
+        {
+            this->critical_[i] = (this->rel_(i) < critical || this->pred_rel_(i) < critical);
+        }
+
+        if (this->critical_[i])
+        {
+            ++this->critical_cnt_;
+        }
+    }
+
+    this->calcTask();
+    this->calcDangerTerms();
+    this->state_.setState(this->critical_cnt_ > 0 ? CRITICAL : DANGER);  // always active -> avoid HW destruction.
+}
+
+/// Only has to be calculated if at least one joint is within the activation buffer (or stays CRITICAL), see JointLimitAvoidance.
+template <typename T_PARAMS, typename PRIO>
+bool JointLimitAvoidanceVec<T_PARAMS, PRIO>::isNearActivation()
+{
+    this->calcRelativeDistances();
+    return (this->critical_cnt_ > 0 ||
+            this->rel_.minCoeff() < this->constraint_params_.params_.thresholds.activation_with_buffer);
+}
+
+/// No joint is CRITICAL and all activation gains are zero.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceVec<T_PARAMS, PRIO>::calculateInactive()
+{
+    ConstraintBase<T_PARAMS, PRIO>::calculateInactive();
+    this->activation_gains_.setZero();
+    this->calcDangerTerms();
+    this->state_.setState(DANGER);
+}
+
+/// Relative distance of each joint position to the nearer limit.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceVec<T_PARAMS, PRIO>::calcRelativeDistances()
+{
+    const Eigen::ArrayXd q = this->joint_states_.current_q_.data.head(this->dof_).array();
+    this->rel_ = ((this->limits_max_ - q) / this->limits_max_).abs().min(((q - this->limits_min_) / this->limits_min_).abs());
+}
+
+/// Activation gain of each joint, based on the relative distance to the nearer limit.
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceVec<T_PARAMS, PRIO>::calcActivationGains()
+{
+    const ConstraintParams& params = this->constraint_params_.params_;
+    const double activation_threshold = params.thresholds.activation;
+    const double activation_buffer_region = params.thresholds.activation_with_buffer;  // [%]
+
+    const Eigen::ArrayXd smoothed = 0.5 * (1.0 + (M_PI * (this->rel_ - activation_threshold) / (activation_buffer_region - activation_threshold)).cos());
+    this->activation_gains_ = (this->rel_ < activation_threshold).select(Eigen::ArrayXd::Ones(this->dof_),
+                                                                         (this->rel_ < activation_buffer_region).select(smoothed.max(0.0), 0.0));
+}
+
+/**
+ * Stacked task Jacobian: One row (partial value of the joint) per critical joint.
+ * The task buffers are only reallocated if the number of critical joints changes.
+ */
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceVec<T_PARAMS, PRIO>::calcTask()
+{
+    const uint32_t cols = this->jacobian_data_.cols();
+    if (this->task_jacobian_.rows() != this->critical_cnt_ || this->task_jacobian_.cols() != cols)
+    {
+        this->task_jacobian_.resize(this->critical_cnt_, cols);
+        this->task_derivatives_.resize(this->critical_cnt_);
+    }
+
+    uint32_t row = 0;
+    for (uint32_t i = 0; i < this->dof_; ++i)
+    {
+        if (this->critical_[i])
+        {
+            this->task_jacobian_.row(row).setZero();
+            this->task_jacobian_(row, i) = this->gradient_(i);
+            this->task_derivatives_(row) = -0.1 * this->values_(i);  // as JointLimitAvoidance for a CRITICAL joint
+            ++row;
+        }
+    }
+}
+
+/**
+ * GPM terms of the joints which are not critical, as the per-joint JointLimitAvoidance constraints with increasing
+ * priorities (one per joint) would contribute them: Joints in DANGER state keep their gradients even if others are CRITICAL.
+ */
+template <typename T_PARAMS, typename PRIO>
+void JointLimitAvoidanceVec<T_PARAMS, PRIO>::calcDangerTerms()
+{
+    const uint32_t cols = this->jacobian_data_.cols();
+    if (this->danger_partial_values_.rows() != cols)
+    {
+        this->danger_partial_values_.resize(cols);
+    }
+
+    this->danger_partial_values_.setZero();
+    this->inv_danger_priority_ = 0.0;
+    for (uint32_t i = 0; i < this->dof_; ++i)
+    {
+        if (!this->critical_[i])
+        {
+            const double prio = this->getPriorityAsNum() + i;
+            const double inv_prio = prio > ZERO_THRESHOLD ? 1.0 / prio : 1.0 / DIV0_SAFE;
+            this->inv_danger_priority_ += inv_prio;
+            this->danger_partial_values_(i) = inv_prio * this->partial_values_(i);
+        }
+    }
+}
+
+template <typename T_PARAMS, typename PRIO>
+double JointLimitAvoidanceVec<T_PARAMS, PRIO>::getInvDangerPriority() const
+{
+    return this->inv_danger_priority_;
+}
+
+template <typename T_PARAMS, typename PRIO>
+Eigen::VectorXd JointLimitAvoidanceVec<T_PARAMS, PRIO>::getDangerPartialValues() const
+{
+    return this->danger_partial_values_;
+}
+
+/// The activation gains of the joints are already considered within the partial values.
+template <typename T_PARAMS, typename PRIO>
+double JointLimitAvoidanceVec<T_PARAMS, PRIO>::getActivationGain() const
+{
+    return 1.0;
+}
+
+/// Returns a value for k_H to weight the partial values for e.g. GPM
+template <typename T_PARAMS, typename PRIO>
+double JointLimitAvoidanceVec<T_PARAMS, PRIO>::getSelfMotionMagnitude(const Eigen::MatrixXd& particular_solution, const Eigen::MatrixXd& homogeneous_solution) const
+{
+    return this->constraint_params_.params_.k_H;
+}
+/* END JointLimitAvoidanceVec **************************************************************************************/
+
 #endif  // COB_TWIST_CONTROLLER_CONSTRAINTS_CONSTRAINT_JLA_IMPL_H
@@ -41,7 +41,7 @@ class ConstraintParamsBase
         {}
 
         const std::string id_;
-        const ConstraintParams params_;
+        ConstraintParams params_;  ///< gains and thresholds (may be updated in place on reconfiguration)
 };
 /* END ConstraintParamsBase *************************************************************************************/
 
@@ -54,20 +54,40 @@ class ConstraintParamsCA : public ConstraintParamsBase
                            const std::vector<std::string>& frame_names = std::vector<std::string>(),
                            const std::string& id = std::string()) :
                 ConstraintParamsBase(params, id),
-                frame_names_(frame_names)
+                frame_names_(frame_names),
+                link_idx_(-1)
         {}
 
         ConstraintParamsCA(const ConstraintParamsCA& cpca) :
                 ConstraintParamsBase(cpca.params_, cpca.id_),
                 frame_names_(cpca.frame_names_),
-                current_distances_(cpca.current_distances_)
+                link_idx_(cpca.link_idx_),
+                distances_(cpca.distances_)
         {}
 
         virtual ~ConstraintParamsCA()
         {}
 
+        static ConstraintTypes getType()
+        {
+            return CA;
+        }
+
+        /// The distances of the link of interest within the current snapshot (empty if none available).
+        inline const std::vector<ObstacleDistanceData>& getCurrentDistances() const
+        {
+            static const std::vector<ObstacleDistanceData> no_distances;
+            if (this->distances_ && this->link_idx_ >= 0 && static_cast<uint32_t>(this->link_idx_) < this->distances_->size())
+            {
+                return (*this->distances_)[this->link_idx_];
+            }
+
+            return no_distances;
+        }
+
         std::vector<std::string> frame_names_;
-        std::vector<ObstacleDistanceData> current_distances_;
+        int32_t link_idx_;  ///< index of the link of interest (resolved by the CallbackDataMediator at constraint creation)
+        boost::shared_ptr<const ObstacleDistancesInfo_t> distances_;  ///< snapshot of all distances (shared with the mediator, not copied)
 };
 /* END ConstraintParamsCA ***************************************************************************************/
 
@@ -94,6 +114,11 @@ class ConstraintParamsJLA : public ConstraintParamsBase
         virtual ~ConstraintParamsJLA()
         {}
 
+        static ConstraintTypes getType()
+        {
+            return JLA;
+        }
+
         std::string joint_;
         int32_t joint_idx_;
         const LimiterParams& limiter_params_;
@@ -22,6 +22,12 @@
 #include <std_msgs/Float64MultiArray.h>
 #include <trajectory_msgs/JointTrajectory.h>
 
+#include <realtime_tools/realtime_publisher.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
@@ -29,10 +35,38 @@
 
 #include "cob_twist_controller/controller_interfaces/controller_interface_base.h"
 
+#define COMMAND_RETRY_PERIOD 0.001  /// [s] a command not handed over to the publishing thread is retried after this period
+
 
 namespace cob_twist_controller
 {
 
+/**
+ * Publishes Float64MultiArray commands via a RealtimePublisher without ever dropping the latest one.
+ * If the publishing thread is still busy, the command is kept pending and published on the next successful trylock,
+ * either with the next command or by a timer, such that e.g. a final stop command is not lost.
+ * Not thread-safe: publish() and the timer have to run on the same callback queue.
+ */
+class CommandPublisher
+{
+    public:
+        CommandPublisher() : pending_(false) {}
+
+        void initialize(ros::NodeHandle& nh, const std::string& topic, unsigned int dof);
+
+        /// Hands the command over to the publishing thread or keeps it pending.
+        void publish(const std::vector<double>& command);
+
+    private:
+        bool tryPublish();
+        void retryTimerCallback(const ros::TimerEvent& event);
+
+        boost::scoped_ptr<realtime_tools::RealtimePublisher<std_msgs::Float64MultiArray> > rt_pub_;
+        std::vector<double> command_;   ///< the latest command (preallocated)
+        bool pending_;                  ///< command_ has not been published yet
+        ros::Timer retry_timer_;
+};
+
 /* BEGIN ControllerInterfaceVelocity ****************************************************************************************/
 /// Class providing a ControllerInterface publishing velocities.
 class ControllerInterfaceVelocity : public ControllerInterfaceBase
@@ -45,6 +79,10 @@ class ControllerInterfaceVelocity : public ControllerInterfaceBase
                                 const TwistControllerParams& params);
         virtual void processResult(const KDL::JntArray& q_dot_ik,
                                    const KDL::JntArray& current_q);
+
+    private:
+        CommandPublisher command_pub_;
+        std::vector<double> q_dot_;     ///< preallocated command
 };
 /* END ControllerInterfaceVelocity **********************************************************************************************/
 
@@ -61,22 +99,37 @@ class ControllerInterfacePosition : public ControllerInterfacePositionBase
                                 const TwistControllerParams& params);
         virtual void processResult(const KDL::JntArray& q_dot_ik,
                                    const KDL::JntArray& current_q);
+
+    private:
+        CommandPublisher command_pub_;
 };
 /* END ControllerInterfacePosition **********************************************************************************************/
 
 
 /* BEGIN ControllerInterfaceTrajectory ****************************************************************************************/
-/// Class providing a ControllerInterface publishing a JointTrajectory.
+/**
+ * Class providing a ControllerInterface publishing a JointTrajectory.
+ * By default a single point for the next cycle is published each cycle. With trajectory_lookahead_points > 1, a
+ * segment extrapolated from the integrated velocities is published every trajectory_decimation cycles instead,
+ * such that the joint_trajectory_controller splices fewer trajectories.
+ */
 class ControllerInterfaceTrajectory : public ControllerInterfacePositionBase
 {
     public:
-        ControllerInterfaceTrajectory() {}
+        ControllerInterfaceTrajectory() : cycle_cnt_(0) {}
         ~ControllerInterfaceTrajectory() {}
 
         virtual void initialize(ros::NodeHandle& nh,
                                 const TwistControllerParams& params);
         virtual void processResult(const KDL::JntArray& q_dot_ik,
                                    const KDL::JntArray& current_q);
+
+    private:
+        /// Writes the lookahead points into the preallocated message.
+        void updateLookahead(trajectory_msgs::JointTrajectory& traj_msg);
+
+        boost::scoped_ptr<realtime_tools::RealtimePublisher<trajectory_msgs::JointTrajectory> > rt_pub_;
+        uint32_t cycle_cnt_;    ///< cycles since the last message
 };
 /* END ControllerInterfaceTrajectory **********************************************************************************************/
 
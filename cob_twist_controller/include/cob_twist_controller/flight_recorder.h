@@ -0,0 +1,206 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_FLIGHT_RECORDER_H
+#define COB_TWIST_CONTROLLER_FLIGHT_RECORDER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "cob_twist_controller/pipeline_stats.h"
+
+#define FLIGHT_RECORDER_CAPACITY 2048               /// cycles kept in the ring buffer (about 20 s at 100 Hz)
+#define FLIGHT_RECORDER_MAX_JOINTS 16
+#define FLIGHT_RECORDER_MAX_SINGULAR_VALUES 6
+#define FLIGHT_RECORDER_MAX_CONSTRAINTS 8
+#define FLIGHT_RECORDER_POST_TRIGGER_CYCLES 256     /// cycles recorded after an anomaly before the dump is written
+#define FLIGHT_RECORDER_POST_TRIGGER_TIMEOUT 2.0    /// [s] the dump is written anyway if the controller stops meanwhile
+#define FLIGHT_RECORDER_MIN_DUMP_INTERVAL 10.0      /// [s] between two dumps triggered by anomalies
+#define FLIGHT_RECORDER_POLL_PERIOD 0.05            /// [s] the background thread checks for pending dumps
+#define FLIGHT_RECORDER_MAX_DUMPS 20                /// dumps kept in the directory per chain (the oldest are deleted first)
+#define FLIGHT_RECORDER_VERSION 1
+
+/// Reasons for a dump (bit mask).
+enum FlightRecorderTriggers
+{
+    TRIGGER_REQUEST = 1,            ///< dump requested by service
+    TRIGGER_CRITICAL = 2,           ///< a constraint entered the CRITICAL state
+    TRIGGER_LIMITER_SATURATION = 4, ///< the output limiters started to scale the joint velocities
+    TRIGGER_LIMIT_VIOLATION = 8,    ///< a joint is beyond its position limits
+    TRIGGER_IK_FAILURE = 16,        ///< CartToJnt failed
+};
+
+/// Anomalies triggering an automatic dump by default (the saturation of the limiters is routine and has to be enabled).
+#define FLIGHT_RECORDER_AUTO_TRIGGERS (TRIGGER_CRITICAL | TRIGGER_LIMIT_VIOLATION | TRIGGER_IK_FAILURE)
+
+/**
+ * One control cycle as stored in the ring buffer and in the dumps (fixed size, host byte order).
+ * Arrays are only valid up to the given numbers of elements.
+ */
+struct FlightRecord
+{
+    int64_t stamp;                  ///< [ns] ROS time of the cycle
+    uint64_t cycle;                 ///< consecutive number of the cycle
+    int32_t result;                 ///< return value of CartToJnt
+    uint32_t triggers;              ///< anomalies of this cycle (FlightRecorderTriggers)
+    uint32_t nr_of_joints;
+    uint32_t nr_of_singular_values;
+    uint32_t nr_of_constraints;
+    double twist[6];                ///< input twist (vx, vy, vz, wx, wy, wz) as passed to CartToJnt
+    double q[FLIGHT_RECORDER_MAX_JOINTS];
+    double q_dot[FLIGHT_RECORDER_MAX_JOINTS];
+    double q_dot_out[FLIGHT_RECORDER_MAX_JOINTS];
+    double damping;                 ///< largest damping term (lambda^2) of the pseudoinverse
+    double singular_values[FLIGHT_RECORDER_MAX_SINGULAR_VALUES];
+    uint8_t constraint_states[FLIGHT_RECORDER_MAX_CONSTRAINTS];     ///< EN_ConstraintStates in the order of priority
+    double constraint_gains[FLIGHT_RECORDER_MAX_CONSTRAINTS];       ///< activation gains of the constraints
+    double position_factor;         ///< scaling by the output limiters (see LimiterJointScaling)
+    double velocity_factor;
+    int32_t violating_joint;
+    int64_t stage_durations[NR_OF_STAGES];  ///< [ns], -1 if a stage has not been executed
+};
+
+/// Header of a dump, followed by the joint names and nr_of_records FlightRecords (oldest first).
+struct FlightRecorderDumpHeader
+{
+    uint32_t version;
+    uint32_t record_size;           ///< sizeof(FlightRecord) of the writer
+    uint32_t nr_of_records;
+    uint32_t triggers;              ///< reasons for the dump
+    uint64_t dropped;               ///< cycles not recorded since the start (due to concurrent snapshots)
+    int64_t stamp;                  ///< [ns] ROS time of the trigger
+};
+
+/**
+ * Always-on, fixed-memory recorder of the last cycles of the control pipeline.
+ * The control thread copies one FlightRecord per cycle into a preallocated ring buffer (record()): it neither allocates
+ * nor blocks, a cycle coinciding with a snapshot is dropped instead. Anomalies (rising edges of the triggers detected
+ * in a record) and service requests are handed over to a background thread, which waits for some more cycles, takes a
+ * snapshot of the ring buffer and writes it to a binary dump (see flight_recorder_decoder for the conversion to CSV).
+ */
+class FlightRecorder
+{
+    public:
+        FlightRecorder();
+
+        ~FlightRecorder();
+
+        /**
+         * Allocates the buffers and starts the background thread.
+         * @param directory The directory of the dumps.
+         * @param name Prefix of the file names of the dumps (e.g. the namespace of the chain).
+         * @param joint_names The names of the recorded joints (stored in the dumps).
+         * @param max_dumps The number of generated dumps kept in the directory (0: unlimited).
+         */
+        void start(const std::string& directory, const std::string& name, const std::vector<std::string>& joint_names,
+                   int max_dumps = FLIGHT_RECORDER_MAX_DUMPS);
+        void stop();
+
+        inline void setEnabled(bool enabled)
+        {
+            this->enabled_ = enabled;
+        }
+
+        inline bool isEnabled() const
+        {
+            return this->enabled_;
+        }
+
+        /// If set, anomalies trigger a dump (at most one per FLIGHT_RECORDER_MIN_DUMP_INTERVAL).
+        inline void setAutoDump(bool auto_dump)
+        {
+            this->auto_dump_ = auto_dump;
+        }
+
+        /// The anomalies triggering an automatic dump (bit mask of FlightRecorderTriggers).
+        inline void setAutoDumpTriggers(uint32_t triggers)
+        {
+            this->auto_dump_triggers_ = triggers;
+        }
+
+        /**
+         * Appends a cycle to the ring buffer (control thread, wait-free).
+         * The cycle number is assigned and the triggers of the record are evaluated here.
+         * @param critical Whether any constraint is CRITICAL (the record only keeps FLIGHT_RECORDER_MAX_CONSTRAINTS).
+         */
+        void record(FlightRecord& record, bool critical);
+
+        /**
+         * Requests a dump of the ring buffer (written by the background thread).
+         * @param file_name The name of the dump file (default: generated within the directory of the dumps).
+         * @return The name of the dump file.
+         */
+        std::string requestDump(const std::string& file_name = "");
+
+        /**
+         * Reads a dump.
+         * @return false if the file cannot be read or has been written by an incompatible recorder.
+         */
+        static bool readDump(const std::string& file_name,
+                             FlightRecorderDumpHeader& header,
+                             std::vector<std::string>& joint_names,
+                             std::vector<FlightRecord>& records);
+
+        /// $ROS_HOME (or ~/.ros if not set).
+        static std::string getDefaultDirectory();
+
+    private:
+        void run();
+
+        /// Copies the ring buffer (oldest cycle first) and writes the dump.
+        void dump(const std::string& file_name, uint32_t triggers, int64_t stamp);
+
+        std::string makeFileName(uint32_t triggers, int64_t stamp) const;
+
+        /// Deletes the oldest generated dumps of this recorder, such that at most max_dumps_ are kept.
+        void removeOldDumps();
+
+        boost::atomic<bool> enabled_;
+        boost::atomic<bool> auto_dump_;
+        boost::atomic<uint32_t> auto_dump_triggers_;
+
+        std::vector<FlightRecord> buffer_;      ///< ring buffer (preallocated)
+        std::vector<FlightRecord> snapshot_;    ///< copy of the ring buffer for the dump (background thread only)
+        boost::mutex buffer_lock_;              ///< only tried by the control thread
+        boost::atomic<uint64_t> head_;          ///< number of recorded cycles (incremented under buffer_lock_)
+        uint64_t cycle_;                        ///< control thread only
+        uint32_t last_triggers_;                ///< control thread only
+        boost::atomic<uint64_t> dropped_;
+
+        boost::atomic<uint32_t> pending_triggers_;  ///< triggers not dumped yet
+        boost::atomic<int64_t> trigger_stamp_;
+        boost::atomic<uint64_t> trigger_head_;      ///< head_ at the first pending trigger
+        boost::atomic<bool> request_pending_;       ///< a requested dump has not been written yet
+
+        std::string directory_;
+        std::string name_;
+        int max_dumps_;
+        std::vector<std::string> joint_names_;
+        boost::mutex request_lock_;
+        std::string requested_file_;            ///< file name of a requested dump (guarded by request_lock_)
+        int64_t request_stamp_;                 ///< [ns] time of the request (guarded by request_lock_)
+
+        boost::thread thread_;
+        boost::atomic<bool> running_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_FLIGHT_RECORDER_H
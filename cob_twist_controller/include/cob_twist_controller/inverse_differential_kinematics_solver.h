@@ -18,17 +18,19 @@
 #ifndef COB_TWIST_CONTROLLER_INVERSE_DIFFERENTIAL_KINEMATICS_SOLVER_H
 #define COB_TWIST_CONTROLLER_INVERSE_DIFFERENTIAL_KINEMATICS_SOLVER_H
 
-#include <kdl/chainjnttojacsolver.hpp>
-#include <kdl/chainfksolvervel_recursive.hpp>
+#include <set>
+#include <kdl/chain.hpp>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
 #include "cob_twist_controller/callback_data_mediator.h"
+#include "cob_twist_controller/kinematics_cache.h"
 #include "cob_twist_controller/limiters/limiter.h"
 #include "cob_twist_controller/kinematic_extensions/kinematic_extension_builder.h"
 #include "cob_twist_controller/constraint_solvers/constraint_solver_factory.h"
 #include "cob_twist_controller/task_stack/task_stack_controller.h"
+#include "cob_twist_controller/pipeline_stats.h"
 
 /**
 * Implementation of a inverse velocity kinematics algorithm based
@@ -49,17 +51,23 @@ public:
      * kinematics for
      *
      */
-    InverseDifferentialKinematicsSolver(const TwistControllerParams& params, const KDL::Chain& chain, CallbackDataMediator& data_mediator) :
+    InverseDifferentialKinematicsSolver(const TwistControllerParams& params,
+                                        const KDL::Chain& chain,
+                                        CallbackDataMediator& data_mediator,
+                                        const KinematicExtensionResources& extension_resources = KinematicExtensionResources()) :
         params_(params),
         limiter_params_(params_.limiter_params),
         chain_(chain),
         jac_(chain_.getNrOfJoints()),
-        jnt2jac_(chain_),
-        fk_solver_vel_(chain_),
+        kinematics_cache_(chain_),
+        prediction_cache_(chain_),
         callback_data_mediator_(data_mediator),
-        constraint_solver_factory_(data_mediator, jnt2jac_, fk_solver_vel_, task_stack_controller_)
+        constraint_solver_factory_(data_mediator, kinematics_cache_, prediction_cache_, task_stack_controller_, pipeline_stats_, constraint_updater_),
+        constraint_updater_(params.constraint_parallel_threads),
+        extension_resources_(extension_resources)
     {
-        this->kinematic_extension_.reset(KinematicExtensionBuilder::createKinematicExtension(this->params_));
+        this->kinematic_extension_.reset(KinematicExtensionBuilder::createKinematicExtension(this->params_, this->extension_resources_));
+        this->kinematic_extension_->setChainKinematics(this->kinematics_cache_);
         this->limiter_params_ = this->kinematic_extension_->adjustLimiterParams(this->limiter_params_);
 
         this->limiters_.reset(new LimiterContainer(this->limiter_params_));
@@ -79,11 +87,60 @@ public:
 
     bool resetAll(TwistControllerParams params);
 
+    /**
+     * Applies new parameters and only rebuilds the components affected by the changes.
+     * Pure gain and threshold changes are taken over in place; the latency of the reconfiguration is reported.
+     */
+    bool reconfigure(const TwistControllerParams& params);
+
+    /// Kinematics of the chain for the joint states of the current cycle.
+    const KinematicsCache& getKinematicsCache() const
+    {
+        return this->kinematics_cache_;
+    }
+
+    /// Kinematics of the chain for the predicted joint states of the constraints.
+    const KinematicsCache& getPredictionCache() const
+    {
+        return this->prediction_cache_;
+    }
+
+    /// Enables or disables the caching of the kinematics (see KinematicsCache::setCaching).
+    void setKinematicsCaching(bool caching)
+    {
+        this->kinematics_cache_.setCaching(caching);
+        this->prediction_cache_.setCaching(caching);
+    }
+
+    /// Scaling of the joint velocities by the output limiters in the last cycle.
+    const LimiterJointScaling& getLimiterScaling() const
+    {
+        return this->limiters_->getJointScaling();
+    }
+
+    /// Constraints of the solver; their states refer to the last cycle.
+    const std::set<ConstraintBase_t>& getConstraints() const
+    {
+        return this->constraint_solver_factory_.getConstraints();
+    }
+
+    /// Pseudoinverse calculator of the solver (singular values and damping of the last cycle, NULL if there is no solver).
+    const IPseudoinverseCalculator* getPInvCalculator() const
+    {
+        return this->constraint_solver_factory_.getPInvCalculator();
+    }
+
+    /// Latency instrumentation of the pipeline; the stages of CartToJnt are marked here, the others by the caller.
+    PipelineStats& getPipelineStats()
+    {
+        return this->pipeline_stats_;
+    }
+
 private:
     const KDL::Chain chain_;
     KDL::Jacobian jac_;
-    KDL::ChainFkSolverVel_recursive fk_solver_vel_;
-    KDL::ChainJntToJacSolver jnt2jac_;
+    KinematicsCache kinematics_cache_;      ///< kinematics for the current joint states, shared with constraints and extensions
+    KinematicsCache prediction_cache_;      ///< kinematics for the predicted joint states of the constraints
     TwistControllerParams params_;
     LimiterParams limiter_params_;
     CallbackDataMediator& callback_data_mediator_;
@@ -92,6 +149,9 @@ private:
     ConstraintSolverFactory constraint_solver_factory_;
 
     TaskStackController_t task_stack_controller_;
+    PipelineStats pipeline_stats_;
+    ConstraintUpdater constraint_updater_;  ///< persistent pool for the parallel update of the constraints
+    KinematicExtensionResources extension_resources_;   ///< ROS resources of the chain for the kinematic extensions
 };
 
 #endif  // COB_TWIST_CONTROLLER_INVERSE_DIFFERENTIAL_KINEMATICS_SOLVER_H
@@ -26,6 +26,9 @@
 class IPseudoinverseCalculator
 {
     public:
+        IPseudoinverseCalculator() : last_damping_(0.0)
+        {}
+
         /**
          * Pure virtual method for calculation of the pseudoinverse
          * @param jacobian The Jacobi matrix.
@@ -44,10 +47,24 @@ class IPseudoinverseCalculator
                                           boost::shared_ptr<DampingBase> db,
                                           const Eigen::MatrixXd& jacobian) const = 0;
 
-        /**
-         * Class has no members so implementing an empty destructor.
-         */
         virtual ~IPseudoinverseCalculator() {}
+
+        /// Singular values of the Jacobian of the last damped calculation (empty if it has not been calculated by SVD).
+        inline const Eigen::VectorXd& getLastSingularValues() const
+        {
+            return this->last_singular_values_;
+        }
+
+        /// Largest damping term (lambda^2) of the last damped calculation.
+        inline double getLastDamping() const
+        {
+            return this->last_damping_;
+        }
+
+    protected:
+        /// Diagnostic values of the last damped calculation (the calculation itself is const).
+        mutable Eigen::VectorXd last_singular_values_;
+        mutable double last_damping_;
 };
 
 #endif  // COB_TWIST_CONTROLLER_INVERSE_JACOBIAN_CALCULATIONS_INVERSE_JACOBIAN_CALCULATION_BASE_H
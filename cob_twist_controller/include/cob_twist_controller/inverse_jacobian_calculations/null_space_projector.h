@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_INVERSE_JACOBIAN_CALCULATIONS_NULL_SPACE_PROJECTOR_H
+#define COB_TWIST_CONTROLLER_INVERSE_JACOBIAN_CALCULATIONS_NULL_SPACE_PROJECTOR_H
+
+#include <stdint.h>
+#include <Eigen/Core>
+#include <Eigen/QR>
+#include <Eigen/SVD>
+
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+
+/**
+ * Recursive task priority resolution by means of an orthonormal basis Z of the remaining null space.
+ * Each task is solved in the reduced coordinates of Z (J * Z instead of J * P with an explicit n x n projector).
+ * The row space of the reduced task Jacobian is split off by a column pivoting QR decomposition, whose Householder
+ * reflections are applied to Z directly. Costs per task are O(n * r * m) instead of O(n^3) (r: remaining null space dimension).
+ * The rank is decided on the singular values of the reduced task Jacobian (those of the small factor R): singular
+ * directions (sigma_i < threshold) are truncated as done in PInvBySVD. Column pivoting moves them to the end of the QR.
+ * The SVD of R is skipped if a lower bound of its smallest singular value proves full rank.
+ * See benchmark_null_space_projector for a comparison with the recursion of SVD pseudoinverses.
+ */
+class NullSpaceProjector
+{
+    public:
+        explicit NullSpaceProjector(double threshold = DIV0_SAFE)
+        : threshold_(threshold)
+        {}
+
+        ~NullSpaceProjector()
+        {}
+
+        /**
+         * Starts a new recursion: solution zero, null space spans all dof.
+         */
+        void reset(uint32_t dof);
+
+        /**
+         * Solves the task in the remaining null space (minimum norm least squares solution w.r.t. the current solution)
+         * and removes its row space from the null space.
+         * @param task_jacobian The task Jacobian (m x dof).
+         * @param task The task velocities (m).
+         * @return The rank of the task within the remaining null space.
+         */
+        uint32_t addTask(const Eigen::MatrixXd& task_jacobian, const Eigen::VectorXd& task);
+
+        /// Projects a vector onto the remaining null space (Z * Z^T * v).
+        Eigen::VectorXd project(const Eigen::VectorXd& v) const;
+
+        inline const Eigen::VectorXd& getSolution() const
+        {
+            return this->solution_;
+        }
+
+        inline const Eigen::MatrixXd& getNullSpaceBasis() const
+        {
+            return this->basis_;
+        }
+
+        inline uint32_t getNullSpaceDimension() const
+        {
+            return this->basis_.cols();
+        }
+
+    private:
+        /// @return true if the reduced task Jacobian has full row rank m for sure (without SVD).
+        bool hasFullRank(uint32_t max_rank, uint32_t m);
+
+        double threshold_;
+        Eigen::VectorXd solution_;
+        Eigen::MatrixXd basis_;   ///< orthonormal basis of the remaining null space (dof x r)
+        Eigen::MatrixXd rotated_basis_;
+        Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr_;
+        Eigen::MatrixXd upper_;     ///< R of the QR decomposition (rank x m)
+        Eigen::MatrixXd upper_inv_;
+        Eigen::JacobiSVD<Eigen::MatrixXd> svd_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_INVERSE_JACOBIAN_CALCULATIONS_NULL_SPACE_PROJECTOR_H
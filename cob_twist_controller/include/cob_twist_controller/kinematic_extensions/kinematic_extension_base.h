@@ -19,21 +19,39 @@
 #define COB_TWIST_CONTROLLER_KINEMATIC_EXTENSIONS_KINEMATIC_EXTENSION_BASE_H
 
 #include <ros/ros.h>
+#include <ros/callback_queue_interface.h>
 #include <tf/tf.h>
 #include <tf/transform_listener.h>
 #include "cob_twist_controller/cob_twist_controller_data_types.h"
+#include "cob_twist_controller/kinematics_cache.h"
+#include "cob_twist_controller/tf_cache.h"
 
+/**
+ * ROS resources of the controlled chain, used by the kinematic extensions instead of creating their own.
+ * Not available (NULL) offline, e.g. in the replay, where only extensions without ROS interfaces can be used.
+ */
+struct KinematicExtensionResources
+{
+    KinematicExtensionResources()
+    : callback_queue(NULL),
+      tf_listener(NULL),
+      tf_cache(NULL)
+    {}
+
+    ros::CallbackQueueInterface* callback_queue;    ///< queue of the chain: subscriptions and timers are processed by the thread of the chain
+    tf::TransformListener* tf_listener;             ///< TF buffer shared by all chains of the process
+    TfCache* tf_cache;                              ///< background TF lookups shared by all chains of the process
+};
 
 /// Base class for kinematic extensions.
 class KinematicExtensionBase
 {
     public:
-        explicit KinematicExtensionBase(const TwistControllerParams& params):
-            params_(params)
-        {
-            /// give tf_listener_ some time to fill buffer
-            ros::Duration(0.5).sleep();
-        }
+        KinematicExtensionBase(const TwistControllerParams& params, const KinematicExtensionResources& resources):
+            params_(params),
+            resources_(resources),
+            chain_kinematics_(NULL)
+        {}
 
         virtual ~KinematicExtensionBase() {}
 
@@ -43,10 +61,28 @@ class KinematicExtensionBase
         virtual LimiterParams adjustLimiterParams(const LimiterParams& limiter_params) = 0;
         virtual void processResultExtension(const KDL::JntArray& q_dot_ik) = 0;
 
+        /// Provides the kinematics of the primary chain for the current cycle (updated before adjustJacobian is called).
+        void setChainKinematics(const KinematicsCache& chain_kinematics)
+        {
+            this->chain_kinematics_ = &chain_kinematics;
+        }
+
     protected:
-        ros::NodeHandle nh_;
-        tf::TransformListener tf_listener_;
+        /// @return false (and reports the error) if the ROS resources required by the extension are not available.
+        bool hasResources(bool tf_required) const
+        {
+            if (NULL == this->resources_.callback_queue || (tf_required && (NULL == this->resources_.tf_listener || NULL == this->resources_.tf_cache)))
+            {
+                ROS_ERROR("KinematicExtension %d requires the ROS resources of the chain", this->params_.kinematic_extension);
+                return false;
+            }
+
+            return true;
+        }
+
         const TwistControllerParams& params_;
+        KinematicExtensionResources resources_;
+        const KinematicsCache* chain_kinematics_;
 };
 
 #endif  // COB_TWIST_CONTROLLER_KINEMATIC_EXTENSIONS_KINEMATIC_EXTENSION_BASE_H
@@ -36,7 +36,7 @@ class KinematicExtensionBuilder
         KinematicExtensionBuilder() {}
         ~KinematicExtensionBuilder() {}
 
-        static KinematicExtensionBase* createKinematicExtension(const TwistControllerParams& params);
+        static KinematicExtensionBase* createKinematicExtension(const TwistControllerParams& params, const KinematicExtensionResources& resources);
 };
 /* END KinematicExtensionBuilder *******************************************************************************************/
 
@@ -46,8 +46,8 @@ class KinematicExtensionBuilder
 class KinematicExtensionNone : public KinematicExtensionBase
 {
     public:
-        explicit KinematicExtensionNone(const TwistControllerParams& params)
-        : KinematicExtensionBase(params)
+        KinematicExtensionNone(const TwistControllerParams& params, const KinematicExtensionResources& resources)
+        : KinematicExtensionBase(params, resources)
         {}
 
         ~KinematicExtensionNone() {}
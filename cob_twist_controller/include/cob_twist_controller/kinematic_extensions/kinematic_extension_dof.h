@@ -26,15 +26,21 @@
 #include <Eigen/Geometry>
 
 #include "cob_twist_controller/kinematic_extensions/kinematic_extension_base.h"
+#include "cob_twist_controller/tf_cache.h"
 
 /* BEGIN KinematicExtensionDOF ****************************************************************************************/
 /// Abstract Helper Class to be used for Cartesian KinematicExtensions based on enabled DoFs.
 class KinematicExtensionDOF : public KinematicExtensionBase
 {
     public:
-        explicit KinematicExtensionDOF(const TwistControllerParams& params)
-        : KinematicExtensionBase(params)
-        {}
+        KinematicExtensionDOF(const TwistControllerParams& params, const KinematicExtensionResources& resources)
+        : KinematicExtensionBase(params, resources)
+        {
+            if (NULL != resources.callback_queue)
+            {
+                nh_.setCallbackQueue(resources.callback_queue);
+            }
+        }
 
         ~KinematicExtensionDOF() {}
 
@@ -47,6 +53,7 @@ class KinematicExtensionDOF : public KinematicExtensionBase
         KDL::Jacobian adjustJacobianDof(const KDL::Jacobian& jac_chain, const KDL::Frame eb_frame_ct, const KDL::Frame cb_frame_eb, const ActiveCartesianDimension active_dim);
 
     protected:
+        ros::NodeHandle nh_;    ///< processes its callbacks in the queue of the chain
         unsigned int ext_dof_;
         std::vector<std::string> joint_names_;
         JointStates joint_states_;
@@ -62,8 +69,9 @@ class KinematicExtensionDOF : public KinematicExtensionBase
 class KinematicExtensionBaseActive : public KinematicExtensionDOF
 {
     public:
-        explicit KinematicExtensionBaseActive(const TwistControllerParams& params)
-        : KinematicExtensionDOF(params)
+        KinematicExtensionBaseActive(const TwistControllerParams& params, const KinematicExtensionResources& resources)
+        : KinematicExtensionDOF(params, resources),
+          cb_bl_idx_(-1)
         {}
 
         ~KinematicExtensionBaseActive() {}
@@ -78,6 +86,7 @@ class KinematicExtensionBaseActive : public KinematicExtensionDOF
 
     private:
         ros::Publisher base_vel_pub_;
+        int32_t cb_bl_idx_;     ///< chain_base_link -> base_link (in the shared TfCache)
 
         double min_vel_lin_base_;
         double min_vel_rot_base_;
@@ -26,8 +26,8 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <kdl_parser/kdl_parser.hpp>
-#include <kdl/chainjnttojacsolver.hpp>
-#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/frames.hpp>
+#include <kdl/jacobian.hpp>
 #include <tf_conversions/tf_kdl.h>
 #include <tf/transform_broadcaster.h>
 #include <Eigen/Geometry>
@@ -35,14 +35,27 @@
 #include "cob_twist_controller/kinematic_extensions/kinematic_extension_base.h"
 #include "cob_twist_controller/utils/simpson_integrator.h"
 
+#define LOOKAT_VALIDATION_SAMPLES 10         /// configurations for which the closed-form kinematics are compared with KDL at initialization
+#define LOOKAT_VALIDATION_TOLERANCE 1.0e-9
+
 /* BEGIN KinematicExtensionLookat ****************************************************************************************/
-/// Class to be used for Cartesian KinematicExtensions for Lookat.
+/**
+ * Class to be used for Cartesian KinematicExtensions for Lookat.
+ * The chain is extended by a fixed pointing offset, a prismatic joint along the pointing axis and three revolute joints
+ * (x, y, z) at the focus. Due to this simple structure, the pose of the focus and the Jacobian of the extended chain are
+ * computed in closed form from the kinematics of the chain (see KinematicExtensionBase::setChainKinematics).
+ */
 class KinematicExtensionLookat : public KinematicExtensionBase
 {
     public:
-        explicit KinematicExtensionLookat(const TwistControllerParams& params)
-        : KinematicExtensionBase(params)
-        {}
+        KinematicExtensionLookat(const TwistControllerParams& params, const KinematicExtensionResources& resources)
+        : KinematicExtensionBase(params, resources)
+        {
+            if (NULL != resources.callback_queue)
+            {
+                nh_.setCallbackQueue(resources.callback_queue);
+            }
+        }
 
         ~KinematicExtensionLookat() {}
 
@@ -53,9 +66,26 @@ class KinematicExtensionLookat : public KinematicExtensionBase
         virtual void processResultExtension(const KDL::JntArray& q_dot_ik);
 
     private:
+        /// Pose of the lookat_focus_frame w.r.t. the chain tip.
+        KDL::Frame getFocusFrame(const KDL::JntArray& q_ext) const;
+
+        /**
+         * Jacobian of the extended chain (reference point is the focus).
+         * @param jac_chain Jacobian of the chain (reference point is the chain tip).
+         * @param chain_tip Pose of the chain tip w.r.t. the chain base.
+         */
+        void computeJacobian(const KDL::Jacobian& jac_chain,
+                             const KDL::Frame& chain_tip,
+                             const KDL::JntArray& q_ext,
+                             KDL::Jacobian& jac_full) const;
+
+        /// Compares the closed-form kinematics with the generic KDL kinematics of the extended chain.
+        bool validateKinematics(const KDL::Chain& chain_main, const KDL::Chain& chain_ext) const;
+
+        ros::NodeHandle nh_;    ///< processes its callbacks in the queue of the chain
         unsigned int ext_dof_;
-        KDL::Chain chain_ext_;
-        KDL::Chain chain_full_;
+        KDL::Frame offset_;             ///< chain tip -> pointing frame
+        KDL::Vector lookat_axis_;       ///< direction of the lookat_lin_joint w.r.t. the pointing frame
         JointStates joint_states_ext_;
         JointStates joint_states_full_;
         std::vector<double> limits_ext_max_;
@@ -63,9 +93,6 @@ class KinematicExtensionLookat : public KinematicExtensionBase
         std::vector<double> limits_ext_vel_;
         std::vector<double> limits_ext_acc_;
 
-        boost::shared_ptr<KDL::ChainJntToJacSolver> jnt2jac_;
-        boost::shared_ptr<KDL::ChainFkSolverPos_recursive> fk_solver_ext_;
-
         boost::shared_ptr<SimpsonIntegrator> integrator_;
 
         boost::mutex mutex_;
@@ -24,6 +24,7 @@
 #include <std_msgs/Float64MultiArray.h>
 #include <sensor_msgs/JointState.h>
 
+#include <boost/shared_ptr.hpp>
 #include <urdf/model.h>
 #include <kdl_parser/kdl_parser.hpp>
 #include <Eigen/Geometry>
@@ -35,9 +36,14 @@
 class KinematicExtensionURDF : public KinematicExtensionBase
 {
     public:
-        explicit KinematicExtensionURDF(const TwistControllerParams& params)
-        : KinematicExtensionBase(params)
-        {}
+        KinematicExtensionURDF(const TwistControllerParams& params, const KinematicExtensionResources& resources)
+        : KinematicExtensionBase(params, resources)
+        {
+            if (NULL != resources.callback_queue)
+            {
+                nh_.setCallbackQueue(resources.callback_queue);
+            }
+        }
 
         ~KinematicExtensionURDF() {}
 
@@ -50,12 +56,14 @@ class KinematicExtensionURDF : public KinematicExtensionBase
         void jointstateCallback(const sensor_msgs::JointState::ConstPtr& msg);
 
     protected:
+        ros::NodeHandle nh_;    ///< processes its callbacks in the queue of the chain (joint_states_ is not locked)
         ros::Publisher command_pub_;
         ros::Subscriber joint_state_sub_;
 
         std::string ext_base_;
         std::string ext_tip_;
         KDL::Chain chain_;
+        boost::shared_ptr<KinematicsCache> ext_kinematics_;
         unsigned int ext_dof_;
         std::vector<std::string> joint_names_;
         JointStates joint_states_;
@@ -72,8 +80,8 @@ class KinematicExtensionURDF : public KinematicExtensionBase
 class KinematicExtensionTorso : public KinematicExtensionURDF
 {
     public:
-        explicit KinematicExtensionTorso(const TwistControllerParams& params)
-        : KinematicExtensionURDF(params)
+        KinematicExtensionTorso(const TwistControllerParams& params, const KinematicExtensionResources& resources)
+        : KinematicExtensionURDF(params, resources)
         {}
 
         ~KinematicExtensionTorso() {}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_KINEMATICS_CACHE_H
+#define COB_TWIST_CONTROLLER_KINEMATICS_CACHE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <kdl/chain.hpp>
+#include <kdl/frames.hpp>
+#include <kdl/jacobian.hpp>
+#include <kdl/jntarray.hpp>
+
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Per-cycle kinematics of a KDL::Chain.
+ * For a given set of joint positions (and velocities) all segment frames, segment twists and joint unit twists are computed
+ * within one recursive pass. The Jacobian of any segment is assembled from those without further recursion.
+ * The cache is keyed by the joint states: updating it with unchanged joint states does not trigger a new pass.
+ * Frame number 0 denotes the chain base, frame number i the tip of segment i-1 (as for the KDL solvers).
+ * update() and getJacobian() may be called concurrently (e.g. by constraints evaluated in parallel), as long as all
+ * callers of a cycle pass the same joint states.
+ */
+class KinematicsCache
+{
+    public:
+        explicit KinematicsCache(const KDL::Chain& chain);
+
+        ~KinematicsCache()
+        {}
+
+        /**
+         * Updates the cached kinematics for the given joint states.
+         * Additional trailing entries (e.g. DoFs of a KinematicExtension) are ignored.
+         * @param q The joint positions.
+         * @param q_dot The joint velocities.
+         * @return 0 on success, -1 in case of too few joint values.
+         */
+        int update(const KDL::JntArray& q, const KDL::JntArray& q_dot);
+        int update(const KDL::JntArray& q);
+
+        /// Pose of the given frame w.r.t. the chain base.
+        const KDL::Frame& getFrame(uint32_t frame_number) const;
+
+        /// Twist of the given frame w.r.t. the chain base (reference point is the frame origin).
+        const KDL::Twist& getTwist(uint32_t frame_number) const;
+
+        /// Jacobian of the given frame (reference point is the frame origin). Columns of subsequent joints are zero.
+        const KDL::Jacobian& getJacobian(uint32_t frame_number);
+
+        /// Jacobian of the chain tip.
+        const KDL::Jacobian& getJacobian();
+
+        uint32_t getNrOfSegments() const
+        {
+            return this->nr_of_segments_;
+        }
+
+        uint32_t getNrOfJoints() const
+        {
+            return this->nr_of_joints_;
+        }
+
+        /// Number of recursive passes executed so far.
+        uint64_t getNrOfPasses() const
+        {
+            return this->nr_of_passes_;
+        }
+
+        /// Number of update requests served so far (with or without recursive pass).
+        uint64_t getNrOfUpdates() const
+        {
+            return this->nr_of_updates_;
+        }
+
+        /// Number of segment Jacobians assembled so far.
+        uint64_t getNrOfJacobians() const
+        {
+            return this->nr_of_jacobians_;
+        }
+
+        /**
+         * Enables (default) or disables the caching. Without caching each update runs a recursive pass and each Jacobian
+         * request runs another one (as the former ChainFkSolverVel_recursive and ChainJntToJacSolver calls of each consumer).
+         * Only meant for comparisons, e.g. by twist_controller_replay.
+         */
+        void setCaching(bool caching)
+        {
+            boost::mutex::scoped_lock lock(this->lock_);
+            this->caching_ = caching;
+            this->valid_ = false;
+        }
+
+    private:
+        void recurse();
+
+        const KDL::Chain chain_;
+        const uint32_t nr_of_segments_;
+        const uint32_t nr_of_joints_;
+
+        bool caching_;
+        bool valid_;
+        KDL::JntArray q_;
+        KDL::JntArray q_dot_;
+
+        std::vector<KDL::Frame> frames_;            ///< indexed by frame number
+        std::vector<KDL::Twist> twists_;            ///< indexed by frame number
+        std::vector<KDL::Twist> joint_twists_;      ///< unit twist of each joint w.r.t. base, reference point at its segment tip
+        std::vector<uint32_t> joint_frames_;        ///< frame number of the segment tip of each joint
+        std::vector<KDL::Jacobian> jacobians_;      ///< indexed by frame number
+        std::vector<bool> jacobians_valid_;
+
+        uint64_t nr_of_passes_;
+        uint64_t nr_of_updates_;
+        uint64_t nr_of_jacobians_;
+
+        boost::mutex lock_;     ///< serializes the lazy updates of the cached data
+};
+
+#endif  // COB_TWIST_CONTROLLER_KINEMATICS_CACHE_H
@@ -24,6 +24,63 @@
 
 #define LIMIT_SAFETY_THRESHOLD 0.1/180.0*M_PI
 
+/* BEGIN LimiterJointFused **************************************************************************************/
+/// Scaling of the joint velocities applied by the fused joint limiter in the last cycle.
+struct LimiterJointScaling
+{
+    double position_factor;             ///< largest divisor due to position limits (1.0: not limited)
+    double velocity_factor;             ///< largest divisor due to velocity limits (1.0: not limited)
+    int32_t position_joint;             ///< joint determining position_factor (-1: none)
+    int32_t velocity_joint;             ///< joint determining velocity_factor (-1: none)
+    int32_t violating_joint;            ///< first joint beyond its position limits (-1: none)
+    std::vector<double> joint_factors;  ///< total divisor per joint (infinity if the velocity is set to zero)
+};
+
+/**
+ * Joint limiter applying the position, velocity (and acceleration) limits in a single stage.
+ * Equivalent to the chain of LimiterAllJoint* resp. LimiterIndividualJoint* limiters (same results), but works on
+ * preallocated arrays: the factors of all limits are determined in one pass over the joints, the scaled velocities are
+ * written in a second one (a third one is only needed if the position limits change the velocity factor).
+ */
+class LimiterJointFused
+{
+    public:
+        explicit LimiterJointFused(const LimiterParams& limiter_params) :
+            limiter_params_(limiter_params)
+        {
+            this->resetScaling(0);
+        }
+
+        ~LimiterJointFused()
+        {}
+
+        /**
+         * Enforces all enabled joint limits.
+         * @param q_dot_ik The calculated joint velocities vector which has to be checked for limits.
+         * @param q The last known joint positions.
+         * @param q_dot_out Scaled joint velocities vector. May be the same object as q_dot_ik.
+         */
+        void enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out);
+
+        inline const LimiterJointScaling& getScaling() const
+        {
+            return this->scaling_;
+        }
+
+    private:
+        void enforceAllLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out);
+        void enforceIndividualLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out);
+
+        /// @return The factor for the velocity of joint i due to its position limits (1.0 if not close to a limit).
+        double positionFactor(unsigned int i, double q_dot, double q, double tolerance) const;
+
+        void resetScaling(unsigned int dof);
+
+        const LimiterParams& limiter_params_;
+        LimiterJointScaling scaling_;
+};
+/* END LimiterJointFused ****************************************************************************************/
+
 /* BEGIN LimiterJointContainer *******************************************************************************/
 /// Container for limiters, implementing interface methods.
 class LimiterContainer
@@ -34,7 +91,18 @@ class LimiterContainer
          * See base class LimiterJointBase for more details on params and returns.
          */
         virtual KDL::Twist enforceLimits(const KDL::Twist& v_in) const;
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
+
+        /**
+         * Applies the fused joint limiter followed by the joint limiters added explicitly.
+         * @param q_dot_out Scaled joint velocities vector. May be the same object as q_dot_ik.
+         */
+        virtual void enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out);
+
+        /// Scaling applied by the fused joint limiter in the last cycle.
+        inline const LimiterJointScaling& getJointScaling() const
+        {
+            return this->fused_limiter_.getScaling();
+        }
 
         /**
          * Initialization for the container.
@@ -44,11 +112,13 @@ class LimiterContainer
         virtual ~LimiterContainer();
 
         explicit LimiterContainer(const LimiterParams& limiter_params) :
-            limiter_params_(limiter_params)
+            limiter_params_(limiter_params),
+            fused_limiter_(limiter_params)
         {}
 
     protected:
         const LimiterParams& limiter_params_;
+        LimiterJointFused fused_limiter_;
 
         std::vector<const LimiterCartesianBase*> input_limiters_;
         std::vector<const LimiterJointBase*> output_limiters_;
@@ -69,57 +139,6 @@ class LimiterContainer
 };
 /* END LimiterJointContainer *****************************************************************************************/
 
-/* BEGIN LimiterAllJointPositions *******************************************************************************/
-/// Class for limiters, declaring the method to limit all joint positions.
-class LimiterAllJointPositions : public LimiterJointBase
-{
-    public:
-        /**
-         * Specific implementation of enforceLimits-method.
-         * See base class LimiterJointBase for more details on params and returns.
-         */
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
-
-        explicit LimiterAllJointPositions(const LimiterParams& limiter_params) :
-            LimiterJointBase(limiter_params)
-        {}
-};
-/* END LimiterAllJointPositions **********************************************************************************/
-
-/* BEGIN LimiterAllJointVelocities *******************************************************************************/
-/// Class for joint velocity limiter (all scaled to keep direction), implementing interface methods.
-class LimiterAllJointVelocities : public LimiterJointBase
-{
-    public:
-        /**
-         * Specific implementation of enforceLimits-method.
-         * See base class LimiterJointBase for more details on params and returns.
-         */
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
-
-        explicit LimiterAllJointVelocities(const LimiterParams& limiter_params) :
-            LimiterJointBase(limiter_params)
-        {}
-};
-/* END LimiterAllJointVelocities *********************************************************************************/
-
-/* BEGIN LimiterAllJointAccelerations ****************************************************************************/
-/// Class for joint acceleration limiter (all scaled to keep direction), implementing interface methods.
-class LimiterAllJointAccelerations : public LimiterJointBase
-{
-    public:
-        /**
-         * Specific implementation of enforceLimits-method.
-         * See base class LimiterJointBase for more details on params and returns.
-         */
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
-
-        explicit LimiterAllJointAccelerations(const LimiterParams& limiter_params) :
-            LimiterJointBase(limiter_params)
-        {}
-};
-/* END LimiterAllJointAccelerations ******************************************************************************/
-
 /* BEGIN LimiterAllCartesianVelocities ***********************************************************************/
 /// Class for limiting the cartesian velocities commands in order to guarantee a BIBO system (all scaled to keep direction).
 class LimiterAllCartesianVelocities : public LimiterCartesianBase
@@ -137,57 +156,6 @@ class LimiterAllCartesianVelocities : public LimiterCartesianBase
 };
 /* END LimiterAllCartesianVelocities *************************************************************************/
 
-/* BEGIN LimiterIndividualJointPositions *************************************************************************/
-/// Class for a limiter, declaring a method to limit joint positions individually
-class LimiterIndividualJointPositions : public LimiterJointBase
-{
-    public:
-        /**
-         * Specific implementation of enforceLimits-method.
-         * See base class LimiterJointBase for more details on params and returns.
-         */
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
-
-        explicit LimiterIndividualJointPositions(const LimiterParams& limiter_params) :
-            LimiterJointBase(limiter_params)
-        {}
-};
-/* END LimiterIndividualJointPositions **************************************************************************/
-
-/* BEGIN LimiterIndividualJointVelocities ***********************************************************************/
-/// Class for joint velocity limiter (individually scaled -> changes direction), implementing interface methods.
-class LimiterIndividualJointVelocities : public LimiterJointBase
-{
-    public:
-        /**
-         * Specific implementation of enforceLimits-method.
-         * See base class LimiterJointBase for more details on params and returns.
-         */
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
-
-        explicit LimiterIndividualJointVelocities(const LimiterParams& limiter_params) :
-            LimiterJointBase(limiter_params)
-        {}
-};
-/* END LimiterIndividualJointVelocities *************************************************************************/
-
-/* BEGIN LimiterIndividualJointAccelerations ***********************************************************************/
-/// Class for joint acceleration limiter (individually scaled -> changes direction), implementing interface methods.
-class LimiterIndividualJointAccelerations : public LimiterJointBase
-{
-    public:
-        /**
-         * Specific implementation of enforceLimits-method.
-         * See base class LimiterJointBase for more details on params and returns.
-         */
-        virtual KDL::JntArray enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const;
-
-        explicit LimiterIndividualJointAccelerations(const LimiterParams& limiter_params) :
-            LimiterJointBase(limiter_params)
-        {}
-};
-/* END LimiterIndividualJointAccelerations *************************************************************************/
-
 /* BEGIN LimiterIndividualCartesianVelocities ***********************************************************************/
 /// Class for limiting the cartesian velocities commands in order to guarantee a BIBO system (individually scaled -> changes direction).
 class LimiterIndividualCartesianVelocities : public LimiterCartesianBase
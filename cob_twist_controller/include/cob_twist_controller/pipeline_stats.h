@@ -0,0 +1,168 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_PIPELINE_STATS_H
+#define COB_TWIST_CONTROLLER_PIPELINE_STATS_H
+
+#include <time.h>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#define PIPELINE_STATS_BUFFER_SIZE 1024  /// cycles buffered between two exports
+
+/// Stages of the twist controller pipeline (in the order of execution).
+enum PipelineStages
+{
+    STAGE_RECEPTION,        ///< age of a stamped twist on reception (header stamp until callback)
+    STAGE_TF_TRANSFORM,     ///< transformation of a stamped twist into the chain base frame
+    STAGE_VISUALIZATION,    ///< visualization of the commanded twist
+    STAGE_JACOBIAN,         ///< forward kinematics and Jacobian of the chain
+    STAGE_EXTENSION,        ///< adjustment of joint states and Jacobian by the kinematic extension
+    STAGE_INPUT_LIMITERS,   ///< Cartesian input limiters
+    STAGE_CONSTRAINTS,      ///< update of the constraints (within the solver)
+    STAGE_SOLVE,            ///< remaining solver calculations
+    STAGE_OUTPUT_LIMITERS,  ///< joint output limiters
+    STAGE_PUBLISH,          ///< processing of the result by the controller interface
+    NR_OF_STAGES
+};
+
+/**
+ * Low-overhead latency instrumentation of the twist controller pipeline.
+ * The control loop stamps the end of each stage with a monotonic clock (mark()) and hands the durations of a cycle
+ * over to a lock-free single-producer/single-consumer ring buffer (end()). The consumer (e.g. a timer) periodically
+ * drains the buffer and exports percentiles and a histogram per stage as diagnostic status.
+ * If disabled, every instrumentation call costs a single branch.
+ * The durations can also be measured without exporting them (setRecording()), e.g. for the FlightRecorder.
+ */
+class PipelineStats
+{
+    public:
+        PipelineStats();
+
+        ~PipelineStats()
+        {}
+
+        void setEnabled(bool enabled);
+
+        inline bool isEnabled() const
+        {
+            return this->enabled_.load(boost::memory_order_relaxed);
+        }
+
+        /// Measures the durations of the stages even if the export is disabled (see getDurations()).
+        void setRecording(bool recording);
+
+        /// Durations of the stages of the current cycle in [ns], -1 if a stage has not been executed (or measured).
+        inline const int64_t* getDurations() const
+        {
+            return this->cycle_.durations;
+        }
+
+        /// Starts a new cycle (producer side).
+        inline void begin()
+        {
+            if (this->measuring_.load(boost::memory_order_relaxed))
+            {
+                for (uint32_t i = 0; i < NR_OF_STAGES; ++i)
+                {
+                    this->cycle_.durations[i] = -1;
+                }
+
+                this->last_stamp_ = now();
+            }
+        }
+
+        /**
+         * Marks the end of a stage: the time since the last mark is accounted to the stage (producer side).
+         * A stage may be marked several times per cycle (e.g. solve before and after the constraint update), the durations add up.
+         */
+        inline void mark(PipelineStages stage)
+        {
+            if (this->measuring_.load(boost::memory_order_relaxed))
+            {
+                const int64_t stamp = now();
+                const int64_t duration = this->cycle_.durations[stage];
+                this->cycle_.durations[stage] = (duration < 0 ? 0 : duration) + stamp - this->last_stamp_;
+                this->last_stamp_ = stamp;
+            }
+        }
+
+        /// Sets the duration of a stage that is not measured by marks, e.g. the age of a message (producer side).
+        inline void setDuration(PipelineStages stage, double seconds)
+        {
+            if (this->measuring_.load(boost::memory_order_relaxed))
+            {
+                this->cycle_.durations[stage] = static_cast<int64_t>(seconds * 1.0e9);
+            }
+        }
+
+        /// Finishes the cycle and hands it over to the consumer (producer side, wait-free).
+        inline void end()
+        {
+            if (this->enabled_.load(boost::memory_order_relaxed))
+            {
+                if (!this->buffer_.push(this->cycle_))
+                {
+                    this->dropped_.fetch_add(1, boost::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * Drains the ring buffer and summarizes all cycles since the last call (consumer side).
+         * @param status One status per stage plus one for the complete cycle and one for the end-to-end latency of
+         *               stamped twists (message age plus cycle, e.g. to compare node and nodelet setups).
+         */
+        void collect(std::vector<diagnostic_msgs::DiagnosticStatus>& status);
+
+        static const char* getStageName(PipelineStages stage);
+
+    private:
+        struct Cycle
+        {
+            int64_t durations[NR_OF_STAGES];    ///< in [ns], -1 if the stage has not been executed
+        };
+
+        static inline int64_t now()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        }
+
+        void summarize(const std::string& name, std::vector<int64_t>& samples, diagnostic_msgs::DiagnosticStatus& status) const;
+
+        boost::atomic<bool> enabled_;       ///< set by the reconfiguration, read by producer and consumer
+        boost::atomic<bool> recording_;
+        boost::atomic<bool> measuring_;     ///< enabled_ or recording_
+        Cycle cycle_;
+        int64_t last_stamp_;
+        boost::atomic<uint64_t> dropped_;   ///< written by the producer, read by the consumer
+        uint64_t last_dropped_;
+        boost::lockfree::spsc_queue<Cycle, boost::lockfree::capacity<PIPELINE_STATS_BUFFER_SIZE> > buffer_;
+
+        std::vector<std::vector<int64_t> > samples_;  ///< consumer side buffers per stage
+        std::vector<int64_t> total_samples_;
+        std::vector<int64_t> end_to_end_samples_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_PIPELINE_STATS_H
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_REPLAY_TWIST_CONTROLLER_LOG_H
+#define COB_TWIST_CONTROLLER_REPLAY_TWIST_CONTROLLER_LOG_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+#include <kdl/frames.hpp>
+#include <kdl/jntarray.hpp>
+#include <cob_control_msgs/ObstacleDistances.h>
+
+#include <cob_twist_controller/TwistControllerConfig.h>
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+
+#define TWIST_CONTROLLER_LOG_VERSION 1
+#define TWIST_CONTROLLER_LOG_QUEUE_SIZE 256         /// records buffered for the writer thread (further records are dropped)
+#define TWIST_CONTROLLER_LOG_RECORD_RESERVE 4096    /// [bytes] preallocated payload per buffered record
+#define TWIST_CONTROLLER_LOG_POLL_PERIOD 0.01       /// [s] the writer thread writes the buffered records to the file
+
+/**
+ * Binary log of the inputs of the twist controller (see TwistControllerLogWriter).
+ * File layout: magic "TCLOG", version, setup record, then a sequence of records.
+ * Each record is: type (uint8), payload size (uint32), payload. All values are stored in host byte order.
+ */
+enum TwistControllerLogRecordTypes
+{
+    RECORD_SETUP = 1,       ///< robot_description and the parameters that are not dynamically reconfigurable
+    RECORD_PARAMS = 2,      ///< dynamic_reconfigure parameters (as applied by the controller)
+    RECORD_OBSTACLES = 3,   ///< obstacle distances as received by the CallbackDataMediator
+    RECORD_CYCLE = 4,       ///< inputs of one CartToJnt call and its result
+};
+
+/// Inputs and result of one control cycle.
+struct TwistControllerLogCycle
+{
+    ros::Time stamp;
+    JointStates joint_states;
+    KDL::Twist twist;       ///< as passed to CartToJnt (i.e. in chain base frame and after base compensation)
+    int32_t result;         ///< return value of CartToJnt
+    KDL::JntArray q_dot;    ///< joint velocities calculated by CartToJnt
+};
+
+/// A record read from a log. Only the members belonging to the record type are valid.
+struct TwistControllerLogRecord
+{
+    uint8_t type;
+    ros::Time stamp;
+    cob_twist_controller::TwistControllerConfig config;
+    cob_control_msgs::ObstacleDistances::Ptr obstacle_distances;
+    TwistControllerLogCycle cycle;
+};
+
+/**
+ * Writes the inputs of the twist controller to a compact binary log.
+ * The write methods only encode the record into a preallocated buffer and hand it over to a lock-free queue,
+ * a background thread writes the queued records to the file. Hence, no file I/O happens on the calling (control) threads.
+ * If the writer thread falls behind by more than TWIST_CONTROLLER_LOG_QUEUE_SIZE records, further records are dropped.
+ */
+class TwistControllerLogWriter
+{
+    public:
+        /**
+         * @param wait_for_buffers Wait for a free record buffer instead of dropping the record, e.g. for offline tools
+         *                         which produce records faster than they can be written (must not be used on control threads).
+         */
+        explicit TwistControllerLogWriter(bool wait_for_buffers = false)
+        : wait_for_buffers_(wait_for_buffers),
+          open_(false),
+          running_(false),
+          dropped_(0)
+        {}
+
+        ~TwistControllerLogWriter()
+        {
+            this->close();
+        }
+
+        /**
+         * Creates the log and writes the setup record.
+         * @param params The parameters of the controller: chain, joints, limits and lookat settings are stored.
+         */
+        bool open(const std::string& file_name, const std::string& robot_description, const TwistControllerParams& params);
+
+        /// Writes the queued records and closes the log. The write methods must not be called concurrently.
+        void close();
+
+        inline bool isOpen() const
+        {
+            return this->open_.load(boost::memory_order_acquire);
+        }
+
+        void writeParams(const ros::Time& stamp, const cob_twist_controller::TwistControllerConfig& config);
+        void writeObstacleDistances(const ros::Time& stamp, const cob_control_msgs::ObstacleDistances& msg);
+
+        /// Inputs and result of one control cycle (see TwistControllerLogCycle).
+        void writeCycle(const ros::Time& stamp, const JointStates& joint_states, const KDL::Twist& twist,
+                        int32_t result, const KDL::JntArray& q_dot);
+
+    private:
+        /// Takes a free record buffer (any thread), false if the log is closed or all buffers are queued (and not waiting).
+        bool acquire(uint32_t& idx);
+
+        /// Queues the encoded record for the writer thread.
+        void commit(uint8_t type, uint32_t idx);
+
+        void run();
+        void writeQueued();
+        void writeRecord(uint8_t type, const std::string& payload);
+
+        const bool wait_for_buffers_;
+        std::ofstream file_;                ///< accessed by the writer thread only while it is running
+        boost::atomic<bool> open_;
+        boost::atomic<bool> running_;
+        boost::atomic<uint64_t> dropped_;
+        boost::thread thread_;
+
+        std::string setup_buffer_;
+        std::vector<std::string> buffers_;  ///< payloads of the buffered records (capacity kept to avoid reallocations)
+        std::vector<uint8_t> types_;        ///< record types of the buffered records
+        boost::lockfree::queue<uint32_t, boost::lockfree::capacity<TWIST_CONTROLLER_LOG_QUEUE_SIZE> > free_;
+        boost::lockfree::queue<uint32_t, boost::lockfree::capacity<TWIST_CONTROLLER_LOG_QUEUE_SIZE> > queued_;
+};
+
+/// Reads a log written by the TwistControllerLogWriter.
+class TwistControllerLogReader
+{
+    public:
+        TwistControllerLogReader()
+        {}
+
+        ~TwistControllerLogReader()
+        {}
+
+        /**
+         * Opens the log and reads the setup record.
+         * @param params Filled with the stored parameters; all others keep their values.
+         */
+        bool open(const std::string& file_name, std::string& robot_description, TwistControllerParams& params);
+
+        /**
+         * Reads the next record.
+         * @return false at the end of the log or if the log is corrupted.
+         */
+        bool read(TwistControllerLogRecord& record);
+
+    private:
+        bool readRecord(uint8_t& type);
+
+        std::ifstream file_;
+        std::string buffer_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_REPLAY_TWIST_CONTROLLER_LOG_H
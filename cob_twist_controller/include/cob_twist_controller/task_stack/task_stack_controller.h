@@ -38,7 +38,6 @@ struct Task
     Eigen::VectorXd task_;
     std::string id_;
     bool is_active_;
-    TwistControllerParams tcp_;
 
     Task(PRIO prio, std::string id) : prio_(prio), id_(id), is_active_(true)
     {}
@@ -52,8 +51,7 @@ struct Task
       id_(task.id_),
       task_jacobian_(task.task_jacobian_),
       task_(task.task_),
-      is_active_(task.is_active_),
-      tcp_(task.tcp_)
+      is_active_(task.is_active_)
     {}
 
     ~Task()
@@ -80,6 +78,11 @@ struct Task
     }
 };
 
+/**
+ * Holds the tasks in stable slots: a task is registered once (by its id) and keeps its slot until clearAllTasks().
+ * The Jacobian and task vector of a slot are preallocated at registration and are updated in place every cycle.
+ * The priority order of the slots is cached and only sorted again when a task is registered or its priority changes.
+ */
 template
 <typename PRIO>
 class TaskStackController
@@ -95,17 +98,36 @@ class TaskStackController
 
         TaskStackController()
         {
-            this->active_task_iter_ = this->tasks_.begin();
+            this->active_task_pos_ = 0;
+            this->order_valid_ = true;
             this->modification_time_ = ros::Time(0);
         }
 
         void clearAllTasks();
 
+        /**
+         * Registers a task and preallocates its buffers. Registering an already known id returns its slot.
+         * Newly registered tasks are inactive.
+         * @return The slot of the task.
+         */
+        uint32_t registerTask(PRIO prio, const std::string& id, uint32_t rows, uint32_t cols);
+
+        /// Direct access to the buffers of a registered task.
+        Task<PRIO>& getTask(uint32_t slot);
+
+        /// Copies the task data into the preallocated buffers of a slot (no reallocation if dimensions are unchanged).
+        template <typename JAC, typename VEC>
+        void updateTask(uint32_t slot, const Eigen::MatrixBase<JAC>& task_jacobian, const Eigen::MatrixBase<VEC>& task);
+
+        void setPriority(uint32_t slot, PRIO prio);
+
         void addTask(Task<PRIO> t);
 
         void deactivateTask(typename std::vector<Task<PRIO> >::iterator it);
         void deactivateTask(std::string task_id);
+        void deactivateTask(uint32_t slot);
         void activateTask(std::string task_id);
+        void activateTask(uint32_t slot);
         void deactivateAllTasks();
 
         void activateAllTasks();
@@ -116,17 +138,27 @@ class TaskStackController
         typename std::vector<Task<PRIO> >::iterator nextActiveTask();
         typename std::vector<Task<PRIO> >::iterator beginTaskIter();
 
+        uint32_t countTasks() const;
         int countActiveTasks() const;
         ros::Time getLastModificationTime() const;
 
     private:
         void updateModificationTime(bool change);
+        void sortOrder();
 
-        std::vector<Task<PRIO> > tasks_;
-        TypedIter_t active_task_iter_;
+        std::vector<Task<PRIO> > tasks_;    ///< indexed by slot
+        std::vector<uint32_t> order_;       ///< slots sorted according to priority
+        bool order_valid_;
+        uint32_t active_task_pos_;          ///< position in order_ of the active task iteration
         ros::Time modification_time_;
 };
 
+template <typename PRIO>
+uint32_t TaskStackController<PRIO>::countTasks() const
+{
+    return this->tasks_.size();
+}
+
 template <typename PRIO>
 int TaskStackController<PRIO>::countActiveTasks() const
 {
@@ -142,48 +174,92 @@ int TaskStackController<PRIO>::countActiveTasks() const
     return i;
 }
 
+template <typename PRIO>
+uint32_t TaskStackController<PRIO>::registerTask(PRIO prio, const std::string& id, uint32_t rows, uint32_t cols)
+{
+    for (uint32_t slot = 0; slot < this->tasks_.size(); ++slot)
+    {
+        if (this->tasks_[slot].id_ == id)
+        {
+            this->setPriority(slot, prio);
+            return slot;
+        }
+    }
+
+    Task<PRIO> t(prio, id, Eigen::MatrixXd::Zero(rows, cols), Eigen::VectorXd::Zero(rows));
+    t.is_active_ = false;
+    this->tasks_.push_back(t);
+    this->order_.push_back(this->tasks_.size() - 1);
+    this->order_valid_ = false;
+    return this->tasks_.size() - 1;
+}
+
+template <typename PRIO>
+Task<PRIO>& TaskStackController<PRIO>::getTask(uint32_t slot)
+{
+    return this->tasks_[slot];
+}
+
+template <typename PRIO>
+template <typename JAC, typename VEC>
+void TaskStackController<PRIO>::updateTask(uint32_t slot,
+                                           const Eigen::MatrixBase<JAC>& task_jacobian,
+                                           const Eigen::MatrixBase<VEC>& task)
+{
+    Task<PRIO>& t = this->tasks_[slot];
+    t.task_jacobian_ = task_jacobian;
+    t.task_ = task;
+}
+
+template <typename PRIO>
+void TaskStackController<PRIO>::setPriority(uint32_t slot, PRIO prio)
+{
+    Task<PRIO>& t = this->tasks_[slot];
+    if (t.prio_ != prio)
+    {
+        t.prio_ = prio;
+        this->order_valid_ = false;
+        this->updateModificationTime(true);
+    }
+}
+
 /**
  * Insert new task sorted.
  */
 template <typename PRIO>
 void TaskStackController<PRIO>::addTask(Task<PRIO> t)
 {
-    TypedIter_t begin_it = this->tasks_.begin();
-    TypedIter_t mem_it = this->tasks_.end();
-    for (TypedIter_t it = this->tasks_.begin(); it != this->tasks_.end(); it++)
+    const uint32_t nr_of_tasks = this->tasks_.size();
+    const uint32_t slot = this->registerTask(t.prio_, t.id_, t.task_jacobian_.rows(), t.task_jacobian_.cols());
+    this->updateTask(slot, t.task_jacobian_, t.task_);
+
+    if (this->tasks_.size() != nr_of_tasks)
     {
-        if (it->id_ == t.id_)  // task already existent -> ignore add
-        {
-            mem_it = it;
-            it->task_jacobian_ = t.task_jacobian_;
-            it->task_ = t.task_;
-            it->tcp_ = t.tcp_;
-            break;
-        }
+        this->tasks_[slot].is_active_ = t.is_active_;
+        this->updateModificationTime(true);
     }
+}
 
-    if (this->tasks_.end() == mem_it)
+/**
+ * Stable sort of the slots: tasks with equal priority keep the order of their registration.
+ */
+template <typename PRIO>
+void TaskStackController<PRIO>::sortOrder()
+{
+    for (uint32_t i = 1; i < this->order_.size(); ++i)
     {
-        for (TypedIter_t it = this->tasks_.begin(); it != this->tasks_.end(); it++)
-        {
-            if (t.prio_ < it->prio_)
-            {
-                mem_it = it;
-                break;
-            }
-        }
-
-        if (this->tasks_.end() == mem_it)
+        const uint32_t slot = this->order_[i];
+        uint32_t j = i;
+        while (j > 0 && this->tasks_[slot].prio_ < this->tasks_[this->order_[j - 1]].prio_)
         {
-            this->tasks_.push_back(t);
-        }
-        else
-        {
-            this->tasks_.insert(mem_it, t);
+            this->order_[j] = this->order_[j - 1];
+            --j;
         }
 
-        this->updateModificationTime(true);
+        this->order_[j] = slot;
     }
+
+    this->order_valid_ = true;
 }
 
 template <typename PRIO>
@@ -206,13 +282,18 @@ void TaskStackController<PRIO>::activateAllTasks()
 template <typename PRIO>
 void TaskStackController<PRIO>::activateHighestPrioTask()
 {
-    TypedIter_t it = this->tasks_.begin();
-    if (this->tasks_.end() != it)
+    if (!this->order_valid_)
     {
-        this->updateModificationTime(!it->is_active_);
+        this->sortOrder();
+    }
 
-        ROS_WARN_STREAM("Activation of highest prio task in stack: " << it->id_);
-        it->is_active_ = true;
+    if (!this->order_.empty())
+    {
+        Task<PRIO>& t = this->tasks_[this->order_.front()];
+        this->updateModificationTime(!t.is_active_);
+
+        ROS_WARN_STREAM("Activation of highest prio task in stack: " << t.id_);
+        t.is_active_ = true;
     }
 }
 
@@ -242,6 +323,14 @@ void TaskStackController<PRIO>::activateTask(std::string task_id)
     }
 }
 
+template <typename PRIO>
+void TaskStackController<PRIO>::activateTask(uint32_t slot)
+{
+    Task<PRIO>& t = this->tasks_[slot];
+    this->updateModificationTime(!t.is_active_);
+    t.is_active_ = true;
+}
+
 template <typename PRIO>
 void TaskStackController<PRIO>::deactivateTask(typename std::vector<Task<PRIO> >::iterator it)
 {
@@ -266,6 +355,14 @@ void TaskStackController<PRIO>::deactivateTask(std::string task_id)
     }
 }
 
+template <typename PRIO>
+void TaskStackController<PRIO>::deactivateTask(uint32_t slot)
+{
+    Task<PRIO>& t = this->tasks_[slot];
+    this->updateModificationTime(t.is_active_);
+    t.is_active_ = false;
+}
+
 template <typename PRIO>
 void TaskStackController<PRIO>::deactivateAllTasks()
 {
@@ -283,37 +380,43 @@ void TaskStackController<PRIO>::deactivateAllTasks()
     this->updateModificationTime(change);
 }
 
+/**
+ * Returns the next active task in priority order (or getTasksEnd() if there is none).
+ */
 template <typename PRIO>
 typename std::vector<Task<PRIO> >::iterator TaskStackController<PRIO>::nextActiveTask()
 {
-    TypedIter_t ret = this->tasks_.end();
-
-    while (this->tasks_.end() != this->active_task_iter_)
+    while (this->active_task_pos_ < this->order_.size())
     {
-        if (this->active_task_iter_->is_active_)
+        const uint32_t slot = this->order_[this->active_task_pos_++];
+        if (this->tasks_[slot].is_active_)
         {
-            ret = this->active_task_iter_++;
-            break;
+            return this->tasks_.begin() + slot;
         }
-
-        this->active_task_iter_++;
     }
 
-    return ret;
+    return this->tasks_.end();
 }
 
 template <typename PRIO>
 typename std::vector<Task<PRIO> >::iterator TaskStackController<PRIO>::beginTaskIter()
 {
-    this->active_task_iter_ = this->tasks_.begin();
-    return this->active_task_iter_;
+    if (!this->order_valid_)
+    {
+        this->sortOrder();
+    }
+
+    this->active_task_pos_ = 0;
+    return this->order_.empty() ? this->tasks_.end() : this->tasks_.begin() + this->order_.front();
 }
 
 template <typename PRIO>
 void TaskStackController<PRIO>::clearAllTasks()
 {
     this->tasks_.clear();
-    this->active_task_iter_ = this->tasks_.end();
+    this->order_.clear();
+    this->order_valid_ = true;
+    this->active_task_pos_ = 0;
     this->updateModificationTime(true);
 }
 
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_TF_CACHE_H
+#define COB_TWIST_CONTROLLER_TF_CACHE_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <stdint.h>
+
+#include <ros/ros.h>
+#include <tf/transform_listener.h>
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#define TF_CACHE_MAX_FRAME_PAIRS 32
+#define TF_CACHE_DEFAULT_RATE 100.0  /// [Hz]
+#define TF_CACHE_DEFAULT_MAX_AGE 0.5  /// [s] older transforms are not returned (the TF of a frame is not published anymore)
+
+/**
+ * Keeps the latest transforms of a few frame pairs up to date in a background thread.
+ * Callbacks of the control loop read the latest transform of a registered pair in constant time without waiting for
+ * the TF tree: each pair holds an immutable snapshot which is exchanged atomically by the background thread.
+ */
+class TfCache
+{
+    public:
+        /**
+         * @param tf_listener The listener to query; it has to outlive the cache.
+         */
+        explicit TfCache(tf::TransformListener& tf_listener);
+
+        ~TfCache()
+        {
+            this->stop();
+        }
+
+        /**
+         * Registers a frame pair to be kept up to date (and tries a first non-blocking lookup).
+         * Registering a pair again returns the index of the existing one.
+         * @return The index of the pair or -1 if the maximum number of pairs has been reached.
+         */
+        int32_t addFramePair(const std::string& target_frame, const std::string& source_frame);
+
+        /// Starts the background thread refreshing all registered pairs with the given rate [Hz].
+        void start(double rate = TF_CACHE_DEFAULT_RATE);
+        void stop();
+
+        /**
+         * Constant-time and non-blocking access to the latest transform from source_frame to target_frame.
+         * @param idx The index returned by addFramePair.
+         * @param max_age [s] Maximum age of the stamp of the transform (<= 0.0: any age). Static transforms (stamp 0) never expire.
+         * @return false if the transform has not been available yet or is too old.
+         */
+        bool getTransform(int32_t idx, tf::StampedTransform& transform, double max_age = TF_CACHE_DEFAULT_MAX_AGE) const;
+
+    private:
+        struct FramePair
+        {
+            std::string target_frame;
+            std::string source_frame;
+            boost::shared_ptr<const tf::StampedTransform> transform;   ///< accessed by means of boost::atomic_load/atomic_store only
+        };
+
+        /// Looks up the latest transform without waiting. @return false if not available.
+        bool refresh(FramePair& pair);
+        void run(double rate);
+
+        tf::TransformListener& tf_listener_;
+
+        FramePair pairs_[TF_CACHE_MAX_FRAME_PAIRS];     ///< fixed storage: registered pairs are never moved
+        boost::atomic<uint32_t> pairs_cnt_;             ///< published after a pair has been completely initialized
+        std::map<std::pair<std::string, std::string>, int32_t> pair_indices_;
+        boost::mutex pairs_lock_;                       ///< serializes the registration
+
+        boost::atomic<bool> running_;
+        boost::thread thread_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_TF_CACHE_H
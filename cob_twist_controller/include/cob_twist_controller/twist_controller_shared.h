@@ -0,0 +1,138 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_TWIST_CONTROLLER_SHARED_H
+#define COB_TWIST_CONTROLLER_TWIST_CONTROLLER_SHARED_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <sensor_msgs/JointState.h>
+#include <tf/transform_listener.h>
+#include <urdf/model.h>
+#include <kdl/tree.hpp>
+#include <kdl/jntarray.hpp>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "cob_twist_controller/tf_cache.h"
+
+/**
+ * Resources shared by all chains controlled within one process (see CobTwistController):
+ * The robot description is parsed once, all chains use the same TF buffer (and TfCache), and the joint_states are
+ * received and deserialized once and demultiplexed to the chains.
+ */
+class TwistControllerShared
+{
+    public:
+        /// Receives the positions and velocities of the registered joints (in the order of registration).
+        typedef boost::function<void (const KDL::JntArray& q, const KDL::JntArray& q_dot)> JointStatesCallback;
+
+        TwistControllerShared();
+
+        ~TwistControllerShared()
+        {}
+
+        /**
+         * Parses /robot_description, subscribes to joint_states and starts the TfCache.
+         * @param nh The namespace of joint_states and twist_controller/tf_cache_rate. The joint_states are processed in its callback queue.
+         */
+        bool initialize(ros::NodeHandle& nh);
+
+        inline const std::string& getRobotDescription() const
+        {
+            return this->robot_description_;
+        }
+
+        inline const KDL::Tree& getTree() const
+        {
+            return this->tree_;
+        }
+
+        inline const urdf::Model& getModel() const
+        {
+            return this->model_;
+        }
+
+        inline tf::TransformListener& getTfListener()
+        {
+            return this->tf_listener_;
+        }
+
+        inline TfCache& getTfCache()
+        {
+            return this->tf_cache_;
+        }
+
+        /**
+         * Registers a consumer of the joint states of the given joints.
+         * For joint_states messages containing all of the joints, the callback is added to the callback queue of the
+         * consumer, i.e. it is executed by the thread processing the other callbacks of the consumer. Messages arriving
+         * while a call is still queued are coalesced: the consumer gets the latest joint states only.
+         * @param owner Identifies the consumer in unregisterJointStates.
+         */
+        void registerJointStates(const void* owner,
+                                 const std::vector<std::string>& joints,
+                                 ros::CallbackQueueInterface* queue,
+                                 const JointStatesCallback& callback);
+        void unregisterJointStates(const void* owner);
+
+        /// The latest joint states of a consumer and whether a call is queued (shared with the queued call).
+        struct JointStatesSlot
+        {
+            boost::mutex lock;
+            KDL::JntArray q;                ///< latest joint states (guarded by lock)
+            KDL::JntArray q_dot;
+            bool pending;                   ///< a call is in the queue of the consumer (guarded by lock)
+            KDL::JntArray q_call;           ///< joint states passed to the callback (queue of the consumer only)
+            KDL::JntArray q_dot_call;
+            JointStatesCallback callback;
+        };
+
+    private:
+        struct JointStatesConsumer
+        {
+            const void* owner;
+            std::vector<std::string> joints;
+            std::vector<int32_t> indices;   ///< position of the joints within the last message (-1: not contained)
+            ros::CallbackQueueInterface* queue;
+            boost::shared_ptr<JointStatesSlot> slot;
+        };
+
+        void jointStatesCallback(const sensor_msgs::JointState::ConstPtr& msg);
+
+        /// @return false if the message does not contain all joints of the consumer.
+        bool updateIndices(const sensor_msgs::JointState& msg, JointStatesConsumer& consumer) const;
+
+        std::string robot_description_;
+        KDL::Tree tree_;
+        urdf::Model model_;
+
+        tf::TransformListener tf_listener_;
+        TfCache tf_cache_;
+
+        ros::Subscriber joint_states_sub_;
+        std::vector<JointStatesConsumer> consumers_;
+        boost::mutex consumers_lock_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_TWIST_CONTROLLER_SHARED_H
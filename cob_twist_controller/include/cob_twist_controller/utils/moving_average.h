@@ -20,7 +20,7 @@
 
 #include <stdint.h>
 #include <ros/ros.h>
-#include <deque>
+#include <vector>
 
 template
 <typename T>
@@ -30,11 +30,20 @@ class MovingAverageBase
         explicit MovingAverageBase()
         {}
 
+        virtual ~MovingAverageBase()
+        {}
+
         virtual void reset() = 0;
         virtual void addElement(T element) = 0;
         virtual bool calcMovingAverage(T& average) const = 0;
 };
 
+/**
+ * Moving average over the last 'size' elements.
+ * The elements are kept in a fixed-capacity ring buffer together with their running sum, i.e. adding an element and
+ * calculating the average are O(1). The running sum is recalculated once per revolution of the ring buffer in order
+ * to bound the accumulation of rounding errors.
+ */
 template
 <typename T>
 class MovingAverageSimple : public MovingAverageBase<T>
@@ -42,41 +51,41 @@ class MovingAverageSimple : public MovingAverageBase<T>
     public:
         explicit MovingAverageSimple(uint16_t size)
         : MovingAverageBase<T>(),
-          size_(size)
-        {
-            weighting_.assign(size_, 1.0);
-        }
+          size_(size > 0 ? size : 1),
+          buffer_(size_),
+          head_(0),
+          count_(0),
+          sum_(T())
+        {}
 
         virtual void reset()
         {
-            s_.clear();
+            head_ = 0;
+            count_ = 0;
+            sum_ = T();
         }
 
         virtual void addElement(T element)
         {
-            if (s_.size() < size_)
+            if (count_ < size_)
             {
-                s_.push_front(element);
+                ++count_;
             }
             else
             {
-                s_.pop_back();
-                s_.push_front(element);
+                sum_ -= buffer_[head_];  // the oldest element is overwritten
             }
+
+            buffer_[head_] = element;
+            sum_ += element;
+            advance();
         }
 
         virtual bool calcMovingAverage(T& average) const
         {
-            if (!s_.empty())
+            if (count_ > 0)
             {
-                T sum;
-                T diff;
-                for (uint16_t i = 0; i < s_.size(); ++i)
-                {
-                    sum += s_[i] * weighting_[i];
-                    diff += weighting_[i];
-                }
-                average = sum / diff;
+                average = sum_ / static_cast<double>(count_);
                 return true;
             }
             else
@@ -87,23 +96,127 @@ class MovingAverageSimple : public MovingAverageBase<T>
         }
 
     protected:
+        /// The element of the given age (0: newest).
+        inline const T& element(uint16_t age) const
+        {
+            return buffer_[(head_ + size_ - 1 - age) % size_];
+        }
+
+        inline void advance()
+        {
+            head_ = (head_ + 1) % size_;
+            if (0 == head_)
+            {
+                recalculate();
+            }
+        }
+
+        virtual void recalculate()
+        {
+            sum_ = T();
+            for (uint16_t age = 0; age < count_; ++age)
+            {
+                sum_ += element(age);
+            }
+        }
+
         uint16_t size_;
-        std::deque<T> s_;
-        std::deque<double> weighting_;
+        std::vector<T> buffer_;
+        uint16_t head_;  ///< position of the next element
+        uint16_t count_;
+        T sum_;
 };
 
+/**
+ * Moving average weighting the element of age a (0: newest) with the triangular number t(size - 1 - a).
+ * As the weights are quadratic in the age, the weighted sum is composed of the running sums of x, a*x and a^2*x,
+ * which are updated in O(1) when all elements age by one.
+ */
 template
 <typename T>
 class MovingAverageWeighted : public MovingAverageSimple<T>
 {
     public:
         explicit MovingAverageWeighted(uint16_t size)
-        : MovingAverageSimple<T>(size)
+        : MovingAverageSimple<T>(size),
+          sum_age_(T()),
+          sum_age_sq_(T())
         {
-            this->weighting_.clear();
-            for (uint16_t i = 0; i < this->size_; i++)
+            double weight_sum = 0.0;
+            for (uint16_t age = 0; age < this->size_; ++age)
             {
-                this->weighting_.push_front(triangle(i));
+                weight_sum += triangle(this->size_ - 1 - age);
+                weight_sums_.push_back(weight_sum);
+            }
+        }
+
+        virtual void reset()
+        {
+            MovingAverageSimple<T>::reset();
+            sum_age_ = T();
+            sum_age_sq_ = T();
+        }
+
+        virtual void addElement(T element)
+        {
+            const double n = static_cast<double>(this->size_);
+
+            // all elements age by one: sum (a+1)^2 x = sum a^2 x + 2 sum a x + sum x
+            sum_age_sq_ += 2.0 * sum_age_ + this->sum_;
+            sum_age_ += this->sum_;
+
+            if (this->count_ < this->size_)
+            {
+                ++this->count_;
+            }
+            else
+            {
+                const T& oldest = this->buffer_[this->head_];  // has reached age n
+                this->sum_ -= oldest;
+                sum_age_ -= n * oldest;
+                sum_age_sq_ -= (n * n) * oldest;
+            }
+
+            this->buffer_[this->head_] = element;  // age 0: contributes to the plain sum only
+            this->sum_ += element;
+            this->advance();
+        }
+
+        virtual bool calcMovingAverage(T& average) const
+        {
+            if (this->count_ > 0)
+            {
+                const double weight_sum = weight_sums_[this->count_ - 1];
+                if (weight_sum <= 0.0)
+                {
+                    // only elements with zero weight (size 1)
+                    average = this->element(0);
+                    return true;
+                }
+
+                // sum t(n-1-a) x = 0.5 * ((n-1) n sum x - (2n-1) sum a x + sum a^2 x)
+                const double n = static_cast<double>(this->size_);
+                average = (0.5 * ((n - 1.0) * n * this->sum_ - (2.0 * n - 1.0) * sum_age_ + sum_age_sq_)) / weight_sum;
+                return true;
+            }
+            else
+            {
+                // no element available
+                return false;
+            }
+        }
+
+    protected:
+        virtual void recalculate()
+        {
+            MovingAverageSimple<T>::recalculate();
+            sum_age_ = T();
+            sum_age_sq_ = T();
+            for (uint16_t age = 1; age < this->count_; ++age)
+            {
+                const double a = static_cast<double>(age);
+                sum_age_ += a * this->element(age);
+                sum_age_sq_ += (a * a) * this->element(age);
             }
         }
 
@@ -119,6 +232,10 @@ class MovingAverageWeighted : public MovingAverageSimple<T>
                 return static_cast<double>(n)*(static_cast<double>(n)+1.0)/2.0;
             }
         }
+
+        T sum_age_;
+        T sum_age_sq_;
+        std::vector<double> weight_sums_;  ///< sum of the weights of the youngest (index + 1) elements
 };
 
 template
@@ -21,31 +21,30 @@
 #include <vector>
 
 #include <ros/ros.h>
+#include <Eigen/Core>
 #include <kdl/jntarray.hpp>
-#include <std_msgs/Float64MultiArray.h>
-
-#include "cob_twist_controller/utils/moving_average.h"
 
+/**
+ * Integrates joint velocities to joint positions using Simpson's rule.
+ * Incoming velocities and outgoing positions are smoothed with an exponential moving average.
+ * The state of all joints is kept in contiguous arrays, such that each step is evaluated for all joints at once.
+ */
 class SimpsonIntegrator
 {
     public:
         explicit SimpsonIntegrator(const uint8_t dof, const double integrator_smoothing = 0.2)
             : dof_(dof),
               integrator_smoothing_(integrator_smoothing),
+              vel_avg_(Eigen::ArrayXd::Zero(dof)),
+              pos_avg_(Eigen::ArrayXd::Zero(dof)),
+              vel_last_(Eigen::ArrayXd::Zero(dof)),
+              vel_before_last_(Eigen::ArrayXd::Zero(dof)),
+              integration_value_(Eigen::ArrayXd::Zero(dof)),
+              history_(0),
+              vel_avg_valid_(false),
+              pos_avg_valid_(false),
               last_update_time_(ros::Time(0.0))
-        {
-            for (uint8_t i = 0; i < dof_; i++)
-            {
-                ma_vel_.push_back(new MovingAvgExponential_double_t(integrator_smoothing_));
-                ma_pos_.push_back(new MovingAvgExponential_double_t(integrator_smoothing_));
-            }
-
-            /// nh_ = ros::NodeHandle("simpson_debug");
-            /// q_dot_ik_pub_ = nh_.advertise<std_msgs::Float64MultiArray>("q_dot_ik", 1);
-            /// q_dot_avg_pub_ = nh_.advertise<std_msgs::Float64MultiArray>("q_dot_avg", 1);
-            /// q_simpson_pub_ = nh_.advertise<std_msgs::Float64MultiArray>("q_simpson", 1);
-            /// q_simpson_avg_pub_ = nh_.advertise<std_msgs::Float64MultiArray>("q_simpson_avg", 1);
-        }
+        {}
 
         ~SimpsonIntegrator()
         {}
@@ -53,15 +52,11 @@ class SimpsonIntegrator
         void resetIntegration()
         {
             // resetting outdated values
-            vel_last_.clear();
-            vel_before_last_.clear();
+            history_ = 0;
 
             // resetting moving average
-            for (unsigned int i = 0; i < dof_; ++i)
-            {
-                ma_vel_[i]->reset();
-                ma_pos_[i]->reset();
-            }
+            vel_avg_valid_ = false;
+            pos_avg_valid_ = false;
         }
 
         bool updateIntegration(const KDL::JntArray& q_dot_ik,
@@ -85,88 +80,57 @@ class SimpsonIntegrator
             }
 
             // smooth incoming velocities
-            KDL::JntArray q_dot_avg(dof_);
-            /// std_msgs::Float64MultiArray q_dot_ik_msg;
-            /// std_msgs::Float64MultiArray q_dot_avg_msg;
-            for (unsigned int i = 0; i < dof_; ++i)
-            {
-                ma_vel_[i]->addElement(q_dot_ik(i));
-                double avg_vel = 0.0;
-                if (ma_vel_[i]->calcMovingAverage(avg_vel))
-                {
-                    q_dot_avg(i) = avg_vel;
-                }
-                else
-                {
-                    q_dot_avg(i) = q_dot_ik(i);
-                }
-
-                /// q_dot_ik_msg.data.push_back(q_dot_ik(i));
-                /// q_dot_avg_msg.data.push_back(q_dot_avg(i));
-            }
+            smooth(q_dot_ik.data.head(dof_).array(), vel_avg_valid_, vel_avg_);
 
-            /// std_msgs::Float64MultiArray q_simpson_msg;
-            /// std_msgs::Float64MultiArray q_simpson_avg_msg;
-            if (!vel_before_last_.empty())
+            if (history_ >= 2)
             {
-                for (unsigned int i = 0; i < dof_; ++i)
-                {
-                    // Simpson
-                    double integration_value = static_cast<double>(period.toSec() / 6.0 * (vel_before_last_[i] + 4.0 * (vel_before_last_[i] + vel_last_[i]) + vel_before_last_[i] + vel_last_[i] + q_dot_avg(i)) + current_q(i));
-
-                    // smooth outgoing positions
-                    ma_pos_[i]->addElement(integration_value);
-                    double avg_pos = 0.0;
-                    if (!ma_pos_[i]->calcMovingAverage(avg_pos))
-                    {
-                        ROS_ERROR("calcMovingAverage failed");
-                        avg_pos = integration_value;
-                    }
-
-                    pos.push_back(avg_pos);
-                    vel.push_back(q_dot_avg(i));
-
-                    /// q_simpson_msg.data.push_back(integration_value);
-                    /// q_simpson_avg_msg.data.push_back(avg_pos);
-                }
-                value_valid = true;
-            }
+                // Simpson
+                integration_value_ = period.toSec() / 6.0 * (vel_before_last_ + 4.0 * (vel_before_last_ + vel_last_) + vel_before_last_ + vel_last_ + vel_avg_)
+                                     + current_q.data.head(dof_).array();
 
-            // Continuously shift the vectors for simpson integration
-            vel_before_last_.clear();
-            for (unsigned int i=0; i < vel_last_.size(); ++i)
-            {
-                vel_before_last_.push_back(vel_last_[i]);
-            }
+                // smooth outgoing positions
+                smooth(integration_value_, pos_avg_valid_, pos_avg_);
 
-            vel_last_.clear();
-            for (unsigned int i=0; i < q_dot_avg.rows(); ++i)
+                pos.assign(pos_avg_.data(), pos_avg_.data() + dof_);
+                vel.assign(vel_avg_.data(), vel_avg_.data() + dof_);
+                value_valid = true;
+            }
+            else
             {
-                vel_last_.push_back(q_dot_avg(i));
+                ++history_;
             }
 
-            /// q_dot_ik_pub_.publish(q_dot_ik_msg);
-            /// q_dot_avg_pub_.publish(q_dot_avg_msg);
-            /// q_simpson_pub_.publish(q_simpson_msg);
-            /// q_simpson_avg_pub_.publish(q_simpson_avg_msg);
+            // Continuously shift the velocities for simpson integration
+            vel_before_last_.swap(vel_last_);
+            vel_last_ = vel_avg_;
 
             return value_valid;
         }
 
     private:
-        std::vector<MovingAvgBase_double_t*> ma_vel_;
-        std::vector<MovingAvgBase_double_t*> ma_pos_;
+        /// Exponential moving average of all joints (the first value after a reset is taken as is).
+        template <typename Derived>
+        inline void smooth(const Eigen::ArrayBase<Derived>& value, bool& valid, Eigen::ArrayXd& average) const
+        {
+            if (valid)
+            {
+                average = integrator_smoothing_ * value + (1.0 - integrator_smoothing_) * average;
+            }
+            else
+            {
+                average = value;
+                valid = true;
+            }
+        }
+
         uint8_t dof_;
         double integrator_smoothing_;
-        std::vector<double> vel_last_, vel_before_last_;
+        Eigen::ArrayXd vel_avg_, pos_avg_;
+        Eigen::ArrayXd vel_last_, vel_before_last_;
+        Eigen::ArrayXd integration_value_;
+        uint8_t history_;   ///< number of velocities available for integration (saturates at 2)
+        bool vel_avg_valid_, pos_avg_valid_;
         ros::Time last_update_time_;
-
-        // debug
-        /// ros::NodeHandle nh_;
-        /// ros::Publisher q_dot_ik_pub_;
-        /// ros::Publisher q_dot_avg_pub_;
-        /// ros::Publisher q_simpson_pub_;
-        /// ros::Publisher q_simpson_avg_pub_;
 };
 
 #endif  // COB_TWIST_CONTROLLER_UTILS_SIMPSON_INTEGRATOR_H
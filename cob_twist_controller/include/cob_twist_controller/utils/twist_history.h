@@ -0,0 +1,160 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef COB_TWIST_CONTROLLER_UTILS_TWIST_HISTORY_H
+#define COB_TWIST_CONTROLLER_UTILS_TWIST_HISTORY_H
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+#include <ros/ros.h>
+#include <kdl/frames.hpp>
+
+#define TWIST_HISTORY_DEFAULT_SIZE 64
+#define TWIST_HISTORY_MIN_EXTRAPOLATION_BASE 0.02  /// [s] minimum time span of the twists the slope for the extrapolation is taken from
+
+/**
+ * Timestamped history of twists (e.g. of the odometry) in a fixed-capacity ring buffer.
+ * A twist can be sampled at any time: between two elements it is interpolated linearly, after the newest element it is
+ * extrapolated linearly (for a limited horizon) and before the oldest element the oldest one is used.
+ * The slope of the extrapolation spans at least TWIST_HISTORY_MIN_EXTRAPOLATION_BASE (i.e. several elements of a fast
+ * odometry), such that the jitter of single messages is not amplified.
+ */
+class TwistHistory
+{
+    public:
+        explicit TwistHistory(uint16_t size = TWIST_HISTORY_DEFAULT_SIZE)
+        : size_(std::max<uint16_t>(size, 2)),
+          stamps_(size_),
+          twists_(size_),
+          head_(0),
+          count_(0)
+        {}
+
+        ~TwistHistory()
+        {}
+
+        void reset()
+        {
+            head_ = 0;
+            count_ = 0;
+        }
+
+        bool empty() const
+        {
+            return 0 == count_;
+        }
+
+        /// Stamp of the newest element (only valid if not empty).
+        const ros::Time& getNewestStamp() const
+        {
+            return stamps_[index(0)];
+        }
+
+        /// Elements older than the newest one are dropped (e.g. reordered messages), an equal stamp replaces the newest one.
+        void addElement(const ros::Time& stamp, const KDL::Twist& twist)
+        {
+            if (count_ > 0)
+            {
+                const ros::Time& newest = stamps_[index(0)];
+                if (stamp < newest)
+                {
+                    return;
+                }
+
+                if (stamp == newest)
+                {
+                    twists_[index(0)] = twist;
+                    return;
+                }
+            }
+
+            stamps_[head_] = stamp;
+            twists_[head_] = twist;
+            head_ = (head_ + 1) % size_;
+            count_ = std::min<uint16_t>(count_ + 1, size_);
+        }
+
+        /**
+         * @param stamp Time of the requested twist.
+         * @param max_extrapolation [s] Beyond the newest element the twist is extrapolated for at most this horizon.
+         *                          If the newest element is older, it is held without extrapolation.
+         * @return false if the history is empty.
+         */
+        bool sample(const ros::Time& stamp, double max_extrapolation, KDL::Twist& twist) const
+        {
+            if (0 == count_)
+            {
+                return false;
+            }
+
+            const uint16_t newest = index(0);
+            if (stamp >= stamps_[newest])
+            {
+                twist = twists_[newest];
+                const double horizon = (stamp - stamps_[newest]).toSec();
+                if (horizon <= 0.0 || horizon > max_extrapolation)
+                {
+                    return true;
+                }
+
+                for (uint16_t i = 1; i < count_; ++i)
+                {
+                    const uint16_t previous = index(i);
+                    const double base = (stamps_[newest] - stamps_[previous]).toSec();
+                    if (base >= TWIST_HISTORY_MIN_EXTRAPOLATION_BASE)
+                    {
+                        twist = twists_[newest] + (twists_[newest] - twists_[previous]) * (horizon / base);
+                        break;
+                    }
+                }
+                return true;
+            }
+
+            /// search backwards, the requested stamp is usually close to the newest element
+            for (uint16_t i = 1; i < count_; ++i)
+            {
+                const uint16_t older = index(i);
+                if (stamps_[older] <= stamp)
+                {
+                    const uint16_t newer = index(i - 1);
+                    const double alpha = (stamp - stamps_[older]).toSec() / (stamps_[newer] - stamps_[older]).toSec();
+                    twist = twists_[older] + (twists_[newer] - twists_[older]) * alpha;
+                    return true;
+                }
+            }
+
+            twist = twists_[index(count_ - 1)];
+            return true;
+        }
+
+    private:
+        /// Position of the i-th newest element.
+        inline uint16_t index(uint16_t i) const
+        {
+            return (head_ + size_ - 1 - i) % size_;
+        }
+
+        const uint16_t size_;
+        std::vector<ros::Time> stamps_;
+        std::vector<KDL::Twist> twists_;
+        uint16_t head_;     ///< position of the next element
+        uint16_t count_;
+};
+
+#endif  // COB_TWIST_CONTROLLER_UTILS_TWIST_HISTORY_H
@@ -22,30 +22,41 @@
 
 #include <eigen_conversions/eigen_msg.h>
 
-/// Counts all currently available distances to obstacles.
-uint32_t CallbackDataMediator::obstacleDistancesCnt()
+CallbackDataMediator::CallbackDataMediator()
+: back_idx_(0),
+  obstacle_distances_cnt_(0)
 {
-    boost::mutex::scoped_lock lock(distances_to_obstacles_lock_);
-    return this->obstacle_distances_.size();
+    this->buffers_[0].reset(new ObstacleDistancesInfo_t());
+    this->buffers_[1].reset(new ObstacleDistancesInfo_t());
+    this->front_ = this->buffers_[1];
 }
 
-/// Consumer: Consumes elements from distances container
-bool CallbackDataMediator::fill(ConstraintParamsCA& params_ca)
+uint32_t CallbackDataMediator::registerLink(const std::string& link)
 {
-    boost::mutex::scoped_lock lock(distances_to_obstacles_lock_);
-    bool success = false;
-    double last_min_distance = std::numeric_limits<double>::max();
-    params_ca.current_distances_.clear();
-    for (ObstacleDistancesIter_t it = this->obstacle_distances_.begin(); it != this->obstacle_distances_.end(); it++)
+    boost::mutex::scoped_lock lock(links_lock_);
+    std::map<std::string, uint32_t>::const_iterator it = this->link_indices_.find(link);
+    if (it != this->link_indices_.end())
     {
-        if (it->first == params_ca.id_)  // select the appropriate distances for frame id of interest
-        {
-            params_ca.current_distances_ = it->second;  // copy all distances for frame to current distances of param struct
-            success = true;
-        }
+        return it->second;
     }
 
-    return success;
+    const uint32_t idx = this->link_indices_.size();
+    this->link_indices_[link] = idx;
+    return idx;
+}
+
+/// Counts all links with currently available distances to obstacles.
+uint32_t CallbackDataMediator::obstacleDistancesCnt()
+{
+    boost::mutex::scoped_lock lock(links_lock_);
+    return this->obstacle_distances_cnt_;
+}
+
+/// Consumer: Takes a reference to the current snapshot (lock-free, no copy)
+bool CallbackDataMediator::fill(ConstraintParamsCA& params_ca)
+{
+    params_ca.distances_ = boost::atomic_load(&this->front_);
+    return !params_ca.getCurrentDistances().empty();
 }
 
 /// Can be used to fill parameters for joint limit avoidance.
@@ -54,18 +65,46 @@ bool CallbackDataMediator::fill(ConstraintParamsJLA& params_jla)
     return true;
 }
 
-/// Producer: Fills obstacle distances but only when they are empty
+/// Producer: Fills the back buffer and publishes it
 void CallbackDataMediator::distancesToObstaclesCallback(const cob_control_msgs::ObstacleDistances::ConstPtr& msg)
 {
-    boost::mutex::scoped_lock lock(distances_to_obstacles_lock_);
-    this->obstacle_distances_.clear();
+    boost::mutex::scoped_lock lock(links_lock_);
+
+    // the back buffer is reused unless a consumer still holds it (then a new one is allocated)
+    ObstacleDistancesInfoPtr_t& back = this->buffers_[this->back_idx_];
+    if (!back.unique())
+    {
+        back.reset(new ObstacleDistancesInfo_t());
+    }
+
+    back->resize(this->link_indices_.size());
+    for (ObstacleDistancesInfo_t::iterator it = back->begin(); it != back->end(); ++it)
+    {
+        it->clear();  // keeps the capacity
+    }
+
     for (cob_control_msgs::ObstacleDistances::_distances_type::const_iterator it = msg->distances.begin(); it != msg->distances.end(); it++)
     {
+        std::map<std::string, uint32_t>::const_iterator idx_it = this->link_indices_.find(it->link_of_interest);
+        if (idx_it == this->link_indices_.end())
+        {
+            continue;  // no constraint registered for this link
+        }
+
         ObstacleDistanceData d;
         d.min_distance = it->distance;
         tf::vectorMsgToEigen(it->frame_vector, d.frame_vector);
         tf::vectorMsgToEigen(it->nearest_point_frame_vector, d.nearest_point_frame_vector);
         tf::vectorMsgToEigen(it->nearest_point_obstacle_vector, d.nearest_point_obstacle_vector);
-        this->obstacle_distances_[it->link_of_interest].push_back(d);
+        (*back)[idx_it->second].push_back(d);
+    }
+
+    this->obstacle_distances_cnt_ = 0;
+    for (ObstacleDistancesInfo_t::const_iterator it = back->begin(); it != back->end(); ++it)
+    {
+        this->obstacle_distances_cnt_ += it->empty() ? 0 : 1;
     }
+
+    boost::atomic_store(&this->front_, ObstacleDistancesInfoConstPtr_t(back));
+    this->back_idx_ = 1 - this->back_idx_;
 }
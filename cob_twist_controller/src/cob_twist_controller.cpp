@@ -15,15 +15,19 @@
  */
 
 
+#include <algorithm>
+#include <set>
 #include <string>
 #include <vector>
 #include <limits>
+#include <sstream>
 #include <ros/ros.h>
 
 #include <cob_twist_controller/cob_twist_controller.h>
 
 #include <kdl_conversions/kdl_msg.h>
 #include <tf/transform_datatypes.h>
+#include <tf_conversions/tf_kdl.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 #include <cob_srvs/SetString.h>
@@ -32,7 +36,7 @@
 
 bool CobTwistController::initialize()
 {
-    ros::NodeHandle nh_twist("twist_controller");
+    ros::NodeHandle nh_twist(nh_, "twist_controller");
 
     // JointNames
     if (!nh_.getParam("joint_names", twist_controller_params_.joints))
@@ -63,28 +67,26 @@ bool CobTwistController::initialize()
         twist_controller_params_.collision_check_links.clear();
     }
 
-    /// parse robot_description and generate KDL chains
-    KDL::Tree my_tree;
-    if (!kdl_parser::treeFromParam("/robot_description", my_tree))
+    /// stand-alone: parse robot_description, subscribe joint_states etc. for this chain only
+    if (!shared_)
     {
-        ROS_ERROR("Failed to construct kdl tree");
-        return false;
+        shared_.reset(new TwistControllerShared());
+        if (!shared_->initialize(nh_))
+        {
+            return false;
+        }
     }
 
-    my_tree.getChain(twist_controller_params_.chain_base_link, twist_controller_params_.chain_tip_link, chain_);
+    /// generate KDL chain from the (shared) robot_description
+    shared_->getTree().getChain(twist_controller_params_.chain_base_link, twist_controller_params_.chain_tip_link, chain_);
     if (chain_.getNrOfJoints() == 0)
     {
         ROS_ERROR("Failed to initialize kinematic chain");
         return false;
     }
 
-    /// parse robot_description and set velocity limits
-    urdf::Model model;
-    if (!model.initParam("/robot_description"))
-    {
-        ROS_ERROR("Failed to parse urdf file for JointLimits");
-        return false;
-    }
+    /// set velocity limits from robot_description
+    const urdf::Model& model = shared_->getModel();
 
     for (uint16_t i = 0; i < twist_controller_params_.dof; i++)
     {
@@ -149,6 +151,17 @@ bool CobTwistController::initialize()
         return false;
     }
     nh_twist.param<double>("integrator_smoothing", twist_controller_params_.integrator_smoothing, 0.2);
+
+    int trajectory_lookahead_points, trajectory_decimation;
+    nh_twist.param<int>("trajectory_lookahead_points", trajectory_lookahead_points, 1);
+    nh_twist.param<double>("trajectory_lookahead_step", twist_controller_params_.trajectory_lookahead_step, 0.0);
+    nh_twist.param<int>("trajectory_decimation", trajectory_decimation, 1);
+    twist_controller_params_.trajectory_lookahead_points = static_cast<uint32_t>(std::max(trajectory_lookahead_points, 1));
+    twist_controller_params_.trajectory_decimation = static_cast<uint32_t>(std::max(trajectory_decimation, 1));
+
+    int constraint_parallel_threads;
+    nh_twist.param<int>("constraint_parallel_threads", constraint_parallel_threads, CONSTRAINT_UPDATER_DEFAULT_THREADS);
+    twist_controller_params_.constraint_parallel_threads = static_cast<uint32_t>(std::max(constraint_parallel_threads, 0));
     try
     {
         interface_loader_.reset(new pluginlib::ClassLoader<cob_twist_controller::ControllerInterfaceBase>("cob_twist_controller", "cob_twist_controller::ControllerInterfaceBase"));
@@ -170,8 +183,30 @@ bool CobTwistController::initialize()
     register_link_client_.waitForExistence(ros::Duration(5.0));
     twist_controller_params_.constraint_ca = CA_OFF;
 
-    /// initialize configuration control solver
-    p_inv_diff_kin_solver_.reset(new InverseDifferentialKinematicsSolver(twist_controller_params_, chain_, callback_data_mediator_));
+    /// record the controller inputs for offline replay
+    std::string record_file;
+    if (nh_twist.getParam("record_file", record_file) && !record_file.empty())
+    {
+        if (log_writer_.open(record_file, shared_->getRobotDescription(), twist_controller_params_))
+        {
+            ROS_INFO_STREAM("Recording twist controller inputs to " << record_file);
+        }
+    }
+
+    /// keep the last cycles for the analysis of anomalies (enabled by dynamic_reconfigure)
+    std::string flight_recorder_dir;
+    nh_twist.param<std::string>("flight_recorder_dir", flight_recorder_dir, FlightRecorder::getDefaultDirectory());
+    int flight_recorder_max_dumps;
+    nh_twist.param<int>("flight_recorder_max_dumps", flight_recorder_max_dumps, FLIGHT_RECORDER_MAX_DUMPS);
+    flight_recorder_.start(flight_recorder_dir, nh_.getNamespace(), twist_controller_params_.joints, flight_recorder_max_dumps);
+    dump_flight_recorder_srv_ = nh_twist.advertiseService("dump_flight_recorder", &CobTwistController::dumpFlightRecorderCallback, this);
+
+    /// initialize configuration control solver (the kinematic extensions use the queue of the chain and the shared TF buffer)
+    KinematicExtensionResources extension_resources;
+    extension_resources.callback_queue = nh_.getCallbackQueue();
+    extension_resources.tf_listener = &shared_->getTfListener();
+    extension_resources.tf_cache = &shared_->getTfCache();
+    p_inv_diff_kin_solver_.reset(new InverseDifferentialKinematicsSolver(twist_controller_params_, chain_, callback_data_mediator_, extension_resources));
     p_inv_diff_kin_solver_->resetAll(twist_controller_params_);
 
     /// Setting up dynamic_reconfigure server for the TwistControlerConfig parameters
@@ -184,19 +219,25 @@ bool CobTwistController::initialize()
     this->joint_states_.last_q_ = KDL::JntArray(chain_.getNrOfJoints());
     this->joint_states_.last_q_dot_ = KDL::JntArray(chain_.getNrOfJoints());
 
-    /// give tf_listener some time to fill tf-cache
-    ros::Duration(1.0).sleep();
+    /// keep the transforms required by the callbacks up to date in the background
+    shared_->getTfCache().addFramePair(twist_controller_params_.chain_base_link, twist_controller_params_.chain_tip_link);
 
     /// initialize ROS interfaces
-    obstacle_distance_sub_ = nh_.subscribe("obstacle_distance", 1, &CallbackDataMediator::distancesToObstaclesCallback, &callback_data_mediator_);
-    jointstate_sub_ = nh_.subscribe("joint_states", 1, &CobTwistController::jointstateCallback, this);
+    obstacle_distance_sub_ = nh_.subscribe("obstacle_distance", 1, &CobTwistController::obstacleDistancesCallback, this);
+    shared_->registerJointStates(this, twist_controller_params_.joints, nh_.getCallbackQueue(),
+                                 boost::bind(&CobTwistController::jointStatesCallback, this, _1, _2));
     twist_sub_ = nh_twist.subscribe("command_twist", 1, &CobTwistController::twistCallback, this);
     twist_stamped_sub_ = nh_twist.subscribe("command_twist_stamped", 1, &CobTwistController::twistStampedCallback, this);
 
     odometry_sub_ = nh_.subscribe("base/odometry", 1, &CobTwistController::odometryCallback, this);
 
-    /// publisher for visualizing current twist direction
-    twist_direction_pub_ = nh_.advertise<visualization_msgs::MarkerArray>("twist_direction", 1);
+    /// publisher for visualizing current twist direction (published by a separate thread)
+    twist_direction_pub_.reset(new realtime_tools::RealtimePublisher<visualization_msgs::MarkerArray>(nh_, "twist_direction", 1));
+    twist_direction_pub_->msg_.markers.resize(2);
+
+    /// latency statistics of the pipeline (published only if enabled)
+    diagnostics_pub_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    pipeline_stats_timer_ = nh_.createTimer(ros::Duration(twist_controller_params_.pipeline_stats_period), &CobTwistController::pipelineStatsTimerCallback, this);
 
     ROS_INFO_STREAM(nh_.getNamespace() << "/twist_controller...initialized!");
     return true;
@@ -239,13 +280,26 @@ void CobTwistController::reconfigureCallback(cob_twist_controller::TwistControll
     
     this->twist_controller_params_.from_config(config);
 
-    if (!p_inv_diff_kin_solver_->resetAll(this->twist_controller_params_))
+    if (!p_inv_diff_kin_solver_->reconfigure(this->twist_controller_params_))
     {
-        ROS_ERROR_STREAM("ResetAll during DynamicReconfigureCallback failed! Resetting to previous config");
+        ROS_ERROR_STREAM("Reconfiguration during DynamicReconfigureCallback failed! Resetting to previous config");
         twist_controller_params_ = backup;
         p_inv_diff_kin_solver_->resetAll(this->twist_controller_params_);
         this->twist_controller_params_.to_config(config);
     }
+
+    p_inv_diff_kin_solver_->getPipelineStats().setEnabled(this->twist_controller_params_.enable_pipeline_stats);
+    p_inv_diff_kin_solver_->getPipelineStats().setRecording(this->twist_controller_params_.enable_flight_recorder);
+    flight_recorder_.setEnabled(this->twist_controller_params_.enable_flight_recorder);
+    flight_recorder_.setAutoDump(this->twist_controller_params_.flight_recorder_auto_dump);
+    flight_recorder_.setAutoDumpTriggers(this->twist_controller_params_.flight_recorder_dump_on_saturation ?
+                                         FLIGHT_RECORDER_AUTO_TRIGGERS | TRIGGER_LIMITER_SATURATION : FLIGHT_RECORDER_AUTO_TRIGGERS);
+    pipeline_stats_timer_.setPeriod(ros::Duration(this->twist_controller_params_.pipeline_stats_period));
+
+    if (log_writer_.isOpen())
+    {
+        log_writer_.writeParams(ros::Time::now(), config);
+    }
 }
 
 void CobTwistController::checkSolverAndConstraints(cob_twist_controller::TwistControllerConfig& config)
@@ -303,7 +357,7 @@ void CobTwistController::checkSolverAndConstraints(cob_twist_controller::TwistCo
         warning = true;
     }
 
-    if (TASK_2ND_PRIO == solver && (JLA_ON == static_cast<ConstraintTypesJLA>(config.constraint_jla) || CA_OFF == static_cast<ConstraintTypesCA>(config.constraint_ca)))
+    if (TASK_2ND_PRIO == solver && (JLA_ON == static_cast<ConstraintTypesJLA>(config.constraint_jla) || JLA_VEC_ON == static_cast<ConstraintTypesJLA>(config.constraint_jla) || CA_OFF == static_cast<ConstraintTypesCA>(config.constraint_ca)))
     {
         ROS_ERROR("The projection of a task into the null space of the main EE task is currently only for the CA constraint supported!");
         twist_controller_params_.constraint_jla = JLA_OFF;
@@ -366,47 +420,71 @@ void CobTwistController::checkSolverAndConstraints(cob_twist_controller::TwistCo
 /// Orientation of twist_stamped_msg is with respect to coordinate system given in header.frame_id
 void CobTwistController::twistStampedCallback(const geometry_msgs::TwistStamped::ConstPtr& msg)
 {
+    PipelineStats& pipeline_stats = p_inv_diff_kin_solver_->getPipelineStats();
+    pipeline_stats.begin();
+    if (!msg->header.stamp.isZero())
+    {
+        pipeline_stats.setDuration(STAGE_RECEPTION, (ros::Time::now() - msg->header.stamp).toSec());
+    }
+
     tf::StampedTransform transform_tf;
     KDL::Frame frame;
     KDL::Twist twist, twist_transformed;
 
-    try
+    if (msg->header.frame_id != twist_frame_)
     {
-        tf_listener_.lookupTransform(twist_controller_params_.chain_base_link, msg->header.frame_id, ros::Time(0), transform_tf);
-        frame.M = KDL::Rotation::Quaternion(transform_tf.getRotation().x(), transform_tf.getRotation().y(), transform_tf.getRotation().z(), transform_tf.getRotation().w());
+        twist_frame_ = msg->header.frame_id;
+        twist_frame_idx_ = shared_->getTfCache().addFramePair(twist_controller_params_.chain_base_link, twist_frame_);
     }
-    catch (tf::TransformException& ex)
+
+    if (!shared_->getTfCache().getTransform(twist_frame_idx_, transform_tf))
     {
-        ROS_ERROR("CobTwistController::twistStampedCallback: \n%s", ex.what());
+        ROS_ERROR_STREAM_THROTTLE(1, "CobTwistController::twistStampedCallback: No transform from " << twist_frame_ << " to " << twist_controller_params_.chain_base_link << " available");
         return;
     }
+    frame.M = KDL::Rotation::Quaternion(transform_tf.getRotation().x(), transform_tf.getRotation().y(), transform_tf.getRotation().z(), transform_tf.getRotation().w());
 
     tf::twistMsgToKDL(msg->twist, twist);
     twist_transformed = frame*twist;
-    solveTwist(twist_transformed);
+    pipeline_stats.mark(STAGE_TF_TRANSFORM);
+    solveTwist(twist_transformed, msg->header.stamp);
 }
 
 /// Orientation of twist_msg is with respect to chain_base coordinate system
 void CobTwistController::twistCallback(const geometry_msgs::Twist::ConstPtr& msg)
 {
+    p_inv_diff_kin_solver_->getPipelineStats().begin();
+
     KDL::Twist twist;
     tf::twistMsgToKDL(*msg, twist);
-    solveTwist(twist);
+    solveTwist(twist, ros::Time());
 }
 
 /// Orientation of twist is with respect to chain_base coordinate system
-void CobTwistController::solveTwist(KDL::Twist twist)
+void CobTwistController::solveTwist(KDL::Twist twist, const ros::Time& stamp)
 {
     ros::Time start, end;
     start = ros::Time::now();
 
-    visualizeTwist(twist);
+    PipelineStats& pipeline_stats = p_inv_diff_kin_solver_->getPipelineStats();
+
+    if (++visualization_cnt_ >= twist_controller_params_.visualization_decimation)
+    {
+        visualization_cnt_ = 0;
+        visualizeTwist(twist);
+    }
+    pipeline_stats.mark(STAGE_VISUALIZATION);
 
     KDL::JntArray q_dot_ik(chain_.getNrOfJoints());
 
     if (twist_controller_params_.kinematic_extension == BASE_COMPENSATION)
     {
-        twist = twist - twist_odometry_cb_;
+        /// the base twist at the time of the twist (not at the time of the last odometry message)
+        KDL::Twist twist_odometry_cb;
+        if (getBaseTwist(stamp.isZero() ? start : stamp, twist_odometry_cb))
+        {
+            twist = twist - twist_odometry_cb;
+        }
     }
 
     int ret_ik = p_inv_diff_kin_solver_->CartToJnt(this->joint_states_,
@@ -420,12 +498,102 @@ void CobTwistController::solveTwist(KDL::Twist twist)
     else
     {
         this->controller_interface_->processResult(q_dot_ik, this->joint_states_.current_q_);
+        pipeline_stats.mark(STAGE_PUBLISH);
     }
 
+    if (log_writer_.isOpen())
+    {
+        log_writer_.writeCycle(start, this->joint_states_, twist, ret_ik, q_dot_ik);
+    }
+
+    if (flight_recorder_.isEnabled())
+    {
+        recordCycle(start, twist, ret_ik, q_dot_ik);
+    }
+
+    pipeline_stats.end();
+
     end = ros::Time::now();
     // ROS_INFO_STREAM("solveTwist took " << (end-start).toSec() << " seconds");
 }
 
+/**
+ * Collects the state of the cycle in a preallocated record, i.e. without allocations.
+ */
+void CobTwistController::recordCycle(const ros::Time& stamp, const KDL::Twist& twist, int result, const KDL::JntArray& q_dot)
+{
+    FlightRecord& record = this->flight_record_;
+    record.stamp = static_cast<int64_t>(stamp.toNSec());
+    record.result = result;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        record.twist[i] = twist.vel(i);
+        record.twist[3 + i] = twist.rot(i);
+    }
+
+    record.nr_of_joints = std::min<uint32_t>(q_dot.rows(), FLIGHT_RECORDER_MAX_JOINTS);
+    for (uint32_t j = 0; j < record.nr_of_joints; ++j)
+    {
+        record.q[j] = this->joint_states_.current_q_(j);
+        record.q_dot[j] = this->joint_states_.current_q_dot_(j);
+        record.q_dot_out[j] = q_dot(j);
+    }
+
+    record.damping = 0.0;
+    record.nr_of_singular_values = 0;
+    const IPseudoinverseCalculator* pinv_calc = p_inv_diff_kin_solver_->getPInvCalculator();
+    if (NULL != pinv_calc)
+    {
+        const Eigen::VectorXd& singular_values = pinv_calc->getLastSingularValues();
+        record.damping = pinv_calc->getLastDamping();
+        record.nr_of_singular_values = std::min<uint32_t>(singular_values.rows(), FLIGHT_RECORDER_MAX_SINGULAR_VALUES);
+        for (uint32_t i = 0; i < record.nr_of_singular_values; ++i)
+        {
+            record.singular_values[i] = singular_values(i);
+        }
+    }
+
+    /// the trigger considers all constraints, the record only keeps the ones of the highest priorities
+    bool critical = false;
+    record.nr_of_constraints = 0;
+    const std::set<ConstraintBase_t>& constraints = p_inv_diff_kin_solver_->getConstraints();
+    for (std::set<ConstraintBase_t>::const_iterator it = constraints.begin(); it != constraints.end(); ++it)
+    {
+        const EN_ConstraintStates state = (*it)->getState().getCurrent();
+        critical = critical || CRITICAL == state;
+        if (record.nr_of_constraints < FLIGHT_RECORDER_MAX_CONSTRAINTS)
+        {
+            record.constraint_states[record.nr_of_constraints] = static_cast<uint8_t>(state);
+            record.constraint_gains[record.nr_of_constraints] = (*it)->getActivationGain();
+            ++record.nr_of_constraints;
+        }
+    }
+
+    const LimiterJointScaling& scaling = p_inv_diff_kin_solver_->getLimiterScaling();
+    record.position_factor = scaling.position_factor;
+    record.velocity_factor = scaling.velocity_factor;
+    record.violating_joint = scaling.violating_joint;
+
+    const int64_t* durations = p_inv_diff_kin_solver_->getPipelineStats().getDurations();
+    std::copy(durations, durations + NR_OF_STAGES, record.stage_durations);
+
+    flight_recorder_.record(record, critical);
+}
+
+bool CobTwistController::dumpFlightRecorderCallback(cob_srvs::SetString::Request& request, cob_srvs::SetString::Response& response)
+{
+    if (!flight_recorder_.isEnabled())
+    {
+        response.success = false;
+        response.message = "flight recorder is disabled";
+        return true;
+    }
+
+    response.message = flight_recorder_.requestDump(request.data);
+    response.success = true;
+    return true;
+}
+
 void CobTwistController::visualizeTwist(KDL::Twist twist)
 {
     std::string tracking_frame = twist_controller_params_.chain_tip_link;
@@ -434,25 +602,36 @@ void CobTwistController::visualizeTwist(KDL::Twist twist)
         tracking_frame = "lookat_focus_frame";
     }
 
+    if (tracking_frame != tracking_frame_)
+    {
+        tracking_frame_ = tracking_frame;
+        tracking_frame_idx_ = shared_->getTfCache().addFramePair(twist_controller_params_.chain_base_link, tracking_frame_);
+    }
+
     tf::StampedTransform transform_tf;
-    try
+    if (!shared_->getTfCache().getTransform(tracking_frame_idx_, transform_tf))
     {
-        tf_listener_.lookupTransform(twist_controller_params_.chain_base_link, tracking_frame, ros::Time(0), transform_tf);
+        ROS_ERROR_STREAM_THROTTLE(1, "CobTwistController::visualizeTwist: No transform from " << tracking_frame_ << " to " << twist_controller_params_.chain_base_link << " available");
+        return;
     }
-    catch (tf::TransformException& ex)
+
+    /// skip the visualization while the previous markers are being published
+    if (!twist_direction_pub_->trylock())
     {
-        ROS_ERROR("CobTwistController::visualizeTwist: \n%s", ex.what());
         return;
     }
 
-    visualization_msgs::Marker marker_vel;
+    /// the markers have to outlive the decimated publishing period
+    const ros::Duration lifetime(std::max(0.1, twist_controller_params_.visualization_decimation * DEFAULT_CYCLE));
+
+    visualization_msgs::Marker& marker_vel = twist_direction_pub_->msg_.markers[0];
     marker_vel.header.frame_id = twist_controller_params_.chain_base_link;
     marker_vel.header.stamp = ros::Time::now();
     marker_vel.ns = "twist_vel";
     marker_vel.id = 0;
     marker_vel.type = visualization_msgs::Marker::ARROW;
     marker_vel.action = visualization_msgs::Marker::ADD;
-    marker_vel.lifetime = ros::Duration(0.1);
+    marker_vel.lifetime = lifetime;
     marker_vel.pose.orientation.w = 1.0;
 
     marker_vel.scale.x = 0.02;
@@ -472,14 +651,14 @@ void CobTwistController::visualizeTwist(KDL::Twist twist)
     marker_vel.points[1].y = transform_tf.getOrigin().y() + 5.0 * twist.vel.y();
     marker_vel.points[1].z = transform_tf.getOrigin().z() + 5.0 * twist.vel.z();
 
-    visualization_msgs::Marker marker_rot;
+    visualization_msgs::Marker& marker_rot = twist_direction_pub_->msg_.markers[1];
     marker_rot.header.frame_id = twist_controller_params_.chain_base_link;
     marker_rot.header.stamp = ros::Time::now();
     marker_rot.ns = "twist_rot";
     marker_rot.id = 0;
     marker_rot.type = visualization_msgs::Marker::CYLINDER;
     marker_rot.action = visualization_msgs::Marker::ADD;
-    marker_rot.lifetime = ros::Duration(0.1);
+    marker_rot.lifetime = lifetime;
     marker_rot.pose.position.x = transform_tf.getOrigin().x();
     marker_rot.pose.position.y = transform_tf.getOrigin().y();
     marker_rot.pose.position.z = transform_tf.getOrigin().z();
@@ -508,84 +687,189 @@ void CobTwistController::visualizeTwist(KDL::Twist twist)
     marker_rot.color.b = 0.0f;
     marker_rot.color.a = 1.0;
 
-    visualization_msgs::MarkerArray markers;
-    markers.markers.push_back(marker_vel);
-    markers.markers.push_back(marker_rot);
-
-    twist_direction_pub_.publish(markers);
+    twist_direction_pub_->unlockAndPublish();
 }
 
-void CobTwistController::jointstateCallback(const sensor_msgs::JointState::ConstPtr& msg)
+void CobTwistController::pipelineStatsTimerCallback(const ros::TimerEvent& event)
 {
-    KDL::JntArray q_temp = this->joint_states_.current_q_;
-    KDL::JntArray q_dot_temp = this->joint_states_.current_q_dot_;
-    int count = 0;
+    PipelineStats& pipeline_stats = p_inv_diff_kin_solver_->getPipelineStats();
+    if (!pipeline_stats.isEnabled())
+    {
+        return;
+    }
+
+    diagnostic_msgs::DiagnosticArray diagnostics;
+    diagnostics.header.stamp = ros::Time::now();
+    pipeline_stats.collect(diagnostics.status);
 
-    for (uint16_t j = 0; j < twist_controller_params_.dof; j++)
+    /// scaling of the output limiters in the last cycle
+    const LimiterJointScaling& scaling = p_inv_diff_kin_solver_->getLimiterScaling();
+    diagnostic_msgs::DiagnosticStatus limiter_status;
+    limiter_status.name = "twist_controller limiters";
+    limiter_status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    limiter_status.message = "not limited";
+    if (scaling.violating_joint >= 0)
     {
-        for (uint16_t i = 0; i < msg->name.size(); i++)
-        {
-            if (strcmp(msg->name[i].c_str(), twist_controller_params_.joints[j].c_str()) == 0)
-            {
-                q_temp(j) = msg->position[i];
-                q_dot_temp(j) = msg->velocity[i];
-                count++;
-                break;
-            }
-        }
+        limiter_status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        std::ostringstream msg;
+        msg << "joint " << scaling.violating_joint << " violates its limits";
+        limiter_status.message = msg.str();
+    }
+    else if (scaling.position_factor > 1.0 || scaling.velocity_factor > 1.0)
+    {
+        limiter_status.message = "scaled";
     }
 
-    if (count == twist_controller_params_.joints.size())
+    std::ostringstream oss;
+    oss << scaling.position_factor;
+    diagnostic_msgs::KeyValue kv;
+    kv.key = "position factor";
+    kv.value = oss.str();
+    limiter_status.values.push_back(kv);
+    oss.str("");
+    oss << scaling.velocity_factor;
+    kv.key = "velocity factor";
+    kv.value = oss.str();
+    limiter_status.values.push_back(kv);
+    for (uint32_t i = 0; i < scaling.joint_factors.size(); ++i)
     {
-        this->joint_states_.last_q_ = joint_states_.current_q_;
-        this->joint_states_.last_q_dot_ = joint_states_.current_q_dot_;
-        this->joint_states_.current_q_ = q_temp;
-        this->joint_states_.current_q_dot_ = q_dot_temp;
+        oss.str("");
+        oss << "joint " << i << " factor";
+        kv.key = oss.str();
+        oss.str("");
+        oss << scaling.joint_factors[i];
+        kv.value = oss.str();
+        limiter_status.values.push_back(kv);
     }
-}
 
-void CobTwistController::odometryCallback(const nav_msgs::Odometry::ConstPtr& msg)
-{
-    KDL::Twist twist_odometry_bl, tangential_twist_bl, twist_odometry_transformed_cb;
-    KDL::Frame cb_frame_bl;
-    tf::StampedTransform cb_transform_bl, bl_transform_ct;
+    diagnostics.status.push_back(limiter_status);
 
-    try
+    /// age of the odometry used for the compensation of the base motion
+    if (twist_controller_params_.kinematic_extension == BASE_COMPENSATION)
     {
-        tf_listener_.waitForTransform(twist_controller_params_.chain_base_link, "base_link", ros::Time(0), ros::Duration(0.5));
-        tf_listener_.lookupTransform(twist_controller_params_.chain_base_link, "base_link", ros::Time(0), cb_transform_bl);
+        diagnostic_msgs::DiagnosticStatus base_status;
+        base_status.name = "twist_controller base compensation";
+        base_status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        base_status.message = "compensated";
+        if (odometry_history_.empty())
+        {
+            base_status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+            base_status.message = "no odometry received";
+        }
+        else if (base_compensation_max_age_ > twist_controller_params_.base_compensation_max_extrapolation)
+        {
+            base_status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+            base_status.message = "odometry older than the extrapolation horizon";
+        }
 
-        tf_listener_.waitForTransform("base_link", twist_controller_params_.chain_tip_link, ros::Time(0), ros::Duration(0.5));
-        tf_listener_.lookupTransform("base_link", twist_controller_params_.chain_tip_link, ros::Time(0), bl_transform_ct);
+        oss.str("");
+        oss << base_compensation_age_;
+        kv.key = "age [s]";
+        kv.value = oss.str();
+        base_status.values.push_back(kv);
+        oss.str("");
+        oss << base_compensation_max_age_;
+        kv.key = "max age [s]";
+        kv.value = oss.str();
+        base_status.values.push_back(kv);
+        base_compensation_max_age_ = 0.0;
 
-        cb_frame_bl.p = KDL::Vector(cb_transform_bl.getOrigin().x(), cb_transform_bl.getOrigin().y(), cb_transform_bl.getOrigin().z());
-        cb_frame_bl.M = KDL::Rotation::Quaternion(cb_transform_bl.getRotation().x(), cb_transform_bl.getRotation().y(), cb_transform_bl.getRotation().z(), cb_transform_bl.getRotation().w());
+        diagnostics.status.push_back(base_status);
     }
-    catch (tf::TransformException& ex)
+    for (std::vector<diagnostic_msgs::DiagnosticStatus>::iterator it = diagnostics.status.begin(); it != diagnostics.status.end(); ++it)
     {
-        ROS_ERROR("CobTwistController::odometryCallback: \n%s", ex.what());
-        return;
+        it->hardware_id = nh_.getNamespace();
     }
 
-    try
+    diagnostics_pub_.publish(diagnostics);
+}
+
+/**
+ * Called within the callback queue of the chain with the states of its joints (see TwistControllerShared).
+ */
+void CobTwistController::jointStatesCallback(const KDL::JntArray& q, const KDL::JntArray& q_dot)
+{
+    this->joint_states_.last_q_ = joint_states_.current_q_;
+    this->joint_states_.last_q_dot_ = joint_states_.current_q_dot_;
+    this->joint_states_.current_q_ = q;
+    this->joint_states_.current_q_dot_ = q_dot;
+}
+
+void CobTwistController::obstacleDistancesCallback(const cob_control_msgs::ObstacleDistances::ConstPtr& msg)
+{
+    callback_data_mediator_.distancesToObstaclesCallback(msg);
+
+    if (log_writer_.isOpen())
     {
-        // Calculate tangential twist for angular base movements v = w x r
-        Eigen::Vector3d r(bl_transform_ct.getOrigin().x(), bl_transform_ct.getOrigin().y(), bl_transform_ct.getOrigin().z());
-        Eigen::Vector3d w(0, 0, msg->twist.twist.angular.z);
-        Eigen::Vector3d res = w.cross(r);
-        tangential_twist_bl.vel = KDL::Vector(res(0), res(1), res(2));
-        tangential_twist_bl.rot = KDL::Vector(0, 0, 0);
+        log_writer_.writeObstacleDistances(ros::Time::now(), *msg);
     }
-    catch(...)
+}
+
+/**
+ * Only stores the twist of the base, its transformation into chain_base_link takes place when the twist is compensated.
+ */
+void CobTwistController::odometryCallback(const nav_msgs::Odometry::ConstPtr& msg)
+{
+    /// the frame pairs are registered on the first odometry message, i.e. only robots with a base keep them up to date
+    if (cb_bl_idx_ < 0 || bl_ct_idx_ < 0)
     {
-        ROS_ERROR("Error occurred while calculating tangential twist for angular base movements.");
-        return;
+        cb_bl_idx_ = shared_->getTfCache().addFramePair(twist_controller_params_.chain_base_link, "base_link");
+        bl_ct_idx_ = shared_->getTfCache().addFramePair("base_link", twist_controller_params_.chain_tip_link);
     }
 
+    KDL::Twist twist_odometry_bl;
     tf::twistMsgToKDL(msg->twist.twist, twist_odometry_bl);  // Base Twist
+    odometry_history_.addElement(msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp, twist_odometry_bl);
+}
+
+/**
+ * The odometry is interpolated (or extrapolated for at most base_compensation_max_extrapolation) to the given time.
+ * If it is older than that, the newest odometry is held.
+ */
+bool CobTwistController::getBaseTwist(const ros::Time& stamp, KDL::Twist& twist_cb)
+{
+    if (odometry_history_.empty() || !updateBaseFrames())
+    {
+        return false;
+    }
+
+    KDL::Twist twist_odometry_bl;
+    odometry_history_.sample(stamp, twist_controller_params_.base_compensation_max_extrapolation, twist_odometry_bl);
+    base_compensation_age_ = (stamp - odometry_history_.getNewestStamp()).toSec();
+    base_compensation_max_age_ = std::max(base_compensation_max_age_, base_compensation_age_);
+
+    // Calculate tangential twist for angular base movements v = w x r
+    KDL::Twist tangential_twist_bl;
+    tangential_twist_bl.vel = KDL::Vector(0.0, 0.0, twist_odometry_bl.rot.z()) * bl_vector_ct_;
+    tangential_twist_bl.rot = KDL::Vector::Zero();
 
     // transform into chain_base
-    twist_odometry_transformed_cb = cb_frame_bl * (twist_odometry_bl + tangential_twist_bl);
+    twist_cb = cb_frame_bl_ * (twist_odometry_bl + tangential_twist_bl);
+    return true;
+}
+
+bool CobTwistController::updateBaseFrames()
+{
+    tf::StampedTransform cb_transform_bl, bl_transform_ct;
+    if (!shared_->getTfCache().getTransform(cb_bl_idx_, cb_transform_bl) || !shared_->getTfCache().getTransform(bl_ct_idx_, bl_transform_ct))
+    {
+        ROS_ERROR_STREAM_THROTTLE(1, "CobTwistController::updateBaseFrames: No transforms between " << twist_controller_params_.chain_base_link
+                                     << ", base_link and " << twist_controller_params_.chain_tip_link << " available");
+        return false;
+    }
+
+    if (!base_frames_valid_ || cb_transform_bl.stamp_ != cb_bl_stamp_)
+    {
+        cb_bl_stamp_ = cb_transform_bl.stamp_;
+        tf::transformTFToKDL(cb_transform_bl, cb_frame_bl_);
+    }
 
-    twist_odometry_cb_ = twist_odometry_transformed_cb;
+    if (!base_frames_valid_ || bl_transform_ct.stamp_ != bl_ct_stamp_)
+    {
+        bl_ct_stamp_ = bl_transform_ct.stamp_;
+        tf::vectorTFToKDL(bl_transform_ct.getOrigin(), bl_vector_ct_);
+    }
+
+    base_frames_valid_ = true;
+    return true;
 }
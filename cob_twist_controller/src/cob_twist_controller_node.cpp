@@ -15,20 +15,149 @@
  */
 
 
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
 #include <cob_twist_controller/cob_twist_controller.h>
+#include <cob_twist_controller/twist_controller_shared.h>
+
+namespace
+{
+    /**
+     * Runs the controller of one chain in its own thread.
+     * All callbacks of the chain (twist commands, joint states, reconfiguration, timers) are processed by its own callback queue.
+     */
+    class ChainThread
+    {
+        public:
+            ChainThread(const std::string& chain_namespace, const boost::shared_ptr<TwistControllerShared>& shared)
+            : nh_(chain_namespace),
+              shared_(shared),
+              running_(false)
+            {
+                this->nh_.setCallbackQueue(&this->callback_queue_);
+            }
+
+            ~ChainThread()
+            {
+                this->stop();
+                this->controller_.reset();
+            }
+
+            bool initialize()
+            {
+                this->controller_.reset(new CobTwistController(this->nh_, this->shared_));
+                return this->controller_->initialize();
+            }
+
+            /**
+             * @param cpus Pins the thread to these CPUs (empty: no affinity).
+             */
+            void start(const std::vector<int>& cpus)
+            {
+                this->running_ = true;
+                this->thread_ = boost::thread(&ChainThread::run, this);
+
+                if (!cpus.empty())
+                {
+                    cpu_set_t cpu_set;
+                    CPU_ZERO(&cpu_set);
+                    for (std::vector<int>::const_iterator it = cpus.begin(); it != cpus.end(); ++it)
+                    {
+                        CPU_SET(*it, &cpu_set);
+                    }
+
+                    if (0 != pthread_setaffinity_np(this->thread_.native_handle(), sizeof(cpu_set_t), &cpu_set))
+                    {
+                        ROS_WARN_STREAM(this->nh_.getNamespace() << ": Failed to set the CPU affinity");
+                    }
+                }
+            }
+
+            void stop()
+            {
+                this->running_ = false;
+                if (this->thread_.joinable())
+                {
+                    this->thread_.join();
+                }
+            }
+
+        private:
+            void run()
+            {
+                while (this->running_ && ros::ok())
+                {
+                    this->callback_queue_.callAvailable(ros::WallDuration(0.1));
+                }
+            }
+
+            ros::NodeHandle nh_;
+            ros::CallbackQueue callback_queue_;
+            boost::shared_ptr<TwistControllerShared> shared_;
+            boost::shared_ptr<CobTwistController> controller_;
+            boost::atomic<bool> running_;
+            boost::thread thread_;
+    };
+}
 
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "cob_twist_controller_node");
-    CobTwistController* cob_twist_controller = new CobTwistController();
 
-    if (!cob_twist_controller->initialize())
+    /// several chains in one process: ~chains lists the namespaces of the chains (each configured like a stand-alone controller)
+    std::vector<std::string> chains;
+    ros::NodeHandle nh_priv("~");
+    if (!nh_priv.getParam("chains", chains) || chains.empty())
+    {
+        CobTwistController* cob_twist_controller = new CobTwistController();
+
+        if (!cob_twist_controller->initialize())
+        {
+            ROS_ERROR("Failed to initialize TwistController");
+            return -1;
+        }
+
+        ros::spin();
+        return 0;
+    }
+
+    /// robot_description, TF and joint_states are shared by all chains
+    ros::NodeHandle nh;
+    boost::shared_ptr<TwistControllerShared> shared(new TwistControllerShared());
+    if (!shared->initialize(nh))
     {
-        ROS_ERROR("Failed to initialize TwistController");
+        ROS_ERROR("Failed to initialize the shared resources of the TwistControllers");
         return -1;
     }
 
+    std::vector<boost::shared_ptr<ChainThread> > chain_threads;
+    for (std::vector<std::string>::const_iterator it = chains.begin(); it != chains.end(); ++it)
+    {
+        boost::shared_ptr<ChainThread> chain_thread(new ChainThread(*it, shared));
+        if (!chain_thread->initialize())
+        {
+            ROS_ERROR_STREAM("Failed to initialize TwistController for chain " << *it);
+            return -1;
+        }
+
+        std::vector<int> cpus;
+        ros::NodeHandle(*it + "/twist_controller").getParam("cpu_affinity", cpus);
+        chain_thread->start(cpus);
+        chain_threads.push_back(chain_thread);
+    }
+
+    /// the global callback queue demultiplexes the joint_states
     ros::spin();
+
+    chain_threads.clear();
     return 0;
 }
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <map>
+#include <string>
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <cob_twist_controller/cob_twist_controller.h>
+#include <cob_twist_controller/twist_controller_shared.h>
+
+namespace cob_twist_controller
+{
+
+/**
+ * The TwistController of one chain within a nodelet manager.
+ * Each chain is loaded as a nodelet of its own, i.e. its callbacks are processed by the callback queue of the nodelet
+ * (instead of a ChainThread). The commands of a CobFrameTracker loaded into the same manager are passed without serialization.
+ * If ~share_resources is set (default), all chains of the manager subscribing to the same joint_states share the
+ * robot description, the TF buffer and the joint_states (see TwistControllerShared). The TF buffer is not shared with
+ * FrameTrackerNodelets or ObstacleDistanceNodelets in the same manager; each of these packages keeps its own one.
+ */
+class TwistControllerNodelet : public nodelet::Nodelet
+{
+    public:
+        virtual ~TwistControllerNodelet()
+        {
+            this->controller_.reset();
+        }
+
+    private:
+        virtual void onInit()
+        {
+            ros::NodeHandle& nh = this->getNodeHandle();
+
+            bool share_resources;
+            this->getPrivateNodeHandle().param<bool>("share_resources", share_resources, true);
+            if (share_resources)
+            {
+                this->shared_ = getShared(nh);
+                if (!this->shared_)
+                {
+                    ROS_ERROR("Failed to initialize the shared resources of the TwistControllers");
+                    return;
+                }
+            }
+
+            /// without shared resources the controller initializes its own ones
+            this->controller_.reset(new CobTwistController(nh, this->shared_));
+            if (!this->controller_->initialize())
+            {
+                ROS_ERROR_STREAM("Failed to initialize TwistController for chain " << nh.getNamespace());
+                this->controller_.reset();
+            }
+        }
+
+        /**
+         * @return The shared resources of the chains subscribing to the same joint_states (initialized on first use).
+         */
+        static boost::shared_ptr<TwistControllerShared> getShared(const ros::NodeHandle& nh)
+        {
+            static std::map<std::string, boost::weak_ptr<TwistControllerShared> > registry;
+            static boost::mutex registry_lock;
+
+            boost::mutex::scoped_lock lock(registry_lock);
+            const std::string joint_states = nh.resolveName("joint_states");
+            boost::shared_ptr<TwistControllerShared> shared = registry[joint_states].lock();
+            if (!shared)
+            {
+                /// the joint_states are demultiplexed by the global callback queue (which outlives the single nodelets)
+                ros::NodeHandle nh_shared(nh);
+                nh_shared.setCallbackQueue(ros::getGlobalCallbackQueue());
+
+                shared.reset(new TwistControllerShared());
+                if (!shared->initialize(nh_shared))
+                {
+                    return boost::shared_ptr<TwistControllerShared>();
+                }
+
+                registry[joint_states] = shared;
+            }
+
+            return shared;
+        }
+
+        boost::shared_ptr<TwistControllerShared> shared_;
+        boost::shared_ptr<CobTwistController> controller_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cob_twist_controller::TwistControllerNodelet, nodelet::Nodelet)
@@ -27,6 +27,8 @@
 #include "cob_twist_controller/constraint_solvers/solvers/task_priority_solver.h"
 #include "cob_twist_controller/constraint_solvers/solvers/stack_of_tasks_solver.h"
 #include "cob_twist_controller/constraint_solvers/solvers/unified_joint_limit_singularity_solver.h"
+#include "cob_twist_controller/constraint_solvers/solvers/hierarchical_qp_solver.h"
+#include "cob_twist_controller/constraint_solvers/solvers/model_predictive_control_solver.h"
 
 #include "cob_twist_controller/damping_methods/damping.h"
 #include "cob_twist_controller/constraints/constraint.h"
@@ -72,36 +74,45 @@ int8_t ConstraintSolverFactory::calculateJointVelocities(Matrix6Xd_t& jacobian_d
 bool ConstraintSolverFactory::getSolverFactory(const TwistControllerParams& params,
                                                const LimiterParams& limiter_params,
                                                boost::shared_ptr<ISolverFactory>& solver_factory,
-                                               TaskStackController_t& task_stack_controller)
+                                               TaskStackController_t& task_stack_controller,
+                                               PipelineStats& pipeline_stats,
+                                               ConstraintUpdater& constraint_updater)
 {
     switch (params.solver)
     {
         case DEFAULT_SOLVER:
-            solver_factory.reset(new SolverFactory<UnconstraintSolver>(params, limiter_params, task_stack_controller));
+            solver_factory.reset(new SolverFactory<UnconstraintSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
             break;
         case WLN:
             switch (params.constraint_jla)
             {
                 case JLA_ON:
-                    solver_factory.reset(new SolverFactory<WLN_JointLimitAvoidanceSolver>(params, limiter_params, task_stack_controller));
+                case JLA_VEC_ON:
+                    solver_factory.reset(new SolverFactory<WLN_JointLimitAvoidanceSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
                 break;
 
                 case JLA_OFF:
-                    solver_factory.reset(new SolverFactory<WeightedLeastNormSolver>(params, limiter_params, task_stack_controller));
+                    solver_factory.reset(new SolverFactory<WeightedLeastNormSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
                 break;
             }
             break;
         case UNIFIED_JLA_SA:
-            solver_factory.reset(new SolverFactory<UnifiedJointLimitSingularitySolver>(params, limiter_params, task_stack_controller));
+            solver_factory.reset(new SolverFactory<UnifiedJointLimitSingularitySolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
             break;
         case GPM:
-            solver_factory.reset(new SolverFactory<GradientProjectionMethodSolver>(params, limiter_params, task_stack_controller));
+            solver_factory.reset(new SolverFactory<GradientProjectionMethodSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
             break;
         case STACK_OF_TASKS:
-            solver_factory.reset(new SolverFactory<StackOfTasksSolver>(params, limiter_params, task_stack_controller));
+            solver_factory.reset(new SolverFactory<StackOfTasksSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
             break;
         case TASK_2ND_PRIO:
-            solver_factory.reset(new SolverFactory<TaskPrioritySolver>(params, limiter_params, task_stack_controller));
+            solver_factory.reset(new SolverFactory<TaskPrioritySolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
+            break;
+        case HIERARCHICAL_QP:
+            solver_factory.reset(new SolverFactory<HierarchicalQPSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
+            break;
+        case MPC:
+            solver_factory.reset(new SolverFactory<ModelPredictiveControlSolver>(params, limiter_params, task_stack_controller, pipeline_stats, constraint_updater));
             break;
         default:
             ROS_ERROR("Returning NULL factory due to constraint solver creation error. There is no solver method for %d implemented.",
@@ -124,8 +135,8 @@ int8_t ConstraintSolverFactory::resetAll(const TwistControllerParams& params, co
     this->constraints_.clear();
     this->constraints_ = ConstraintsBuilder_t::createConstraints(params,
                                                                  limiter_params,
-                                                                 this->jnt_to_jac_,
-                                                                 this->fk_solver_vel_,
+                                                                 this->kinematics_cache_,
+                                                                 this->prediction_cache_,
                                                                  this->data_mediator_);
 
     for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
@@ -133,10 +144,31 @@ int8_t ConstraintSolverFactory::resetAll(const TwistControllerParams& params, co
         ROS_DEBUG_STREAM((*it)->getTaskId());
     }
 
-    if (!ConstraintSolverFactory::getSolverFactory(params, limiter_params, this->solver_factory_, this->task_stack_controller_))
+    if (!ConstraintSolverFactory::getSolverFactory(params, limiter_params, this->solver_factory_, this->task_stack_controller_, this->pipeline_stats_, this->constraint_updater_))
     {
         return -2;
     }
 
     return 0;
 }
+
+int8_t ConstraintSolverFactory::resetDamping(const TwistControllerParams& params)
+{
+    boost::shared_ptr<DampingBase> damping_method(DampingBuilder::createDamping(params));
+    if (NULL == damping_method)
+    {
+        ROS_ERROR("Keeping current damping method due to damping creation error.");
+        return -1;  // error
+    }
+
+    this->damping_method_ = damping_method;
+    return 0;
+}
+
+void ConstraintSolverFactory::updateConstraintParams(const TwistControllerParams& params)
+{
+    for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
+    {
+        (*it)->updateParams(params);
+    }
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <time.h>
+#include <set>
+#include <vector>
+
+#include <ros/ros.h>
+#include <boost/bind.hpp>
+
+#include "cob_twist_controller/constraint_solvers/constraint_updater.h"
+
+namespace
+{
+    inline int64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+}
+
+ConstraintUpdater::ConstraintUpdater(uint32_t nr_of_threads)
+: nr_of_threads_(nr_of_threads),
+  running_(false),
+  generation_(0),
+  busy_workers_(0),
+  next_job_(0),
+  joint_states_(NULL),
+  joints_prediction_(NULL),
+  jacobian_data_(NULL)
+{}
+
+ConstraintUpdater::~ConstraintUpdater()
+{
+    this->stop();
+}
+
+/**
+ * The cheap constraints are updated by the calling thread while the workers start on the expensive ones.
+ * Forking is only worth it for at least two expensive constraints; otherwise everything is updated inline.
+ */
+void ConstraintUpdater::update(const std::set<ConstraintBase_t>& constraints,
+                               double min_cost,
+                               const JointStates& joint_states,
+                               const KDL::JntArrayVel& joints_prediction,
+                               const Matrix6Xd_t& jacobian_data)
+{
+    this->joint_states_ = &joint_states;
+    this->joints_prediction_ = &joints_prediction;
+    this->jacobian_data_ = &jacobian_data;
+
+    this->jobs_.clear();
+    if (this->nr_of_threads_ > 0)
+    {
+        for (std::set<ConstraintBase_t>::const_iterator it = constraints.begin(); it != constraints.end(); ++it)
+        {
+            if ((*it)->getUpdateCost() >= min_cost)
+            {
+                this->jobs_.push_back(*it);
+            }
+        }
+    }
+
+    if (this->jobs_.size() < 2)
+    {
+        for (std::set<ConstraintBase_t>::const_iterator it = constraints.begin(); it != constraints.end(); ++it)
+        {
+            this->updateConstraint(**it);
+        }
+
+        return;
+    }
+
+    if (!this->running_)
+    {
+        this->start();
+    }
+
+    // fork
+    this->next_job_.store(0, boost::memory_order_relaxed);
+    {
+        boost::mutex::scoped_lock lock(this->lock_);
+        this->busy_workers_ = this->nr_of_threads_;
+        ++this->generation_;
+    }
+    this->start_cond_.notify_all();
+
+    // the jobs have been collected in the order of the set (their costs may already be changed by the workers)
+    uint32_t job_idx = 0;
+    for (std::set<ConstraintBase_t>::const_iterator it = constraints.begin(); it != constraints.end(); ++it)
+    {
+        if (job_idx < this->jobs_.size() && this->jobs_[job_idx] == *it)
+        {
+            ++job_idx;
+        }
+        else
+        {
+            this->updateConstraint(**it);
+        }
+    }
+
+    this->processJobs();
+
+    // join
+    boost::mutex::scoped_lock lock(this->lock_);
+    while (this->busy_workers_ > 0)
+    {
+        this->done_cond_.wait(lock);
+    }
+}
+
+void ConstraintUpdater::start()
+{
+    this->running_ = true;
+    for (uint32_t i = 0; i < this->nr_of_threads_; ++i)
+    {
+        this->threads_.create_thread(boost::bind(&ConstraintUpdater::run, this));
+    }
+
+    ROS_INFO_STREAM("ConstraintUpdater: Started " << this->nr_of_threads_ << " worker threads");
+}
+
+void ConstraintUpdater::stop()
+{
+    {
+        boost::mutex::scoped_lock lock(this->lock_);
+        this->running_ = false;
+    }
+    this->start_cond_.notify_all();
+    this->threads_.join_all();
+}
+
+void ConstraintUpdater::run()
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        {
+            boost::mutex::scoped_lock lock(this->lock_);
+            while (this->running_ && this->generation_ == generation)
+            {
+                this->start_cond_.wait(lock);
+            }
+
+            if (!this->running_)
+            {
+                return;
+            }
+
+            generation = this->generation_;
+        }
+
+        this->processJobs();
+
+        boost::mutex::scoped_lock lock(this->lock_);
+        if (0 == --this->busy_workers_)
+        {
+            this->done_cond_.notify_one();
+        }
+    }
+}
+
+void ConstraintUpdater::processJobs()
+{
+    uint32_t idx;
+    while ((idx = this->next_job_.fetch_add(1, boost::memory_order_relaxed)) < this->jobs_.size())
+    {
+        this->updateConstraint(*this->jobs_[idx]);
+    }
+}
+
+void ConstraintUpdater::updateConstraint(PriorityBase<uint32_t>& constraint)
+{
+    const int64_t start = now();
+    constraint.update(*this->joint_states_, *this->joints_prediction_, *this->jacobian_data_);
+    const double cost = static_cast<double>(now() - start) * 1.0e-3;
+
+    const double last_cost = constraint.getUpdateCost();
+    constraint.setUpdateCost(last_cost > 0.0 ? last_cost + CONSTRAINT_UPDATER_COST_SMOOTHING * (cost - last_cost) : cost);
+}
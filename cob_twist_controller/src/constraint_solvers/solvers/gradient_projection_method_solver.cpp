@@ -41,10 +41,11 @@ Eigen::MatrixXd GradientProjectionMethodSolver::solve(const Vector6d_t& in_cart_
     Eigen::MatrixXd homogeneous_solution = Eigen::MatrixXd::Zero(particular_solution.rows(), particular_solution.cols());
     KDL::JntArrayVel predict_jnts_vel(joint_states.current_q_.rows());
 
+    this->markStage(STAGE_SOLVE);
+    this->updateConstraints(joint_states, predict_jnts_vel);
     for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
     {
         ROS_DEBUG_STREAM("task id: " << (*it)->getTaskId());
-        (*it)->update(joint_states, predict_jnts_vel, this->jacobian_data_);
         Eigen::VectorXd q_dot_0 = (*it)->getPartialValues();
         Eigen::MatrixXd tmp_projection = projector * q_dot_0;
         double activation_gain = (*it)->getActivationGain();  // contribution of the homo. solution to the part. solution
@@ -52,6 +53,8 @@ Eigen::MatrixXd GradientProjectionMethodSolver::solve(const Vector6d_t& in_cart_
         homogeneous_solution += (constraint_k_H * activation_gain * tmp_projection);
     }
 
+    this->markStage(STAGE_CONSTRAINTS);
+
     Eigen::MatrixXd qdots_out = particular_solution + this->params_.k_H * homogeneous_solution;  // weighting with k_H is done in loop
 
     // //DEBUG: for verification of nullspace projection
@@ -0,0 +1,412 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <set>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "cob_twist_controller/constraint_solvers/solvers/hierarchical_qp_solver.h"
+#include "cob_twist_controller/task_stack/task_stack_controller.h"
+
+Eigen::MatrixXd HierarchicalQPSolver::solve(const Vector6d_t& in_cart_velocities,
+                                            const JointStates& joint_states)
+{
+    this->global_constraint_state_ = NORMAL;
+    ros::Time now = ros::Time::now();
+    double cycle = (now - this->last_time_).toSec();
+    this->last_time_ = now;
+
+    const int n = this->jacobian_data_.cols();
+
+    Eigen::MatrixXd damped_pinv = pinv_calc_.calculate(this->params_, this->damping_, this->jacobian_data_);
+    Eigen::MatrixXd pinv = pinv_calc_.calculate(this->jacobian_data_);
+
+    Eigen::MatrixXd particular_solution = damped_pinv * in_cart_velocities;
+
+    Eigen::MatrixXd ident = Eigen::MatrixXd::Identity(pinv.rows(), this->jacobian_data_.cols());
+    Eigen::MatrixXd projector = ident - pinv * this->jacobian_data_;
+
+    Eigen::VectorXd sum_of_gradient = Eigen::VectorXd::Zero(n);
+
+    KDL::JntArrayVel predict_jnts_vel(joint_states.current_q_.rows());
+
+    // predict next joint states!
+    for (int i = 0; i < joint_states.current_q_.rows(); ++i)
+    {
+        predict_jnts_vel.q(i) = particular_solution(i, 0) * cycle + joint_states.current_q_(i);
+        predict_jnts_vel.qdot(i) = particular_solution(i, 0);
+    }
+
+    this->markStage(STAGE_SOLVE);
+    // First iteration: update constraint state and calculate the according GPM weighting (DANGER state)
+    double inv_sum_of_prionums = 0.0;
+    this->updateConstraints(joint_states, predict_jnts_vel);
+    for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
+    {
+        const double constr_prio = (*it)->getPriorityAsNum();
+        if ((*it)->getState().getCurrent() == DANGER)
+        {
+            inv_sum_of_prionums += constr_prio > ZERO_THRESHOLD ? 1.0 / constr_prio : 1.0 / DIV0_SAFE;
+        }
+    }
+
+    this->markStage(STAGE_CONSTRAINTS);
+
+    // Second iteration: CRITICAL constraints become tasks, DANGER constraints contribute to the gradient
+    this->prepareTaskSlots();
+    uint32_t i = 0;
+    for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it, ++i)
+    {
+        this->processState(it, projector, particular_solution, inv_sum_of_prionums, sum_of_gradient, this->constraint_task_slots_[i]);
+    }
+
+    sum_of_gradient = this->params_.k_H * sum_of_gradient;  // "global" weighting for all constraints.
+
+    // no damping of the main task necessary: the hierarchy is strict and the limits are hard
+    this->updateMainTask(in_cart_velocities);
+
+    Eigen::VectorXd lower, upper;
+    this->calcBounds(joint_states, cycle, lower, upper);
+
+    // the velocity closest to standstill is feasible w.r.t. the bounds and serves as start point of the first level
+    Eigen::VectorXd x = Eigen::VectorXd::Zero(n).cwiseMax(lower).cwiseMin(upper);
+    Eigen::MatrixXd A_eq(0, n);
+    Eigen::VectorXd b_eq(0);
+
+    uint32_t level = 0;
+    TaskSetIter_t it = this->task_stack_controller_.beginTaskIter();
+    while ((it = this->task_stack_controller_.nextActiveTask()) != this->task_stack_controller_.getTasksEnd())
+    {
+        const Eigen::MatrixXd& J_task = it->task_jacobian_;
+        if (J_task.cols() != n || J_task.rows() != it->task_.rows())
+        {
+            ROS_ERROR_STREAM("HierarchicalQPSolver: Dimension mismatch of task \"" << it->id_ << "\". Skipping it!");
+            continue;
+        }
+
+        this->solveLevel(level, J_task, it->task_, this->params_.hqp_solver_params.regularization, A_eq, b_eq, lower, upper, x);
+
+        // the task velocity achieved on this level must not be changed by any lower level
+        Eigen::MatrixXd A_eq_new(A_eq.rows() + J_task.rows(), n);
+        A_eq_new << A_eq, J_task;
+        Eigen::VectorXd b_eq_new(b_eq.rows() + J_task.rows());
+        b_eq_new << b_eq, J_task * x;
+        A_eq = A_eq_new;
+        b_eq = b_eq_new;
+        ++level;
+    }
+
+    // lowest level: follow the GPM gradient within the remaining redundancy (least norm solution if there is none)
+    this->solveLevel(level, Eigen::MatrixXd::Identity(n, n), sum_of_gradient, 0.0, A_eq, b_eq, lower, upper, x);
+
+    Eigen::MatrixXd qdots_out = Eigen::MatrixXd::Zero(n, 1);
+    qdots_out.col(0) = x;
+    return qdots_out;
+}
+
+void HierarchicalQPSolver::calcBounds(const JointStates& joint_states,
+                                      double cycle,
+                                      Eigen::VectorXd& lower,
+                                      Eigen::VectorXd& upper) const
+{
+    const int n = this->jacobian_data_.cols();
+    const double inf = std::numeric_limits<double>::infinity();
+    lower = Eigen::VectorXd::Constant(n, -inf);
+    upper = Eigen::VectorXd::Constant(n, inf);
+
+    // the first cycle (or a cycle after a pause) has no meaningful cycle time
+    const double dt = (cycle > ZERO_THRESHOLD && cycle < 1.0) ? cycle : DEFAULT_CYCLE;
+
+    for (int i = 0; i < n; ++i)
+    {
+        if (this->limiter_params_.enforce_vel_limits && i < this->limiter_params_.limits_vel.size())
+        {
+            lower(i) = -this->limiter_params_.limits_vel[i];
+            upper(i) = this->limiter_params_.limits_vel[i];
+        }
+
+        if (this->limiter_params_.enforce_pos_limits &&
+            i < this->limiter_params_.limits_min.size() &&
+            i < this->limiter_params_.limits_max.size() &&
+            i < joint_states.current_q_.rows())
+        {
+            lower(i) = std::max(lower(i), (this->limiter_params_.limits_min[i] - joint_states.current_q_(i)) / dt);
+            upper(i) = std::min(upper(i), (this->limiter_params_.limits_max[i] - joint_states.current_q_(i)) / dt);
+        }
+
+        // joint already beyond a position limit: move back as fast as allowed
+        if (lower(i) > upper(i))
+        {
+            if (upper(i) < 0.0)
+            {
+                upper(i) = lower(i);
+            }
+            else
+            {
+                lower(i) = upper(i);
+            }
+        }
+    }
+}
+
+int HierarchicalQPSolver::solveLevel(uint32_t level,
+                                     const Eigen::MatrixXd& A,
+                                     const Eigen::VectorXd& b,
+                                     double regularization,
+                                     const Eigen::MatrixXd& A_eq,
+                                     const Eigen::VectorXd& b_eq,
+                                     const Eigen::VectorXd& lower,
+                                     const Eigen::VectorXd& upper,
+                                     Eigen::VectorXd& x)
+{
+    const int n = x.rows();
+    const double tolerance = this->params_.hqp_solver_params.tolerance;
+    const uint32_t max_iterations = this->params_.hqp_solver_params.max_iterations;
+
+    const Eigen::MatrixXd H = A.transpose() * A + regularization * Eigen::MatrixXd::Identity(n, n);
+    const Eigen::VectorXd g = -A.transpose() * b;
+
+    if (this->working_sets_.size() <= level)
+    {
+        this->working_sets_.resize(level + 1);
+    }
+
+    Eigen::VectorXi& working_set = this->working_sets_[level];
+    Eigen::VectorXd x_eqp(n);
+    Eigen::VectorXd lambda(n);
+
+    // Warm start: the working set of the last cycle is taken over if its subproblem solution is feasible.
+    if (working_set.rows() != n)
+    {
+        working_set = Eigen::VectorXi::Zero(n);
+    }
+    else if (working_set.cwiseAbs().sum() > 0)
+    {
+        bool feasible = this->solveEqualityProblem(H, g, A_eq, b_eq, lower, upper, working_set, x_eqp, lambda);
+        for (int j = 0; feasible && j < n; ++j)
+        {
+            feasible = (x_eqp(j) >= lower(j) - tolerance) && (x_eqp(j) <= upper(j) + tolerance);
+        }
+
+        if (feasible)
+        {
+            x = x_eqp.cwiseMax(lower).cwiseMin(upper);
+        }
+        else
+        {
+            working_set.setZero();
+        }
+    }
+
+    for (uint32_t iter = 0; iter < max_iterations; ++iter)
+    {
+        if (!this->solveEqualityProblem(H, g, A_eq, b_eq, lower, upper, working_set, x_eqp, lambda))
+        {
+            ROS_WARN_STREAM_THROTTLE(1.0, "HierarchicalQPSolver: Inconsistent working set on level " << level << ". Keeping last feasible solution!");
+            working_set.setZero();
+            return -1;
+        }
+
+        const Eigen::VectorXd p = x_eqp - x;
+        if (p.lpNorm<Eigen::Infinity>() <= tolerance)
+        {
+            x = x_eqp.cwiseMax(lower).cwiseMin(upper);
+
+            // release the bound with the most violated optimality condition (if any)
+            int release = -1;
+            double max_violation = tolerance;
+            for (int j = 0; j < n; ++j)
+            {
+                const double violation = working_set(j) * lambda(j);
+                if (violation > max_violation)
+                {
+                    max_violation = violation;
+                    release = j;
+                }
+            }
+
+            if (release < 0)
+            {
+                return iter + 1;
+            }
+
+            working_set(release) = 0;
+        }
+        else
+        {
+            // step towards the subproblem solution until the first free joint hits a bound
+            double alpha = 1.0;
+            int blocking = -1;
+            int side = 0;
+            for (int j = 0; j < n; ++j)
+            {
+                if (working_set(j) != 0)
+                {
+                    continue;
+                }
+
+                if (p(j) > 0.0 && x(j) + p(j) > upper(j))
+                {
+                    const double alpha_j = std::max(0.0, (upper(j) - x(j)) / p(j));
+                    if (alpha_j < alpha)
+                    {
+                        alpha = alpha_j;
+                        blocking = j;
+                        side = 1;
+                    }
+                }
+                else if (p(j) < 0.0 && x(j) + p(j) < lower(j))
+                {
+                    const double alpha_j = std::max(0.0, (lower(j) - x(j)) / p(j));
+                    if (alpha_j < alpha)
+                    {
+                        alpha = alpha_j;
+                        blocking = j;
+                        side = -1;
+                    }
+                }
+            }
+
+            x += alpha * p;
+            if (blocking >= 0)
+            {
+                working_set(blocking) = side;
+                x(blocking) = side > 0 ? upper(blocking) : lower(blocking);
+            }
+        }
+    }
+
+    ROS_WARN_STREAM_THROTTLE(1.0, "HierarchicalQPSolver: Level " << level << " not converged within " << max_iterations << " iterations!");
+    return -1;
+}
+
+bool HierarchicalQPSolver::solveEqualityProblem(const Eigen::MatrixXd& H,
+                                                const Eigen::VectorXd& g,
+                                                const Eigen::MatrixXd& A_eq,
+                                                const Eigen::VectorXd& b_eq,
+                                                const Eigen::VectorXd& lower,
+                                                const Eigen::VectorXd& upper,
+                                                const Eigen::VectorXi& working_set,
+                                                Eigen::VectorXd& x,
+                                                Eigen::VectorXd& lambda) const
+{
+    const int n = H.rows();
+    const int m = A_eq.rows();
+    const double tolerance = this->params_.hqp_solver_params.tolerance;
+
+    // joints in the working set are fixed at their bounds
+    std::vector<int> free_idx;
+    free_idx.reserve(n);
+    x = Eigen::VectorXd::Zero(n);
+    for (int j = 0; j < n; ++j)
+    {
+        if (working_set(j) > 0)
+        {
+            x(j) = upper(j);
+        }
+        else if (working_set(j) < 0)
+        {
+            x(j) = lower(j);
+        }
+        else
+        {
+            free_idx.push_back(j);
+        }
+    }
+
+    const int nf = free_idx.size();
+    const Eigen::VectorXd g_fixed = g + H * x;
+    const Eigen::VectorXd r = b_eq - A_eq * x;
+
+    Eigen::MatrixXd H_f(nf, nf);
+    Eigen::VectorXd g_f(nf);
+    Eigen::MatrixXd E_f(m, nf);
+    for (int k = 0; k < nf; ++k)
+    {
+        g_f(k) = g_fixed(free_idx[k]);
+        E_f.col(k) = A_eq.col(free_idx[k]);
+        for (int l = 0; l < nf; ++l)
+        {
+            H_f(k, l) = H(free_idx[k], free_idx[l]);
+        }
+    }
+
+    Eigen::VectorXd x_f = Eigen::VectorXd::Zero(nf);
+    Eigen::VectorXd mu = Eigen::VectorXd::Zero(m);
+    if (m > 0)
+    {
+        if (0 == nf)
+        {
+            if (r.norm() > tolerance * (1.0 + b_eq.norm()))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // particular solution and null space of the equality constraints of the free joints
+            Eigen::JacobiSVD<Eigen::MatrixXd> svd(E_f, Eigen::ComputeThinU | Eigen::ComputeFullV);
+            const Eigen::VectorXd& s = svd.singularValues();
+            const double s_threshold = tolerance * std::max(1.0, s.rows() > 0 ? s(0) : 0.0);
+            int rank = 0;
+            while (rank < s.rows() && s(rank) > s_threshold)
+            {
+                ++rank;
+            }
+
+            const Eigen::MatrixXd U_r = svd.matrixU().leftCols(rank);
+            const Eigen::MatrixXd V_r = svd.matrixV().leftCols(rank);
+            const Eigen::VectorXd s_inv = s.head(rank).cwiseInverse();
+            const Eigen::VectorXd x_p = V_r * s_inv.asDiagonal() * (U_r.transpose() * r);
+            if ((E_f * x_p - r).norm() > tolerance * (1.0 + b_eq.norm()))
+            {
+                return false;
+            }
+
+            x_f = x_p;
+            if (rank < nf)
+            {
+                const Eigen::MatrixXd N = svd.matrixV().rightCols(nf - rank);
+                const Eigen::MatrixXd H_n = N.transpose() * H_f * N;
+                const Eigen::VectorXd z = H_n.ldlt().solve(-N.transpose() * (H_f * x_p + g_f));
+                x_f += N * z;
+            }
+
+            // multipliers of the equality constraints: least squares solution of E_f^T mu = -(H_f x_f + g_f)
+            mu = -U_r * s_inv.asDiagonal() * (V_r.transpose() * (H_f * x_f + g_f));
+        }
+    }
+    else if (nf > 0)
+    {
+        x_f = H_f.ldlt().solve(-g_f);
+    }
+
+    for (int k = 0; k < nf; ++k)
+    {
+        x(free_idx[k]) = x_f(k);
+    }
+
+    // multipliers of the bounds: positive values at an upper (negative at a lower) bound indicate that releasing it improves the objective
+    lambda = H * x + g + A_eq.transpose() * mu;
+    for (int k = 0; k < nf; ++k)
+    {
+        lambda(free_idx[k]) = 0.0;
+    }
+
+    return true;
+}
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <set>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "cob_twist_controller/constraint_solvers/solvers/model_predictive_control_solver.h"
+
+/**
+ * Sets up the QP of the horizon (linearized at the current state) and commands the first step of its solution.
+ * The constraints are evaluated as in the GPM, but at the state predicted by the first step of the last plan.
+ */
+Eigen::MatrixXd ModelPredictiveControlSolver::solve(const Vector6d_t& in_cart_velocities,
+                                                    const JointStates& joint_states)
+{
+    ros::Time now = ros::Time::now();
+    double cycle = (now - this->last_time_).toSec();
+    this->last_time_ = now;
+
+    // the first cycle (or a cycle after a pause) has no meaningful cycle time
+    const double dt = (cycle > ZERO_THRESHOLD && cycle < 1.0) ? cycle : DEFAULT_CYCLE;
+
+    const MPCSolverParams& mpc_params = this->params_.mpc_solver_params;
+    const uint32_t n = this->jacobian_data_.cols();
+    const uint32_t horizon = std::max<uint32_t>(mpc_params.horizon, 1);
+    const uint32_t nx = n * horizon;
+
+    // a changed problem size invalidates the warm start
+    if (n != this->n_ || horizon != this->horizon_)
+    {
+        this->n_ = n;
+        this->horizon_ = horizon;
+        this->x_ = Eigen::VectorXd::Zero(nx);
+        this->y_ = Eigen::VectorXd::Zero(3 * nx);
+    }
+    else
+    {
+        this->shiftWarmStart();
+    }
+
+    this->h_ = Eigen::VectorXd::Constant(horizon, mpc_params.step);
+    this->h_(0) = dt;
+
+    Eigen::VectorXd u_prev = Eigen::VectorXd::Zero(n);
+    for (uint32_t j = 0; j < n && j < joint_states.current_q_dot_.rows(); ++j)
+    {
+        u_prev(j) = joint_states.current_q_dot_(j);
+    }
+
+    Eigen::MatrixXd damped_pinv = pinv_calc_.calculate(this->params_, this->damping_, this->jacobian_data_);
+    Eigen::MatrixXd pinv = pinv_calc_.calculate(this->jacobian_data_);
+
+    Eigen::MatrixXd particular_solution = damped_pinv * in_cart_velocities;
+
+    Eigen::MatrixXd ident = Eigen::MatrixXd::Identity(pinv.rows(), this->jacobian_data_.cols());
+    Eigen::MatrixXd projector = ident - pinv * this->jacobian_data_;
+
+    Eigen::MatrixXd homogeneous_solution = Eigen::MatrixXd::Zero(particular_solution.rows(), particular_solution.cols());
+    KDL::JntArrayVel predict_jnts_vel(joint_states.current_q_.rows());
+
+    // predict next joint states by means of the (shifted) last plan
+    for (int i = 0; i < joint_states.current_q_.rows(); ++i)
+    {
+        const double u = (static_cast<uint32_t>(i) < n) ? this->x_(i) : 0.0;
+        predict_jnts_vel.q(i) = u * dt + joint_states.current_q_(i);
+        predict_jnts_vel.qdot(i) = u;
+    }
+
+    this->markStage(STAGE_SOLVE);
+    this->updateConstraints(joint_states, predict_jnts_vel);
+    for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
+    {
+        Eigen::VectorXd q_dot_0 = (*it)->getPartialValues();
+        Eigen::MatrixXd tmp_projection = projector * q_dot_0;
+        double activation_gain = (*it)->getActivationGain();
+        double constraint_k_H = (*it)->getSelfMotionMagnitude(particular_solution, tmp_projection);
+        homogeneous_solution += (constraint_k_H * activation_gain * tmp_projection);
+    }
+
+    this->markStage(STAGE_CONSTRAINTS);
+
+    const Eigen::VectorXd u_p = particular_solution.col(0);
+    const Eigen::VectorXd u_h = this->params_.k_H * homogeneous_solution.col(0);
+
+    // cost of one step: ||J (u - u_p)||^2 + ||P (u - u_h)||^2 + reg * ||u - u_p - u_h||^2
+    const Eigen::MatrixXd JtJ = this->jacobian_data_.transpose() * this->jacobian_data_;
+    const Eigen::MatrixXd PtP = projector.transpose() * projector;
+    const Eigen::MatrixXd H_step = JtJ + PtP + MPC_REGULARIZATION * Eigen::MatrixXd::Identity(n, n);
+    const Eigen::VectorXd g_step = -(JtJ * u_p + PtP * u_h + MPC_REGULARIZATION * (u_p + u_h));
+
+    // normalized by the duration of the horizon, such that the weights do not depend on it
+    const double duration = this->h_.sum();
+    Eigen::MatrixXd H = Eigen::MatrixXd::Zero(nx, nx);
+    Eigen::VectorXd g = Eigen::VectorXd::Zero(nx);
+    for (uint32_t k = 0; k < horizon; ++k)
+    {
+        const double w_task = this->h_(k) / duration;
+        H.block(k * n, k * n, n, n) += w_task * H_step;
+        g.segment(k * n, n) += w_task * g_step;
+
+        const double w_acc = mpc_params.weight_acc / (this->h_(k) * duration);
+        H.block(k * n, k * n, n, n).diagonal().array() += w_acc;
+        if (k > 0)
+        {
+            H.block((k - 1) * n, (k - 1) * n, n, n).diagonal().array() += w_acc;
+            H.block(k * n, (k - 1) * n, n, n).diagonal().array() -= w_acc;
+            H.block((k - 1) * n, k * n, n, n).diagonal().array() -= w_acc;
+        }
+        else
+        {
+            g.segment(0, n) -= w_acc * u_prev;
+        }
+    }
+
+    this->calcBounds(joint_states, u_prev);
+
+    this->iterations_ = this->solveQP(H, g);
+    if (this->iterations_ < 0)
+    {
+        ROS_WARN_STREAM_THROTTLE(1, "ModelPredictiveControlSolver: No convergence within " << mpc_params.max_iterations << " iterations");
+    }
+
+    // the hard velocity and position limits of the first step hold even for an inaccurate solution
+    const double h_0 = this->h_(0);
+    Eigen::MatrixXd qdots_out = Eigen::MatrixXd::Zero(n, 1);
+    qdots_out.col(0) = this->x_.head(n).cwiseMax(this->lower_.head(n)).cwiseMin(this->upper_.head(n));
+    qdots_out.col(0) = qdots_out.col(0).cwiseMax(this->lower_.segment(2 * nx, n) / h_0).cwiseMin(this->upper_.segment(2 * nx, n) / h_0);
+    return qdots_out;
+}
+
+/**
+ * The first step of the last plan has been commanded, i.e. the plan (and the dual variables of each block of rows) is
+ * moved forward by one step for the current cycle. The last step is repeated.
+ */
+void ModelPredictiveControlSolver::shiftWarmStart()
+{
+    const uint32_t n = this->n_;
+    const uint32_t nx = n * this->horizon_;
+    if (this->horizon_ < 2)
+    {
+        return;
+    }
+
+    const uint32_t shifted = nx - n;
+    this->x_.head(shifted) = this->x_.tail(shifted).eval();
+    for (uint32_t block = 0; block < 3; ++block)
+    {
+        this->y_.segment(block * nx, shifted) = this->y_.segment(block * nx + n, shifted).eval();
+    }
+}
+
+void ModelPredictiveControlSolver::calcBounds(const JointStates& joint_states, const Eigen::VectorXd& u_prev)
+{
+    const uint32_t n = this->n_;
+    const uint32_t nx = n * this->horizon_;
+    const double inf = std::numeric_limits<double>::infinity();
+    this->lower_ = Eigen::VectorXd::Constant(3 * nx, -inf);
+    this->upper_ = Eigen::VectorXd::Constant(3 * nx, inf);
+
+    for (uint32_t j = 0; j < n; ++j)
+    {
+        const bool vel_limited = this->limiter_params_.enforce_vel_limits && j < this->limiter_params_.limits_vel.size();
+        const bool acc_limited = this->limiter_params_.enforce_acc_limits && j < this->limiter_params_.limits_acc.size();
+        const bool pos_limited = this->limiter_params_.enforce_pos_limits &&
+                                 j < this->limiter_params_.limits_min.size() &&
+                                 j < this->limiter_params_.limits_max.size() &&
+                                 j < joint_states.current_q_.rows();
+
+        // a joint beyond a position limit must not move further, but may stay where it is
+        double pos_lower = -inf;
+        double pos_upper = inf;
+        if (pos_limited)
+        {
+            pos_lower = std::min(this->limiter_params_.limits_min[j] - joint_states.current_q_(j), 0.0);
+            pos_upper = std::max(this->limiter_params_.limits_max[j] - joint_states.current_q_(j), 0.0);
+        }
+
+        for (uint32_t k = 0; k < this->horizon_; ++k)
+        {
+            const uint32_t idx = k * n + j;
+            if (vel_limited)
+            {
+                this->lower_(idx) = -this->limiter_params_.limits_vel[j];
+                this->upper_(idx) = this->limiter_params_.limits_vel[j];
+            }
+
+            if (acc_limited)
+            {
+                const double offset = (0 == k) ? u_prev(j) : 0.0;
+                this->lower_(nx + idx) = offset - this->limiter_params_.limits_acc[j] * this->h_(k);
+                this->upper_(nx + idx) = offset + this->limiter_params_.limits_acc[j] * this->h_(k);
+            }
+
+            this->lower_(2 * nx + idx) = pos_lower;
+            this->upper_(2 * nx + idx) = pos_upper;
+        }
+    }
+
+    this->rho_.resize(3 * nx);
+    for (uint32_t i = 0; i < 3 * nx; ++i)
+    {
+        if (this->lower_(i) == -inf && this->upper_(i) == inf)
+        {
+            this->rho_(i) = MPC_ADMM_RHO_MIN;
+        }
+        else if (this->upper_(i) - this->lower_(i) < ZERO_THRESHOLD)
+        {
+            this->rho_(i) = this->rho_scale_ * MPC_ADMM_RHO * MPC_ADMM_RHO_EQ_SCALE;
+        }
+        else
+        {
+            this->rho_(i) = this->rho_scale_ * MPC_ADMM_RHO;
+        }
+    }
+}
+
+void ModelPredictiveControlSolver::multiplyA(const Eigen::VectorXd& x, Eigen::VectorXd& z) const
+{
+    const uint32_t n = this->n_;
+    const uint32_t nx = n * this->horizon_;
+    z.resize(3 * nx);
+
+    z.head(nx) = x;
+    z.segment(nx, n) = x.head(n);
+    z.segment(2 * nx, n) = this->h_(0) * x.head(n);
+    for (uint32_t k = 1; k < this->horizon_; ++k)
+    {
+        z.segment(nx + k * n, n) = x.segment(k * n, n) - x.segment((k - 1) * n, n);
+        z.segment(2 * nx + k * n, n) = z.segment(2 * nx + (k - 1) * n, n) + this->h_(k) * x.segment(k * n, n);
+    }
+}
+
+void ModelPredictiveControlSolver::multiplyAt(const Eigen::VectorXd& z, Eigen::VectorXd& x) const
+{
+    const uint32_t n = this->n_;
+    const uint32_t nx = n * this->horizon_;
+    x = z.head(nx) + z.segment(nx, nx);
+
+    // transposed cumulative sum: sum of the position rows of all later steps
+    Eigen::VectorXd pos_sum = Eigen::VectorXd::Zero(n);
+    for (int k = this->horizon_ - 1; k >= 0; --k)
+    {
+        if (k + 1 < static_cast<int>(this->horizon_))
+        {
+            x.segment(k * n, n) -= z.segment(nx + (k + 1) * n, n);
+        }
+
+        pos_sum += z.segment(2 * nx + k * n, n);
+        x.segment(k * n, n) += this->h_(k) * pos_sum;
+    }
+}
+
+void ModelPredictiveControlSolver::addAtRhoA(Eigen::MatrixXd& K) const
+{
+    const uint32_t n = this->n_;
+    const uint32_t nx = n * this->horizon_;
+    Eigen::VectorXd rho_pos_sum(this->horizon_);
+
+    // the rows only couple the steps of the same joint
+    for (uint32_t j = 0; j < n; ++j)
+    {
+        double sum = 0.0;
+        for (int k = this->horizon_ - 1; k >= 0; --k)
+        {
+            sum += this->rho_(2 * nx + k * n + j);
+            rho_pos_sum(k) = sum;
+        }
+
+        for (uint32_t k = 0; k < this->horizon_; ++k)
+        {
+            const uint32_t idx = k * n + j;
+            K(idx, idx) += this->rho_(idx) + this->rho_(nx + idx);
+            if (k > 0)
+            {
+                const uint32_t idx_prev = idx - n;
+                K(idx_prev, idx_prev) += this->rho_(nx + idx);
+                K(idx, idx_prev) -= this->rho_(nx + idx);
+                K(idx_prev, idx) -= this->rho_(nx + idx);
+            }
+
+            for (uint32_t m = 0; m < this->horizon_; ++m)
+            {
+                K(idx, m * n + j) += this->h_(k) * this->h_(m) * rho_pos_sum(std::max(k, m));
+            }
+        }
+    }
+}
+
+/**
+ * ADMM iterations as in OSQP (Stellato et al.: "OSQP: An Operator Splitting Solver for Quadratic Programs", 2020).
+ * The step sizes are adapted to the ratio of the residuals every MPC_ADMM_ADAPT_INTERVAL iterations (which requires
+ * a new factorization) and kept for the next cycle.
+ */
+int ModelPredictiveControlSolver::solveQP(const Eigen::MatrixXd& H, const Eigen::VectorXd& g)
+{
+    const MPCSolverParams& mpc_params = this->params_.mpc_solver_params;
+    const double tolerance = mpc_params.tolerance;
+    const double alpha = MPC_ADMM_ALPHA;
+    const double sigma = MPC_ADMM_SIGMA;
+
+    Eigen::MatrixXd K = H;
+    K.diagonal().array() += sigma;
+    this->addAtRhoA(K);
+    this->llt_.compute(K);
+
+    Eigen::VectorXd z, z_tilde, z_relaxed, x_tilde, rhs, Ax, Aty;
+    this->multiplyA(this->x_, z);
+    z = z.cwiseMax(this->lower_).cwiseMin(this->upper_);
+
+    for (uint32_t iter = 1; iter <= mpc_params.max_iterations; ++iter)
+    {
+        this->multiplyAt(this->rho_.cwiseProduct(z) - this->y_, rhs);
+        rhs += sigma * this->x_ - g;
+        x_tilde = this->llt_.solve(rhs);
+        this->multiplyA(x_tilde, z_tilde);
+
+        this->x_ = alpha * x_tilde + (1.0 - alpha) * this->x_;
+        z_relaxed = alpha * z_tilde + (1.0 - alpha) * z;
+        z = (z_relaxed + this->y_.cwiseQuotient(this->rho_)).cwiseMax(this->lower_).cwiseMin(this->upper_);
+        this->y_ += this->rho_.cwiseProduct(z_relaxed - z);
+
+        this->multiplyA(this->x_, Ax);
+        this->multiplyAt(this->y_, Aty);
+        const Eigen::VectorXd Hx = H * this->x_;
+        const double primal_residual = (Ax - z).lpNorm<Eigen::Infinity>();
+        const double dual_residual = (Hx + g + Aty).lpNorm<Eigen::Infinity>();
+        const double primal_scale = std::max(Ax.lpNorm<Eigen::Infinity>(), z.lpNorm<Eigen::Infinity>());
+        const double dual_scale = std::max(Hx.lpNorm<Eigen::Infinity>(),
+                                           std::max(Aty.lpNorm<Eigen::Infinity>(), g.lpNorm<Eigen::Infinity>()));
+        if (primal_residual <= tolerance * (1.0 + primal_scale) && dual_residual <= tolerance * (1.0 + dual_scale))
+        {
+            return iter;
+        }
+
+        if (0 == iter % MPC_ADMM_ADAPT_INTERVAL)
+        {
+            const double ratio = std::sqrt((primal_residual / (primal_scale + DIV0_SAFE)) /
+                                           (dual_residual / (dual_scale + DIV0_SAFE) + DIV0_SAFE));
+            const double rho_scale = std::min(std::max(this->rho_scale_ * ratio, MPC_ADMM_RHO_SCALE_MIN), MPC_ADMM_RHO_SCALE_MAX);
+            if (rho_scale > MPC_ADMM_ADAPT_RATIO * this->rho_scale_ || rho_scale * MPC_ADMM_ADAPT_RATIO < this->rho_scale_)
+            {
+                // rows without bounds keep their minimum step size
+                for (int i = 0; i < this->rho_.rows(); ++i)
+                {
+                    if (this->rho_(i) > MPC_ADMM_RHO_MIN)
+                    {
+                        this->rho_(i) *= rho_scale / this->rho_scale_;
+                    }
+                }
+
+                this->rho_scale_ = rho_scale;
+                K = H;
+                K.diagonal().array() += sigma;
+                this->addAtRhoA(K);
+                this->llt_.compute(K);
+            }
+        }
+    }
+
+    return -1;
+}
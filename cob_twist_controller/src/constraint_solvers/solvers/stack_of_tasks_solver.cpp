@@ -16,6 +16,7 @@
 
 
 #include <set>
+#include <vector>
 
 #include "cob_twist_controller/constraint_solvers/solvers/stack_of_tasks_solver.h"
 #include "cob_twist_controller/task_stack/task_stack_controller.h"
@@ -36,8 +37,6 @@ Eigen::MatrixXd StackOfTasksSolver::solve(const Vector6d_t& in_cart_velocities,
     Eigen::MatrixXd ident = Eigen::MatrixXd::Identity(pinv.rows(), this->jacobian_data_.cols());
     Eigen::MatrixXd projector = ident - pinv * this->jacobian_data_;
 
-    Eigen::MatrixXd projector_i = Eigen::MatrixXd::Identity(this->jacobian_data_.cols(), this->jacobian_data_.cols());
-    Eigen::VectorXd q_i = Eigen::VectorXd::Zero(this->jacobian_data_.cols());
     Eigen::MatrixXd qdots_out = Eigen::MatrixXd::Zero(this->jacobian_data_.cols(), 1);
 
     Eigen::VectorXd sum_of_gradient = Eigen::VectorXd::Zero(this->jacobian_data_.cols());
@@ -51,22 +50,23 @@ Eigen::MatrixXd StackOfTasksSolver::solve(const Vector6d_t& in_cart_velocities,
         predict_jnts_vel.qdot(i) = particular_solution(i, 0);
     }
 
+    this->markStage(STAGE_SOLVE);
     // First iteration: update constraint state and calculate the according GPM weighting (DANGER state)
     double inv_sum_of_prionums = 0.0;
+    this->updateConstraints(joint_states, predict_jnts_vel);
     for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
     {
-        (*it)->update(joint_states, predict_jnts_vel, this->jacobian_data_);
-        const double constr_prio = (*it)->getPriorityAsNum();
-        if ((*it)->getState().getCurrent() == DANGER)
-        {
-            inv_sum_of_prionums += constr_prio > ZERO_THRESHOLD ? 1.0 / constr_prio : 1.0 / DIV0_SAFE;
-        }
+        inv_sum_of_prionums += (*it)->getInvDangerPriority();
     }
 
+    this->markStage(STAGE_CONSTRAINTS);
+
     // Second iteration: Process constraints with sum of prios for active GPM constraints!
-    for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
+    this->prepareTaskSlots();
+    uint32_t i = 0;
+    for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it, ++i)
     {
-        this->processState(it, projector, particular_solution, inv_sum_of_prionums, sum_of_gradient);
+        this->processState(it, projector, particular_solution, inv_sum_of_prionums, sum_of_gradient, this->constraint_task_slots_[i]);
     }
 
     sum_of_gradient = this->params_.k_H * sum_of_gradient;  // "global" weighting for all constraints.
@@ -81,84 +81,105 @@ Eigen::MatrixXd StackOfTasksSolver::solve(const Vector6d_t& in_cart_velocities,
     }
 
     const Vector6d_t scaled_in_cart_velocities = (1.0 / pow(this->in_cart_vel_damping_, 2.0)) * in_cart_velocities;
-    Task_t t(this->params_.priority_main, "Main task", this->jacobian_data_, scaled_in_cart_velocities);
-    t.tcp_ = this->params_;
-    this->task_stack_controller_.addTask(t);
+    this->updateMainTask(scaled_in_cart_velocities);
 
     // ROS_INFO_STREAM("============== Task output ============= with main task damping: " << this->in_cart_vel_damping_);
+    // each task is solved in the null space of all higher prioritized tasks (reduced coordinates of the null space basis)
+    this->null_space_projector_.reset(this->jacobian_data_.cols());
     TaskSetIter_t it = this->task_stack_controller_.beginTaskIter();
     while ((it = this->task_stack_controller_.nextActiveTask()) != this->task_stack_controller_.getTasksEnd())
     {
-        Eigen::MatrixXd J_task = it->task_jacobian_;
-        Eigen::MatrixXd J_temp = J_task * projector_i;
-        Eigen::VectorXd v_task = it->task_;
-        Eigen::MatrixXd J_temp_inv = pinv_calc_.calculate(J_temp);  //ToDo: Do we need damping here?
-        q_i = q_i + J_temp_inv * (v_task - J_task * q_i);
-        projector_i = projector_i - J_temp_inv * J_temp;
+        if (0 == this->null_space_projector_.getNullSpaceDimension())
+        {
+            break;  // no redundancy left for lower prioritized tasks
+        }
+
+        this->null_space_projector_.addTask(it->task_jacobian_, it->task_);  //ToDo: Do we need damping here?
     }
 
-    qdots_out.col(0) = q_i + projector_i * sum_of_gradient;
+    qdots_out.col(0) = this->null_space_projector_.getSolution() + this->null_space_projector_.project(sum_of_gradient);
     return qdots_out;
 }
 
 
+void StackOfTasksSolver::updateMainTask(const Vector6d_t& in_cart_velocities)
+{
+    if (this->main_task_slot_ < 0)
+    {
+        this->main_task_slot_ = this->task_stack_controller_.registerTask(this->params_.priority_main,
+                                                                          "Main task",
+                                                                          this->jacobian_data_.rows(),
+                                                                          this->jacobian_data_.cols());
+    }
+
+    this->task_stack_controller_.setPriority(this->main_task_slot_, this->params_.priority_main);  // may be reconfigured in place
+    this->task_stack_controller_.updateTask(this->main_task_slot_, this->jacobian_data_, in_cart_velocities);
+    this->task_stack_controller_.activateTask(static_cast<uint32_t>(this->main_task_slot_));
+}
+
+void StackOfTasksSolver::prepareTaskSlots()
+{
+    // an empty task stack has been cleared since the slots have been registered
+    bool reset = (this->slot_constraints_.size() != this->constraints_.size() || 0 == this->task_stack_controller_.countTasks());
+
+    // the slots belong to the constraints they have been registered for: any other constraint in a position invalidates them
+    std::vector<ConstraintBase_t>::const_iterator slot_it = this->slot_constraints_.begin();
+    for (std::set<ConstraintBase_t>::const_iterator it = this->constraints_.begin(); !reset && it != this->constraints_.end(); ++it, ++slot_it)
+    {
+        reset = (*it != *slot_it);
+    }
+
+    if (reset)
+    {
+        this->main_task_slot_ = -1;
+        this->slot_constraints_.assign(this->constraints_.begin(), this->constraints_.end());
+        this->constraint_task_slots_.assign(this->constraints_.size(), -1);
+    }
+}
+
 void StackOfTasksSolver::processState(std::set<ConstraintBase_t>::iterator& it,
                                       const Eigen::MatrixXd& projector,
                                       const Eigen::MatrixXd& particular_solution,
                                       double inv_sum_of_prios,
-                                      Eigen::VectorXd& sum_of_gradient)
+                                      Eigen::VectorXd& sum_of_gradient,
+                                      int32_t& task_slot)
 {
-    Eigen::VectorXd q_dot_0 = (*it)->getPartialValues();
     const double activation_gain = (*it)->getActivationGain();
-    Eigen::MatrixXd tmp_projection = projector * q_dot_0;
-    const double magnitude = (*it)->getSelfMotionMagnitude(particular_solution, tmp_projection);
+    this->projection_.noalias() = projector * (*it)->getPartialValues();
+    const double magnitude = (*it)->getSelfMotionMagnitude(particular_solution, this->projection_);
     ConstraintState cstate = (*it)->getState();
 
-    const double constr_prio = (*it)->getPriorityAsNum();
-    const double inv_constr_prio = constr_prio > ZERO_THRESHOLD ? 1.0 / constr_prio : 1.0 / DIV0_SAFE;
-    // only necessary for GPM sum because task stack is already sorted according to PRIOs.
-    const double gpm_weighting = inv_constr_prio / inv_sum_of_prios;
-
-    if (cstate.isTransition())
+    if (cstate.getCurrent() == CRITICAL)
     {
-        if (cstate.getCurrent() == CRITICAL)
-        {
-            // "global" weighting k_H for all constraint tasks.
-            Task_t t = (*it)->createTask();
-            double factor = activation_gain * std::abs(magnitude);
-            t.task_ = factor * t.task_;
-            this->task_stack_controller_.addTask(t);
-            this->task_stack_controller_.activateTask((*it)->getTaskId());
-        }
-        else if (cstate.getCurrent() == DANGER)
-        {
-            this->task_stack_controller_.deactivateTask((*it)->getTaskId());
-            sum_of_gradient += gpm_weighting * activation_gain * magnitude * q_dot_0;  // smm adapted q_dot_0 vector
-        }
-        else
+        const Eigen::MatrixXd& task_jacobian = (*it)->getTaskJacobian();
+        if (task_slot < 0)
         {
-            this->task_stack_controller_.deactivateTask((*it)->getTaskId());
+            task_slot = this->task_stack_controller_.registerTask((*it)->getPriority(),
+                                                                  (*it)->getTaskId(),
+                                                                  task_jacobian.rows(),
+                                                                  task_jacobian.cols());
         }
+
+        // "global" weighting k_H for all constraint tasks.
+        const double factor = activation_gain * std::abs(magnitude);  // task must be decided whether negative or not!
+        this->task_stack_controller_.updateTask(task_slot, task_jacobian, factor * (*it)->getTaskDerivatives());
+        this->task_stack_controller_.activateTask(static_cast<uint32_t>(task_slot));
     }
     else
     {
-        if (cstate.getCurrent() == CRITICAL)
-        {
-            Task_t t = (*it)->createTask();
-            double factor = activation_gain * std::abs(magnitude);  // task must be decided whether negative or not!
-            t.task_ = factor * t.task_;
-            this->task_stack_controller_.addTask(t);
-        }
-        else if (cstate.getCurrent() == DANGER)
-        {
-            sum_of_gradient += gpm_weighting * activation_gain * magnitude * q_dot_0;  // smm adapted q_dot_0 vector
-        }
-        else
+        if (task_slot >= 0 && cstate.isTransition())
         {
-            // just compute the particular solution
+            this->task_stack_controller_.deactivateTask(static_cast<uint32_t>(task_slot));
         }
     }
 
+    // parts in DANGER state (also of a CRITICAL constraint, e.g. the other joints of JointLimitAvoidanceVec)
+    // only necessary for GPM sum because task stack is already sorted according to PRIOs.
+    if ((*it)->getInvDangerPriority() > 0.0)
+    {
+        sum_of_gradient += (activation_gain * magnitude / inv_sum_of_prios) * (*it)->getDangerPartialValues();  // smm adapted q_dot_0 vector
+    }
+
     if (cstate.getCurrent() > this->global_constraint_state_ )
     {
         this->global_constraint_state_ = cstate.getCurrent();
@@ -56,9 +56,10 @@ Eigen::MatrixXd TaskPrioritySolver::solve(const Vector6d_t& in_cart_velocities,
 
     if (this->constraints_.size() > 0)
     {
+        this->markStage(STAGE_SOLVE);
+        this->updateConstraints(joint_states, predict_jnts_vel);
         for (std::set<ConstraintBase_t>::iterator it = this->constraints_.begin(); it != this->constraints_.end(); ++it)
         {
-            (*it)->update(joint_states, predict_jnts_vel, this->jacobian_data_);
             current_cost_func_value = (*it)->getValue();
             derivative_cost_func_value = (*it)->getDerivativeValue();
             partial_cost_func = (*it)->getPartialValues();  // Equal to (partial g) / (partial q) = J_g
@@ -69,6 +70,8 @@ Eigen::MatrixXd TaskPrioritySolver::solve(const Vector6d_t& in_cart_velocities,
             ROS_INFO_STREAM("smm: " << magnitude);
         }
 
+        this->markStage(STAGE_CONSTRAINTS);
+
         Eigen::MatrixXd jac_inv_2nd_term = Eigen::MatrixXd::Zero(projector.cols(), partial_cost_func.cols());
         if (activation_gain > 0.0)
         {
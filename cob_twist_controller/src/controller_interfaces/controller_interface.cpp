@@ -15,6 +15,8 @@
  */
 
 
+#include <algorithm>
+
 #include <pluginlib/class_list_macros.h>
 #include "cob_twist_controller/controller_interfaces/controller_interface.h"
 #include "cob_twist_controller/controller_interfaces/controller_interface_base.h"
@@ -22,13 +24,61 @@
 namespace cob_twist_controller
 {
 
+/* BEGIN CommandPublisher ********************************************************************************************************/
+void CommandPublisher::initialize(ros::NodeHandle& nh, const std::string& topic, unsigned int dof)
+{
+    rt_pub_.reset(new realtime_tools::RealtimePublisher<std_msgs::Float64MultiArray>(nh, topic, 1));
+    rt_pub_->msg_.data.resize(dof, 0.0);
+    command_.resize(dof, 0.0);
+    pending_ = false;
+    retry_timer_ = nh.createTimer(ros::Duration(COMMAND_RETRY_PERIOD), &CommandPublisher::retryTimerCallback, this, false, false);
+}
+
+void CommandPublisher::publish(const std::vector<double>& command)
+{
+    std::copy(command.begin(), command.end(), command_.begin());
+    pending_ = true;
+    if (!tryPublish())
+    {
+        /// no-op if the timer is already running
+        retry_timer_.start();
+    }
+}
+
+/**
+ * The message is handed over to the publishing thread, if it has finished the previous one.
+ */
+bool CommandPublisher::tryPublish()
+{
+    if (!rt_pub_->trylock())
+    {
+        return false;
+    }
+
+    rt_pub_->msg_.data = command_;
+    rt_pub_->unlockAndPublish();
+    pending_ = false;
+    return true;
+}
+
+void CommandPublisher::retryTimerCallback(const ros::TimerEvent& event)
+{
+    if (!pending_ || tryPublish())
+    {
+        retry_timer_.stop();
+    }
+}
+/* END CommandPublisher **********************************************************************************************************/
+
+
 /* BEGIN ControllerInterfaceVelocity ********************************************************************************************/
 void ControllerInterfaceVelocity::initialize(ros::NodeHandle& nh,
                                              const TwistControllerParams& params)
 {
     nh_ = nh;
     params_ = params;
-    pub_ = nh.advertise<std_msgs::Float64MultiArray>("joint_group_velocity_controller/command", 1);
+    q_dot_.resize(params_.dof, 0.0);
+    command_pub_.initialize(nh, "joint_group_velocity_controller/command", params_.dof);
 }
 /**
  * Method processing the result by publishing to the 'joint_group_velocity_controller/command' topic.
@@ -36,14 +86,12 @@ void ControllerInterfaceVelocity::initialize(ros::NodeHandle& nh,
 inline void ControllerInterfaceVelocity::processResult(const KDL::JntArray& q_dot_ik,
                                                        const KDL::JntArray& current_q)
 {
-    std_msgs::Float64MultiArray vel_msg;
-
     for (unsigned int i = 0; i < params_.dof; i++)
     {
-        vel_msg.data.push_back(q_dot_ik(i));
+        q_dot_[i] = q_dot_ik(i);
     }
 
-    pub_.publish(vel_msg);
+    command_pub_.publish(q_dot_);
 }
 /* END ControllerInterfaceVelocity **********************************************************************************************/
 
@@ -56,7 +104,7 @@ void ControllerInterfacePosition::initialize(ros::NodeHandle& nh,
     params_ = params;
     last_update_time_ = ros::Time(0.0);
     integrator_.reset(new SimpsonIntegrator(params.dof, params.integrator_smoothing));
-    pub_ = nh.advertise<std_msgs::Float64MultiArray>("joint_group_position_controller/command", 1);
+    command_pub_.initialize(nh, "joint_group_position_controller/command", params_.dof);
 }
 /**
  * Method processing the result using integration method (Simpson) and publishing to the 'joint_group_position_controller/command' topic.
@@ -67,9 +115,7 @@ inline void ControllerInterfacePosition::processResult(const KDL::JntArray& q_do
     if (updateIntegration(q_dot_ik, current_q))
     {
         /// publish to interface
-        std_msgs::Float64MultiArray pos_msg;
-        pos_msg.data = pos_;
-        pub_.publish(pos_msg);
+        command_pub_.publish(pos_);
     }
 }
 /* END ControllerInterfacePosition ******************************************************************************************/
@@ -83,7 +129,29 @@ void ControllerInterfaceTrajectory::initialize(ros::NodeHandle& nh,
     params_ = params;
     last_update_time_ = ros::Time(0.0);
     integrator_.reset(new SimpsonIntegrator(params.dof, params.integrator_smoothing));
-    pub_ = nh.advertise<trajectory_msgs::JointTrajectory>("joint_trajectory_controller/command", 1);
+    rt_pub_.reset(new realtime_tools::RealtimePublisher<trajectory_msgs::JointTrajectory>(nh, "joint_trajectory_controller/command", 1));
+
+    /// the message is allocated once and only its values are updated afterwards
+    cycle_cnt_ = 0;
+    trajectory_msgs::JointTrajectory& traj_msg = rt_pub_->msg_;
+    traj_msg.joint_names = params_.joints;
+    traj_msg.points.resize(params_.trajectory_lookahead_points);
+    for (unsigned int k = 0; k < traj_msg.points.size(); k++)
+    {
+        traj_msg.points[k].positions.resize(params_.dof, 0.0);
+        if (params_.trajectory_lookahead_points > 1)
+        {
+            traj_msg.points[k].velocities.resize(params_.dof, 0.0);
+        }
+    }
+
+    if (params_.trajectory_lookahead_points > 1 &&
+        params_.trajectory_lookahead_step <= 0.0 &&
+        params_.trajectory_lookahead_points - 1 <= params_.trajectory_decimation)
+    {
+        ROS_WARN("The lookahead of %u points ends before the next trajectory is published every %u cycles",
+                 params_.trajectory_lookahead_points, params_.trajectory_decimation);
+    }
 }
 /**
  * Method processing the result using integration method (Simpson) and publishing to the 'joint_trajectory_controller/command' topic.
@@ -93,20 +161,61 @@ inline void ControllerInterfaceTrajectory::processResult(const KDL::JntArray& q_
 {
     if (updateIntegration(q_dot_ik, current_q))
     {
-        trajectory_msgs::JointTrajectoryPoint traj_point;
-        traj_point.positions = pos_;
-        // traj_point.velocities = vel_;
-        // traj_point.accelerations.assign(params_.dof, 0.0);
-        // traj_point.effort.assign(params_.dof, 0.0);
-        traj_point.time_from_start = period_;
-
-        trajectory_msgs::JointTrajectory traj_msg;
-        // traj_msg.header.stamp = ros::Time::now();
-        traj_msg.joint_names = params_.joints;
-        traj_msg.points.push_back(traj_point);
+        /// if the publishing thread is still busy, the trajectory is published in the next cycle
+        if (++cycle_cnt_ < params_.trajectory_decimation || !rt_pub_->trylock())
+        {
+            return;
+        }
+        cycle_cnt_ = 0;
+
+        trajectory_msgs::JointTrajectory& traj_msg = rt_pub_->msg_;
+        if (traj_msg.points.size() > 1)
+        {
+            updateLookahead(traj_msg);
+        }
+        else
+        {
+            traj_msg.points[0].positions = pos_;
+            traj_msg.points[0].time_from_start = period_;
+        }
 
         /// publish to interface
-        pub_.publish(traj_msg);
+        rt_pub_->unlockAndPublish();
+    }
+}
+
+/**
+ * The positions are extrapolated linearly with the integrated velocities and clamped to the joint limits.
+ * The last point comes to rest, such that the joint_trajectory_controller stops smoothly if no further trajectory arrives.
+ * It lies half a step behind the linear extrapolation: the cubic segment from (pos, vel) to rest then decelerates
+ * linearly instead of overshooting the velocity (by a third) before stopping.
+ */
+void ControllerInterfaceTrajectory::updateLookahead(trajectory_msgs::JointTrajectory& traj_msg)
+{
+    const double step = (params_.trajectory_lookahead_step > 0.0) ? params_.trajectory_lookahead_step : period_.toSec();
+    const unsigned int last = traj_msg.points.size() - 1;
+
+    for (unsigned int k = 0; k <= last; k++)
+    {
+        trajectory_msgs::JointTrajectoryPoint& point = traj_msg.points[k];
+        const double dt = k * step;
+        const double dt_pos = (k < last) ? dt : (last - 0.5) * step;
+
+        for (unsigned int i = 0; i < params_.dof; i++)
+        {
+            double pos = pos_[i] + vel_[i] * dt_pos;
+            double vel = (k < last) ? vel_[i] : 0.0;
+            if (pos <= params_.limiter_params.limits_min[i] || pos >= params_.limiter_params.limits_max[i])
+            {
+                pos = std::min(std::max(pos, params_.limiter_params.limits_min[i]), params_.limiter_params.limits_max[i]);
+                vel = 0.0;
+            }
+
+            point.positions[i] = pos;
+            point.velocities[i] = vel;
+        }
+
+        point.time_from_start = period_ + ros::Duration(dt);
     }
 }
 /* END ControllerInterfaceTrajectory ******************************************************************************************/
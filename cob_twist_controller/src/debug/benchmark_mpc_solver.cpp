@@ -0,0 +1,245 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/**
+ * Offline benchmark of the ModelPredictiveControlSolver (solver type MPC) against the cycle budget.
+ * A 7 DoF arm (kinematics of a KUKA LWR, Jacobian computed in closed form) follows a slowly varying twist command at
+ * 100 Hz for each horizon. The twist drives several joints into their position, velocity and acceleration limits,
+ * so the QP has active bounds most of the time. No constraints are set, i.e. the homogeneous solution is zero.
+ * Reports the ADMM iterations and the duration of one solve() per cycle (p50 / p99 / max), the cycles without
+ * convergence and the max. violation of the limits by the commanded joint velocities.
+ * Runs without a ROS master (simulated time); returns 1 if the p99 of the duration exceeds the cycle time or if a
+ * velocity or position limit is violated (the acceleration limits only hold for converged cycles).
+ */
+
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/Dense>
+
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+#include "cob_twist_controller/damping_methods/damping.h"
+#include "cob_twist_controller/constraint_solvers/solvers/model_predictive_control_solver.h"
+
+#define NR_OF_JOINTS 7
+#define CYCLE_TIME 0.01         /// 100 Hz
+#define NR_OF_CYCLES 3000       /// default, 30 s per horizon
+
+namespace
+{
+    int64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    template <typename T>
+    T percentile(std::vector<T>& samples, double p)
+    {
+        const uint32_t idx = std::min<uint32_t>(static_cast<uint32_t>(p * samples.size()), samples.size() - 1);
+        std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return samples[idx];
+    }
+
+    Eigen::Matrix3d rotation(const Eigen::Vector3d& axis, double angle)
+    {
+        return Eigen::AngleAxisd(angle, axis).toRotationMatrix();
+    }
+
+    /// Geometric Jacobian of the tip (base frame) of an arm with the joint axes z, y, z, y, z, y, z.
+    Matrix6Xd_t calcJacobian(const Eigen::VectorXd& q)
+    {
+        const double offsets[NR_OF_JOINTS + 1] = {0.31, 0.0, 0.4, 0.0, 0.39, 0.0, 0.0, 0.078};
+        std::vector<Eigen::Vector3d> axes(NR_OF_JOINTS);
+        std::vector<Eigen::Vector3d> origins(NR_OF_JOINTS);
+        Eigen::Matrix3d rot = Eigen::Matrix3d::Identity();
+        Eigen::Vector3d pos = Eigen::Vector3d::Zero();
+        for (uint32_t i = 0; i < NR_OF_JOINTS; ++i)
+        {
+            pos += rot * Eigen::Vector3d(0.0, 0.0, offsets[i]);
+            const Eigen::Vector3d axis = (0 == i % 2) ? Eigen::Vector3d::UnitZ() : Eigen::Vector3d::UnitY();
+            axes[i] = rot * axis;
+            origins[i] = pos;
+            rot = rot * rotation(axis, q(i));
+        }
+
+        pos += rot * Eigen::Vector3d(0.0, 0.0, offsets[NR_OF_JOINTS]);
+
+        Matrix6Xd_t jacobian(6, NR_OF_JOINTS);
+        for (uint32_t i = 0; i < NR_OF_JOINTS; ++i)
+        {
+            jacobian.block<3, 1>(0, i) = axes[i].cross(pos - origins[i]);
+            jacobian.block<3, 1>(3, i) = axes[i];
+        }
+
+        return jacobian;
+    }
+
+    Vector6d_t calcTwist(double t)
+    {
+        Vector6d_t twist;
+        twist << 0.15 * std::sin(0.5 * t), 0.15 * std::cos(0.3 * t), 0.1 * std::sin(0.7 * t),
+                 0.3 * std::sin(0.4 * t), 0.3 * std::cos(0.25 * t), 0.4 * std::sin(0.6 * t);
+        return twist;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t nr_of_cycles = NR_OF_CYCLES;
+    if (argc > 1)
+    {
+        nr_of_cycles = std::max(std::atoi(argv[1]), 1);
+    }
+
+    ros::Time::init();
+
+    TwistControllerParams params;
+    params.solver = MPC;
+    params.damping_method = MANIPULABILITY;
+
+    LimiterParams limiter_params;
+    limiter_params.enforce_pos_limits = true;
+    limiter_params.enforce_vel_limits = true;
+    limiter_params.enforce_acc_limits = true;
+    for (uint32_t j = 0; j < NR_OF_JOINTS; ++j)
+    {
+        limiter_params.limits_min.push_back(-1.5);
+        limiter_params.limits_max.push_back(1.5);
+        limiter_params.limits_vel.push_back(0.5);
+        limiter_params.limits_acc.push_back(2.0);
+    }
+
+    const uint32_t horizons[] = {5, 10, 20};
+    bool passed = true;
+
+    std::cout << NR_OF_JOINTS << " joints, " << nr_of_cycles << " cycles at " << 1.0 / CYCLE_TIME << " Hz, tolerance "
+              << params.mpc_solver_params.tolerance << ", max. " << params.mpc_solver_params.max_iterations << " iterations" << std::endl;
+    for (uint32_t h = 0; h < 3; ++h)
+    {
+        params.mpc_solver_params.horizon = horizons[h];
+        TaskStackController_t task_stack_controller;
+        ModelPredictiveControlSolver solver(params, limiter_params, task_stack_controller);
+        boost::shared_ptr<DampingBase> damping(DampingBuilder::createDamping(params));
+        solver.setDamping(damping);
+
+        JointStates joint_states;
+        joint_states.current_q_.resize(NR_OF_JOINTS);
+        joint_states.current_q_dot_.resize(NR_OF_JOINTS);
+        for (uint32_t j = 0; j < NR_OF_JOINTS; ++j)
+        {
+            joint_states.current_q_(j) = (0 == j % 2) ? 0.3 : 0.8;
+            joint_states.current_q_dot_(j) = 0.0;
+        }
+
+        joint_states.last_q_ = joint_states.current_q_;
+        joint_states.last_q_dot_ = joint_states.current_q_dot_;
+
+        std::vector<int> iterations;
+        std::vector<int64_t> durations;
+        uint32_t failed = 0;
+        uint32_t active = 0;
+        double max_vel_violation = 0.0;
+        double max_acc_violation = 0.0;
+        double max_pos_violation = 0.0;
+        for (uint32_t c = 0; c < nr_of_cycles; ++c)
+        {
+            const double t = c * CYCLE_TIME;
+            ros::Time::setNow(ros::Time(1.0 + t));
+            solver.setJacobianData(calcJacobian(joint_states.current_q_.data));
+
+            const int64_t start = now();
+            const Eigen::MatrixXd q_dot = solver.solve(calcTwist(t), joint_states);
+            durations.push_back(now() - start);
+
+            // the first cycle has no warm start
+            if (c > 0)
+            {
+                iterations.push_back(solver.getIterations());
+            }
+
+            if (solver.getIterations() < 0)
+            {
+                ++failed;
+            }
+
+            bool limit_active = false;
+            joint_states.last_q_ = joint_states.current_q_;
+            joint_states.last_q_dot_ = joint_states.current_q_dot_;
+            for (uint32_t j = 0; j < NR_OF_JOINTS; ++j)
+            {
+                const double acc = std::fabs(q_dot(j, 0) - joint_states.current_q_dot_(j)) / CYCLE_TIME;
+                max_vel_violation = std::max(max_vel_violation, std::fabs(q_dot(j, 0)) - limiter_params.limits_vel[j]);
+                if (c > 0)
+                {
+                    max_acc_violation = std::max(max_acc_violation, acc - limiter_params.limits_acc[j]);
+                }
+
+                limit_active = limit_active ||
+                               std::fabs(q_dot(j, 0)) > 0.99 * limiter_params.limits_vel[j] ||
+                               acc > 0.99 * limiter_params.limits_acc[j];
+
+                joint_states.current_q_(j) += q_dot(j, 0) * CYCLE_TIME;
+                joint_states.current_q_dot_(j) = q_dot(j, 0);
+                const double q = joint_states.current_q_(j);
+                max_pos_violation = std::max(max_pos_violation, std::max(limiter_params.limits_min[j] - q, q - limiter_params.limits_max[j]));
+                limit_active = limit_active ||
+                               q < limiter_params.limits_min[j] + 0.01 ||
+                               q > limiter_params.limits_max[j] - 0.01;
+            }
+
+            if (limit_active)
+            {
+                ++active;
+            }
+        }
+
+        std::sort(iterations.begin(), iterations.end());
+        const int64_t max_duration = *std::max_element(durations.begin(), durations.end());
+        const int64_t p99_duration = percentile(durations, 0.99);
+        passed = passed &&
+                 (p99_duration * 1.0e-9 < CYCLE_TIME) &&
+                 (max_vel_violation <= ZERO_THRESHOLD) &&
+                 (max_pos_violation <= ZERO_THRESHOLD);
+        std::cout << std::fixed << std::setprecision(1)
+                  << "horizon " << std::setw(2) << horizons[h]
+                  << ": iterations p50 " << percentile(iterations, 0.5)
+                  << " / p99 " << percentile(iterations, 0.99)
+                  << " / max " << iterations.back()
+                  << ", duration [us] p50 " << percentile(durations, 0.5) * 1.0e-3
+                  << " / p99 " << p99_duration * 1.0e-3
+                  << " / max " << max_duration * 1.0e-3
+                  << ", not converged " << failed
+                  << ", limit active " << 100.0 * active / nr_of_cycles << " %"
+                  << std::scientific << std::setprecision(2)
+                  << ", max. violation vel " << std::max(max_vel_violation, 0.0)
+                  << " acc " << std::max(max_acc_violation, 0.0)
+                  << " pos " << std::max(max_pos_violation, 0.0) << std::endl;
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Offline regression check and benchmark of the NullSpaceProjector used by the StackOfTasksSolver.
+ * Random task stacks (a 6-row main task and three 1-row constraint tasks) are resolved by the NullSpaceProjector and by
+ * the recursion of SVD pseudoinverses it replaces (J_i * P_i, PInvBySVD). Besides full rank stacks, rank deficient ones are
+ * checked: duplicated rows with consistent and inconsistent tasks, a main task of rank 4 and constraint tasks within the
+ * row space of the main task. Reports the max. deviation of the joint velocities (relative to their magnitude, since
+ * ill-conditioned stacks result in large velocities) and the duration of one recursion.
+ * Runs without a ROS master; returns 1 if the deviation exceeds the tolerance.
+ */
+
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <Eigen/Core>
+
+#include "cob_twist_controller/inverse_jacobian_calculations/inverse_jacobian_calculation.h"
+#include "cob_twist_controller/inverse_jacobian_calculations/null_space_projector.h"
+
+#define NR_OF_STACKS 1000       /// random task stacks per case
+#define NR_OF_RUNS 20000        /// timed recursions per number of joints
+
+namespace
+{
+    enum StackCases
+    {
+        FULL_RANK,
+        DUPLICATED_ROW,             ///< main task with two equal rows and equal velocities
+        DUPLICATED_ROW_INCONSISTENT,///< main task with two equal rows and different velocities (least squares)
+        MAIN_RANK_4,                ///< main task of rank 4
+        TASK_IN_ROW_SPACE,          ///< constraint task within the row space of the main task (rank 0 in the null space)
+        NR_OF_CASES
+    };
+
+    const char* CASE_NAMES[NR_OF_CASES] = {"full rank", "duplicated row", "duplicated row (inconsistent)", "main task rank 4", "task in row space"};
+
+    struct TaskStack
+    {
+        std::vector<Eigen::MatrixXd> jacobians;
+        std::vector<Eigen::VectorXd> tasks;
+        Eigen::VectorXd gradient;
+    };
+
+    int64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    double percentile(std::vector<int64_t>& samples, double p)
+    {
+        const uint32_t idx = std::min<uint32_t>(static_cast<uint32_t>(p * samples.size()), samples.size() - 1);
+        std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return static_cast<double>(samples[idx]) * 1.0e-3;
+    }
+
+    TaskStack createStack(uint32_t dof, StackCases stack_case)
+    {
+        TaskStack stack;
+        Eigen::MatrixXd main_jacobian = Eigen::MatrixXd::Random(6, dof);
+        Eigen::VectorXd main_task = Eigen::VectorXd::Random(6);
+        switch (stack_case)
+        {
+            case DUPLICATED_ROW:
+                main_jacobian.row(5) = main_jacobian.row(4);
+                main_task(5) = main_task(4);
+                break;
+            case DUPLICATED_ROW_INCONSISTENT:
+                main_jacobian.row(5) = main_jacobian.row(4);
+                break;
+            case MAIN_RANK_4:
+                main_jacobian = Eigen::MatrixXd::Random(6, 4) * Eigen::MatrixXd::Random(4, dof);
+                break;
+            default:
+                break;
+        }
+
+        stack.jacobians.push_back(main_jacobian);
+        stack.tasks.push_back(main_task);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            Eigen::MatrixXd jacobian = Eigen::MatrixXd::Random(1, dof);
+            if (TASK_IN_ROW_SPACE == stack_case && 0 == i)
+            {
+                jacobian = Eigen::MatrixXd::Random(1, 6) * main_jacobian;
+            }
+
+            stack.jacobians.push_back(jacobian);
+            stack.tasks.push_back(Eigen::VectorXd::Random(1));
+        }
+
+        stack.gradient = Eigen::VectorXd::Random(dof);
+        return stack;
+    }
+
+    /// The recursion replaced by the NullSpaceProjector (StackOfTasksSolver before).
+    Eigen::VectorXd solveBySvd(const TaskStack& stack, const PInvBySVD& pinv_calc)
+    {
+        const uint32_t dof = stack.gradient.rows();
+        Eigen::MatrixXd projector_i = Eigen::MatrixXd::Identity(dof, dof);
+        Eigen::VectorXd q_i = Eigen::VectorXd::Zero(dof);
+        for (uint32_t i = 0; i < stack.jacobians.size(); ++i)
+        {
+            const Eigen::MatrixXd J_temp = stack.jacobians[i] * projector_i;
+            const Eigen::MatrixXd J_temp_inv = pinv_calc.calculate(J_temp);
+            q_i = q_i + J_temp_inv * (stack.tasks[i] - stack.jacobians[i] * q_i);
+            projector_i = projector_i - J_temp_inv * J_temp;
+        }
+
+        return q_i + projector_i * stack.gradient;
+    }
+
+    /// As in StackOfTasksSolver::solve.
+    Eigen::VectorXd solveByProjector(const TaskStack& stack, NullSpaceProjector& projector)
+    {
+        projector.reset(stack.gradient.rows());
+        for (uint32_t i = 0; i < stack.jacobians.size(); ++i)
+        {
+            if (0 == projector.getNullSpaceDimension())
+            {
+                break;
+            }
+
+            projector.addTask(stack.jacobians[i], stack.tasks[i]);
+        }
+
+        return projector.getSolution() + projector.project(stack.gradient);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double tolerance = 1.0e-9;
+    if (argc > 1)
+    {
+        tolerance = std::atof(argv[1]);
+    }
+
+    std::srand(42);
+    PInvBySVD pinv_calc;
+    NullSpaceProjector projector;
+    const uint32_t dofs[] = {7, 12, 18};
+    bool passed = true;
+
+    std::cout << std::setprecision(3);
+    std::cout << "max. deviation |q_dot_projector - q_dot_svd| / max(1, |q_dot_svd|) of " << NR_OF_STACKS << " random task stacks:" << std::endl;
+    for (uint32_t c = 0; c < NR_OF_CASES; ++c)
+    {
+        std::cout << "  " << std::setw(30) << std::left << CASE_NAMES[c] << std::right;
+        for (uint32_t d = 0; d < 3; ++d)
+        {
+            double max_delta = 0.0;
+            for (uint32_t i = 0; i < NR_OF_STACKS; ++i)
+            {
+                const TaskStack stack = createStack(dofs[d], static_cast<StackCases>(c));
+                const Eigen::VectorXd q_dot_svd = solveBySvd(stack, pinv_calc);
+                const Eigen::VectorXd delta = solveByProjector(stack, projector) - q_dot_svd;
+                max_delta = std::max(max_delta, delta.cwiseAbs().maxCoeff() / std::max(1.0, q_dot_svd.cwiseAbs().maxCoeff()));
+            }
+
+            passed = passed && (max_delta <= tolerance);
+            std::cout << "  " << dofs[d] << " dof: " << std::scientific << max_delta << std::fixed;
+        }
+
+        std::cout << std::endl;
+    }
+
+    std::cout << "duration of one recursion (full rank) [us], p50 / p99:" << std::endl;
+    for (uint32_t d = 0; d < 3; ++d)
+    {
+        std::vector<TaskStack> stacks;
+        for (uint32_t i = 0; i < NR_OF_STACKS; ++i)
+        {
+            stacks.push_back(createStack(dofs[d], FULL_RANK));
+        }
+
+        std::vector<int64_t> svd_samples;
+        std::vector<int64_t> projector_samples;
+        double checksum = 0.0;
+        for (uint32_t i = 0; i < NR_OF_RUNS; ++i)
+        {
+            const TaskStack& stack = stacks[i % NR_OF_STACKS];
+            int64_t t_start = now();
+            checksum += solveBySvd(stack, pinv_calc)(0);
+            svd_samples.push_back(now() - t_start);
+
+            t_start = now();
+            checksum -= solveByProjector(stack, projector)(0);
+            projector_samples.push_back(now() - t_start);
+        }
+
+        std::cout << "  " << std::setw(2) << dofs[d] << " dof: SVD recursion " << percentile(svd_samples, 0.5) << " / " << percentile(svd_samples, 0.99)
+                  << ", NullSpaceProjector " << percentile(projector_samples, 0.5) << " / " << percentile(projector_samples, 0.99)
+                  << " (checksum " << std::scientific << checksum << std::fixed << ")" << std::endl;
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << " (tolerance " << std::scientific << tolerance << ")" << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,407 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+
+#include "cob_twist_controller/cob_twist_controller_data_types.h"
+#include "cob_twist_controller/flight_recorder.h"
+
+namespace
+{
+    const char DUMP_MAGIC[] = "TCFR";
+    const uint32_t DUMP_MAGIC_SIZE = 4;
+
+    const char* getTriggerName(uint32_t triggers)
+    {
+        if (triggers & TRIGGER_REQUEST) { return "request"; }
+        if (triggers & TRIGGER_CRITICAL) { return "critical"; }
+        if (triggers & TRIGGER_LIMIT_VIOLATION) { return "violation"; }
+        if (triggers & TRIGGER_IK_FAILURE) { return "ik_failure"; }
+        if (triggers & TRIGGER_LIMITER_SATURATION) { return "saturation"; }
+        return "unknown";
+    }
+}
+
+FlightRecorder::FlightRecorder()
+: enabled_(false),
+  auto_dump_(false),
+  auto_dump_triggers_(FLIGHT_RECORDER_AUTO_TRIGGERS),
+  head_(0),
+  cycle_(0),
+  last_triggers_(0),
+  dropped_(0),
+  pending_triggers_(0),
+  trigger_stamp_(0),
+  trigger_head_(0),
+  request_pending_(false),
+  max_dumps_(FLIGHT_RECORDER_MAX_DUMPS),
+  request_stamp_(0),
+  running_(false)
+{}
+
+FlightRecorder::~FlightRecorder()
+{
+    this->stop();
+}
+
+void FlightRecorder::start(const std::string& directory, const std::string& name, const std::vector<std::string>& joint_names,
+                           int max_dumps)
+{
+    this->stop();
+
+    this->directory_ = directory;
+    this->joint_names_ = joint_names;
+    this->max_dumps_ = max_dumps;
+
+    /// e.g. "/arm_left" -> "arm_left"
+    this->name_ = name;
+    std::replace(this->name_.begin(), this->name_.end(), '/', '_');
+    this->name_.erase(0, this->name_.find_first_not_of('_'));
+    if (this->name_.empty())
+    {
+        this->name_ = "twist_controller";
+    }
+
+    this->buffer_.assign(FLIGHT_RECORDER_CAPACITY, FlightRecord());
+    this->snapshot_.assign(FLIGHT_RECORDER_CAPACITY, FlightRecord());
+    this->head_ = 0;
+    this->pending_triggers_ = 0;
+    this->request_pending_ = false;
+
+    this->running_ = true;
+    this->thread_ = boost::thread(&FlightRecorder::run, this);
+}
+
+void FlightRecorder::stop()
+{
+    this->running_ = false;
+    if (this->thread_.joinable())
+    {
+        this->thread_.join();
+    }
+}
+
+void FlightRecorder::record(FlightRecord& record, bool critical)
+{
+    if (!this->enabled_ || !this->running_.load(boost::memory_order_relaxed))
+    {
+        return;
+    }
+
+    record.cycle = this->cycle_++;
+
+    uint32_t triggers = critical ? TRIGGER_CRITICAL : 0;
+
+    if (record.position_factor > 1.0 || record.velocity_factor > 1.0)
+    {
+        triggers |= TRIGGER_LIMITER_SATURATION;
+    }
+
+    if (record.violating_joint >= 0)
+    {
+        triggers |= TRIGGER_LIMIT_VIOLATION;
+    }
+
+    if (0 != record.result)
+    {
+        triggers |= TRIGGER_IK_FAILURE;
+    }
+
+    record.triggers = triggers;
+    const uint32_t rising_triggers = triggers & ~this->last_triggers_ & this->auto_dump_triggers_.load(boost::memory_order_relaxed);
+    this->last_triggers_ = triggers;
+
+    /// a snapshot is taken in this moment: drop the cycle instead of waiting
+    boost::mutex::scoped_try_lock lock(this->buffer_lock_);
+    if (!lock.owns_lock())
+    {
+        this->dropped_.fetch_add(1, boost::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t head = this->head_.load(boost::memory_order_relaxed);
+    this->buffer_[head % FLIGHT_RECORDER_CAPACITY] = record;
+    this->head_.store(head + 1, boost::memory_order_release);
+    lock.unlock();
+
+    if (this->auto_dump_ && 0 != rising_triggers)
+    {
+        if (0 == this->pending_triggers_.load(boost::memory_order_acquire))
+        {
+            this->trigger_stamp_.store(record.stamp, boost::memory_order_relaxed);
+            this->trigger_head_.store(head + 1, boost::memory_order_relaxed);
+        }
+
+        this->pending_triggers_.fetch_or(rising_triggers, boost::memory_order_release);
+    }
+}
+
+std::string FlightRecorder::requestDump(const std::string& file_name)
+{
+    const int64_t stamp = static_cast<int64_t>(ros::Time::now().toNSec());
+    const std::string dump_file = file_name.empty() ? this->makeFileName(TRIGGER_REQUEST, stamp) : file_name;
+    {
+        boost::mutex::scoped_lock lock(this->request_lock_);
+        this->requested_file_ = dump_file;
+        this->request_stamp_ = stamp;
+    }
+
+    this->request_pending_.store(true, boost::memory_order_release);
+    return dump_file;
+}
+
+/**
+ * Background loop: a requested dump is written immediately, a dump triggered by an anomaly as soon as
+ * FLIGHT_RECORDER_POST_TRIGGER_CYCLES further cycles have been recorded (or after FLIGHT_RECORDER_POST_TRIGGER_TIMEOUT).
+ */
+void FlightRecorder::run()
+{
+    ros::WallTime waiting_since;
+    ros::WallTime last_auto_dump;
+    while (this->running_)
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(static_cast<int64_t>(FLIGHT_RECORDER_POLL_PERIOD * 1000.0)));
+
+        if (this->request_pending_.exchange(false, boost::memory_order_acq_rel))
+        {
+            std::string file_name;
+            int64_t stamp;
+            {
+                boost::mutex::scoped_lock lock(this->request_lock_);
+                file_name = this->requested_file_;
+                stamp = this->request_stamp_;
+            }
+
+            this->dump(file_name, TRIGGER_REQUEST, stamp);
+            this->removeOldDumps();
+        }
+
+        uint32_t triggers = this->pending_triggers_.load(boost::memory_order_acquire);
+        if (0 == triggers)
+        {
+            continue;
+        }
+
+        const ros::WallTime now = ros::WallTime::now();
+        if (waiting_since.isZero())
+        {
+            waiting_since = now;
+        }
+
+        if (this->head_.load(boost::memory_order_acquire) < this->trigger_head_.load(boost::memory_order_relaxed) + FLIGHT_RECORDER_POST_TRIGGER_CYCLES &&
+            (now - waiting_since).toSec() < FLIGHT_RECORDER_POST_TRIGGER_TIMEOUT)
+        {
+            continue;
+        }
+
+        waiting_since = ros::WallTime();
+        triggers = this->pending_triggers_.exchange(0, boost::memory_order_acq_rel);
+        const int64_t stamp = this->trigger_stamp_.load(boost::memory_order_relaxed);
+
+        if (!last_auto_dump.isZero() && (now - last_auto_dump).toSec() < FLIGHT_RECORDER_MIN_DUMP_INTERVAL)
+        {
+            ROS_WARN_STREAM("FlightRecorder: Skipping dump (" << getTriggerName(triggers) << "), the last one has been written "
+                            << (now - last_auto_dump).toSec() << " s ago");
+            continue;
+        }
+
+        last_auto_dump = now;
+        this->dump(this->makeFileName(triggers, stamp), triggers, stamp);
+        this->removeOldDumps();
+    }
+}
+
+void FlightRecorder::dump(const std::string& file_name, uint32_t triggers, int64_t stamp)
+{
+    uint32_t nr_of_records;
+    {
+        boost::mutex::scoped_lock lock(this->buffer_lock_);
+        const uint64_t head = this->head_.load(boost::memory_order_relaxed);
+        nr_of_records = static_cast<uint32_t>(std::min<uint64_t>(head, FLIGHT_RECORDER_CAPACITY));
+        for (uint32_t i = 0; i < nr_of_records; ++i)
+        {
+            this->snapshot_[i] = this->buffer_[(head - nr_of_records + i) % FLIGHT_RECORDER_CAPACITY];
+        }
+    }
+
+    std::ofstream file(file_name.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        ROS_ERROR_STREAM("FlightRecorder: Failed to open " << file_name);
+        return;
+    }
+
+    FlightRecorderDumpHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.version = FLIGHT_RECORDER_VERSION;
+    header.record_size = sizeof(FlightRecord);
+    header.nr_of_records = nr_of_records;
+    header.triggers = triggers;
+    header.dropped = this->dropped_.load(boost::memory_order_relaxed);
+    header.stamp = stamp;
+
+    file.write(DUMP_MAGIC, DUMP_MAGIC_SIZE);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const uint32_t nr_of_joints = this->joint_names_.size();
+    file.write(reinterpret_cast<const char*>(&nr_of_joints), sizeof(nr_of_joints));
+    for (uint32_t i = 0; i < nr_of_joints; ++i)
+    {
+        const uint32_t size = this->joint_names_[i].size();
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file.write(this->joint_names_[i].data(), size);
+    }
+
+    file.write(reinterpret_cast<const char*>(&this->snapshot_[0]), static_cast<std::streamsize>(nr_of_records) * sizeof(FlightRecord));
+    if (!file.good())
+    {
+        ROS_ERROR_STREAM("FlightRecorder: Failed to write " << file_name);
+        return;
+    }
+
+    ROS_INFO_STREAM("FlightRecorder: Wrote " << nr_of_records << " cycles (" << getTriggerName(triggers) << ") to " << file_name);
+}
+
+bool FlightRecorder::readDump(const std::string& file_name,
+                              FlightRecorderDumpHeader& header,
+                              std::vector<std::string>& joint_names,
+                              std::vector<FlightRecord>& records)
+{
+    std::ifstream file(file_name.c_str(), std::ios::binary);
+    char magic[DUMP_MAGIC_SIZE];
+    if (!file.read(magic, DUMP_MAGIC_SIZE) || 0 != std::memcmp(magic, DUMP_MAGIC, DUMP_MAGIC_SIZE))
+    {
+        return false;
+    }
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        FLIGHT_RECORDER_VERSION != header.version ||
+        sizeof(FlightRecord) != header.record_size)
+    {
+        return false;
+    }
+
+    uint32_t nr_of_joints;
+    if (!file.read(reinterpret_cast<char*>(&nr_of_joints), sizeof(nr_of_joints)))
+    {
+        return false;
+    }
+
+    joint_names.resize(nr_of_joints);
+    for (uint32_t i = 0; i < nr_of_joints; ++i)
+    {
+        uint32_t size;
+        if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+        {
+            return false;
+        }
+
+        joint_names[i].resize(size);
+        if (size > 0 && !file.read(&joint_names[i][0], size))
+        {
+            return false;
+        }
+    }
+
+    records.resize(header.nr_of_records);
+    if (header.nr_of_records > 0 &&
+        !file.read(reinterpret_cast<char*>(&records[0]), static_cast<std::streamsize>(header.nr_of_records) * sizeof(FlightRecord)))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+std::string FlightRecorder::getDefaultDirectory()
+{
+    const char* ros_home = std::getenv("ROS_HOME");
+    if (NULL != ros_home)
+    {
+        return ros_home;
+    }
+
+    const char* home = std::getenv("HOME");
+    return (NULL != home) ? std::string(home) + "/.ros" : std::string("/tmp");
+}
+
+std::string FlightRecorder::makeFileName(uint32_t triggers, int64_t stamp) const
+{
+    std::ostringstream oss;
+    oss << this->directory_ << "/" << this->name_ << "_" << stamp / 1000000000LL << "_"
+        << std::setw(3) << std::setfill('0') << (stamp % 1000000000LL) / 1000000LL
+        << "_" << getTriggerName(triggers) << ".tcfr";
+    return oss.str();
+}
+
+/**
+ * Only the files generated by makeFileName() are considered, i.e. "<name>_<sec>_<msec>_<reason>.tcfr" within the
+ * directory of the dumps. Since the names start with the time stamp, the oldest dumps come first in lexical order.
+ */
+void FlightRecorder::removeOldDumps()
+{
+    if (this->max_dumps_ <= 0)
+    {
+        return;
+    }
+
+    namespace fs = boost::filesystem;
+    const std::string prefix = this->name_ + "_";
+    std::vector<fs::path> dumps;
+    try
+    {
+        for (fs::directory_iterator it(this->directory_); it != fs::directory_iterator(); ++it)
+        {
+            const std::string file_name = it->path().filename().string();
+            if (fs::is_regular_file(it->status()) &&
+                file_name.size() > prefix.size() &&
+                0 == file_name.compare(0, prefix.size(), prefix) &&
+                std::isdigit(static_cast<unsigned char>(file_name[prefix.size()])) &&
+                ".tcfr" == it->path().extension().string())
+            {
+                dumps.push_back(it->path());
+            }
+        }
+
+        if (dumps.size() <= static_cast<std::size_t>(this->max_dumps_))
+        {
+            return;
+        }
+
+        std::sort(dumps.begin(), dumps.end());
+        for (std::size_t i = 0; i < dumps.size() - this->max_dumps_; ++i)
+        {
+            fs::remove(dumps[i]);
+            ROS_INFO_STREAM("FlightRecorder: Removed " << dumps[i].string() << " (more than " << this->max_dumps_ << " dumps)");
+        }
+    }
+    catch (const fs::filesystem_error& e)
+    {
+        ROS_WARN_STREAM("FlightRecorder: Failed to remove old dumps: " << e.what());
+    }
+}
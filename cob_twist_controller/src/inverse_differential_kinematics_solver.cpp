@@ -17,8 +17,6 @@
 
 #include <ros/ros.h>
 #include <eigen_conversions/eigen_kdl.h>
-#include <kdl/chainfksolvervel_recursive.hpp>
-
 #include "cob_twist_controller/inverse_differential_kinematics_solver.h"
 
 /**
@@ -31,9 +29,14 @@ int InverseDifferentialKinematicsSolver::CartToJnt(const JointStates& joint_stat
     // ROS_INFO_STREAM("joint_states.current_q_: " << joint_states.current_q_.rows());
     int8_t retStat = -1;
 
-    /// Let the ChainJntToJacSolver calculate the jacobian "jac_chain" for the current joint positions "q_in"
-    KDL::Jacobian jac_chain(chain_.getNrOfJoints());
-    jnt2jac_.JntToJac(joint_states.current_q_, jac_chain);
+    /// Update the kinematics of this cycle (frames, twists and Jacobians of all segments in one pass)
+    /// They are shared with the constraints and the kinematic extension.
+    if (0 != this->kinematics_cache_.update(joint_states.current_q_, joint_states.current_q_dot_))
+    {
+        return retStat;
+    }
+    const KDL::Jacobian& jac_chain = this->kinematics_cache_.getJacobian();
+    this->pipeline_stats_.mark(STAGE_JACOBIAN);
     // ROS_INFO_STREAM("jac_chain.rows: " << jac_chain.rows() << ", jac_chain.columns: " << jac_chain.columns());
 
     JointStates joint_states_full = this->kinematic_extension_->adjustJointStates(joint_states);
@@ -42,18 +45,21 @@ int InverseDifferentialKinematicsSolver::CartToJnt(const JointStates& joint_stat
     /// append columns to Jacobian in order to reflect additional DoFs of kinematical extension
     KDL::Jacobian jac_full = this->kinematic_extension_->adjustJacobian(jac_chain);
     // ROS_INFO_STREAM("jac_full.rows: " << jac_full.rows() << ", jac_full.columns: " << jac_full.columns());
+    this->pipeline_stats_.mark(STAGE_EXTENSION);
 
     /// apply input limiters for limiting Cartesian velocities (input Twist)
     Vector6d_t v_in_vec;
     KDL::Twist v_temp;
     v_temp = this->limiters_->enforceLimits(v_in);
     tf::twistKDLToEigen(v_temp, v_in_vec);
+    this->pipeline_stats_.mark(STAGE_INPUT_LIMITERS);
 
     Eigen::MatrixXd qdot_out_vec;
     retStat = constraint_solver_factory_.calculateJointVelocities(jac_full.data,
                                                                   v_in_vec,
                                                                   joint_states_full,
                                                                   qdot_out_vec);
+    this->pipeline_stats_.mark(STAGE_SOLVE);
 
     /// convert output
     KDL::JntArray qdot_out_full(jac_full.columns());
@@ -65,7 +71,8 @@ int InverseDifferentialKinematicsSolver::CartToJnt(const JointStates& joint_stat
     // ROS_INFO_STREAM("qdot_out_full.rows: " << qdot_out_full.rows());
 
     /// output limiters shut be applied here in order to be able to consider the additional DoFs within "AllLimit", too
-    qdot_out_full = this->limiters_->enforceLimits(qdot_out_full, joint_states_full.current_q_);
+    this->limiters_->enforceLimits(qdot_out_full, joint_states_full.current_q_, qdot_out_full);
+    this->pipeline_stats_.mark(STAGE_OUTPUT_LIMITERS);
 
     // ROS_INFO_STREAM("qdot_out_full.rows enforced: " << qdot_out_full.rows());
     // for (int i = 0; i < jac_full.columns(); i++)
@@ -89,8 +96,9 @@ bool InverseDifferentialKinematicsSolver::resetAll(TwistControllerParams params)
 {
     this->params_ = params;
 
-    this->kinematic_extension_.reset(KinematicExtensionBuilder::createKinematicExtension(this->params_));
+    this->kinematic_extension_.reset(KinematicExtensionBuilder::createKinematicExtension(this->params_, this->extension_resources_));
     if (this->kinematic_extension_ == NULL) { return false; }
+    this->kinematic_extension_->setChainKinematics(this->kinematics_cache_);
     this->limiter_params_ = this->kinematic_extension_->adjustLimiterParams(this->params_.limiter_params);
 
     this->limiters_.reset(new LimiterContainer(this->limiter_params_));
@@ -104,3 +112,63 @@ bool InverseDifferentialKinematicsSolver::resetAll(TwistControllerParams params)
     }
     return true;
 }
+
+bool InverseDifferentialKinematicsSolver::reconfigure(const TwistControllerParams& params)
+{
+    const ros::WallTime start = ros::WallTime::now();
+
+    /// changes of the structure (extension, solver, constraint selection or constraint order) require a complete reset
+    const bool structure_changed = params.kinematic_extension != this->params_.kinematic_extension ||
+                                   params.solver != this->params_.solver ||
+                                   params.constraint_jla != this->params_.constraint_jla ||
+                                   params.constraint_ca != this->params_.constraint_ca ||
+                                   params.constraint_params.at(JLA).priority != this->params_.constraint_params.at(JLA).priority ||
+                                   params.constraint_params.at(CA).priority != this->params_.constraint_params.at(CA).priority;
+    if (structure_changed)
+    {
+        const bool success = this->resetAll(params);
+        ROS_INFO_STREAM("Reconfiguration with complete reset took " << (ros::WallTime::now() - start).toSec() * 1000.0 << " ms");
+        return success;
+    }
+
+    /// the damping method holds a copy of the parameters
+    const bool damping_changed = params.damping_method != this->params_.damping_method ||
+                                 params.damping_factor != this->params_.damping_factor ||
+                                 params.lambda_max != this->params_.lambda_max ||
+                                 params.w_threshold != this->params_.w_threshold ||
+                                 params.beta != this->params_.beta ||
+                                 params.slope_damping != this->params_.slope_damping ||
+                                 params.eps_damping != this->params_.eps_damping;
+
+    /// the set of active limiters depends on these flags only
+    const LimiterParams& lp_new = params.limiter_params;
+    const LimiterParams& lp_old = this->params_.limiter_params;
+    const bool limiters_changed = lp_new.keep_direction != lp_old.keep_direction ||
+                                  lp_new.enforce_input_limits != lp_old.enforce_input_limits ||
+                                  lp_new.enforce_pos_limits != lp_old.enforce_pos_limits ||
+                                  lp_new.enforce_vel_limits != lp_old.enforce_vel_limits ||
+                                  lp_new.enforce_acc_limits != lp_old.enforce_acc_limits;
+
+    /// solvers, limiters and the kinematic extension reference params_ and limiter_params_, i.e. they take over changes in place
+    this->params_ = params;
+    this->limiter_params_ = this->kinematic_extension_->adjustLimiterParams(this->params_.limiter_params);
+
+    if (limiters_changed)
+    {
+        this->limiters_.reset(new LimiterContainer(this->limiter_params_));
+        this->limiters_->init();
+    }
+
+    if (damping_changed && 0 != this->constraint_solver_factory_.resetDamping(this->params_))
+    {
+        ROS_ERROR("Failed to reset damping method after dynamic_reconfigure.");
+        return false;
+    }
+
+    this->constraint_solver_factory_.updateConstraintParams(this->params_);
+
+    ROS_INFO_STREAM("Reconfiguration in place (" << (damping_changed ? "new damping method, " : "")
+                    << (limiters_changed ? "new limiters, " : "") << "updated gains) took "
+                    << (ros::WallTime::now() - start).toSec() * 1000.0 << " ms");
+    return true;
+}
@@ -57,6 +57,8 @@ Eigen::MatrixXd PInvBySVD::calculate(const TwistControllerParams& params,
     Eigen::VectorXd singularValues = svd.singularValues();
     Eigen::VectorXd singularValuesInv = Eigen::VectorXd::Zero(singularValues.rows());
     Eigen::MatrixXd lambda = db->getDampingFactor(singularValues, jacobian);
+    this->last_singular_values_ = singularValues;
+    this->last_damping_ = (lambda.rows() > 0) ? lambda.diagonal().maxCoeff() : 0.0;
 
     if (params.numerical_filtering)
     {
@@ -133,6 +135,8 @@ Eigen::MatrixXd PInvDirect::calculate(const TwistControllerParams& params,
     }
 
     Eigen::MatrixXd lambda = db->getDampingFactor(Eigen::VectorXd::Zero(1, 1), jacobian);
+    this->last_singular_values_.resize(0);
+    this->last_damping_ = (lambda.rows() > 0) ? lambda.diagonal().maxCoeff() : 0.0;
     if (cols >= rows)
     {
         Eigen::MatrixXd ident = Eigen::MatrixXd::Identity(rows, rows);
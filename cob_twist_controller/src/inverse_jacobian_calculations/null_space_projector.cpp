@@ -0,0 +1,117 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Cholesky>
+
+#include "cob_twist_controller/inverse_jacobian_calculations/null_space_projector.h"
+
+void NullSpaceProjector::reset(uint32_t dof)
+{
+    this->solution_ = Eigen::VectorXd::Zero(dof);
+    this->basis_ = Eigen::MatrixXd::Identity(dof, dof);
+}
+
+/**
+ * With the QR decomposition J_red^T * P = Q * R of the reduced task Jacobian J_red = J * Z (rank k) follows
+ * J_red = P * R_1^T * Q_1^T, where Q_1 are the first k columns of Q and R_1 the first k rows of R.
+ * The minimum norm solution lies in span(Q_1): z = Q_1 * y with R_1^T * y = P^T * e.
+ * The remaining columns of Q span the null space of J_red.
+ */
+uint32_t NullSpaceProjector::addTask(const Eigen::MatrixXd& task_jacobian, const Eigen::VectorXd& task)
+{
+    const uint32_t r = this->basis_.cols();
+    const uint32_t m = task_jacobian.rows();
+    if (0 == r || 0 == m)
+    {
+        return 0;
+    }
+
+    this->qr_.compute((task_jacobian * this->basis_).transpose());
+
+    // rank as in PInvBySVD: singular values below the threshold are truncated
+    // (R has the singular values of the reduced task Jacobian, Q and P are orthogonal)
+    const Eigen::MatrixXd& qr_matrix = this->qr_.matrixQR();
+    const uint32_t max_rank = std::min(r, m);
+    uint32_t k = 0;
+    if (this->hasFullRank(max_rank, m))
+    {
+        k = m;
+    }
+    else
+    {
+        this->upper_ = qr_matrix.topRows(max_rank).triangularView<Eigen::Upper>();
+        this->svd_.compute(this->upper_);
+        const Eigen::VectorXd& singular_values = this->svd_.singularValues();
+        while (k < max_rank && singular_values(k) >= this->threshold_)
+        {
+            ++k;
+        }
+    }
+
+    if (0 == k)
+    {
+        return 0;
+    }
+
+    const Eigen::VectorXd rhs = this->qr_.colsPermutation().transpose() * (task - task_jacobian * this->solution_);
+    const Eigen::MatrixXd R_1 = qr_matrix.topRows(k).triangularView<Eigen::Upper>();
+    Eigen::VectorXd y;
+    if (k == m)
+    {
+        y = R_1.transpose().triangularView<Eigen::Lower>().solve(rhs);
+    }
+    else
+    {
+        // more task rows than rank: least squares solution
+        y = (R_1 * R_1.transpose()).ldlt().solve(R_1 * rhs);
+    }
+
+    this->rotated_basis_ = this->basis_ * this->qr_.householderQ();
+    this->solution_.noalias() += this->rotated_basis_.leftCols(k) * y;
+    this->basis_ = this->rotated_basis_.rightCols(r - k);
+
+    return k;
+}
+
+/**
+ * Cheap check of the common case without SVD: For a square triangular R, 1 / ||R^-1||_F is a lower bound of the
+ * smallest singular value. The SVD is only required if the bound is below the threshold.
+ */
+bool NullSpaceProjector::hasFullRank(uint32_t max_rank, uint32_t m)
+{
+    if (max_rank < m)
+    {
+        return false;   // more task rows than null space dimensions
+    }
+
+    const Eigen::MatrixXd& qr_matrix = this->qr_.matrixQR();
+    if (qr_matrix.diagonal().head(m).cwiseAbs().minCoeff() < this->threshold_)
+    {
+        return false;   // sigma_min <= min |R_ii|
+    }
+
+    this->upper_inv_.setIdentity(m, m);
+    qr_matrix.topLeftCorner(m, m).triangularView<Eigen::Upper>().solveInPlace(this->upper_inv_);
+    return 1.0 / this->upper_inv_.norm() >= this->threshold_;
+}
+
+Eigen::VectorXd NullSpaceProjector::project(const Eigen::VectorXd& v) const
+{
+    return this->basis_ * (this->basis_.transpose() * v);
+}
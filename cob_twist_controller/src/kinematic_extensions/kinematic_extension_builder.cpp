@@ -23,31 +23,31 @@
 /**
  * Static builder method to create kinematic extensions based on given parameterization.
  */
-KinematicExtensionBase* KinematicExtensionBuilder::createKinematicExtension(const TwistControllerParams& params)
+KinematicExtensionBase* KinematicExtensionBuilder::createKinematicExtension(const TwistControllerParams& params, const KinematicExtensionResources& resources)
 {
     KinematicExtensionBase* keb = NULL;
 
     switch (params.kinematic_extension)
     {
         case NO_EXTENSION:
-            keb = new KinematicExtensionNone(params);
+            keb = new KinematicExtensionNone(params, resources);
             break;
         case BASE_COMPENSATION:
             // nothing to do here for BASE_COMPENSATION - only affects twist subscription callback
-            keb = new KinematicExtensionNone(params);
+            keb = new KinematicExtensionNone(params, resources);
             break;
         case BASE_ACTIVE:
-            keb = new KinematicExtensionBaseActive(params);
+            keb = new KinematicExtensionBaseActive(params, resources);
             break;
         case COB_TORSO:
-            keb = new KinematicExtensionTorso(params);
+            keb = new KinematicExtensionTorso(params, resources);
             break;
         case LOOKAT:
-            keb = new KinematicExtensionLookat(params);
+            keb = new KinematicExtensionLookat(params, resources);
             break;
         default:
             ROS_ERROR("KinematicExtension %d not defined! Using default: 'NO_EXTENSION'!", params.kinematic_extension);
-            keb = new KinematicExtensionNone(params);
+            keb = new KinematicExtensionNone(params, resources);
             break;
     }
     if (!keb->initExtension())
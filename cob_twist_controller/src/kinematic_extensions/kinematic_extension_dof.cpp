@@ -133,6 +133,12 @@ KDL::Jacobian KinematicExtensionDOF::adjustJacobianDof(const KDL::Jacobian& jac_
 /* BEGIN KinematicExtensionBaseActive ********************************************************************************************/
 bool KinematicExtensionBaseActive::initExtension()
 {
+    if (!hasResources(true))
+    {
+        return false;
+    }
+
+    cb_bl_idx_ = resources_.tf_cache->addFramePair(params_.chain_base_link, "base_link");
     base_vel_pub_ = nh_.advertise<geometry_msgs::Twist>("base/command", 1);
 
     min_vel_lin_base_ = 0.005;  // used to avoid infinitesimal motion
@@ -169,31 +175,23 @@ bool KinematicExtensionBaseActive::initExtension()
  */
 KDL::Jacobian KinematicExtensionBaseActive::adjustJacobian(const KDL::Jacobian& jac_chain)
 {
-    tf::StampedTransform bl_transform_ct, cb_transform_bl;
+    tf::StampedTransform cb_transform_bl;
     KDL::Frame bl_frame_ct, cb_frame_bl;
     ActiveCartesianDimension active_dim;
 
     /// get required transformations
-    try
-    {
-        ros::Time now = ros::Time(0);
-        tf_listener_.waitForTransform("base_link", params_.chain_tip_link, now, ros::Duration(0.5));
-        tf_listener_.lookupTransform("base_link", params_.chain_tip_link,  now, bl_transform_ct);
-
-        tf_listener_.waitForTransform(params_.chain_base_link, "base_link", now, ros::Duration(0.5));
-        tf_listener_.lookupTransform(params_.chain_base_link, "base_link", now, cb_transform_bl);
-    }
-    catch (tf::TransformException& ex)
+    if (!resources_.tf_cache->getTransform(cb_bl_idx_, cb_transform_bl))
     {
-        ROS_ERROR("%s", ex.what());
+        ROS_ERROR_STREAM_THROTTLE(1, "No transform from base_link to " << params_.chain_base_link << " available");
+        cb_transform_bl.setIdentity();
     }
 
-    bl_frame_ct.p = KDL::Vector(bl_transform_ct.getOrigin().x(), bl_transform_ct.getOrigin().y(), bl_transform_ct.getOrigin().z());
-    bl_frame_ct.M = KDL::Rotation::Quaternion(bl_transform_ct.getRotation().x(), bl_transform_ct.getRotation().y(), bl_transform_ct.getRotation().z(), bl_transform_ct.getRotation().w());
-
     cb_frame_bl.p = KDL::Vector(cb_transform_bl.getOrigin().x(), cb_transform_bl.getOrigin().y(), cb_transform_bl.getOrigin().z());
     cb_frame_bl.M = KDL::Rotation::Quaternion(cb_transform_bl.getRotation().x(), cb_transform_bl.getRotation().y(), cb_transform_bl.getRotation().z(), cb_transform_bl.getRotation().w());
 
+    /// the chain tip is given by the forward kinematics of the current cycle
+    bl_frame_ct = cb_frame_bl.Inverse() * chain_kinematics_->getFrame(chain_kinematics_->getNrOfSegments());
+
     /// active base can move in lin_x, lin_y and rot_z
     active_dim.lin_x = 1;
     active_dim.lin_y = 1;
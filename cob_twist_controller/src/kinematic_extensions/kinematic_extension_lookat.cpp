@@ -15,6 +15,7 @@
  */
 
 
+#include <cmath>
 #include <string>
 #include <vector>
 #include <limits>
@@ -26,6 +27,11 @@
 /* BEGIN KinematicExtensionLookat ********************************************************************************************/
 bool KinematicExtensionLookat::initExtension()
 {
+    if (!hasResources(true))
+    {
+        return false;
+    }
+
     /// parse robot_description and generate KDL chains
     KDL::Tree tree;
     if (!kdl_parser::treeFromParam("robot_description", tree))
@@ -47,12 +53,15 @@ bool KinematicExtensionLookat::initExtension()
     {
         case X_POSITIVE:
             lookat_lin_joint_type = KDL::Joint::TransX;
+            lookat_axis_ = KDL::Vector(1.0, 0.0, 0.0);
             break;
         case Y_POSITIVE:
             lookat_lin_joint_type = KDL::Joint::TransY;
+            lookat_axis_ = KDL::Vector(0.0, 1.0, 0.0);
             break;
         case Z_POSITIVE:
             lookat_lin_joint_type = KDL::Joint::TransZ;
+            lookat_axis_ = KDL::Vector(0.0, 0.0, 1.0);
             break;
         case X_NEGATIVE:
             lookat_lin_joint_type = KDL::Joint::TransX;
@@ -69,6 +78,7 @@ bool KinematicExtensionLookat::initExtension()
         default:
             ROS_ERROR("LookatAxisType %d not defined! Using default: 'X_POSITIVE'!", params_.lookat_offset.lookat_axis_type);
             lookat_lin_joint_type = KDL::Joint::TransX;
+            lookat_axis_ = KDL::Vector(1.0, 0.0, 0.0);
             break;
     }
 
@@ -76,7 +86,8 @@ bool KinematicExtensionLookat::initExtension()
     try
     {
         tf::StampedTransform offset_transform;
-        tf_listener_.lookupTransform(params_.chain_tip_link, params_.lookat_pointing_frame, ros::Time(0), offset_transform);
+        resources_.tf_listener->waitForTransform(params_.chain_tip_link, params_.lookat_pointing_frame, ros::Time(0), ros::Duration(0.5));
+        resources_.tf_listener->lookupTransform(params_.chain_tip_link, params_.lookat_pointing_frame, ros::Time(0), offset_transform);
         tf::transformTFToKDL(offset_transform, offset);
     }
     catch (tf::TransformException& ex)
@@ -86,16 +97,20 @@ bool KinematicExtensionLookat::initExtension()
         offset.p = KDL::Vector(params_.lookat_offset.translation_x, params_.lookat_offset.translation_y, params_.lookat_offset.translation_z);
         offset.M = KDL::Rotation::Quaternion(params_.lookat_offset.rotation_x, params_.lookat_offset.rotation_y, params_.lookat_offset.rotation_z, params_.lookat_offset.rotation_w);
     }
+    offset_ = offset;
+
+    /// the lookat chain is only built for the validation of the closed-form kinematics
+    KDL::Chain chain_ext;
 
     //fixed pointing offset
     KDL::Joint offset_joint("offset_joint", KDL::Joint::None);
     KDL::Segment offset_link("offset_link", offset_joint, offset);
-    chain_ext_.addSegment(offset_link);
+    chain_ext.addSegment(offset_link);
 
     //lookat chain
     KDL::Joint lookat_lin_joint("lookat_lin_joint", lookat_lin_joint_type);
     KDL::Segment lookat_rotx_link("lookat_rotx_link", lookat_lin_joint);
-    chain_ext_.addSegment(lookat_rotx_link);
+    chain_ext.addSegment(lookat_rotx_link);
     limits_ext_max_.push_back(std::numeric_limits<double>::max());
     limits_ext_min_.push_back(-std::numeric_limits<double>::max());
     limits_ext_vel_.push_back(5.0);
@@ -103,7 +118,7 @@ bool KinematicExtensionLookat::initExtension()
 
     KDL::Joint lookat_rotx_joint("lookat_rotx_joint", KDL::Joint::RotX);
     KDL::Segment lookat_roty_link("lookat_roty_link", lookat_rotx_joint);
-    chain_ext_.addSegment(lookat_roty_link);
+    chain_ext.addSegment(lookat_roty_link);
     // limits_ext_max_.push_back(M_PI);
     // limits_ext_min_.push_back(-M_PI);
     limits_ext_max_.push_back(std::numeric_limits<double>::max());
@@ -114,7 +129,7 @@ bool KinematicExtensionLookat::initExtension()
 
     KDL::Joint lookat_roty_joint("lookat_roty_joint", KDL::Joint::RotY);
     KDL::Segment lookat_rotz_link("lookat_rotz_link", lookat_roty_joint);
-    chain_ext_.addSegment(lookat_rotz_link);
+    chain_ext.addSegment(lookat_rotz_link);
     // limits_ext_max_.push_back(M_PI);
     // limits_ext_min_.push_back(-M_PI);
     limits_ext_max_.push_back(std::numeric_limits<double>::max());
@@ -125,7 +140,7 @@ bool KinematicExtensionLookat::initExtension()
 
     KDL::Joint lookat_rotz_joint("lookat_rotz_joint", KDL::Joint::RotZ);
     KDL::Segment lookat_focus_frame("lookat_focus_frame", lookat_rotz_joint);
-    chain_ext_.addSegment(lookat_focus_frame);
+    chain_ext.addSegment(lookat_focus_frame);
     // limits_ext_max_.push_back(M_PI);
     // limits_ext_min_.push_back(-M_PI);
     limits_ext_max_.push_back(std::numeric_limits<double>::max());
@@ -134,13 +149,12 @@ bool KinematicExtensionLookat::initExtension()
     limits_ext_vel_.push_back(M_PI);
     limits_ext_acc_.push_back(std::numeric_limits<double>::max());
 
-    chain_full_ = chain_main;
-    chain_full_.addChain(chain_ext_);
-
-    fk_solver_ext_.reset(new KDL::ChainFkSolverPos_recursive(chain_ext_));
-    jnt2jac_.reset(new KDL::ChainJntToJacSolver(chain_full_));
-
     this->ext_dof_ = 4;
+    if (!validateKinematics(chain_main, chain_ext))
+    {
+        return false;
+    }
+
     this->joint_states_ext_.last_q_.resize(ext_dof_);
     KDL::SetToZero(this->joint_states_ext_.last_q_);
     this->joint_states_ext_.last_q_dot_.resize(ext_dof_);
@@ -162,9 +176,8 @@ KDL::Jacobian KinematicExtensionLookat::adjustJacobian(const KDL::Jacobian& jac_
 {
     /// compose jac_full considering kinematical extension
     boost::mutex::scoped_lock lock(mutex_);
-    KDL::Jacobian jac_full(chain_full_.getNrOfJoints());
-
-    jnt2jac_->JntToJac(joint_states_full_.current_q_ , jac_full);
+    KDL::Jacobian jac_full(jac_chain.columns() + ext_dof_);
+    computeJacobian(jac_chain, chain_kinematics_->getFrame(chain_kinematics_->getNrOfSegments()), joint_states_ext_.current_q_, jac_full);
 
     return jac_full;
 }
@@ -236,13 +249,96 @@ void KinematicExtensionLookat::processResultExtension(const KDL::JntArray& q_dot
 void KinematicExtensionLookat::broadcastFocusFrame(const ros::TimerEvent& event)
 {
     boost::mutex::scoped_lock lock(mutex_);
-    KDL::Frame focus_frame;
-
-    fk_solver_ext_->JntToCart(joint_states_ext_.current_q_, focus_frame);
+    KDL::Frame focus_frame = getFocusFrame(joint_states_ext_.current_q_);
 
     tf::Transform transform;
     tf::transformKDLToTF(focus_frame, transform);
     br_.sendTransform(tf::StampedTransform(transform, ros::Time::now(), params_.chain_tip_link, "lookat_focus_frame"));
 }
 
+KDL::Frame KinematicExtensionLookat::getFocusFrame(const KDL::JntArray& q_ext) const
+{
+    return offset_ * KDL::Frame(KDL::Rotation::RotX(q_ext(1)) * KDL::Rotation::RotY(q_ext(2)) * KDL::Rotation::RotZ(q_ext(3)),
+                                lookat_axis_ * q_ext(0));
+}
+
+/**
+ * The columns of the chain are shifted from the chain tip to the focus. The lookat_lin_joint translates the focus along
+ * the pointing axis, the lookat_rot joints rotate about the axes of their (intermediate) frames, which are all located
+ * at the focus.
+ */
+void KinematicExtensionLookat::computeJacobian(const KDL::Jacobian& jac_chain,
+                                               const KDL::Frame& chain_tip,
+                                               const KDL::JntArray& q_ext,
+                                               KDL::Jacobian& jac_full) const
+{
+    const unsigned int chain_dof = jac_chain.columns();
+    const KDL::Rotation pointing_rot = chain_tip.M * offset_.M;
+    const KDL::Vector tip_focus = chain_tip.M * getFocusFrame(q_ext).p;
+
+    for (unsigned int i = 0; i < chain_dof; i++)
+    {
+        jac_full.setColumn(i, jac_chain.getColumn(i).RefPoint(tip_focus));
+    }
+
+    const KDL::Rotation rot_x = pointing_rot * KDL::Rotation::RotX(q_ext(1));
+    const KDL::Rotation rot_y = rot_x * KDL::Rotation::RotY(q_ext(2));
+    jac_full.setColumn(chain_dof, KDL::Twist(pointing_rot * lookat_axis_, KDL::Vector::Zero()));
+    jac_full.setColumn(chain_dof + 1, KDL::Twist(KDL::Vector::Zero(), pointing_rot.UnitX()));
+    jac_full.setColumn(chain_dof + 2, KDL::Twist(KDL::Vector::Zero(), rot_x.UnitY()));
+    jac_full.setColumn(chain_dof + 3, KDL::Twist(KDL::Vector::Zero(), rot_y.UnitZ()));
+}
+
+/**
+ * The configurations are spread deterministically over the joint space (the lookat_lin_joint stays positive).
+ */
+bool KinematicExtensionLookat::validateKinematics(const KDL::Chain& chain_main, const KDL::Chain& chain_ext) const
+{
+    KDL::Chain chain_full = chain_main;
+    chain_full.addChain(chain_ext);
+
+    KinematicsCache kinematics_main(chain_main);
+    KinematicsCache kinematics_full(chain_full);
+    const unsigned int chain_dof = chain_main.getNrOfJoints();
+
+    KDL::JntArray q_full(chain_dof + ext_dof_);
+    KDL::JntArray q_ext(ext_dof_);
+    KDL::Jacobian jac_full(chain_dof + ext_dof_);
+    double max_error = 0.0;
+
+    for (unsigned int k = 0; k < LOOKAT_VALIDATION_SAMPLES; k++)
+    {
+        for (unsigned int i = 0; i < chain_dof + ext_dof_; i++)
+        {
+            q_full(i) = M_PI * std::sin(1.7 * (k + 1) + 2.3 * (i + 1));
+        }
+        q_full(chain_dof) = 0.1 + std::fabs(q_full(chain_dof));
+        for (unsigned int i = 0; i < ext_dof_; i++)
+        {
+            q_ext(i) = q_full(chain_dof + i);
+        }
+
+        kinematics_main.update(q_full);
+        kinematics_full.update(q_full);
+
+        const KDL::Frame& chain_tip = kinematics_main.getFrame(kinematics_main.getNrOfSegments());
+        computeJacobian(kinematics_main.getJacobian(), chain_tip, q_ext, jac_full);
+
+        const KDL::Frame focus = chain_tip * getFocusFrame(q_ext);
+        const KDL::Frame& focus_kdl = kinematics_full.getFrame(kinematics_full.getNrOfSegments());
+        const KDL::Twist focus_error = KDL::diff(focus_kdl, focus);
+
+        max_error = std::max(max_error, (jac_full.data - kinematics_full.getJacobian().data).cwiseAbs().maxCoeff());
+        max_error = std::max(max_error, std::max(focus_error.vel.Norm(), focus_error.rot.Norm()));
+    }
+
+    if (max_error > LOOKAT_VALIDATION_TOLERANCE)
+    {
+        ROS_ERROR_STREAM("KinematicExtensionLookat: The closed-form kinematics deviate from KDL by " << max_error);
+        return false;
+    }
+
+    return true;
+}
+
 /* END KinematicExtensionLookat ********************************************************************************************/
@@ -23,6 +23,11 @@
 /* BEGIN KinematicExtensionURDF ********************************************************************************************/
 bool KinematicExtensionURDF::initExtension()
 {
+    if (!hasResources(false))
+    {
+        return false;
+    }
+
     /// parse robot_description and generate KDL chains
     KDL::Tree tree;
     if (!kdl_parser::treeFromParam("robot_description", tree))
@@ -50,6 +55,7 @@ bool KinematicExtensionURDF::initExtension()
         }
     }
     this->ext_dof_ = chain_.getNrOfJoints();
+    this->ext_kinematics_.reset(new KinematicsCache(chain_));
     this->joint_states_.last_q_.resize(ext_dof_);
     this->joint_states_.last_q_dot_.resize(ext_dof_);
     this->joint_states_.current_q_.resize(ext_dof_);
@@ -84,6 +90,11 @@ KDL::Jacobian KinematicExtensionURDF::adjustJacobian(const KDL::Jacobian& jac_ch
     jac_ext.resize(6, ext_dof_);
     jac_ext.setZero();
 
+    /// forward kinematics of the extension (ext_base -> chain_base) and of the primary chain (chain_base -> chain_tip)
+    this->ext_kinematics_->update(this->joint_states_.current_q_);
+    const KDL::Frame& ext_base_frame_cb = this->ext_kinematics_->getFrame(this->ext_kinematics_->getNrOfSegments());
+    const KDL::Frame ext_base_frame_ct = ext_base_frame_cb * chain_kinematics_->getFrame(chain_kinematics_->getNrOfSegments());
+
     unsigned int k = 0;
     for (unsigned int i = 0; i < chain_.getNrOfSegments(); i++)
     {
@@ -119,27 +130,9 @@ KDL::Jacobian KinematicExtensionURDF::adjustJacobian(const KDL::Jacobian& jac_ch
         }
 
         /// get required transformations
-        tf::StampedTransform eb_transform_ct, cb_transform_eb;
-        KDL::Frame eb_frame_ct, cb_frame_eb;
-        try
-        {
-            ros::Time now = ros::Time::now();
-            tf_listener_.waitForTransform(chain_.getSegment(i).getName(), params_.chain_tip_link, now, ros::Duration(0.5));
-            tf_listener_.lookupTransform(chain_.getSegment(i).getName(), params_.chain_tip_link,  now, eb_transform_ct);
-
-            tf_listener_.waitForTransform(params_.chain_base_link, chain_.getSegment(i).getName(), now, ros::Duration(0.5));
-            tf_listener_.lookupTransform(params_.chain_base_link, chain_.getSegment(i).getName(), now, cb_transform_eb);
-        }
-        catch (tf::TransformException& ex)
-        {
-            ROS_ERROR("%s", ex.what());
-        }
-
-        eb_frame_ct.p = KDL::Vector(eb_transform_ct.getOrigin().x(), eb_transform_ct.getOrigin().y(), eb_transform_ct.getOrigin().z());
-        eb_frame_ct.M = KDL::Rotation::Quaternion(eb_transform_ct.getRotation().x(), eb_transform_ct.getRotation().y(), eb_transform_ct.getRotation().z(), eb_transform_ct.getRotation().w());
-
-        cb_frame_eb.p = KDL::Vector(cb_transform_eb.getOrigin().x(), cb_transform_eb.getOrigin().y(), cb_transform_eb.getOrigin().z());
-        cb_frame_eb.M = KDL::Rotation::Quaternion(cb_transform_eb.getRotation().x(), cb_transform_eb.getRotation().y(), cb_transform_eb.getRotation().z(), cb_transform_eb.getRotation().w());
+        const KDL::Frame& ext_base_frame_eb = this->ext_kinematics_->getFrame(i + 1);
+        KDL::Frame eb_frame_ct = ext_base_frame_eb.Inverse() * ext_base_frame_ct;
+        KDL::Frame cb_frame_eb = ext_base_frame_cb.Inverse() * ext_base_frame_eb;
 
         // rotation from base_frame of primary chain to base_frame of extension (eb)
         Eigen::Quaterniond quat_cb;
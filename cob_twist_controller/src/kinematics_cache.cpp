@@ -0,0 +1,187 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <vector>
+#include <ros/ros.h>
+
+#include "cob_twist_controller/kinematics_cache.h"
+
+KinematicsCache::KinematicsCache(const KDL::Chain& chain)
+    : chain_(chain),
+      nr_of_segments_(chain.getNrOfSegments()),
+      nr_of_joints_(chain.getNrOfJoints()),
+      caching_(true),
+      valid_(false),
+      q_(chain.getNrOfJoints()),
+      q_dot_(chain.getNrOfJoints()),
+      frames_(chain.getNrOfSegments() + 1),
+      twists_(chain.getNrOfSegments() + 1),
+      joint_twists_(chain.getNrOfJoints()),
+      joint_frames_(chain.getNrOfJoints(), 0),
+      jacobians_(chain.getNrOfSegments() + 1, KDL::Jacobian(chain.getNrOfJoints())),
+      jacobians_valid_(chain.getNrOfSegments() + 1, false),
+      nr_of_passes_(0),
+      nr_of_updates_(0),
+      nr_of_jacobians_(0)
+{
+    KDL::SetToZero(this->q_);
+    KDL::SetToZero(this->q_dot_);
+}
+
+int KinematicsCache::update(const KDL::JntArray& q, const KDL::JntArray& q_dot)
+{
+    if (q.rows() < this->nr_of_joints_ || q_dot.rows() < this->nr_of_joints_)
+    {
+        ROS_ERROR_STREAM("KinematicsCache: Expected at least " << this->nr_of_joints_ << " joint values but got " << q.rows() << " positions and " << q_dot.rows() << " velocities!");
+        return -1;
+    }
+
+    boost::mutex::scoped_lock lock(this->lock_);
+    ++this->nr_of_updates_;
+    bool changed = !this->valid_ || !this->caching_;
+    for (uint32_t i = 0; i < this->nr_of_joints_; ++i)
+    {
+        if (this->q_(i) != q(i) || this->q_dot_(i) != q_dot(i))
+        {
+            changed = true;
+        }
+        this->q_(i) = q(i);
+        this->q_dot_(i) = q_dot(i);
+    }
+
+    if (changed)
+    {
+        this->recurse();
+    }
+
+    return 0;
+}
+
+int KinematicsCache::update(const KDL::JntArray& q)
+{
+    if (q.rows() < this->nr_of_joints_)
+    {
+        ROS_ERROR_STREAM("KinematicsCache: Expected at least " << this->nr_of_joints_ << " joint values but got " << q.rows() << " positions!");
+        return -1;
+    }
+
+    boost::mutex::scoped_lock lock(this->lock_);
+    ++this->nr_of_updates_;
+    bool changed = !this->valid_ || !this->caching_;
+    for (uint32_t i = 0; i < this->nr_of_joints_; ++i)
+    {
+        if (this->q_(i) != q(i) || this->q_dot_(i) != 0.0)
+        {
+            changed = true;
+        }
+        this->q_(i) = q(i);
+        this->q_dot_(i) = 0.0;
+    }
+
+    if (changed)
+    {
+        this->recurse();
+    }
+
+    return 0;
+}
+
+/**
+ * One recursive pass along the chain (same conventions as KDL::ChainFkSolverVel_recursive and KDL::ChainJntToJacSolver).
+ */
+void KinematicsCache::recurse()
+{
+    this->frames_[0] = KDL::Frame::Identity();
+    this->twists_[0] = KDL::Twist::Zero();
+
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < this->nr_of_segments_; ++i)
+    {
+        const KDL::Segment& segment = this->chain_.getSegment(i);
+        const KDL::Frame& frame_root = this->frames_[i];
+
+        if (segment.getJoint().getType() != KDL::Joint::None)
+        {
+            const KDL::Frame pose = segment.pose(this->q_(j));
+            this->frames_[i + 1] = frame_root * pose;
+            this->twists_[i + 1] = this->twists_[i].RefPoint(frame_root.M * pose.p) + frame_root.M * segment.twist(this->q_(j), this->q_dot_(j));
+            this->joint_twists_[j] = frame_root.M * segment.twist(this->q_(j), 1.0);
+            this->joint_frames_[j] = i + 1;
+            ++j;
+        }
+        else
+        {
+            const KDL::Frame pose = segment.pose(0.0);
+            this->frames_[i + 1] = frame_root * pose;
+            this->twists_[i + 1] = this->twists_[i].RefPoint(frame_root.M * pose.p);
+        }
+    }
+
+    this->jacobians_valid_.assign(this->jacobians_valid_.size(), false);
+    this->valid_ = true;
+    ++this->nr_of_passes_;
+}
+
+const KDL::Frame& KinematicsCache::getFrame(uint32_t frame_number) const
+{
+    return this->frames_.at(frame_number);
+}
+
+const KDL::Twist& KinematicsCache::getTwist(uint32_t frame_number) const
+{
+    return this->twists_.at(frame_number);
+}
+
+/**
+ * Assembles the Jacobian of a frame from the joint unit twists of the last recursive pass.
+ * Each column only needs to be shifted to the reference point of the requested frame.
+ */
+const KDL::Jacobian& KinematicsCache::getJacobian(uint32_t frame_number)
+{
+    boost::mutex::scoped_lock lock(this->lock_);
+    KDL::Jacobian& jac = this->jacobians_.at(frame_number);
+    if (!this->caching_)
+    {
+        this->recurse();
+    }
+
+    if (!this->jacobians_valid_[frame_number])
+    {
+        const KDL::Vector& p_frame = this->frames_[frame_number].p;
+        for (uint32_t j = 0; j < this->nr_of_joints_; ++j)
+        {
+            if (this->joint_frames_[j] <= frame_number)
+            {
+                const KDL::Vector& p_joint = this->frames_[this->joint_frames_[j]].p;
+                jac.setColumn(j, this->joint_twists_[j].RefPoint(p_frame - p_joint));
+            }
+            else
+            {
+                jac.setColumn(j, KDL::Twist::Zero());
+            }
+        }
+        this->jacobians_valid_[frame_number] = true;
+        ++this->nr_of_jacobians_;
+    }
+
+    return jac;
+}
+
+const KDL::Jacobian& KinematicsCache::getJacobian()
+{
+    return this->getJacobian(this->nr_of_segments_);
+}
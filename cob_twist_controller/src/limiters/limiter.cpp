@@ -16,243 +16,298 @@
 
 
 #include <vector>
+#include <limits>
 #include <ros/ros.h>
 
 #include "cob_twist_controller/limiters/limiter.h"
 
-/* BEGIN LimiterContainer ***************************************************************************************/
+/* BEGIN LimiterJointFused **************************************************************************************/
 /**
- * This implementation calls enforce limits on all registered Limiters in the respective limiters vector.
+ * Dispatches to the keep-direction or the individual variant.
+ * q_dot_out is only reallocated if the number of joints changes; q_dot_ik(i) is read before q_dot_out(i) is written,
+ * such that the limits can be enforced in place.
  */
-KDL::Twist LimiterContainer::enforceLimits(const KDL::Twist& v_in) const
+void LimiterJointFused::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out)
 {
-    // If nothing to do just return v_in.
-    KDL::Twist v_out(v_in);
-    for (input_LimIter_t it = this->input_limiters_.begin(); it != this->input_limiters_.end(); it++)
+    if (q_dot_out.rows() != q_dot_ik.rows())
     {
-        v_out = (*it)->enforceLimits(v_out);
+        q_dot_out.resize(q_dot_ik.rows());
     }
 
-    return v_out;
-}
-KDL::JntArray LimiterContainer::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
-{
-    // If nothing to do just return q_dot.
-    KDL::JntArray q_dot_norm(q_dot_ik);
-    for (output_LimIter_t it = this->output_limiters_.begin(); it != this->output_limiters_.end(); it++)
+    this->resetScaling(q_dot_ik.rows());
+
+    if (limiter_params_.keep_direction)
     {
-        q_dot_norm = (*it)->enforceLimits(q_dot_norm, q);
+        this->enforceAllLimits(q_dot_ik, q, q_dot_out);
+    }
+    else
+    {
+        this->enforceIndividualLimits(q_dot_ik, q, q_dot_out);
     }
-
-    return q_dot_norm;
 }
 
 /**
- * Building the limiters vector according the the chosen parameters.
+ * Same results as LimiterAllJointPositions followed by LimiterAllJointVelocities:
+ * The velocity factor refers to the velocities already scaled by the position factor. Hence, it is taken over from
+ * the first pass only if the position limits are not active; else it is determined while scaling.
  */
-void LimiterContainer::init()
+void LimiterJointFused::enforceAllLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out)
 {
-    this->eraseAll();
+    const double tolerance = limiter_params_.limits_tolerance / 180.0 * M_PI;
+    double pos_factor = 1.0;
+    double vel_factor = 1.0;
 
-    if (limiter_params_.keep_direction)
+    for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
     {
-        if (limiter_params_.enforce_input_limits)
-        {
-            this->add(new LimiterAllCartesianVelocities(limiter_params_));
-        }
-
         if (limiter_params_.enforce_pos_limits)
         {
-            this->add(new LimiterAllJointPositions(limiter_params_));
+            if ((limiter_params_.limits_max[i] - LIMIT_SAFETY_THRESHOLD <= q(i) && q_dot_ik(i) > 0) ||
+               (limiter_params_.limits_min[i] + LIMIT_SAFETY_THRESHOLD >= q(i) && q_dot_ik(i) < 0))
+            {
+                ROS_ERROR_STREAM("Joint " << i << " violates its limits. Setting to Zero!");
+                KDL::SetToZero(q_dot_out);
+                this->scaling_.violating_joint = i;
+                this->scaling_.joint_factors.assign(q_dot_ik.rows(), std::numeric_limits<double>::infinity());
+                return;
+            }
+
+            double temp = this->positionFactor(i, q_dot_ik(i), q(i), tolerance);
+            if (temp > pos_factor)
+            {
+                pos_factor = temp;
+                this->scaling_.position_joint = i;
+            }
         }
 
         if (limiter_params_.enforce_vel_limits)
         {
-            this->add(new LimiterAllJointVelocities(limiter_params_));
+            double temp = std::fabs(q_dot_ik(i) / limiter_params_.limits_vel[i]);
+            if (vel_factor < temp)
+            {
+                vel_factor = temp;
+                this->scaling_.velocity_joint = i;
+            }
         }
+    }
 
-        if (limiter_params_.enforce_acc_limits)
+    if (pos_factor > 1.0)
+    {
+        ROS_ERROR_STREAM_THROTTLE(1, "Position tolerance surpassed (by Joint " << this->scaling_.position_joint << "): Scaling ALL VELOCITIES with factor = " << pos_factor);
+        vel_factor = 1.0;
+        this->scaling_.velocity_joint = -1;
+        for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
         {
-            this->add(new LimiterAllJointAccelerations(limiter_params_));
+            q_dot_out(i) = q_dot_ik(i) / pos_factor;
+            if (limiter_params_.enforce_vel_limits && vel_factor < std::fabs(q_dot_out(i) / limiter_params_.limits_vel[i]))
+            {
+                vel_factor = std::fabs(q_dot_out(i) / limiter_params_.limits_vel[i]);
+                this->scaling_.velocity_joint = i;
+            }
         }
     }
     else
     {
-        if (limiter_params_.enforce_input_limits)
+        q_dot_out.data = q_dot_ik.data;
+    }
+
+    if (vel_factor > 1.0)
+    {
+        ROS_WARN_STREAM_THROTTLE(1, "Velocity limit surpassed (by Joint " << this->scaling_.velocity_joint << "): Scaling ALL VELOCITIES with factor = " << vel_factor);
+        for (unsigned int i = 0; i < q_dot_out.rows(); i++)
         {
-            this->add(new LimiterIndividualCartesianVelocities(limiter_params_));
+            q_dot_out(i) = q_dot_out(i) / vel_factor;
         }
+    }
+
+    this->scaling_.position_factor = pos_factor;
+    this->scaling_.velocity_factor = vel_factor;
+    this->scaling_.joint_factors.assign(q_dot_ik.rows(), pos_factor * vel_factor);
+}
+
+/**
+ * Same results as LimiterIndividualJointPositions followed by LimiterIndividualJointVelocities:
+ * Each joint is scaled independently, hence all limits are applied in a single pass.
+ */
+void LimiterJointFused::enforceIndividualLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out)
+{
+    const double tolerance = limiter_params_.limits_tolerance / 180.0 * M_PI;
+
+    for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
+    {
+        double q_dot = q_dot_ik(i);
+        double joint_factor = 1.0;
 
         if (limiter_params_.enforce_pos_limits)
         {
-            this->add(new LimiterIndividualJointPositions(limiter_params_));
+            if ((limiter_params_.limits_max[i] - LIMIT_SAFETY_THRESHOLD <= q(i) && q_dot_ik(i) > 0) ||
+               (limiter_params_.limits_min[i] + LIMIT_SAFETY_THRESHOLD >= q(i) && q_dot_ik(i) < 0))
+            {
+                ROS_ERROR_STREAM("Joint " << i << " violates its limits. Setting to Zero!");
+                q_dot = 0.0;
+                joint_factor = std::numeric_limits<double>::infinity();
+                if (this->scaling_.violating_joint < 0)
+                {
+                    this->scaling_.violating_joint = i;
+                }
+            }
+
+            double factor = this->positionFactor(i, q_dot_ik(i), q(i), tolerance);
+            q_dot = q_dot / factor;
+            joint_factor *= factor;
+            if (factor > this->scaling_.position_factor)
+            {
+                this->scaling_.position_factor = factor;
+                this->scaling_.position_joint = i;
+            }
         }
 
         if (limiter_params_.enforce_vel_limits)
         {
-            this->add(new LimiterIndividualJointVelocities(limiter_params_));
+            double factor = std::fabs(q_dot / limiter_params_.limits_vel[i]);
+            if (1.0 < factor)
+            {
+                q_dot = q_dot / factor;
+                joint_factor *= factor;
+                if (factor > this->scaling_.velocity_factor)
+                {
+                    this->scaling_.velocity_factor = factor;
+                    this->scaling_.velocity_joint = i;
+                }
+            }
         }
 
-        if (limiter_params_.enforce_acc_limits)
-        {
-            this->add(new LimiterIndividualJointAccelerations(limiter_params_));
-        }
+        q_dot_out(i) = q_dot;
+        this->scaling_.joint_factors[i] = joint_factor;
     }
 }
 
 /**
- * Deletes all limiters and clears the vector holding them.
+ * The factor is calculated by using the cosine function to provide a smooth transition from 1 to infinity
+ * when a joint moves towards a limit within limits_tolerance.
  */
-void LimiterContainer::eraseAll()
+double LimiterJointFused::positionFactor(unsigned int i, double q_dot, double q, double tolerance) const
 {
-    for (uint32_t cnt = 0; cnt < this->input_limiters_.size(); ++cnt)
+    double factor = 1.0;
+    if (fabs(limiter_params_.limits_max[i] - q) <= tolerance)  // Joint is close to the MAXIMUM limit
     {
-        delete(this->input_limiters_[cnt]);
+        if (q_dot > 0.0)  // Joint moves towards the MAX limit
+        {
+            double temp = 1.0 / pow((0.5 + 0.5 * cos(M_PI * (q + tolerance - limiter_params_.limits_max[i]) / tolerance)), 5.0);
+            factor = (temp > factor) ? temp : factor;
+        }
     }
-    for (uint32_t cnt = 0; cnt < this->output_limiters_.size(); ++cnt)
+
+    if (fabs(q - limiter_params_.limits_min[i]) <= tolerance)  // Joint is close to the MINIMUM limit
     {
-        delete(this->output_limiters_[cnt]);
+        if (q_dot < 0.0)  // Joint moves towards the MIN limit
+        {
+            double temp = 1.0 / pow(0.5 + 0.5 * cos(M_PI * (q - tolerance - limiter_params_.limits_min[i]) / tolerance), 5.0);
+            factor = (temp > factor) ? temp : factor;
+        }
     }
 
-    this->input_limiters_.clear();
-    this->output_limiters_.clear();
+    return factor;
 }
 
-/**
- * Adding new limiters to the vector.
- */
-void LimiterContainer::add(const LimiterCartesianBase* lb)
+void LimiterJointFused::resetScaling(unsigned int dof)
 {
-    this->input_limiters_.push_back(lb);
-}
-void LimiterContainer::add(const LimiterJointBase* lb)
-{
-    this->output_limiters_.push_back(lb);
+    this->scaling_.position_factor = 1.0;
+    this->scaling_.velocity_factor = 1.0;
+    this->scaling_.position_joint = -1;
+    this->scaling_.velocity_joint = -1;
+    this->scaling_.violating_joint = -1;
+    this->scaling_.joint_factors.assign(dof, 1.0);
 }
+/* END LimiterJointFused ****************************************************************************************/
 
+/* BEGIN LimiterContainer ***************************************************************************************/
 /**
- * Destruction of the whole container
+ * This implementation calls enforce limits on all registered Limiters in the respective limiters vector.
  */
-LimiterContainer::~LimiterContainer()
+KDL::Twist LimiterContainer::enforceLimits(const KDL::Twist& v_in) const
 {
-    this->eraseAll();
+    // If nothing to do just return v_in.
+    KDL::Twist v_out(v_in);
+    for (input_LimIter_t it = this->input_limiters_.begin(); it != this->input_limiters_.end(); it++)
+    {
+        v_out = (*it)->enforceLimits(v_out);
+    }
+
+    return v_out;
+}
+void LimiterContainer::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q, KDL::JntArray& q_dot_out)
+{
+    this->fused_limiter_.enforceLimits(q_dot_ik, q, q_dot_out);
+    for (output_LimIter_t it = this->output_limiters_.begin(); it != this->output_limiters_.end(); it++)
+    {
+        q_dot_out = (*it)->enforceLimits(q_dot_out, q);
+    }
 }
-/* END LimiterContainer *****************************************************************************************/
 
-/* BEGIN LimiterAllJointPositions *******************************************************************************/
 /**
- * Checks the positions of the joints whether they are in limits_tolerance or not. If not the corresponding velocities vector is scaled.
- * This function multiplies the velocities that result from the IK with a limits-dependent factor in case the joint positions violate the specified limits_tolerance.
- * The factor is calculated by using the cosine function to provide a smooth transition from 1 to zero.
- * Factor is applied on all joint velocities (although only one joint has exceeded its limits), so that the direction of the desired twist is not changed.
- * -> Important for the Use-Case to follow a trajectory exactly!
+ * Building the limiters vector according the the chosen parameters.
+ * The joint limits are enforced by the fused joint limiter, i.e. only the Cartesian limiters are added here.
  */
-KDL::JntArray LimiterAllJointPositions::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
+void LimiterContainer::init()
 {
-    KDL::JntArray q_dot_norm(q_dot_ik);
-    double tolerance = limiter_params_.limits_tolerance / 180.0 * M_PI;
-    double max_factor = 1.0;
-    int joint_index = -1;
+    this->eraseAll();
 
-    for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
+    if (limiter_params_.enforce_input_limits)
     {
-        if ((limiter_params_.limits_max[i] - LIMIT_SAFETY_THRESHOLD <= q(i) && q_dot_ik(i) > 0) ||
-           (limiter_params_.limits_min[i] + LIMIT_SAFETY_THRESHOLD >= q(i) && q_dot_ik(i) < 0))
-        {
-            ROS_ERROR_STREAM("Joint " << i << " violates its limits. Setting to Zero!");
-            KDL::SetToZero(q_dot_norm);
-            return q_dot_norm;
-        }
-
-        if (fabs(limiter_params_.limits_max[i] - q(i)) <= tolerance)  // Joint is close to the MAXIMUM limit
+        if (limiter_params_.keep_direction)
         {
-            if (q_dot_ik(i) > 0)  // Joint moves towards the MAX limit
-            {
-                double temp = 1.0 / pow((0.5 + 0.5 * cos(M_PI * (q(i) + tolerance - limiter_params_.limits_max[i]) / tolerance)), 5.0);
-                // double temp = tolerance / fabs(limiter_params_.limits_max[i] - q(i));
-                if (temp > max_factor)
-                {
-                    max_factor = temp;
-                    joint_index = i;
-                }
-            }
+            this->add(new LimiterAllCartesianVelocities(limiter_params_));
         }
-
-        if (fabs(q(i) - limiter_params_.limits_min[i]) <= tolerance)  // Joint is close to the MINIMUM limit
+        else
         {
-            if (q_dot_ik(i) < 0)  // Joint moves towards the MIN limit
-            {
-                double temp = 1.0 / pow(0.5 + 0.5 * cos(M_PI * (q(i) - tolerance - limiter_params_.limits_min[i]) / tolerance), 5.0);
-                // double temp = tolerance / fabs(q(i) - limiter_params_.limits_min[i]);
-                if (temp > max_factor)
-                {
-                    max_factor = temp;
-                    joint_index = i;
-                }
-            }
+            this->add(new LimiterIndividualCartesianVelocities(limiter_params_));
         }
     }
 
-    if (max_factor > 1.0)
+    if (limiter_params_.enforce_acc_limits)
     {
-        ROS_ERROR_STREAM_THROTTLE(1, "Position tolerance surpassed (by Joint " << joint_index << "): Scaling ALL VELOCITIES with factor = " << max_factor);
-        for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
-        {
-            q_dot_norm(i) = q_dot_ik(i) / max_factor;
-        }
+        ROS_WARN("Joint acceleration limits not yet implemented");
     }
-
-    return q_dot_norm;
 }
-/* END LimiterAllJointPositions *********************************************************************************/
 
-/* BEGIN LimiterAllJointVelocities ******************************************************************************/
 /**
- * Enforce limits on all joint velocities to keep direction.
- * Limits all velocities according to the limits_vel vector if necessary.
+ * Deletes all limiters and clears the vector holding them.
  */
-KDL::JntArray LimiterAllJointVelocities::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
+void LimiterContainer::eraseAll()
 {
-    KDL::JntArray q_dot_norm(q_dot_ik);
-    double max_factor = 1.0;
-    int joint_index = -1;
-
-    for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
+    for (uint32_t cnt = 0; cnt < this->input_limiters_.size(); ++cnt)
     {
-        if (max_factor < std::fabs(q_dot_ik(i) / limiter_params_.limits_vel[i]))
-        {
-            max_factor = std::fabs(q_dot_ik(i) / limiter_params_.limits_vel[i]);
-            joint_index = i;
-        }
+        delete(this->input_limiters_[cnt]);
     }
-
-    if (max_factor > 1.0)
+    for (uint32_t cnt = 0; cnt < this->output_limiters_.size(); ++cnt)
     {
-        ROS_WARN_STREAM_THROTTLE(1, "Velocity limit surpassed (by Joint " << joint_index << "): Scaling ALL VELOCITIES with factor = " << max_factor);
-        for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
-        {
-            q_dot_norm(i) = q_dot_ik(i) / max_factor;
-        }
+        delete(this->output_limiters_[cnt]);
     }
 
-    return q_dot_norm;
+    this->input_limiters_.clear();
+    this->output_limiters_.clear();
 }
-/* END LimiterAllJointVelocities ********************************************************************************/
 
-/* BEGIN LimiterAllJointAccelerations ******************************************************************************/
 /**
- * Enforce limits on all joint velocities based on acceleration limits to keep direction.
- * Limits all velocities according to the limits_acc vector if necessary.
+ * Adding new limiters to the vector.
  */
-KDL::JntArray LimiterAllJointAccelerations::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
+void LimiterContainer::add(const LimiterCartesianBase* lb)
 {
-    KDL::JntArray q_dot_norm(q_dot_ik);
-
-    ROS_WARN("LimiterAllJointAccelerations not yet implemented");
+    this->input_limiters_.push_back(lb);
+}
+void LimiterContainer::add(const LimiterJointBase* lb)
+{
+    this->output_limiters_.push_back(lb);
+}
 
-    return q_dot_norm;
+/**
+ * Destruction of the whole container
+ */
+LimiterContainer::~LimiterContainer()
+{
+    this->eraseAll();
 }
-/* END LimiterAllJointAccelerations *****************************************************************************/
+/* END LimiterContainer *****************************************************************************************/
 
 /* BEGIN LimiterAllCartesianVelocities ********************************************************************/
 /**
@@ -287,90 +342,6 @@ KDL::Twist LimiterAllCartesianVelocities::enforceLimits(const KDL::Twist& v_in)
 }
 /* END LimiterAllCartesianVelocities **********************************************************************/
 
-/* BEGIN LimiterIndividualJointPositions ************************************************************************/
-/**
- * This implementation calculates limits for the joint positions without keeping the direction.
- * Then for each corresponding joint velocity an individual factor for scaling is calculated and then used.
- */
-KDL::JntArray LimiterIndividualJointPositions::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
-{
-    KDL::JntArray q_dot_norm(q_dot_ik);
-    double tolerance = limiter_params_.limits_tolerance / 180.0 * M_PI;
-
-    for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
-    {
-        if ((limiter_params_.limits_max[i] - LIMIT_SAFETY_THRESHOLD <= q(i) && q_dot_ik(i) > 0) ||
-           (limiter_params_.limits_min[i] + LIMIT_SAFETY_THRESHOLD >= q(i) && q_dot_ik(i) < 0))
-        {
-            ROS_ERROR_STREAM("Joint " << i << " violates its limits. Setting to Zero!");
-            q_dot_norm(i) = 0.0;
-        }
-
-        double factor = 1.0;
-        if (fabs(limiter_params_.limits_max[i] - q(i)) <= tolerance)  // Joint is close to the MAXIMUM limit
-        {
-            if (q_dot_ik(i) > 0.0)  // Joint moves towards the MAX limit
-            {
-                double temp = 1.0 / pow((0.5 + 0.5 * cos(M_PI * (q(i) + tolerance - limiter_params_.limits_max[i]) / tolerance)), 5.0);
-                // double temp = tolerance / fabs(limiter_params_.limits_max[i] - q(i));
-                factor = (temp > factor) ? temp : factor;
-            }
-        }
-
-        if (fabs(q(i) - limiter_params_.limits_min[i]) <= tolerance)  // Joint is close to the MINIMUM limit
-        {
-            if (q_dot_ik(i) < 0.0)  // Joint moves towards the MIN limit
-            {
-                double temp = 1.0 / pow(0.5 + 0.5 * cos(M_PI * (q(i) - tolerance - limiter_params_.limits_min[i]) / tolerance), 5.0);
-                // double temp = tolerance / fabs(q(i) - limiter_params_.limits_min[i]);
-                factor = (temp > factor) ? temp : factor;
-            }
-        }
-        q_dot_norm(i) = q_dot_norm(i) / factor;
-    }
-
-    return q_dot_norm;
-}
-/* END LimiterIndividualJointPositions **************************************************************************/
-
-/* BEGIN LimiterIndividualJointVelocities ***********************************************************************/
-/**
- * This implementation calculates limits for the joint velocities without keeping the direction.
- * For each joint velocity in the vector an individual factor for scaling is calculated and used.
- */
-KDL::JntArray LimiterIndividualJointVelocities::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
-{
-    KDL::JntArray q_dot_norm(q_dot_ik);
-
-    for (unsigned int i = 0; i < q_dot_ik.rows(); i++)
-    {
-        double factor = 1.0;
-        if (factor < std::fabs(q_dot_ik(i) / limiter_params_.limits_vel[i]))
-        {
-            factor = std::fabs(q_dot_ik(i) / limiter_params_.limits_vel[i]);
-            q_dot_norm(i) = q_dot_ik(i) / factor;
-        }
-    }
-
-    return q_dot_norm;
-}
-/* END LimiterIndividualJointVelocities *************************************************************************/
-
-/* BEGIN LimiterIndividualJointAccelerations ********************************************************************/
-/**
- * This implementation scales velocities based on given limits for joint accelerations without keeping the direction.
- * For each joint velocity in the vector an individual factor for scaling is calculated and used.
- */
-KDL::JntArray LimiterIndividualJointAccelerations::enforceLimits(const KDL::JntArray& q_dot_ik, const KDL::JntArray& q) const
-{
-    KDL::JntArray q_dot_norm(q_dot_ik);
-
-    ROS_WARN("LimiterIndividualJointAccelerations not yet implemented");
-
-    return q_dot_norm;
-}
-/* END LimiterIndividualJointAccelerations **********************************************************************/
-
 /* BEGIN LimiterIndividualCartesianVelocities ********************************************************************/
 /**
  * This implementation implements a saturation function to the Cartesian twists.
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <sstream>
+
+#include "cob_twist_controller/pipeline_stats.h"
+
+namespace
+{
+    /// Upper bounds of the histogram buckets in [us] (the last bucket collects everything above).
+    const int64_t HISTOGRAM_BOUNDS[] = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000};
+    const uint32_t NR_OF_BUCKETS = sizeof(HISTOGRAM_BOUNDS) / sizeof(HISTOGRAM_BOUNDS[0]);
+
+    const char* STAGE_NAMES[NR_OF_STAGES] = {"reception",
+                                             "tf_transform",
+                                             "visualization",
+                                             "jacobian",
+                                             "extension",
+                                             "input_limiters",
+                                             "constraints",
+                                             "solve",
+                                             "output_limiters",
+                                             "publish"};
+
+    diagnostic_msgs::KeyValue makeKeyValue(const std::string& key, double value)
+    {
+        std::ostringstream oss;
+        oss << value;
+        diagnostic_msgs::KeyValue kv;
+        kv.key = key;
+        kv.value = oss.str();
+        return kv;
+    }
+
+    /// Nearest-rank percentile of the (partially reordered) samples in [us].
+    double percentile(std::vector<int64_t>& samples, double p)
+    {
+        size_t idx = static_cast<size_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+        std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return static_cast<double>(samples[idx]) * 1.0e-3;
+    }
+}
+
+PipelineStats::PipelineStats()
+: enabled_(false),
+  recording_(false),
+  measuring_(false),
+  last_stamp_(0),
+  dropped_(0),
+  last_dropped_(0),
+  samples_(NR_OF_STAGES)
+{
+    for (uint32_t i = 0; i < NR_OF_STAGES; ++i)
+    {
+        this->cycle_.durations[i] = -1;
+        this->samples_[i].reserve(PIPELINE_STATS_BUFFER_SIZE);
+    }
+
+    this->total_samples_.reserve(PIPELINE_STATS_BUFFER_SIZE);
+    this->end_to_end_samples_.reserve(PIPELINE_STATS_BUFFER_SIZE);
+}
+
+void PipelineStats::setEnabled(bool enabled)
+{
+    this->enabled_ = enabled;
+    this->measuring_ = enabled || this->recording_;
+}
+
+void PipelineStats::setRecording(bool recording)
+{
+    this->recording_ = recording;
+    this->measuring_ = this->enabled_ || recording;
+}
+
+const char* PipelineStats::getStageName(PipelineStages stage)
+{
+    return (stage < NR_OF_STAGES) ? STAGE_NAMES[stage] : "unknown";
+}
+
+void PipelineStats::collect(std::vector<diagnostic_msgs::DiagnosticStatus>& status)
+{
+    for (uint32_t i = 0; i < NR_OF_STAGES; ++i)
+    {
+        this->samples_[i].clear();
+    }
+
+    this->total_samples_.clear();
+    this->end_to_end_samples_.clear();
+
+    Cycle cycle;
+    while (this->buffer_.pop(cycle))
+    {
+        int64_t total = 0;
+        for (uint32_t i = 0; i < NR_OF_STAGES; ++i)
+        {
+            if (cycle.durations[i] >= 0)
+            {
+                this->samples_[i].push_back(cycle.durations[i]);
+
+                // the message age is not part of the processing time
+                if (STAGE_RECEPTION != i)
+                {
+                    total += cycle.durations[i];
+                }
+            }
+        }
+
+        this->total_samples_.push_back(total);
+
+        // stamped twists only: from the header stamp (e.g. set by the frame tracker) until the command is published
+        if (cycle.durations[STAGE_RECEPTION] >= 0)
+        {
+            this->end_to_end_samples_.push_back(cycle.durations[STAGE_RECEPTION] + total);
+        }
+    }
+
+    status.resize(NR_OF_STAGES + 2);
+    for (uint32_t i = 0; i < NR_OF_STAGES; ++i)
+    {
+        this->summarize(STAGE_NAMES[i], this->samples_[i], status[i]);
+    }
+
+    this->summarize("cycle", this->total_samples_, status[NR_OF_STAGES]);
+    this->summarize("end-to-end", this->end_to_end_samples_, status[NR_OF_STAGES + 1]);
+
+    const uint64_t dropped = this->dropped_.load(boost::memory_order_relaxed);
+    if (dropped != this->last_dropped_)
+    {
+        status[NR_OF_STAGES].level = diagnostic_msgs::DiagnosticStatus::WARN;
+        std::ostringstream oss;
+        oss << (dropped - this->last_dropped_) << " cycles dropped (buffer full)";
+        status[NR_OF_STAGES].message = oss.str();
+        this->last_dropped_ = dropped;
+    }
+}
+
+void PipelineStats::summarize(const std::string& name, std::vector<int64_t>& samples, diagnostic_msgs::DiagnosticStatus& status) const
+{
+    status.name = "twist_controller pipeline: " + name;
+    status.hardware_id = "";
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.values.clear();
+
+    if (samples.empty())
+    {
+        status.message = "no samples";
+        return;
+    }
+
+    int64_t sum = 0;
+    int64_t max = samples[0];
+    std::vector<uint32_t> histogram(NR_OF_BUCKETS + 1, 0);
+    for (std::vector<int64_t>::const_iterator it = samples.begin(); it != samples.end(); ++it)
+    {
+        sum += *it;
+        max = std::max(max, *it);
+        histogram[std::upper_bound(HISTOGRAM_BOUNDS, HISTOGRAM_BOUNDS + NR_OF_BUCKETS, *it / 1000) - HISTOGRAM_BOUNDS]++;
+    }
+
+    std::ostringstream oss;
+    oss << samples.size() << " samples";
+    status.message = oss.str();
+
+    status.values.push_back(makeKeyValue("count", samples.size()));
+    status.values.push_back(makeKeyValue("mean [us]", static_cast<double>(sum) * 1.0e-3 / static_cast<double>(samples.size())));
+    status.values.push_back(makeKeyValue("p50 [us]", percentile(samples, 0.5)));
+    status.values.push_back(makeKeyValue("p90 [us]", percentile(samples, 0.9)));
+    status.values.push_back(makeKeyValue("p99 [us]", percentile(samples, 0.99)));
+    status.values.push_back(makeKeyValue("max [us]", static_cast<double>(max) * 1.0e-3));
+
+    for (uint32_t i = 0; i <= NR_OF_BUCKETS; ++i)
+    {
+        std::ostringstream key;
+        if (i < NR_OF_BUCKETS)
+        {
+            key << "< " << HISTOGRAM_BOUNDS[i] << " us";
+        }
+        else
+        {
+            key << ">= " << HISTOGRAM_BOUNDS[NR_OF_BUCKETS - 1] << " us";
+        }
+
+        status.values.push_back(makeKeyValue(key.str(), histogram[i]));
+    }
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Converts a dump of the FlightRecorder into CSV (one line per cycle, oldest first).
+ * Durations are given in [us]; empty fields denote values that have not been recorded in a cycle.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "cob_twist_controller/flight_recorder.h"
+#include "cob_twist_controller/pipeline_stats.h"
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: flight_recorder_decoder <dump> [<csv>]" << std::endl
+                  << "  Writes the CSV to <csv> (default: standard output)." << std::endl;
+    }
+
+    void writeStamp(std::ostream& out, int64_t stamp)
+    {
+        out << stamp / 1000000000LL << "." << std::setw(9) << std::setfill('0') << stamp % 1000000000LL << std::setfill(' ');
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        printUsage();
+        return 1;
+    }
+
+    FlightRecorderDumpHeader header;
+    std::vector<std::string> joint_names;
+    std::vector<FlightRecord> records;
+    if (!FlightRecorder::readDump(argv[1], header, joint_names, records))
+    {
+        std::cerr << "Failed to read " << argv[1] << " (no dump or written by an incompatible version)" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (3 == argc)
+    {
+        file.open(argv[2]);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = (3 == argc) ? file : std::cout;
+
+    const uint32_t nr_of_joints = std::min<uint32_t>(joint_names.size(), FLIGHT_RECORDER_MAX_JOINTS);
+    uint32_t nr_of_constraints = 0;
+    for (std::vector<FlightRecord>::const_iterator it = records.begin(); it != records.end(); ++it)
+    {
+        nr_of_constraints = std::max(nr_of_constraints, std::min<uint32_t>(it->nr_of_constraints, FLIGHT_RECORDER_MAX_CONSTRAINTS));
+    }
+
+    std::cerr << records.size() << " cycles, triggers " << header.triggers << ", " << header.dropped << " dropped" << std::endl;
+
+    /// header line
+    const char* TWIST_NAMES[6] = {"vx", "vy", "vz", "wx", "wy", "wz"};
+    out << "stamp,cycle,result,triggers";
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        out << ",twist_" << TWIST_NAMES[i];
+    }
+    for (uint32_t j = 0; j < nr_of_joints; ++j)
+    {
+        out << ",q_" << joint_names[j];
+    }
+    for (uint32_t j = 0; j < nr_of_joints; ++j)
+    {
+        out << ",q_dot_" << joint_names[j];
+    }
+    for (uint32_t j = 0; j < nr_of_joints; ++j)
+    {
+        out << ",q_dot_out_" << joint_names[j];
+    }
+    out << ",damping";
+    for (uint32_t i = 0; i < FLIGHT_RECORDER_MAX_SINGULAR_VALUES; ++i)
+    {
+        out << ",singular_value_" << i;
+    }
+    for (uint32_t i = 0; i < nr_of_constraints; ++i)
+    {
+        out << ",constraint_" << i << "_state,constraint_" << i << "_gain";
+    }
+    out << ",position_factor,velocity_factor,violating_joint";
+    for (uint32_t s = 0; s < NR_OF_STAGES; ++s)
+    {
+        out << "," << PipelineStats::getStageName(static_cast<PipelineStages>(s)) << "_us";
+    }
+    out << std::endl;
+
+    /// one line per cycle
+    out << std::setprecision(9);
+    for (std::vector<FlightRecord>::const_iterator it = records.begin(); it != records.end(); ++it)
+    {
+        writeStamp(out, it->stamp);
+        out << "," << it->cycle << "," << it->result << "," << it->triggers;
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            out << "," << it->twist[i];
+        }
+
+        const double* joint_values[3] = {it->q, it->q_dot, it->q_dot_out};
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            for (uint32_t j = 0; j < nr_of_joints; ++j)
+            {
+                out << ",";
+                if (j < it->nr_of_joints)
+                {
+                    out << joint_values[k][j];
+                }
+            }
+        }
+
+        out << "," << it->damping;
+        for (uint32_t i = 0; i < FLIGHT_RECORDER_MAX_SINGULAR_VALUES; ++i)
+        {
+            out << ",";
+            if (i < it->nr_of_singular_values)
+            {
+                out << it->singular_values[i];
+            }
+        }
+
+        for (uint32_t i = 0; i < nr_of_constraints; ++i)
+        {
+            out << ",";
+            if (i < it->nr_of_constraints)
+            {
+                out << static_cast<int>(it->constraint_states[i]) << "," << it->constraint_gains[i];
+            }
+            else
+            {
+                out << ",";
+            }
+        }
+
+        out << "," << it->position_factor << "," << it->velocity_factor << "," << it->violating_joint;
+        for (uint32_t s = 0; s < NR_OF_STAGES; ++s)
+        {
+            out << ",";
+            if (it->stage_durations[s] >= 0)
+            {
+                out << static_cast<double>(it->stage_durations[s]) * 1.0e-3;
+            }
+        }
+        out << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,632 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstring>
+#include <vector>
+
+#include <ros/ros.h>
+#include <dynamic_reconfigure/Config.h>
+
+#include "cob_twist_controller/replay/twist_controller_log.h"
+
+namespace
+{
+    const char LOG_MAGIC[] = "TCLOG";
+    const uint32_t LOG_MAGIC_SIZE = 5;
+
+    /// Appends values to a record payload.
+    class Encoder
+    {
+        public:
+            explicit Encoder(std::string& buffer)
+            : buffer_(buffer)
+            {
+                this->buffer_.clear();
+            }
+
+            template <typename T>
+            void put(const T& value)
+            {
+                this->buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+            }
+
+            void putString(const std::string& value)
+            {
+                this->put<uint32_t>(value.size());
+                this->buffer_.append(value);
+            }
+
+            void putTime(const ros::Time& value)
+            {
+                this->put<uint32_t>(value.sec);
+                this->put<uint32_t>(value.nsec);
+            }
+
+            void putVector(const std::vector<double>& value)
+            {
+                this->put<uint32_t>(value.size());
+                for (uint32_t i = 0; i < value.size(); ++i)
+                {
+                    this->put<double>(value[i]);
+                }
+            }
+
+            void putStrings(const std::vector<std::string>& value)
+            {
+                this->put<uint32_t>(value.size());
+                for (uint32_t i = 0; i < value.size(); ++i)
+                {
+                    this->putString(value[i]);
+                }
+            }
+
+            void putJntArray(const KDL::JntArray& value)
+            {
+                this->put<uint32_t>(value.rows());
+                for (uint32_t i = 0; i < value.rows(); ++i)
+                {
+                    this->put<double>(value(i));
+                }
+            }
+
+            void putVector3(const geometry_msgs::Vector3& value)
+            {
+                this->put<double>(value.x);
+                this->put<double>(value.y);
+                this->put<double>(value.z);
+            }
+
+        private:
+            std::string& buffer_;
+    };
+
+    /// Reads values from a record payload; any read beyond the payload invalidates the decoder.
+    class Decoder
+    {
+        public:
+            explicit Decoder(const std::string& buffer)
+            : buffer_(buffer),
+              pos_(0),
+              valid_(true)
+            {}
+
+            inline bool isValid() const
+            {
+                return this->valid_;
+            }
+
+            template <typename T>
+            T get()
+            {
+                T value = T();
+                if (this->valid_ && this->pos_ + sizeof(T) <= this->buffer_.size())
+                {
+                    std::memcpy(&value, this->buffer_.data() + this->pos_, sizeof(T));
+                    this->pos_ += sizeof(T);
+                }
+                else
+                {
+                    this->valid_ = false;
+                }
+
+                return value;
+            }
+
+            std::string getString()
+            {
+                const uint32_t size = this->get<uint32_t>();
+                if (!this->valid_ || this->pos_ + size > this->buffer_.size())
+                {
+                    this->valid_ = false;
+                    return std::string();
+                }
+
+                std::string value = this->buffer_.substr(this->pos_, size);
+                this->pos_ += size;
+                return value;
+            }
+
+            ros::Time getTime()
+            {
+                const uint32_t sec = this->get<uint32_t>();
+                const uint32_t nsec = this->get<uint32_t>();
+                return ros::Time(sec, nsec);
+            }
+
+            void getVector(std::vector<double>& value)
+            {
+                const uint32_t size = this->get<uint32_t>();
+                value.clear();
+                for (uint32_t i = 0; i < size && this->valid_; ++i)
+                {
+                    value.push_back(this->get<double>());
+                }
+            }
+
+            void getStrings(std::vector<std::string>& value)
+            {
+                const uint32_t size = this->get<uint32_t>();
+                value.clear();
+                for (uint32_t i = 0; i < size && this->valid_; ++i)
+                {
+                    value.push_back(this->getString());
+                }
+            }
+
+            void getJntArray(KDL::JntArray& value)
+            {
+                const uint32_t size = this->get<uint32_t>();
+                if (!this->valid_ || this->pos_ + size * sizeof(double) > this->buffer_.size())
+                {
+                    this->valid_ = false;
+                    return;
+                }
+
+                value.resize(size);
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    value(i) = this->get<double>();
+                }
+            }
+
+            void getVector3(geometry_msgs::Vector3& value)
+            {
+                value.x = this->get<double>();
+                value.y = this->get<double>();
+                value.z = this->get<double>();
+            }
+
+        private:
+            const std::string& buffer_;
+            size_t pos_;
+            bool valid_;
+    };
+}
+
+/* BEGIN TwistControllerLogWriter *******************************************************************************************/
+bool TwistControllerLogWriter::open(const std::string& file_name, const std::string& robot_description, const TwistControllerParams& params)
+{
+    this->close();
+    if (this->buffers_.empty())
+    {
+        this->buffers_.resize(TWIST_CONTROLLER_LOG_QUEUE_SIZE);
+        this->types_.resize(TWIST_CONTROLLER_LOG_QUEUE_SIZE, 0);
+        for (uint32_t i = 0; i < TWIST_CONTROLLER_LOG_QUEUE_SIZE; ++i)
+        {
+            this->buffers_[i].reserve(TWIST_CONTROLLER_LOG_RECORD_RESERVE);
+            this->free_.push(i);
+        }
+    }
+
+    this->file_.open(file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!this->file_.is_open())
+    {
+        ROS_ERROR_STREAM("Failed to open twist controller log " << file_name);
+        return false;
+    }
+
+    const uint32_t version = TWIST_CONTROLLER_LOG_VERSION;
+    this->file_.write(LOG_MAGIC, LOG_MAGIC_SIZE);
+    this->file_.write(reinterpret_cast<const char*>(&version), sizeof(version));
+
+    Encoder enc(this->setup_buffer_);
+    enc.putString(robot_description);
+    enc.putString(params.chain_base_link);
+    enc.putString(params.chain_tip_link);
+    enc.putStrings(params.joints);
+    enc.putStrings(params.collision_check_links);
+    enc.putString(params.controller_interface);
+    enc.put<double>(params.integrator_smoothing);
+    enc.putVector(params.limiter_params.limits_min);
+    enc.putVector(params.limiter_params.limits_max);
+    enc.putVector(params.limiter_params.limits_vel);
+    enc.putVector(params.limiter_params.limits_acc);
+    enc.putString(params.lookat_pointing_frame);
+    enc.put<int32_t>(params.lookat_offset.lookat_axis_type);
+    enc.put<double>(params.lookat_offset.translation_x);
+    enc.put<double>(params.lookat_offset.translation_y);
+    enc.put<double>(params.lookat_offset.translation_z);
+    enc.put<double>(params.lookat_offset.rotation_x);
+    enc.put<double>(params.lookat_offset.rotation_y);
+    enc.put<double>(params.lookat_offset.rotation_z);
+    enc.put<double>(params.lookat_offset.rotation_w);
+    this->writeRecord(RECORD_SETUP, this->setup_buffer_);
+    if (!this->file_.good())
+    {
+        this->file_.close();
+        return false;
+    }
+
+    this->dropped_ = 0;
+    this->running_ = true;
+    this->thread_ = boost::thread(&TwistControllerLogWriter::run, this);
+    this->open_.store(true, boost::memory_order_release);
+    return true;
+}
+
+void TwistControllerLogWriter::close()
+{
+    if (!this->open_.exchange(false, boost::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    this->running_ = false;
+    if (this->thread_.joinable())
+    {
+        this->thread_.join();
+    }
+
+    this->file_.close();
+    const uint64_t dropped = this->dropped_.load();
+    if (dropped > 0)
+    {
+        ROS_WARN_STREAM("Twist controller log: " << dropped << " records have been dropped (writer thread too slow)");
+    }
+}
+
+/**
+ * The parameters are stored by name (as dynamic_reconfigure message), such that logs stay readable if parameters are added.
+ */
+void TwistControllerLogWriter::writeParams(const ros::Time& stamp, const cob_twist_controller::TwistControllerConfig& config)
+{
+    uint32_t idx;
+    if (!this->acquire(idx))
+    {
+        return;
+    }
+
+    dynamic_reconfigure::Config msg;
+    config.__toMessage__(msg);
+
+    Encoder enc(this->buffers_[idx]);
+    enc.putTime(stamp);
+    enc.put<uint32_t>(msg.bools.size());
+    for (uint32_t i = 0; i < msg.bools.size(); ++i)
+    {
+        enc.putString(msg.bools[i].name);
+        enc.put<uint8_t>(msg.bools[i].value ? 1 : 0);
+    }
+
+    enc.put<uint32_t>(msg.ints.size());
+    for (uint32_t i = 0; i < msg.ints.size(); ++i)
+    {
+        enc.putString(msg.ints[i].name);
+        enc.put<int32_t>(msg.ints[i].value);
+    }
+
+    enc.put<uint32_t>(msg.strs.size());
+    for (uint32_t i = 0; i < msg.strs.size(); ++i)
+    {
+        enc.putString(msg.strs[i].name);
+        enc.putString(msg.strs[i].value);
+    }
+
+    enc.put<uint32_t>(msg.doubles.size());
+    for (uint32_t i = 0; i < msg.doubles.size(); ++i)
+    {
+        enc.putString(msg.doubles[i].name);
+        enc.put<double>(msg.doubles[i].value);
+    }
+
+    this->commit(RECORD_PARAMS, idx);
+}
+
+void TwistControllerLogWriter::writeObstacleDistances(const ros::Time& stamp, const cob_control_msgs::ObstacleDistances& msg)
+{
+    uint32_t idx;
+    if (!this->acquire(idx))
+    {
+        return;
+    }
+
+    Encoder enc(this->buffers_[idx]);
+    enc.putTime(stamp);
+    enc.put<uint32_t>(msg.distances.size());
+    for (uint32_t i = 0; i < msg.distances.size(); ++i)
+    {
+        const cob_control_msgs::ObstacleDistance& d = msg.distances[i];
+        enc.putString(d.header.frame_id);
+        enc.putString(d.link_of_interest);
+        enc.putString(d.obstacle_id);
+        enc.put<double>(d.distance);
+        enc.putVector3(d.frame_vector);
+        enc.putVector3(d.nearest_point_frame_vector);
+        enc.putVector3(d.nearest_point_obstacle_vector);
+    }
+
+    this->commit(RECORD_OBSTACLES, idx);
+}
+
+void TwistControllerLogWriter::writeCycle(const ros::Time& stamp, const JointStates& joint_states, const KDL::Twist& twist,
+                                          int32_t result, const KDL::JntArray& q_dot)
+{
+    uint32_t idx;
+    if (!this->acquire(idx))
+    {
+        return;
+    }
+
+    Encoder enc(this->buffers_[idx]);
+    enc.putTime(stamp);
+    enc.putJntArray(joint_states.current_q_);
+    enc.putJntArray(joint_states.last_q_);
+    enc.putJntArray(joint_states.current_q_dot_);
+    enc.putJntArray(joint_states.last_q_dot_);
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        enc.put<double>(twist(i));
+    }
+
+    enc.put<int32_t>(result);
+    enc.putJntArray(q_dot);
+    this->commit(RECORD_CYCLE, idx);
+}
+
+bool TwistControllerLogWriter::acquire(uint32_t& idx)
+{
+    if (!this->open_.load(boost::memory_order_acquire))
+    {
+        return false;
+    }
+
+    while (!this->free_.pop(idx))
+    {
+        if (!this->wait_for_buffers_)
+        {
+            this->dropped_.fetch_add(1, boost::memory_order_relaxed);
+            return false;
+        }
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    return true;
+}
+
+void TwistControllerLogWriter::commit(uint8_t type, uint32_t idx)
+{
+    this->types_[idx] = type;
+    this->queued_.push(idx);  // cannot fail: at most TWIST_CONTROLLER_LOG_QUEUE_SIZE buffers exist
+}
+
+void TwistControllerLogWriter::run()
+{
+    while (this->running_)
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(static_cast<int64_t>(TWIST_CONTROLLER_LOG_POLL_PERIOD * 1000.0)));
+        this->writeQueued();
+    }
+
+    this->writeQueued();
+}
+
+/// Writes the queued records in the order of their commits and returns their buffers.
+void TwistControllerLogWriter::writeQueued()
+{
+    uint32_t idx;
+    while (this->queued_.pop(idx))
+    {
+        this->writeRecord(this->types_[idx], this->buffers_[idx]);
+        this->free_.push(idx);
+    }
+}
+
+void TwistControllerLogWriter::writeRecord(uint8_t type, const std::string& payload)
+{
+    if (!this->file_.is_open())
+    {
+        return;
+    }
+
+    const uint32_t size = payload.size();
+    this->file_.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    this->file_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    this->file_.write(payload.data(), size);
+}
+/* END TwistControllerLogWriter *********************************************************************************************/
+
+
+/* BEGIN TwistControllerLogReader *******************************************************************************************/
+bool TwistControllerLogReader::open(const std::string& file_name, std::string& robot_description, TwistControllerParams& params)
+{
+    this->file_.open(file_name.c_str(), std::ios::in | std::ios::binary);
+    if (!this->file_.is_open())
+    {
+        ROS_ERROR_STREAM("Failed to open twist controller log " << file_name);
+        return false;
+    }
+
+    char magic[LOG_MAGIC_SIZE];
+    uint32_t version = 0;
+    this->file_.read(magic, LOG_MAGIC_SIZE);
+    this->file_.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!this->file_.good() || 0 != std::memcmp(magic, LOG_MAGIC, LOG_MAGIC_SIZE))
+    {
+        ROS_ERROR_STREAM(file_name << " is not a twist controller log");
+        return false;
+    }
+
+    if (TWIST_CONTROLLER_LOG_VERSION != version)
+    {
+        ROS_ERROR_STREAM("Unsupported twist controller log version " << version << " (expected " << TWIST_CONTROLLER_LOG_VERSION << ")");
+        return false;
+    }
+
+    uint8_t type = 0;
+    if (!this->readRecord(type) || RECORD_SETUP != type)
+    {
+        ROS_ERROR_STREAM("Setup record missing in " << file_name);
+        return false;
+    }
+
+    Decoder dec(this->buffer_);
+    robot_description = dec.getString();
+    params.chain_base_link = dec.getString();
+    params.chain_tip_link = dec.getString();
+    dec.getStrings(params.joints);
+    params.dof = params.joints.size();
+    dec.getStrings(params.collision_check_links);
+    params.controller_interface = dec.getString();
+    params.integrator_smoothing = dec.get<double>();
+    dec.getVector(params.limiter_params.limits_min);
+    dec.getVector(params.limiter_params.limits_max);
+    dec.getVector(params.limiter_params.limits_vel);
+    dec.getVector(params.limiter_params.limits_acc);
+    params.lookat_pointing_frame = dec.getString();
+    params.lookat_offset.lookat_axis_type = static_cast<LookatAxisTypes>(dec.get<int32_t>());
+    params.lookat_offset.translation_x = dec.get<double>();
+    params.lookat_offset.translation_y = dec.get<double>();
+    params.lookat_offset.translation_z = dec.get<double>();
+    params.lookat_offset.rotation_x = dec.get<double>();
+    params.lookat_offset.rotation_y = dec.get<double>();
+    params.lookat_offset.rotation_z = dec.get<double>();
+    params.lookat_offset.rotation_w = dec.get<double>();
+
+    if (!dec.isValid())
+    {
+        ROS_ERROR_STREAM("Corrupted setup record in " << file_name);
+        return false;
+    }
+
+    return true;
+}
+
+bool TwistControllerLogReader::read(TwistControllerLogRecord& record)
+{
+    if (!this->readRecord(record.type))
+    {
+        return false;
+    }
+
+    Decoder dec(this->buffer_);
+    record.stamp = dec.getTime();
+    switch (record.type)
+    {
+        case RECORD_PARAMS:
+        {
+            dynamic_reconfigure::Config msg;
+            uint32_t size = dec.get<uint32_t>();
+            for (uint32_t i = 0; i < size && dec.isValid(); ++i)
+            {
+                dynamic_reconfigure::BoolParameter p;
+                p.name = dec.getString();
+                p.value = (0 != dec.get<uint8_t>());
+                msg.bools.push_back(p);
+            }
+
+            size = dec.get<uint32_t>();
+            for (uint32_t i = 0; i < size && dec.isValid(); ++i)
+            {
+                dynamic_reconfigure::IntParameter p;
+                p.name = dec.getString();
+                p.value = dec.get<int32_t>();
+                msg.ints.push_back(p);
+            }
+
+            size = dec.get<uint32_t>();
+            for (uint32_t i = 0; i < size && dec.isValid(); ++i)
+            {
+                dynamic_reconfigure::StrParameter p;
+                p.name = dec.getString();
+                p.value = dec.getString();
+                msg.strs.push_back(p);
+            }
+
+            size = dec.get<uint32_t>();
+            for (uint32_t i = 0; i < size && dec.isValid(); ++i)
+            {
+                dynamic_reconfigure::DoubleParameter p;
+                p.name = dec.getString();
+                p.value = dec.get<double>();
+                msg.doubles.push_back(p);
+            }
+
+            // parameters unknown to the log (e.g. added later) keep their default values
+            record.config = cob_twist_controller::TwistControllerConfig::__getDefault__();
+            record.config.__fromMessage__(msg);
+            break;
+        }
+        case RECORD_OBSTACLES:
+        {
+            record.obstacle_distances.reset(new cob_control_msgs::ObstacleDistances());
+            const uint32_t size = dec.get<uint32_t>();
+            for (uint32_t i = 0; i < size && dec.isValid(); ++i)
+            {
+                cob_control_msgs::ObstacleDistance d;
+                d.header.stamp = record.stamp;
+                d.header.frame_id = dec.getString();
+                d.link_of_interest = dec.getString();
+                d.obstacle_id = dec.getString();
+                d.distance = dec.get<double>();
+                dec.getVector3(d.frame_vector);
+                dec.getVector3(d.nearest_point_frame_vector);
+                dec.getVector3(d.nearest_point_obstacle_vector);
+                record.obstacle_distances->distances.push_back(d);
+            }
+
+            break;
+        }
+        case RECORD_CYCLE:
+        {
+            record.cycle.stamp = record.stamp;
+            dec.getJntArray(record.cycle.joint_states.current_q_);
+            dec.getJntArray(record.cycle.joint_states.last_q_);
+            dec.getJntArray(record.cycle.joint_states.current_q_dot_);
+            dec.getJntArray(record.cycle.joint_states.last_q_dot_);
+            for (uint32_t i = 0; i < 6; ++i)
+            {
+                record.cycle.twist(i) = dec.get<double>();
+            }
+
+            record.cycle.result = dec.get<int32_t>();
+            dec.getJntArray(record.cycle.q_dot);
+            break;
+        }
+        default:
+            ROS_WARN_STREAM("Skipping unknown record type " << static_cast<int>(record.type));
+            break;
+    }
+
+    if (!dec.isValid())
+    {
+        ROS_ERROR("Corrupted record in twist controller log");
+        return false;
+    }
+
+    return true;
+}
+
+bool TwistControllerLogReader::readRecord(uint8_t& type)
+{
+    uint32_t size = 0;
+    this->file_.read(reinterpret_cast<char*>(&type), sizeof(type));
+    this->file_.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!this->file_.good())
+    {
+        return false;
+    }
+
+    this->buffer_.resize(size);
+    if (size > 0)
+    {
+        this->file_.read(&this->buffer_[0], size);
+    }
+
+    return this->file_.good();
+}
+/* END TwistControllerLogReader *********************************************************************************************/
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Offline replay of a twist controller log (see TwistControllerLogWriter) through InverseDifferentialKinematicsSolver::CartToJnt.
+ * Runs without a ROS master as fast as possible: ros::Time is simulated with the recorded stamps, such that all
+ * cycle time dependent calculations are deterministic.
+ * Reports throughput, the latency distribution of CartToJnt, the work of the KinematicsCache and the deviation of the
+ * joint velocities from a reference (the outputs recorded in the log or those of another replay written with --output).
+ * With --solver, the recorded cycles are replayed through another solver, e.g. to check that it fits into the cycle time.
+ * With --no-kinematics-cache, each consumer of the kinematics runs its own recursive pass (as without the KinematicsCache),
+ * such that two replays of the same log compare the passes and the latency with and without the cache.
+ */
+
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <ros/ros.h>
+#include <kdl/tree.hpp>
+#include <kdl_parser/kdl_parser.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "cob_twist_controller/replay/twist_controller_log.h"
+#include "cob_twist_controller/inverse_differential_kinematics_solver.h"
+#include "cob_twist_controller/callback_data_mediator.h"
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: twist_controller_replay <log> [options]" << std::endl
+                  << "  --reference <log>   compare the outputs with another log (default: outputs recorded in <log>)" << std::endl
+                  << "  --output <log>      write a log with the replayed outputs (to be used as reference)" << std::endl
+                  << "  --tolerance <value> max. allowed deviation of the joint velocities [rad/s] (default: 1e-9)" << std::endl
+                  << "  --solver <id>       replay with another solver (see SolverTypes, e.g. 7: MPC)" << std::endl
+                  << "  --no-kinematics-cache  recompute the kinematics for each request (for comparison)" << std::endl;
+    }
+
+    int64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    double percentile(std::vector<int64_t>& samples, double p)
+    {
+        size_t idx = static_cast<size_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+        std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return static_cast<double>(samples[idx]) * 1.0e-3;
+    }
+
+    bool readReference(const std::string& file_name, std::vector<TwistControllerLogCycle>& cycles)
+    {
+        TwistControllerLogReader reader;
+        std::string robot_description;
+        TwistControllerParams params;
+        if (!reader.open(file_name, robot_description, params))
+        {
+            return false;
+        }
+
+        TwistControllerLogRecord record;
+        while (reader.read(record))
+        {
+            if (RECORD_CYCLE == record.type)
+            {
+                cycles.push_back(record.cycle);
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string log_file, reference_file, output_file;
+    double tolerance = 1.0e-9;
+    int solver_type = -1;
+    bool kinematics_caching = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        if ("--reference" == arg && i + 1 < argc)
+        {
+            reference_file = argv[++i];
+        }
+        else if ("--output" == arg && i + 1 < argc)
+        {
+            output_file = argv[++i];
+        }
+        else if ("--tolerance" == arg && i + 1 < argc)
+        {
+            tolerance = std::atof(argv[++i]);
+        }
+        else if ("--solver" == arg && i + 1 < argc)
+        {
+            solver_type = std::atoi(argv[++i]);
+        }
+        else if ("--no-kinematics-cache" == arg)
+        {
+            kinematics_caching = false;
+        }
+        else if (log_file.empty() && 0 != arg.compare(0, 2, "--"))
+        {
+            log_file = arg;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (log_file.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    /// no ROS master required: time is simulated by means of the recorded stamps
+    ros::Time::init();
+
+    TwistControllerParams params;
+    std::string robot_description;
+    TwistControllerLogReader reader;
+    if (!reader.open(log_file, robot_description, params))
+    {
+        return 1;
+    }
+
+    /// load the complete log in advance, such that file access does not distort the measurement
+    std::vector<TwistControllerLogRecord> records;
+    TwistControllerLogRecord record;
+    while (reader.read(record))
+    {
+        records.push_back(record);
+    }
+
+    std::vector<TwistControllerLogCycle> reference;
+    if (reference_file.empty())
+    {
+        for (uint32_t i = 0; i < records.size(); ++i)
+        {
+            if (RECORD_CYCLE == records[i].type)
+            {
+                reference.push_back(records[i].cycle);
+            }
+        }
+    }
+    else if (!readReference(reference_file, reference))
+    {
+        return 1;
+    }
+
+    KDL::Tree tree;
+    KDL::Chain chain;
+    if (!kdl_parser::treeFromString(robot_description, tree) ||
+        !tree.getChain(params.chain_base_link, params.chain_tip_link, chain) ||
+        chain.getNrOfJoints() == 0)
+    {
+        std::cerr << "Failed to initialize kinematic chain from " << params.chain_base_link << " to " << params.chain_tip_link << std::endl;
+        return 1;
+    }
+
+    params.frame_names.clear();
+    for (uint16_t i = 0; i < chain.getNrOfSegments(); ++i)
+    {
+        params.frame_names.push_back(chain.getSegment(i).getName());
+    }
+
+    TwistControllerLogWriter writer(true);
+    if (!output_file.empty() && !writer.open(output_file, robot_description, params))
+    {
+        return 1;
+    }
+
+    CallbackDataMediator data_mediator;
+    boost::shared_ptr<InverseDifferentialKinematicsSolver> solver;
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(reference.size());
+    uint32_t cycle_idx = 0;
+    uint32_t skipped = 0;
+    uint32_t compared = 0;
+    uint32_t result_mismatches = 0;
+    uint32_t above_tolerance = 0;
+    double max_delta = 0.0;
+    double sum_sq_delta = 0.0;
+    uint32_t delta_cnt = 0;
+
+    const int64_t start = now();
+    for (std::vector<TwistControllerLogRecord>::iterator it = records.begin(); it != records.end(); ++it)
+    {
+        ros::Time::setNow(it->stamp);
+        switch (it->type)
+        {
+            case RECORD_PARAMS:
+            {
+                if (solver_type >= 0)
+                {
+                    it->config.solver = solver_type;
+                }
+
+                params.from_config(it->config);
+                if (NO_EXTENSION != params.kinematic_extension && BASE_COMPENSATION != params.kinematic_extension)
+                {
+                    std::cerr << "KinematicExtension " << params.kinematic_extension << " requires a running robot and cannot be replayed offline" << std::endl;
+                    return 1;
+                }
+
+                if (!solver)
+                {
+                    solver.reset(new InverseDifferentialKinematicsSolver(params, chain, data_mediator));
+                    solver->setKinematicsCaching(kinematics_caching);
+                    solver->resetAll(params);
+                }
+                else if (!solver->reconfigure(params))
+                {
+                    std::cerr << "Reconfiguration failed at " << it->stamp.toSec() << " s, resetting the solver" << std::endl;
+                    solver->resetAll(params);
+                }
+
+                writer.writeParams(it->stamp, it->config);
+                break;
+            }
+            case RECORD_OBSTACLES:
+            {
+                data_mediator.distancesToObstaclesCallback(it->obstacle_distances);
+                writer.writeObstacleDistances(it->stamp, *it->obstacle_distances);
+                break;
+            }
+            case RECORD_CYCLE:
+            {
+                const uint32_t idx = cycle_idx++;
+                if (!solver)
+                {
+                    ++skipped;
+                    break;
+                }
+
+                TwistControllerLogCycle cycle = it->cycle;
+                cycle.q_dot.resize(chain.getNrOfJoints());
+                KDL::SetToZero(cycle.q_dot);
+
+                const int64_t t_start = now();
+                cycle.result = solver->CartToJnt(cycle.joint_states, cycle.twist, cycle.q_dot);
+                latencies.push_back(now() - t_start);
+
+                writer.writeCycle(cycle.stamp, cycle.joint_states, cycle.twist, cycle.result, cycle.q_dot);
+
+                if (idx < reference.size() && reference[idx].q_dot.rows() == cycle.q_dot.rows())
+                {
+                    ++compared;
+                    if (reference[idx].result != cycle.result)
+                    {
+                        ++result_mismatches;
+                    }
+
+                    double cycle_delta = 0.0;
+                    for (uint32_t j = 0; j < cycle.q_dot.rows(); ++j)
+                    {
+                        const double delta = std::fabs(cycle.q_dot(j) - reference[idx].q_dot(j));
+                        cycle_delta = std::max(cycle_delta, delta);
+                        sum_sq_delta += delta * delta;
+                        ++delta_cnt;
+                    }
+
+                    max_delta = std::max(max_delta, cycle_delta);
+                    if (cycle_delta > tolerance)
+                    {
+                        ++above_tolerance;
+                    }
+                }
+
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    const double duration = static_cast<double>(now() - start) * 1.0e-9;
+    writer.close();
+
+    if (latencies.empty())
+    {
+        std::cerr << "No cycles replayed (" << skipped << " cycles before the first parameter record)" << std::endl;
+        return 1;
+    }
+
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < latencies.size(); ++i)
+    {
+        sum += latencies[i];
+    }
+
+    const double max_latency = static_cast<double>(*std::max_element(latencies.begin(), latencies.end())) * 1.0e-3;
+    std::cout << std::fixed << std::setprecision(3)
+              << "Replayed " << latencies.size() << " cycles (" << skipped << " skipped) in " << duration << " s: "
+              << latencies.size() / duration << " cycles/s" << std::endl
+              << "CartToJnt latency [us]: mean " << static_cast<double>(sum) * 1.0e-3 / latencies.size()
+              << ", p50 " << percentile(latencies, 0.5)
+              << ", p90 " << percentile(latencies, 0.9)
+              << ", p99 " << percentile(latencies, 0.99)
+              << ", max " << max_latency << std::endl;
+
+    /// a cycle should take a single recursive pass, further ones indicate consumers not sharing the kinematics
+    const KinematicsCache* caches[] = {&solver->getKinematicsCache(), &solver->getPredictionCache()};
+    const char* cache_names[] = {"Kinematics cache", "Prediction cache"};
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        std::cout << cache_names[i] << (kinematics_caching ? "" : " (disabled)") << ": " << caches[i]->getNrOfUpdates() << " updates, "
+                  << caches[i]->getNrOfPasses() << " recursive passes ("
+                  << static_cast<double>(caches[i]->getNrOfPasses()) / latencies.size() << " per cycle), "
+                  << caches[i]->getNrOfJacobians() << " segment Jacobians ("
+                  << static_cast<double>(caches[i]->getNrOfJacobians()) / latencies.size() << " per cycle)" << std::endl;
+    }
+
+    if (compared != latencies.size())
+    {
+        std::cout << "Reference covers " << compared << " of " << latencies.size() << " cycles" << std::endl;
+    }
+
+    std::cout << std::scientific << std::setprecision(3)
+              << "Deviation from " << (reference_file.empty() ? "recorded outputs" : reference_file) << " [rad/s]: max " << max_delta
+              << ", rms " << (delta_cnt > 0 ? std::sqrt(sum_sq_delta / delta_cnt) : 0.0)
+              << ", " << above_tolerance << " cycles above " << tolerance
+              << ", " << result_mismatches << " result mismatches" << std::endl;
+
+    return (above_tolerance > 0 || result_mismatches > 0) ? 2 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string>
+#include <utility>
+
+#include "cob_twist_controller/tf_cache.h"
+
+TfCache::TfCache(tf::TransformListener& tf_listener)
+: tf_listener_(tf_listener),
+  pairs_cnt_(0),
+  running_(false)
+{}
+
+int32_t TfCache::addFramePair(const std::string& target_frame, const std::string& source_frame)
+{
+    boost::mutex::scoped_lock lock(this->pairs_lock_);
+
+    const std::pair<std::string, std::string> key(target_frame, source_frame);
+    std::map<std::pair<std::string, std::string>, int32_t>::const_iterator it = this->pair_indices_.find(key);
+    if (it != this->pair_indices_.end())
+    {
+        return it->second;
+    }
+
+    const uint32_t idx = this->pairs_cnt_.load(boost::memory_order_relaxed);
+    if (idx >= TF_CACHE_MAX_FRAME_PAIRS)
+    {
+        ROS_ERROR_STREAM("TfCache: Cannot register more than " << TF_CACHE_MAX_FRAME_PAIRS << " frame pairs");
+        return -1;
+    }
+
+    FramePair& pair = this->pairs_[idx];
+    pair.target_frame = target_frame;
+    pair.source_frame = source_frame;
+    this->refresh(pair);
+
+    this->pair_indices_[key] = idx;
+    this->pairs_cnt_.store(idx + 1, boost::memory_order_release);
+    return idx;
+}
+
+void TfCache::start(double rate)
+{
+    this->stop();
+
+    if (rate <= 0.0)
+    {
+        ROS_WARN_STREAM("TfCache: Invalid rate " << rate << ", using " << TF_CACHE_DEFAULT_RATE << " Hz");
+        rate = TF_CACHE_DEFAULT_RATE;
+    }
+
+    this->running_ = true;
+    this->thread_ = boost::thread(&TfCache::run, this, rate);
+}
+
+void TfCache::stop()
+{
+    this->running_ = false;
+    if (this->thread_.joinable())
+    {
+        this->thread_.join();
+    }
+}
+
+bool TfCache::getTransform(int32_t idx, tf::StampedTransform& transform, double max_age) const
+{
+    if (idx < 0 || static_cast<uint32_t>(idx) >= this->pairs_cnt_.load(boost::memory_order_acquire))
+    {
+        return false;
+    }
+
+    boost::shared_ptr<const tf::StampedTransform> snapshot = boost::atomic_load(&this->pairs_[idx].transform);
+    if (!snapshot)
+    {
+        return false;
+    }
+
+    /// the lookup of the latest transform keeps succeeding with the last known one if a frame is not published anymore
+    if (max_age > 0.0 && !snapshot->stamp_.isZero() && (ros::Time::now() - snapshot->stamp_).toSec() > max_age)
+    {
+        ROS_WARN_STREAM_THROTTLE(1, "TfCache: The transform from " << this->pairs_[idx].source_frame << " to "
+                                 << this->pairs_[idx].target_frame << " is older than " << max_age << " s");
+        return false;
+    }
+
+    transform = *snapshot;
+    return true;
+}
+
+bool TfCache::refresh(FramePair& pair)
+{
+    boost::shared_ptr<tf::StampedTransform> transform(new tf::StampedTransform());
+    try
+    {
+        /// ros::Time(0): latest available transform, i.e. lookupTransform does not wait
+        this->tf_listener_.lookupTransform(pair.target_frame, pair.source_frame, ros::Time(0), *transform);
+    }
+    catch (tf::TransformException& ex)
+    {
+        ROS_DEBUG_STREAM_THROTTLE(1, "TfCache: " << ex.what());
+        return false;
+    }
+
+    boost::atomic_store(&pair.transform, boost::shared_ptr<const tf::StampedTransform>(transform));
+    return true;
+}
+
+/**
+ * Background loop: refreshes all registered pairs, such that the control loop never waits for the TF tree.
+ * If a pair is not available, the last known transform is kept.
+ */
+void TfCache::run(double rate)
+{
+    ros::WallRate loop_rate(rate);
+    while (this->running_ && ros::ok())
+    {
+        const uint32_t cnt = this->pairs_cnt_.load(boost::memory_order_acquire);
+        for (uint32_t i = 0; i < cnt; ++i)
+        {
+            this->refresh(this->pairs_[i]);
+        }
+
+        loop_rate.sleep();
+    }
+}
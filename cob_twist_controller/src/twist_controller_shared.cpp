@@ -0,0 +1,202 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <kdl_parser/kdl_parser.hpp>
+#include <boost/make_shared.hpp>
+
+#include "cob_twist_controller/twist_controller_shared.h"
+
+namespace
+{
+    /// Executes the JointStatesCallback of a consumer with its latest joint states within the callback queue of the consumer.
+    class JointStatesCall : public ros::CallbackInterface
+    {
+        public:
+            explicit JointStatesCall(const boost::shared_ptr<TwistControllerShared::JointStatesSlot>& slot)
+            : slot_(slot)
+            {}
+
+            virtual CallResult call()
+            {
+                TwistControllerShared::JointStatesSlot& slot = *this->slot_;
+                {
+                    boost::mutex::scoped_lock lock(slot.lock);
+                    slot.q_call = slot.q;
+                    slot.q_dot_call = slot.q_dot;
+                    slot.pending = false;
+                }
+
+                slot.callback(slot.q_call, slot.q_dot_call);
+                return Success;
+            }
+
+        private:
+            boost::shared_ptr<TwistControllerShared::JointStatesSlot> slot_;
+    };
+
+    inline uint64_t ownerId(const void* owner)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(owner));
+    }
+}
+
+TwistControllerShared::TwistControllerShared()
+: tf_cache_(tf_listener_)
+{}
+
+bool TwistControllerShared::initialize(ros::NodeHandle& nh)
+{
+    /// parse robot_description once for all chains
+    if (!nh.getParam("/robot_description", this->robot_description_))
+    {
+        ROS_ERROR("Parameter '/robot_description' not set");
+        return false;
+    }
+
+    if (!kdl_parser::treeFromString(this->robot_description_, this->tree_))
+    {
+        ROS_ERROR("Failed to construct kdl tree");
+        return false;
+    }
+
+    if (!this->model_.initString(this->robot_description_))
+    {
+        ROS_ERROR("Failed to parse urdf file for JointLimits");
+        return false;
+    }
+
+    /// give tf_listener some time to fill tf-cache
+    ros::Duration(1.0).sleep();
+
+    double tf_cache_rate;
+    nh.param<double>("twist_controller/tf_cache_rate", tf_cache_rate, TF_CACHE_DEFAULT_RATE);
+    this->tf_cache_.start(tf_cache_rate);
+
+    this->joint_states_sub_ = nh.subscribe("joint_states", 1, &TwistControllerShared::jointStatesCallback, this);
+    return true;
+}
+
+void TwistControllerShared::registerJointStates(const void* owner,
+                                                const std::vector<std::string>& joints,
+                                                ros::CallbackQueueInterface* queue,
+                                                const JointStatesCallback& callback)
+{
+    JointStatesConsumer consumer;
+    consumer.owner = owner;
+    consumer.joints = joints;
+    consumer.queue = queue;
+    consumer.slot = boost::make_shared<JointStatesSlot>();
+    consumer.slot->q.resize(joints.size());
+    consumer.slot->q_dot.resize(joints.size());
+    consumer.slot->pending = false;
+    consumer.slot->callback = callback;
+
+    boost::mutex::scoped_lock lock(this->consumers_lock_);
+    this->consumers_.push_back(consumer);
+}
+
+void TwistControllerShared::unregisterJointStates(const void* owner)
+{
+    boost::mutex::scoped_lock lock(this->consumers_lock_);
+    for (std::vector<JointStatesConsumer>::iterator it = this->consumers_.begin(); it != this->consumers_.end();)
+    {
+        if (it->owner == owner)
+        {
+            /// drop the joint states that have not been processed yet
+            it->queue->removeByID(ownerId(owner));
+            it = this->consumers_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/**
+ * Demultiplexes the joint states: each consumer gets the states of its joints in its own callback queue.
+ * The indices of the joints are only searched again if the layout of the messages changes.
+ * A consumer lagging behind the joint_states does not accumulate calls: at most one call per consumer is queued,
+ * which processes the latest joint states.
+ */
+void TwistControllerShared::jointStatesCallback(const sensor_msgs::JointState::ConstPtr& msg)
+{
+    boost::mutex::scoped_lock lock(this->consumers_lock_);
+    for (std::vector<JointStatesConsumer>::iterator it = this->consumers_.begin(); it != this->consumers_.end(); ++it)
+    {
+        if (!this->updateIndices(*msg, *it))
+        {
+            continue;
+        }
+
+        JointStatesSlot& slot = *it->slot;
+        boost::mutex::scoped_lock slot_lock(slot.lock);
+        for (uint16_t j = 0; j < it->joints.size(); ++j)
+        {
+            slot.q(j) = msg->position[it->indices[j]];
+            slot.q_dot(j) = msg->velocity[it->indices[j]];
+        }
+
+        if (!slot.pending)
+        {
+            slot.pending = true;
+            it->queue->addCallback(boost::make_shared<JointStatesCall>(it->slot), ownerId(it->owner));
+        }
+    }
+}
+
+bool TwistControllerShared::updateIndices(const sensor_msgs::JointState& msg, JointStatesConsumer& consumer) const
+{
+    const size_t size = std::min(msg.name.size(), std::min(msg.position.size(), msg.velocity.size()));
+
+    bool valid = (consumer.indices.size() == consumer.joints.size());
+    for (uint16_t j = 0; valid && j < consumer.joints.size(); ++j)
+    {
+        valid = (consumer.indices[j] >= 0 &&
+                 static_cast<size_t>(consumer.indices[j]) < size &&
+                 msg.name[consumer.indices[j]] == consumer.joints[j]);
+    }
+
+    if (valid)
+    {
+        return true;
+    }
+
+    consumer.indices.assign(consumer.joints.size(), -1);
+    for (uint16_t j = 0; j < consumer.joints.size(); ++j)
+    {
+        for (uint16_t i = 0; i < size; ++i)
+        {
+            if (msg.name[i] == consumer.joints[j])
+            {
+                consumer.indices[j] = i;
+                break;
+            }
+        }
+
+        if (consumer.indices[j] < 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}